@@ -103,6 +103,13 @@ namespace bmx
 
 		bool is_handled = false;
 
+		// Stamping scheduler pop time for sampled request traces.
+		if (((*(uint32_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_SOCKET_FLAGS)) & MixedCodeConstants::SOCKET_DATA_FLAGS_TRACED) != 0) {
+			LARGE_INTEGER ticks;
+			QueryPerformanceCounter(&ticks);
+			(*(uint64_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_TRACE_SCHEDULER_POP_TICKS)) = ticks.QuadPart;
+		}
+
 		// Send the response back.
 		if (((*(uint32_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_SOCKET_FLAGS)) & MixedCodeConstants::SOCKET_DATA_GATEWAY_AND_IPC_TEST) != 0)
 		{
@@ -489,6 +489,13 @@ EXTERN_C uint32_t __stdcall sc_bmx_send_buffer(
     // Points to user data offset in chunk.
     uint32_t chunk_user_data_offset = starcounter::MixedCodeConstants::CHUNK_OFFSET_SOCKET_DATA + starcounter::MixedCodeConstants::SOCKET_DATA_OFFSET_BLOB;
 
+    // Stamping response push time for sampled request traces.
+    if (((*(uint32_t*)(cur_chunk_buf + starcounter::MixedCodeConstants::CHUNK_OFFSET_SOCKET_FLAGS)) & starcounter::MixedCodeConstants::SOCKET_DATA_FLAGS_TRACED) != 0) {
+        LARGE_INTEGER ticks;
+        QueryPerformanceCounter(&ticks);
+        (*(uint64_t*)(cur_chunk_buf + starcounter::MixedCodeConstants::CHUNK_OFFSET_TRACE_RESPONSE_PUSH_TICKS)) = ticks.QuadPart;
+    }
+
     // Adding connection flags.
     (*(uint32_t*)(cur_chunk_buf + starcounter::MixedCodeConstants::CHUNK_OFFSET_SOCKET_FLAGS)) |= conn_flags;
 
@@ -0,0 +1,61 @@
+//
+// fake_codehost.cpp
+// fake_codehost
+//
+// Copyright  2006-2013 Starcounter AB. All rights reserved.
+// Starcounter is a registered trademark of Starcounter AB.
+//
+// This fake codehost is for the Windows platform.
+//
+
+#include <cstdint>
+#include <iostream>
+#include "fake_codehost.hpp"
+
+// Usage example with database named "fakedb" running under PERSONAL server,
+// 4 schedulers, a gateway with 2 workers and system port 8181, serving the
+// handlers in handlers.txt for 60000 milliseconds:
+//>sc_fake_codehost.exe PERSONAL fakedb 4 2 8181 handlers.txt 60000
+int wmain(int argc, wchar_t* argv[], wchar_t* envp[])
+try {
+	starcounter::interprocess_communication::fake_codehost app(argc, argv);
+	app.initialize();
+	app.run();
+
+	std::cout << "Fake codehost serving " << app.handlers() << " handler(s). . ." << std::endl;
+
+	// The main thread prints statistics once a second while the schedulers run.
+	for (uint32_t elapsed_ms = 0; (0 == app.timeout()) || (elapsed_ms < app.timeout()); elapsed_ms += 1000) {
+		::Sleep(1000);
+		app.show_statistics(1000);
+	}
+
+	std::cout << "Fake codehost done, stopping all schedulers. . ." << std::endl;
+	app.stop();
+	::exit(EXIT_SUCCESS);
+}
+catch (starcounter::interprocess_communication::fake_codehost_exception& e) {
+	std::cout << "error: fake_codehost_exception "
+	<< "caught with error code " << e.error_code() << std::endl;
+	::exit(EXIT_FAILURE);
+}
+catch (starcounter::core::database_shared_memory_parameters_ptr_exception& e) {
+	std::cout << "error: database_shared_memory_parameters_ptr_exception "
+	<< "caught with error code " << e.error_code() << std::endl;
+	::exit(EXIT_FAILURE);
+}
+catch (starcounter::core::monitor_interface_ptr_exception& e) {
+	std::cout << "error: monitor_interface_ptr_exception "
+	<< "caught with error code " << e.error_code() << std::endl;
+	::exit(EXIT_FAILURE);
+}
+catch (boost::interprocess::interprocess_exception&) {
+	std::cout << "error: boost::interprocess::interprocess_exception caught"
+	<< std::endl;
+	::exit(EXIT_FAILURE);
+}
+catch (...) {
+	// An unknown exception was caught.
+	std::cout << "error: unknown exception caught" << std::endl;
+	::exit(EXIT_FAILURE);
+}
@@ -0,0 +1,219 @@
+//
+// fake_codehost.hpp
+// fake_codehost
+//
+// Copyright  2006-2013 Starcounter AB. All rights reserved.
+// Starcounter is a registered trademark of Starcounter AB.
+//
+// A codehost stand-in that speaks the IPC protocol with the network gateway.
+// It registers configurable URI handlers and answers them with canned or
+// size-parameterised HTTP responses after an optional synthetic handler
+// latency, so that the gateway plus IPC can be benchmarked without a
+// database.
+//
+
+#ifndef STARCOUNTER_INTERPROCESS_COMMUNICATION_FAKE_CODEHOST_HPP
+#define STARCOUNTER_INTERPROCESS_COMMUNICATION_FAKE_CODEHOST_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#if defined(_MSC_VER)
+# define WIN32_LEAN_AND_MEAN
+# include <winsock2.h>
+# include <windows.h>
+# undef WIN32_LEAN_AND_MEAN
+#endif // (_MSC_VER)
+#include <intrin.h>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#include "../common/macro_definitions.hpp"
+#include "../common/noncopyable.hpp"
+#include "../common/config_param.hpp"
+#include "../common/pid_type.hpp"
+#include "../common/owner_id.hpp"
+#include "../common/chunk.hpp"
+#include "../common/database_shared_memory_parameters.hpp"
+#include "../common/monitor_interface.hpp"
+#include <sccoreerr.h>
+
+typedef struct _sc_io_event
+{
+	unsigned long client_index_;
+
+	unsigned long long chunk_index_;
+} sc_io_event;
+
+// These functions are exported by the server library.
+EXTERN_C unsigned long sc_initialize_io_service(const char* name, const char* server_name, unsigned long port_count, bool is_system, unsigned int num_shm_chunks, unsigned char gateway_num_workers);
+EXTERN_C unsigned long server_initialize_port(void *port_mem128, const char *name, unsigned long port_number, owner_id_value_type owner_id_value, uint32_t channels_size);
+EXTERN_C unsigned long server_get_next_signal_or_task(void *port, unsigned int timeout_milliseconds, sc_io_event *pio_event);
+EXTERN_C unsigned long sc_send_to_client(void *port, unsigned long channel_index, unsigned long chunk_index);
+EXTERN_C unsigned long sc_acquire_linked_shared_memory_chunks_counted(void *port, unsigned long start_chunk_index, unsigned long num_chunks);
+EXTERN_C void *sc_get_shared_memory_chunk(void *port, unsigned long long chunk_index);
+EXTERN_C unsigned long sc_release_linked_shared_memory_chunks(void *port, unsigned long start_chunk_index);
+
+namespace starcounter {
+namespace interprocess_communication {
+
+using namespace starcounter::core;
+
+/// Exception class.
+class fake_codehost_exception {
+public:
+	typedef uint32_t error_code_type;
+
+	explicit fake_codehost_exception(error_code_type err)
+	: err_(err) {}
+
+	error_code_type error_code() const {
+		return err_;
+	}
+
+private:
+	error_code_type err_;
+};
+
+/// One URI handler served by the fake codehost.
+struct fake_handler {
+	// Port the handler is registered on in the gateway.
+	uint16_t port_;
+
+	// Method and URI, for example "GET /ping".
+	std::string method_space_uri_;
+
+	// Complete HTTP response, built once when the handlers are loaded.
+	std::string response_;
+
+	// Synthetic handler latency in performance counter ticks.
+	int64_t latency_ticks_;
+};
+
+/// Per scheduler state, each scheduler runs in its own thread.
+struct CACHE_LINE_ALIGN fake_scheduler {
+	// Memory for the server port.
+	uint8_t port_[128];
+
+	// Scheduler number.
+	uint32_t id_;
+
+	// Number of handled requests.
+	volatile int64_t num_handled_;
+
+	// Number of chunks that had no known handler.
+	volatile int64_t num_unknown_;
+
+	// Scheduler thread handle.
+	::HANDLE thread_;
+
+	// Back pointer used by the thread routine.
+	class fake_codehost* owner_;
+};
+
+/// Class fake_codehost.
+/**
+ * @throws fake_codehost_exception when something can not be achieved.
+ */
+class fake_codehost : private noncopyable {
+public:
+	enum {
+		// Maximum number of URI handlers.
+		max_handlers = 256,
+
+		// Number of shared memory chunks.
+		default_num_chunks = 1 << 16
+	};
+
+	/// Construction of the fake codehost.
+	/**
+	 * @param argc Argument count.
+	 * @param argv Argument vector.
+	 * @throws fake_codehost_exception if the arguments are wrong.
+	 */
+	explicit fake_codehost(int argc, wchar_t* argv[]);
+
+	/// Destruction of the fake codehost.
+	// It waits for scheduler threads to finish.
+	~fake_codehost();
+
+	/// Creates the database shared memory and registers with the IPC monitor.
+	void initialize();
+
+	/// Starts the schedulers and registers the codehost and handlers in the gateway.
+	void run();
+
+	/// Stops the schedulers and unregisters the codehost in the gateway.
+	void stop();
+
+	/// Prints handled requests since the last call.
+	void show_statistics(uint32_t interval_ms);
+
+	/// Get timeout in milliseconds, 0 means run until killed.
+	uint32_t timeout() const {
+		return timeout_;
+	}
+
+	/// Get number of handlers.
+	std::size_t handlers() const {
+		return handlers_.size();
+	}
+
+private:
+	/// Loads handlers from the handlers file.
+	void load_handlers(const std::string& handlers_file);
+
+	/// Sends an HTTP request to the gateway system port.
+	uint32_t send_to_gateway(const std::string& method_and_uri, const std::string& body);
+
+	/// Scheduler thread routine.
+	static DWORD WINAPI scheduler_routine(LPVOID arg);
+
+	/// Processes one request chunk on the given scheduler.
+	void process_chunk(fake_scheduler& s, unsigned long client_index, chunk_index the_chunk_index);
+
+	/// Writes the response into the request chunk and sends it back.
+	void send_response(fake_scheduler& s, unsigned long channel_index, chunk_index the_chunk_index, const std::string& response);
+
+	std::string server_name_;
+	std::string database_name_;
+	std::string segment_name_;
+	uint32_t num_schedulers_;
+	uint32_t gateway_workers_;
+	uint16_t system_port_;
+	uint32_t timeout_;
+	bool is_system_;
+
+	database_shared_memory_parameters_ptr db_shm_params_;
+	monitor_interface_ptr the_monitor_interface_;
+	pid_type pid_;
+	owner_id owner_id_;
+
+	// Set when registered with the IPC monitor.
+	bool registered_;
+
+	std::vector<fake_handler> handlers_;
+	fake_scheduler scheduler_[max_number_of_schedulers];
+
+	// Set when schedulers should stop.
+	volatile bool stop_;
+
+	// Total handled requests at the last statistics print.
+	int64_t last_handled_;
+};
+
+} // namespace interprocess_communication
+} // namespace starcounter
+
+#include "impl/fake_codehost.hpp"
+
+#endif // STARCOUNTER_INTERPROCESS_COMMUNICATION_FAKE_CODEHOST_HPP
@@ -0,0 +1,540 @@
+//
+// impl/fake_codehost.hpp
+// fake_codehost
+//
+// Copyright  2006-2013 Starcounter AB. All rights reserved.
+// Starcounter is a registered trademark of Starcounter AB.
+//
+// Implementation of class fake_codehost.
+//
+
+#ifndef STARCOUNTER_INTERPROCESS_COMMUNICATION_IMPL_FAKE_CODEHOST_HPP
+#define STARCOUNTER_INTERPROCESS_COMMUNICATION_IMPL_FAKE_CODEHOST_HPP
+
+// Implementation
+
+namespace starcounter {
+namespace interprocess_communication {
+
+fake_codehost::fake_codehost(int argc, wchar_t* argv[])
+: num_schedulers_(0),
+gateway_workers_(0),
+system_port_(0),
+timeout_(0),
+is_system_(false),
+registered_(false),
+stop_(false),
+last_handled_(0) {
+	///=========================================================================
+	/// First argument: <server name>, for example "PERSONAL" or "SYSTEM".
+	/// Second argument: <database name>, for example "fakedb".
+	/// Third argument: <number of schedulers>, for example "4".
+	/// Fourth argument: <number of gateway workers>, must match the gateway.
+	/// Fifth argument: <gateway system port>, for example "8181".
+	/// Sixth argument: <handlers file>, see load_handlers().
+	/// Seventh argument (optional): <timeout in milliseconds>, 0 runs until
+	/// the process is killed.
+	///
+	/// Example:
+	/// >sc_fake_codehost.exe PERSONAL fakedb 4 2 8181 handlers.txt 60000
+	///=========================================================================
+	for (std::size_t s = 0; s < max_number_of_schedulers; ++s) {
+		scheduler_[s].thread_ = NULL;
+	}
+
+	if (argc < 7) {
+		std::wcout << "Please enter the arguments in this order:\n"
+		"First argument: <server name>, for example \"PERSONAL\" or \"SYSTEM\".\n"
+		"Second argument: <database name>, for example \"fakedb\".\n"
+		"Third argument: <number of schedulers>, for example \"4\".\n"
+		"Fourth argument: <number of gateway workers>, for example \"2\".\n"
+		"Fifth argument: <gateway system port>, for example \"8181\".\n"
+		"Sixth argument: <handlers file>, one handler per line:\n"
+		"    <port> <method> <uri> <response body size | =canned body> [<latency in microseconds>]\n"
+		"Seventh argument (optional): <timeout in milliseconds>, 0 runs until killed.\n"
+		<< std::endl;
+
+		throw fake_codehost_exception(SCERRUNSPECIFIED);
+	}
+
+	char buffer[segment_name_size];
+
+	// Convert the arguments from wide-character strings to multibyte strings.
+	std::wcstombs(buffer, argv[1], segment_name_size -1);
+	buffer[segment_name_size -1] = '\0';
+	server_name_ = boost::to_upper_copy<std::string>(std::string(buffer));
+	is_system_ = (server_name_ == "SYSTEM");
+
+	std::wcstombs(buffer, argv[2], segment_name_size -1);
+	buffer[segment_name_size -1] = '\0';
+	database_name_ = boost::to_lower_copy<std::string>(std::string(buffer));
+
+	std::wcstombs(buffer, argv[3], segment_name_size -1);
+	buffer[segment_name_size -1] = '\0';
+	num_schedulers_ = std::atoi(buffer);
+
+	std::wcstombs(buffer, argv[4], segment_name_size -1);
+	buffer[segment_name_size -1] = '\0';
+	gateway_workers_ = std::atoi(buffer);
+
+	std::wcstombs(buffer, argv[5], segment_name_size -1);
+	buffer[segment_name_size -1] = '\0';
+	system_port_ = static_cast<uint16_t>(std::atoi(buffer));
+
+	if ((num_schedulers_ == 0) || (num_schedulers_ > max_number_of_schedulers) ||
+	(gateway_workers_ == 0) || (gateway_workers_ > max_number_of_clients) ||
+	(system_port_ == 0)) {
+		std::cout << "error: wrong number of schedulers, gateway workers or system port." << std::endl;
+		throw fake_codehost_exception(SCERRUNSPECIFIED);
+	}
+
+	std::wcstombs(buffer, argv[6], segment_name_size -1);
+	buffer[segment_name_size -1] = '\0';
+	load_handlers(buffer);
+
+	if (argc >= 8) {
+		std::wcstombs(buffer, argv[7], segment_name_size -1);
+		buffer[segment_name_size -1] = '\0';
+		timeout_ = std::atoi(buffer);
+	}
+}
+
+fake_codehost::~fake_codehost() {
+	// Join scheduler threads.
+	stop();
+}
+
+void fake_codehost::load_handlers(const std::string& handlers_file) {
+	std::ifstream f(handlers_file.c_str());
+
+	if (!f.is_open()) {
+		std::cout << "error: can't open handlers file " << handlers_file << std::endl;
+		throw fake_codehost_exception(SCERRUNSPECIFIED);
+	}
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+
+	// Largest response that fits in the request chunk plus one round of
+	// linked chunks.
+	const int64_t max_response_bytes = MixedCodeConstants::SOCKET_DATA_BLOB_SIZE_BYTES
+		+ MixedCodeConstants::MAX_BYTES_EXTRA_LINKED_IPC_CHUNKS;
+
+	std::string line;
+
+	while (std::getline(f, line)) {
+		// Skipping empty lines and comments.
+		std::size_t first = line.find_first_not_of(" \t\r");
+		if ((std::string::npos == first) || (line[first] == '#'))
+			continue;
+
+		std::stringstream ss(line);
+		int32_t port = 0;
+		std::string method, uri, body;
+		int64_t latency_us = 0;
+
+		ss >> port >> method >> uri >> body;
+		if (!(ss >> latency_us))
+			latency_us = 0;
+
+		if ((port <= 0) || (port >= 65536) || uri.empty() || body.empty() || (latency_us < 0)) {
+			std::cout << "error: wrong handler line \"" << line << "\"." << std::endl;
+			throw fake_codehost_exception(SCERRUNSPECIFIED);
+		}
+
+		// Canned body starts with '=', otherwise it is the body size in bytes.
+		if (body[0] == '=') {
+			body = body.substr(1);
+		}
+		else {
+			int64_t body_size = _atoi64(body.c_str());
+			if ((body_size < 0) || (body_size > max_response_bytes)) {
+				std::cout << "error: wrong response size in handler line \"" << line << "\"." << std::endl;
+				throw fake_codehost_exception(SCERRUNSPECIFIED);
+			}
+
+			body.assign(static_cast<std::size_t>(body_size), 'x');
+		}
+
+		std::stringstream response;
+		response << "HTTP/1.1 200 OK\r\n"
+			"Content-Type: text/plain\r\n"
+			"Content-Length: " << body.size() << "\r\n\r\n" << body;
+
+		fake_handler h;
+		h.port_ = static_cast<uint16_t>(port);
+		h.method_space_uri_ = method + " " + uri;
+		h.response_ = response.str();
+		h.latency_ticks_ = (latency_us * freq.QuadPart) / 1000000;
+
+		if ((static_cast<int64_t>(h.response_.size()) > max_response_bytes) || (handlers_.size() >= max_handlers)) {
+			std::cout << "error: response too big or too many handlers at line \"" << line << "\"." << std::endl;
+			throw fake_codehost_exception(SCERRUNSPECIFIED);
+		}
+
+		handlers_.push_back(h);
+	}
+
+	if (handlers_.empty()) {
+		std::cout << "error: no handlers in " << handlers_file << std::endl;
+		throw fake_codehost_exception(SCERRUNSPECIFIED);
+	}
+}
+
+void fake_codehost::initialize() {
+	///=========================================================================
+	/// Open or create the database shared memory parameters. The format is
+	/// <DATABASE_NAME_PREFIX>_<SERVER_NAME>_<DATABASE_NAME>_0, which is the
+	/// name the gateway opens when the codehost is registered.
+	///=========================================================================
+	std::string db_shm_params_name = std::string(DATABASE_NAME_PREFIX) + "_"
+		+ server_name_ + "_" + boost::to_upper_copy<std::string>(database_name_) + "_0";
+
+	db_shm_params_.init(db_shm_params_name.c_str(), is_system_);
+	db_shm_params_->set_server_name(server_name_.c_str());
+
+	// The new segment gets the next sequence number.
+	std::stringstream segment_name;
+	segment_name << DATABASE_NAME_PREFIX << "_" << server_name_ << "_"
+		<< boost::to_upper_copy<std::string>(database_name_) << "_"
+		<< (db_shm_params_->get_sequence_number() +1);
+	segment_name_ = segment_name.str();
+
+	///=========================================================================
+	/// Register with the IPC monitor, same as a database process.
+	///=========================================================================
+	std::string monitor_interface_name = server_name_ + "_" + MONITOR_INTERFACE_SUFFIX;
+	the_monitor_interface_.init(monitor_interface_name.c_str());
+
+	pid_.set_current();
+
+	uint32_t err_code = the_monitor_interface_->register_database_process(pid_,
+		segment_name_, owner_id_, 10000);
+
+	if (err_code) {
+		std::cout << "error: can't register with the IPC monitor." << std::endl;
+		throw fake_codehost_exception(err_code);
+	}
+
+	registered_ = true;
+
+	///=========================================================================
+	/// Create the database shared memory and the server ports. Schedulers
+	/// must be active before the gateway attaches, since it reads the number
+	/// of active schedulers.
+	///=========================================================================
+	err_code = sc_initialize_io_service(segment_name_.c_str(), server_name_.c_str(),
+		num_schedulers_, is_system_, default_num_chunks, static_cast<unsigned char>(gateway_workers_));
+
+	if (err_code) {
+		std::cout << "error: can't create the database shared memory." << std::endl;
+		throw fake_codehost_exception(err_code);
+	}
+
+	db_shm_params_->increment_sequence_number();
+
+	for (uint32_t s = 0; s < num_schedulers_; ++s) {
+		scheduler_[s].id_ = s;
+		scheduler_[s].num_handled_ = 0;
+		scheduler_[s].num_unknown_ = 0;
+		scheduler_[s].owner_ = this;
+
+		err_code = server_initialize_port(scheduler_[s].port_, segment_name_.c_str(), s,
+			owner_id_.get(), num_schedulers_ * gateway_workers_);
+
+		if (err_code) {
+			std::cout << "error: can't initialize server port " << s << "." << std::endl;
+			throw fake_codehost_exception(err_code);
+		}
+	}
+
+	std::cout << "Fake codehost initialized with segment name: " << segment_name_ << std::endl;
+}
+
+void fake_codehost::run() {
+	for (uint32_t s = 0; s < num_schedulers_; ++s) {
+		scheduler_[s].thread_ = ::CreateThread(NULL, 0, scheduler_routine, &scheduler_[s], 0, NULL);
+
+		if (NULL == scheduler_[s].thread_) {
+			throw fake_codehost_exception(SCERRUNSPECIFIED);
+		}
+	}
+
+	WSADATA wsa_data;
+	if (0 != WSAStartup(MAKEWORD(2, 2), &wsa_data)) {
+		throw fake_codehost_exception(SCERRUNSPECIFIED);
+	}
+
+	// Registering the codehost, the gateway attaches to the shared memory.
+	uint32_t err_code = send_to_gateway("POST /gw/codehost",
+		database_name_ + " " + MixedCodeConstants::EndOfRequest);
+
+	if (err_code) {
+		std::cout << "error: can't register codehost " << database_name_ << " in the gateway." << std::endl;
+		throw fake_codehost_exception(err_code);
+	}
+
+	// Registering the handlers, handler info is the index in handlers_.
+	for (std::size_t i = 0; i < handlers_.size(); ++i) {
+		std::string uri = handlers_[i].method_space_uri_;
+		std::replace(uri.begin(), uri.end(), ' ', '\\');
+
+		std::stringstream body;
+		body << database_name_ << " fake_codehost " << i << " " << handlers_[i].port_
+			<< " " << uri << " 0\r\n\r\n\r\n\r\n";
+
+		err_code = send_to_gateway("POST /gw/handler/uri", body.str());
+
+		if (err_code) {
+			std::cout << "error: can't register handler \"" << handlers_[i].method_space_uri_
+				<< "\" on port " << handlers_[i].port_ << "." << std::endl;
+			throw fake_codehost_exception(err_code);
+		}
+	}
+}
+
+void fake_codehost::stop() {
+	if (stop_)
+		return;
+
+	stop_ = true;
+
+	for (uint32_t s = 0; s < num_schedulers_; ++s) {
+		if (NULL != scheduler_[s].thread_) {
+			::WaitForSingleObject(scheduler_[s].thread_, INFINITE);
+			::CloseHandle(scheduler_[s].thread_);
+			scheduler_[s].thread_ = NULL;
+		}
+	}
+
+	// Detaching from the gateway and the IPC monitor, ignoring errors since
+	// the process is going down anyway.
+	if (registered_) {
+		send_to_gateway("DELETE /gw/codehost", database_name_ + " " + MixedCodeConstants::EndOfRequest);
+		the_monitor_interface_->unregister_database_process(pid_, owner_id_, 10000);
+	}
+}
+
+void fake_codehost::show_statistics(uint32_t interval_ms) {
+	int64_t handled = 0, unknown = 0;
+
+	for (uint32_t s = 0; s < num_schedulers_; ++s) {
+		handled += scheduler_[s].num_handled_;
+		unknown += scheduler_[s].num_unknown_;
+	}
+
+	std::cout << "Handled: " << handled << " (" << ((handled - last_handled_) * 1000 / interval_ms)
+		<< "/s), unknown: " << unknown << std::endl;
+
+	last_handled_ = handled;
+}
+
+uint32_t fake_codehost::send_to_gateway(const std::string& method_and_uri, const std::string& body) {
+	SOCKET sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (INVALID_SOCKET == sock)
+		return SCERRUNSPECIFIED;
+
+	DWORD recv_timeout_ms = 10000;
+	::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*) &recv_timeout_ms, sizeof(recv_timeout_ms));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(system_port_);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (0 != ::connect(sock, (sockaddr*) &addr, sizeof(addr))) {
+		::closesocket(sock);
+		return SCERRUNSPECIFIED;
+	}
+
+	std::stringstream request;
+	request << method_and_uri << " HTTP/1.1\r\n"
+		"Host: localhost\r\n"
+		"Content-Length: " << body.size() << "\r\n\r\n" << body;
+
+	std::string request_str = request.str();
+
+	for (std::size_t sent = 0; sent < request_str.size(); ) {
+		int n = ::send(sock, request_str.c_str() + sent, static_cast<int>(request_str.size() - sent), 0);
+		if (n <= 0) {
+			::closesocket(sock);
+			return SCERRUNSPECIFIED;
+		}
+
+		sent += n;
+	}
+
+	// Reading until the response headers are complete.
+	std::string response;
+	char buf[1024];
+
+	while (std::string::npos == response.find("\r\n\r\n")) {
+		int n = ::recv(sock, buf, sizeof(buf), 0);
+		if (n <= 0)
+			break;
+
+		response.append(buf, n);
+	}
+
+	::closesocket(sock);
+
+	// Checking for "HTTP/1.1 2xx".
+	if ((response.size() > 9) && (response.compare(0, 5, "HTTP/") == 0) &&
+		(response[response.find(' ') + 1] == '2')) {
+		return 0;
+	}
+
+	// Picking the error code from the gateway if any.
+	std::size_t err_header = response.find(MixedCodeConstants::ScErrorCodeHttpHeader);
+	if (std::string::npos != err_header) {
+		uint32_t err_code = std::strtoul(response.c_str() + err_header +
+			strlen(MixedCodeConstants::ScErrorCodeHttpHeader) + 1, NULL, 10);
+
+		if (err_code)
+			return err_code;
+	}
+
+	return SCERRUNSPECIFIED;
+}
+
+DWORD WINAPI fake_codehost::scheduler_routine(LPVOID arg) {
+	fake_scheduler& s = *reinterpret_cast<fake_scheduler*>(arg);
+	sc_io_event io_event;
+
+	while (!s.owner_->stop_) {
+		unsigned long err_code = server_get_next_signal_or_task(s.port_, 100, &io_event);
+
+		if (SCERRWAITTIMEOUT == err_code)
+			continue;
+
+		if (err_code) {
+			std::cout << "error: scheduler " << s.id_ << " failed with error " << err_code << std::endl;
+			return err_code;
+		}
+
+		// Signals and tasks from other schedulers are not used.
+		if (static_cast<unsigned long>(no_client_number) == io_event.client_index_)
+			continue;
+
+		s.owner_->process_chunk(s, io_event.client_index_, static_cast<chunk_index>(io_event.chunk_index_));
+	}
+
+	return 0;
+}
+
+void fake_codehost::process_chunk(fake_scheduler& s, unsigned long client_index, chunk_index the_chunk_index) {
+	uint8_t* raw_chunk = (uint8_t*) sc_get_shared_memory_chunk(s.port_, the_chunk_index);
+	chunk_type* smc = (chunk_type*) raw_chunk;
+	uint32_t flags = *(uint32_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_SOCKET_FLAGS);
+
+	// Channel between the gateway worker and this scheduler.
+	unsigned long channel_index = client_index * num_schedulers_ + s.id_;
+
+	// Sending gateway and IPC test chunks back as is.
+	if (flags & MixedCodeConstants::SOCKET_DATA_GATEWAY_AND_IPC_TEST) {
+		sc_send_to_client(s.port_, channel_index, the_chunk_index);
+		s.num_handled_++;
+		return;
+	}
+
+	// Stamping scheduler pop time for sampled request traces.
+	if (flags & MixedCodeConstants::SOCKET_DATA_FLAGS_TRACED) {
+		LARGE_INTEGER ticks;
+		QueryPerformanceCounter(&ticks);
+		(*(uint64_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_TRACE_SCHEDULER_POP_TICKS)) = ticks.QuadPart;
+	}
+
+	bmx_handler_type handler_info = smc->get_bmx_handler_info();
+
+	// Releasing chunks that are not for any of our handlers.
+	if (handler_info >= handlers_.size()) {
+		sc_release_linked_shared_memory_chunks(s.port_, the_chunk_index);
+		s.num_unknown_++;
+		return;
+	}
+
+	const fake_handler& h = handlers_[static_cast<std::size_t>(handler_info)];
+
+	// Spinning for the synthetic handler latency.
+	if (h.latency_ticks_ > 0) {
+		LARGE_INTEGER start, now;
+		QueryPerformanceCounter(&start);
+
+		do {
+			_mm_pause();
+			QueryPerformanceCounter(&now);
+		} while (now.QuadPart - start.QuadPart < h.latency_ticks_);
+	}
+
+	send_response(s, channel_index, the_chunk_index, h.response_);
+	s.num_handled_++;
+}
+
+void fake_codehost::send_response(fake_scheduler& s, unsigned long channel_index, chunk_index the_chunk_index, const std::string& response) {
+	uint8_t* raw_chunk = (uint8_t*) sc_get_shared_memory_chunk(s.port_, the_chunk_index);
+	chunk_type* smc = (chunk_type*) raw_chunk;
+
+	// Releasing linked request chunks, the response is written from scratch.
+	if (smc->get_link() != chunk_type::link_terminator) {
+		sc_release_linked_shared_memory_chunks(s.port_, smc->get_link());
+		smc->terminate_link();
+	}
+
+	const int32_t len = static_cast<int32_t>(response.size());
+	const int32_t offset = MixedCodeConstants::CHUNK_OFFSET_SOCKET_DATA + MixedCodeConstants::SOCKET_DATA_OFFSET_BLOB;
+	const int32_t first_chunk_bytes = MixedCodeConstants::CHUNK_MAX_DATA_BYTES - offset;
+
+	// Same layout as sc_bmx_send_buffer writes.
+	*(uint32_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_USER_DATA_TOTAL_LENGTH_FROM_DB) = len;
+	*(uint32_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_USER_DATA_NUM_BYTES) = len;
+
+	smc->set_bmx_handler_info(~((bmx_handler_type) 0));
+	smc->set_request_size(0);
+
+	if (len <= first_chunk_bytes) {
+		memcpy(raw_chunk + offset, response.c_str(), len);
+	}
+	else {
+		// Linking enough extra chunks for the rest of the response.
+		uint32_t num_extra_chunks = (len - first_chunk_bytes + MixedCodeConstants::CHUNK_MAX_DATA_BYTES - 1) /
+			MixedCodeConstants::CHUNK_MAX_DATA_BYTES;
+
+		if (sc_acquire_linked_shared_memory_chunks_counted(s.port_, the_chunk_index, num_extra_chunks)) {
+			sc_release_linked_shared_memory_chunks(s.port_, the_chunk_index);
+			return;
+		}
+
+		memcpy(raw_chunk + offset, response.c_str(), first_chunk_bytes);
+
+		int32_t written = first_chunk_bytes;
+		chunk_index cur_chunk_index = smc->get_link();
+
+		while (written < len) {
+			uint8_t* cur_chunk = (uint8_t*) sc_get_shared_memory_chunk(s.port_, cur_chunk_index);
+
+			int32_t n = len - written;
+			if (n > MixedCodeConstants::CHUNK_MAX_DATA_BYTES)
+				n = MixedCodeConstants::CHUNK_MAX_DATA_BYTES;
+
+			memcpy(cur_chunk, response.c_str() + written, n);
+			written += n;
+
+			cur_chunk_index = ((chunk_type*) cur_chunk)->get_link();
+		}
+	}
+
+	// Stamping response push time for sampled request traces.
+	if ((*(uint32_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_SOCKET_FLAGS)) & MixedCodeConstants::SOCKET_DATA_FLAGS_TRACED) {
+		LARGE_INTEGER ticks;
+		QueryPerformanceCounter(&ticks);
+		(*(uint64_t*)(raw_chunk + MixedCodeConstants::CHUNK_OFFSET_TRACE_RESPONSE_PUSH_TICKS)) = ticks.QuadPart;
+	}
+
+	sc_send_to_client(s.port_, channel_index, the_chunk_index);
+}
+
+} // namespace interprocess_communication
+} // namespace starcounter
+
+#endif // STARCOUNTER_INTERPROCESS_COMMUNICATION_IMPL_FAKE_CODEHOST_HPP
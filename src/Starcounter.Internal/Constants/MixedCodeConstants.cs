@@ -74,7 +74,7 @@ namespace Starcounter.Internal
             SOCKET_DATA_FLAGS_JUST_SEND = 2 << 4,
             SOCKET_DATA_FLAGS_JUST_DISCONNECT = 2 << 5,
             SOCKET_DATA_FLAGS_TRIGGER_DISCONNECT = 2 << 6,
-            // Free slot here 2 << 7.
+            SOCKET_DATA_FLAGS_WS_BROADCAST = 2 << 7,
             HTTP_WS_FLAGS_PROXIED_SERVER_SOCKET = 2 << 8,
             HTTP_WS_FLAGS_UNKNOWN_PROXIED_PROTO = 2 << 9,
             HTTP_WS_FLAGS_GRACEFULLY_CLOSE = 2 << 10,
@@ -82,12 +82,14 @@ namespace Starcounter.Internal
             SOCKET_DATA_FLAGS_ON_HOST_ACCUMULATION = 2 << 12,
             HTTP_WS_FLAGS_UPGRADE_APPROVED = 2 << 13,
             HTTP_WS_FLAGS_UPGRADE_REQUEST = 2 << 14,
+            SOCKET_DATA_FLAGS_UDP_BATCH = 2 << 15,
             HTTP_WS_JUST_PUSH_DISCONNECT = 2 << 16,
             SOCKET_DATA_GATEWAY_NO_IPC_TEST = 2 << 17,
             SOCKET_DATA_GATEWAY_AND_IPC_TEST = 2 << 18,
             SOCKET_DATA_GATEWAY_NO_IPC_NO_CHUNKS_TEST = 2 << 19,
             SOCKET_DATA_HOST_LOOPING_CHUNKS = 2 << 20,
-            SOCKET_DATA_STREAMING_RESPONSE_BODY = 2 << 21
+            SOCKET_DATA_STREAMING_RESPONSE_BODY = 2 << 21,
+            SOCKET_DATA_FLAGS_TRACED = 2 << 23
         };
 
         /// <summary>
@@ -123,7 +125,8 @@ namespace Starcounter.Internal
             AGGR_MSG_NO_FLAGS,
             AGGR_MSG_GATEWAY_NO_IPC,
             AGGR_MSG_GATEWAY_AND_IPC,
-            AGGR_MSG_GATEWAY_NO_IPC_NO_CHUNKS
+            AGGR_MSG_GATEWAY_NO_IPC_NO_CHUNKS,
+            AGGR_MSG_WIRE_FORMAT_V2
         };
 
         /// <summary>
@@ -161,6 +164,8 @@ namespace Starcounter.Internal
         public const int SOCKET_DATA_OFFSET_UDP_SOURCE_PORT = 168;
         public const int CHUNK_OFFSET_UPGRADE_PART_BYTES_TO_DB = 104;
         public const int CHUNK_OFFSET_USER_DATA_TOTAL_LENGTH_FROM_DB = 140;
+        public const int CHUNK_OFFSET_TRACE_SCHEDULER_POP_TICKS = 48;
+        public const int CHUNK_OFFSET_TRACE_RESPONSE_PUSH_TICKS = 56;
 
         // Invalid WebSocket channel ID.
         public const int INVALID_WS_CHANNEL_ID = 0;
@@ -241,6 +246,15 @@ namespace Starcounter.Internal
         /// </summary>
         public const int SOCKET_DATA_BLOB_SIZE_BYTES = SOCKET_DATA_MAX_SIZE - SOCKET_DATA_OFFSET_BLOB;
 
+        /// <summary>
+        /// Offsets in record of packed UDP datagrams: IPv4 address (network order),
+        /// port (host order), datagram length and then datagram bytes.
+        /// </summary>
+        public const int UDP_BATCH_RECORD_OFFSET_IP = 0;
+        public const int UDP_BATCH_RECORD_OFFSET_PORT = 4;
+        public const int UDP_BATCH_RECORD_OFFSET_DATA_LEN = 8;
+        public const int UDP_BATCH_RECORD_HEADER_SIZE = 12;
+
         // Maximum URI string length.
         public const int MAX_URI_STRING_LEN = 1024;
 
@@ -231,6 +231,89 @@ namespace Starcounter
             Send(Encoding.UTF8.GetBytes(data), isText, connFlags);
         }
 
+        /// <summary>
+        /// Size of one broadcast target in bytes (unique id, socket index, worker id, padding).
+        /// </summary>
+        const Int32 BroadcastTargetSizeBytes = 16;
+
+        /// <summary>
+        /// Server push of one message on all WebSockets of the group.
+        /// Gateway builds the frame once and sends it on every socket of the group.
+        /// </summary>
+        /// <param name="groupName">WebSocket group name.</param>
+        /// <param name="data">Data to push.</param>
+        /// <param name="dataLen">Length of data in bytes.</param>
+        /// <param name="isText">Is given data a text?</param>
+        public static void BroadcastToGroup(String groupName, Byte[] data, Int32 dataLen, Boolean isText = false) {
+            PushBroadcastMessage(WsGroupInfo.CalculateGroupIdFromGroupName(groupName), data, dataLen, isText);
+        }
+
+        /// <summary>
+        /// Server push of one text message on all WebSockets of the group.
+        /// </summary>
+        /// <param name="groupName">WebSocket group name.</param>
+        /// <param name="data">Text to push.</param>
+        public static void BroadcastToGroup(String groupName, String data) {
+            Byte[] dataBytes = Encoding.UTF8.GetBytes(data);
+            PushBroadcastMessage(WsGroupInfo.CalculateGroupIdFromGroupName(groupName), dataBytes, dataBytes.Length, true);
+        }
+
+        /// <summary>
+        /// Server push of one message on given WebSockets.
+        /// Gateway builds the frame once and sends it on every given socket.
+        /// </summary>
+        /// <param name="sockets">WebSockets to push to.</param>
+        /// <param name="data">Data to push.</param>
+        /// <param name="dataLen">Length of data in bytes.</param>
+        /// <param name="isText">Is given data a text?</param>
+        public static unsafe void Broadcast(IList<WebSocket> sockets, Byte[] data, Int32 dataLen, Boolean isText = false) {
+
+            Int32 numTargets = 0;
+            foreach (WebSocket ws in sockets) {
+                if (!ws.IsDead())
+                    numTargets++;
+            }
+
+            if (0 == numTargets)
+                return;
+
+            // Targets go in front of the message: [number of targets][targets][data].
+            Int32 targetsLen = sizeof(Int32) + numTargets * BroadcastTargetSizeBytes;
+            Byte[] buf = new Byte[targetsLen + dataLen];
+
+            fixed (Byte* p = buf) {
+
+                *(Int32*)p = numTargets;
+                Byte* target = p + sizeof(Int32);
+
+                foreach (WebSocket ws in sockets) {
+
+                    if (ws.IsDead())
+                        continue;
+
+                    *(UInt64*)target = ws.socketStruct_.SocketUniqueId;
+                    *(UInt32*)(target + 8) = ws.socketStruct_.SocketIndexNum;
+                    *(target + 12) = ws.socketStruct_.GatewayWorkerId;
+
+                    target += BroadcastTargetSizeBytes;
+                }
+            }
+
+            Buffer.BlockCopy(data, 0, buf, targetsLen, dataLen);
+
+            PushBroadcastMessage(MixedCodeConstants.INVALID_WS_CHANNEL_ID, buf, buf.Length, isText);
+        }
+
+        /// <summary>
+        /// Server push of one text message on given WebSockets.
+        /// </summary>
+        /// <param name="sockets">WebSockets to push to.</param>
+        /// <param name="data">Text to push.</param>
+        public static void Broadcast(IList<WebSocket> sockets, String data) {
+            Byte[] dataBytes = Encoding.UTF8.GetBytes(data);
+            Broadcast(sockets, dataBytes, dataBytes.Length, true);
+        }
+
         /// <summary>
         /// Internal WebSocket creation.
         /// </summary>
@@ -355,5 +438,71 @@ namespace Starcounter
 
             dataStream.SendResponse(data, 0, dataLen, connFlags);
         }
+
+        /// <summary>
+        /// Pushes broadcast message to gateway.
+        /// </summary>
+        static unsafe void PushBroadcastMessage(
+            UInt32 groupId,
+            Byte[] data,
+            Int32 dataLen,
+            Boolean isText)
+        {
+            // Checking that whole broadcast is pushed to gateway at once.
+            if (dataLen > MixedCodeConstants.MAX_BYTES_EXTRA_LINKED_IPC_CHUNKS) {
+                throw new ArgumentOutOfRangeException("dataLen", "Broadcast can't be bigger than " + MixedCodeConstants.MAX_BYTES_EXTRA_LINKED_IPC_CHUNKS + " bytes.");
+            }
+
+            UInt32 chunkIndex;
+            Byte* chunkMem;
+
+            UInt32 errCode = bmx.sc_bmx_obtain_new_chunk(&chunkIndex, &chunkMem);
+
+            if (0 != errCode) {
+
+                if (Error.SCERRACQUIRELINKEDCHUNKS == errCode) {
+                    // NOTE: If we can not obtain a chunk just returning because we can't do much.
+                    return;
+                } else {
+                    throw ErrorCode.ToException(errCode);
+                }
+            }
+
+            Byte schedulerId = StarcounterEnvironment.CurrentSchedulerId;
+
+            // NOTE: Any gateway worker can distribute the broadcast, so spreading them by scheduler.
+            Byte gwWorkerId = (Byte)(schedulerId % StarcounterEnvironment.Gateway.NumberOfWorkers);
+
+            NetworkDataStream dataStream = new NetworkDataStream(chunkIndex, gwWorkerId, schedulerId);
+
+            Byte* socketDataBegin = chunkMem + MixedCodeConstants.CHUNK_OFFSET_SOCKET_DATA;
+
+            (*(ScSessionStruct*)(chunkMem + MixedCodeConstants.CHUNK_OFFSET_SESSION)) = new ScSessionStruct(true);
+
+            (*(UInt32*)(chunkMem + MixedCodeConstants.CHUNK_OFFSET_SOCKET_FLAGS)) =
+                (UInt32)MixedCodeConstants.SOCKET_DATA_FLAGS.SOCKET_DATA_FLAGS_WS_BROADCAST;
+
+            (*(Byte*)(socketDataBegin + MixedCodeConstants.SOCKET_DATA_OFFSET_NETWORK_PROTO_TYPE)) =
+                (Byte)MixedCodeConstants.NetworkProtocolType.PROTOCOL_WEBSOCKETS;
+
+            (*(Byte*)(socketDataBegin + MixedCodeConstants.SOCKET_DATA_OFFSET_BOUND_WORKER_ID)) = gwWorkerId;
+
+            // Explicit list of sockets is given when there is no group.
+            (*(UInt32*)(socketDataBegin + MixedCodeConstants.SOCKET_DATA_OFFSET_WS_CHANNEL_ID)) = groupId;
+
+            (*(UInt32*)(chunkMem + MixedCodeConstants.CHUNK_OFFSET_USER_DATA_OFFSET_IN_SOCKET_DATA)) =
+                MixedCodeConstants.SOCKET_DATA_OFFSET_BLOB;
+
+            // Checking if we have text or binary WebSocket frame.
+            if (isText) {
+                (*(Byte*)(socketDataBegin + MixedCodeConstants.SOCKET_DATA_OFFSET_WS_OPCODE)) =
+                    (Byte)MixedCodeConstants.WebSocketDataTypes.WS_OPCODE_TEXT;
+            } else {
+                (*(Byte*)(socketDataBegin + MixedCodeConstants.SOCKET_DATA_OFFSET_WS_OPCODE)) =
+                    (Byte)MixedCodeConstants.WebSocketDataTypes.WS_OPCODE_BINARY;
+            }
+
+            dataStream.SendResponse(data, 0, dataLen, Response.ConnectionFlags.NoSpecialFlags);
+        }
     }
 }
\ No newline at end of file
@@ -251,6 +251,72 @@ namespace Starcounter {
         /// </summary>
         const Int32 AggregationStructSizeBytes = 24;
 
+        /// <summary>
+        /// Maximum number of bytes in wire format v2 varint.
+        /// </summary>
+        const Int32 AggregationV2MaxVarintBytes = 5;
+
+        /// <summary>
+        /// Space reserved for wire format v2 batch header in send blob.
+        /// </summary>
+        const Int32 AggregationV2BatchHeaderMaxBytes = 2 * AggregationV2MaxVarintBytes;
+
+        /// <summary>
+        /// Maximum size of wire format v2 message header.
+        /// </summary>
+        const Int32 AggregationV2MessageHeaderMaxBytes = 1 + 3 * AggregationV2MaxVarintBytes;
+
+        /// <summary>
+        /// Maximum wire format v2 batch payload (gateway receives whole batch into one chunk).
+        /// </summary>
+        const Int32 AggregationV2MaxBatchSizeBytes = 2 * 1024 * 1024 - 1024;
+
+        /// <summary>
+        /// Writes wire format v2 varint and returns number of written bytes.
+        /// </summary>
+        static unsafe Int32 WriteVarint(Byte* dest, UInt32 value) {
+
+            Int32 numBytes = 0;
+
+            while (value >= 0x80) {
+                dest[numBytes++] = (Byte)((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+
+            dest[numBytes++] = (Byte)value;
+
+            return numBytes;
+        }
+
+        /// <summary>
+        /// Reads wire format v2 varint, returns false if more data is needed.
+        /// </summary>
+        static unsafe Boolean ReadVarint(ref Byte* pos, Byte* end, out UInt32 value) {
+
+            Byte* p = pos;
+            UInt32 v = 0;
+            value = 0;
+
+            for (Int32 i = 0; i < AggregationV2MaxVarintBytes; i++) {
+
+                if (p >= end)
+                    return false;
+
+                Byte b = *p;
+                p++;
+
+                v |= (UInt32)(b & 0x7F) << (7 * i);
+
+                if (0 == (b & 0x80)) {
+                    value = v;
+                    pos = p;
+                    return true;
+                }
+            }
+
+            throw new InvalidOperationException("Malformed aggregation varint.");
+        }
+
         /// <summary>
         /// Current sent/received balance.
         /// </summary>
@@ -355,7 +421,8 @@ namespace Starcounter {
             UInt16 portNumber,
             UInt16 aggrPortNumber,
             Int32 receiveTimeoutSeconds = TimeIntervalSeconds * 3,
-            Int32 maxAwaitedResponses = MaxAwaitedResponses) {
+            Int32 maxAwaitedResponses = MaxAwaitedResponses,
+            Boolean useWireFormatV2 = true) {
 
             // Checking if timeout is divisible by 5 seconds.
             if (0 != receiveTimeoutSeconds % TimeIntervalSeconds) {
@@ -416,6 +483,10 @@ namespace Starcounter {
                     ags->unique_aggr_salt_ = 0;
                     ags->msg_type_ = (Byte)MixedCodeConstants.AggregationMessageTypes.AGGR_CREATE_SOCKET;
                     ags->msg_flags_ = 0;
+
+                    // Asking gateway to switch connection to wire format v2.
+                    if (useWireFormatV2)
+                        ags->msg_flags_ = (Byte)MixedCodeConstants.AggregationMessageFlags.AGGR_MSG_WIRE_FORMAT_V2;
                 }
 
                 aggrSocket_.Send(aggregateSendBlob_, AggregationStructSizeBytes, SocketFlags.None);
@@ -434,6 +505,12 @@ namespace Starcounter {
                 {
                     AggregationStruct* aggrStruct = (AggregationStruct*)fixedBytes;
                     referenceAggrStruct_ = *aggrStruct;
+
+                    // NOTE: Gateway that supports wire format v2 confirms it with non-zero handle.
+                    if (useWireFormatV2) {
+                        wireFormatV2Handle_ = ((UInt32)aggrStruct->unique_aggr_salt_ << 16) | aggrStruct->unique_aggr_index_;
+                        wireFormatV2_ = (0 != wireFormatV2Handle_);
+                    }
                 }
             }
 
@@ -580,8 +657,67 @@ namespace Starcounter {
                             // Offset and number of bytes left to process in receive.
                             Int32 processed_bytes_offset = 0, remaining_bytes_to_process = 0;
 
+                            // Processing whole wire format v2 batches.
+                            while (wireFormatV2_ && (processed_bytes_offset != numRecvBytes)) {
+
+                                Byte* batchStart = rb + processed_bytes_offset;
+                                Byte* recvEnd = rb + numRecvBytes;
+                                Byte* pos = batchStart;
+                                UInt32 batchLen, numMessages;
+
+                                // Checking if whole batch is received.
+                                if ((!ReadVarint(ref pos, recvEnd, out batchLen)) ||
+                                    (!ReadVarint(ref pos, recvEnd, out numMessages)) ||
+                                    (batchLen > recvEnd - pos)) {
+
+                                    Int32 processing_bytes_left = numRecvBytes - processed_bytes_offset;
+
+                                    // Moving the tail up to the beginning.
+                                    Buffer.BlockCopy(aggrReceiveBlob_, processed_bytes_offset, aggrReceiveBlob_, 0, processing_bytes_left);
+
+                                    // Continuing receiving from the beginning.
+                                    remaining_bytes_to_process = processing_bytes_left;
+
+                                    break;
+                                }
+
+                                Byte* batchEnd = pos + batchLen;
+
+                                for (UInt32 m = 0; m < numMessages; m++) {
+
+                                    UInt32 handle, aggrIndex, sizeBytes;
+
+                                    if (pos >= batchEnd) {
+                                        throw new InvalidOperationException("Malformed aggregation batch.");
+                                    }
+
+                                    Byte msgType = (Byte)(*pos & 0x03);
+                                    pos++;
+
+                                    if ((!ReadVarint(ref pos, batchEnd, out handle)) ||
+                                        (!ReadVarint(ref pos, batchEnd, out aggrIndex)) ||
+                                        (!ReadVarint(ref pos, batchEnd, out sizeBytes)) ||
+                                        (sizeBytes > batchEnd - pos)) {
+
+                                        throw new InvalidOperationException("Malformed aggregation batch.");
+                                    }
+
+                                    ProcessReceivedMessage(
+                                        (UInt16)(aggrIndex & 0xFFFF),
+                                        (UInt16)(aggrIndex >> 16),
+                                        msgType,
+                                        (Int32)(pos - rb),
+                                        (Int32)sizeBytes);
+
+                                    pos += sizeBytes;
+                                }
+
+                                // Switching to next batch.
+                                processed_bytes_offset = (Int32)(batchEnd - rb);
+                            }
+
                             // Processing until we have bytes to process.
-                            while (processed_bytes_offset != numRecvBytes) {
+                            while ((!wireFormatV2_) && (processed_bytes_offset != numRecvBytes)) {
 
                                 AggregationStruct* ags = (AggregationStruct*)(rb + processed_bytes_offset);
 
@@ -603,70 +739,110 @@ namespace Starcounter {
                                     break;
                                 }
 
-                                // Modifying balance.
-                                Interlocked.Decrement(ref sentReceivedBalance_);
-
-                                // Incrementing counter.
-                                numResponsesReceived_++;
-
                                 // Offset in receive buffer where the response data resides.
                                 Int32 responseDataOffset = processed_bytes_offset + AggregationStructSizeBytes;
 
                                 // Switching to next message.
                                 processed_bytes_offset += AggregationStructSizeBytes + ags->size_bytes_;
 
-                                // Getting from awaiting task.
-                                AggrTask aggrTask = receiveAwaitingTasksArray_[ags->unique_aggr_index_];
+                                ProcessReceivedMessage(
+                                    ags->unique_aggr_index_,
+                                    ags->unique_aggr_salt_,
+                                    ags->msg_type_,
+                                    responseDataOffset,
+                                    ags->size_bytes_);
+                            }
 
-                                // Checking if salt is not the same.
-                                // This can happen when response comes later than task that was cleaned by timeout.
-                                if ((null == aggrTask) ||
-                                    (0 == aggrTask.TaskUniqueSalt) ||
-                                    (aggrTask.TaskUniqueSalt != ags->unique_aggr_salt_)) {
+                            // Setting the number of bytes left to be processed.
+                            numRecvBytes = remaining_bytes_to_process;
+                        }
+                    }
+                }
+            } catch (Exception exc) {
+                Console.WriteLine(exc);
+                throw exc;
+            }
+        }
 
-                                    continue;
-                                }
+        /// <summary>
+        /// Passes one received message to the awaiting task.
+        /// </summary>
+        void ProcessReceivedMessage(
+            UInt16 aggrTaskIndex,
+            UInt16 aggrTaskSalt,
+            Byte msgType,
+            Int32 responseDataOffset,
+            Int32 responseSizeBytes) {
 
-                                // Setting the slot to null.
-                                receiveAwaitingTasksArray_[ags->unique_aggr_index_] = null;
+            // Modifying balance.
+            Interlocked.Decrement(ref sentReceivedBalance_);
 
-                                // Checking type of task.
-                                switch ((MixedCodeConstants.AggregationMessageTypes)ags->msg_type_) {
+            // Incrementing counter.
+            numResponsesReceived_++;
 
-                                    case MixedCodeConstants.AggregationMessageTypes.AGGR_DATA: {
+            // Checking if task index is correct.
+            if (aggrTaskIndex >= receiveAwaitingTasksArray_.Length)
+                return;
 
-                                        // Constructing the response from received bytes and calling user delegate.
-                                        Response resp = new Response(aggrReceiveBlob_, responseDataOffset, ags->size_bytes_, true);
+            // Getting from awaiting task.
+            AggrTask aggrTask = receiveAwaitingTasksArray_[aggrTaskIndex];
 
-                                        // Enqueing the receive procedure.
-                                        responseProcTasks_.Enqueue(new ResponseProcTask(resp, aggrTask.ReceiveProc));
+            // Checking if salt is not the same.
+            // This can happen when response comes later than task that was cleaned by timeout.
+            if ((null == aggrTask) ||
+                (0 == aggrTask.TaskUniqueSalt) ||
+                (aggrTask.TaskUniqueSalt != aggrTaskSalt)) {
 
-                                        break;
-                                    }
+                return;
+            }
 
-                                    case MixedCodeConstants.AggregationMessageTypes.AGGR_CREATE_SOCKET:
-                                    case MixedCodeConstants.AggregationMessageTypes.AGGR_DESTROY_SOCKET: {
+            // Setting the slot to null.
+            receiveAwaitingTasksArray_[aggrTaskIndex] = null;
 
-                                        break;
-                                    }
-                                }
+            // Checking type of task.
+            switch ((MixedCodeConstants.AggregationMessageTypes)msgType) {
 
-                                // Resetting salt.
-                                aggrTask.ResetSalt();
+                case MixedCodeConstants.AggregationMessageTypes.AGGR_DATA: {
 
-                                // Releasing free task index.
-                                freeTasks_.Enqueue(aggrTask);
-                            }
+                    // Constructing the response from received bytes and calling user delegate.
+                    Response resp = new Response(aggrReceiveBlob_, responseDataOffset, responseSizeBytes, true);
 
-                            // Setting the number of bytes left to be processed.
-                            numRecvBytes = remaining_bytes_to_process;
-                        }
-                    }
+                    // Enqueing the receive procedure.
+                    responseProcTasks_.Enqueue(new ResponseProcTask(resp, aggrTask.ReceiveProc));
+
+                    break;
+                }
+
+                case MixedCodeConstants.AggregationMessageTypes.AGGR_CREATE_SOCKET:
+                case MixedCodeConstants.AggregationMessageTypes.AGGR_DESTROY_SOCKET: {
+
+                    break;
                 }
-            } catch (Exception exc) {
-                Console.WriteLine(exc);
-                throw exc;
             }
+
+            // Resetting salt.
+            aggrTask.ResetSalt();
+
+            // Releasing free task index.
+            freeTasks_.Enqueue(aggrTask);
+        }
+
+        /// <summary>
+        /// Sends wire format v2 batch, writing its header right before the first message.
+        /// </summary>
+        unsafe void SendV2Batch(Byte* sb, Int32 sendBytesOffset, UInt32 numMessages) {
+
+            Byte* batchHeader = stackalloc Byte[AggregationV2BatchHeaderMaxBytes];
+            UInt32 batchLen = (UInt32)(sendBytesOffset - AggregationV2BatchHeaderMaxBytes);
+
+            Int32 batchHeaderLen = WriteVarint(batchHeader, batchLen);
+            batchHeaderLen += WriteVarint(batchHeader + batchHeaderLen, numMessages);
+
+            Int32 batchStartOffset = AggregationV2BatchHeaderMaxBytes - batchHeaderLen;
+            for (Int32 i = 0; i < batchHeaderLen; i++)
+                sb[batchStartOffset + i] = batchHeader[i];
+
+            aggrSocket_.Send(aggregateSendBlob_, batchStartOffset, sendBytesOffset - batchStartOffset, SocketFlags.None);
         }
 
         /// <summary>
@@ -694,8 +870,12 @@ namespace Starcounter {
                             if (tasksToSend_.Count == 0)
                                 Thread.Sleep(1);
 
+                            // Messages start after reserved v2 batch header.
+                            Int32 send_start_offset = wireFormatV2_ ? AggregationV2BatchHeaderMaxBytes : 0;
+
                             // Checking if we have anything to send.
-                            Int32 send_bytes_offset = 0;
+                            Int32 send_bytes_offset = send_start_offset;
+                            UInt32 num_batch_messages = 0;
 
                             AggrTask sendTask;
 
@@ -714,6 +894,44 @@ namespace Starcounter {
                                 // Incrementing sockets balance.
                                 Interlocked.Increment(ref sentReceivedBalance_);
 
+                                // Writing compact v2 message header.
+                                if (wireFormatV2_) {
+
+                                    // Checking if request fits into batch.
+                                    if (AggregationV2MessageHeaderMaxBytes + sendTask.RequestSize >= AggregationV2MaxBatchSizeBytes - (send_bytes_offset - send_start_offset)) {
+
+                                        if (0 == num_batch_messages) {
+                                            throw new Exception("Request size is bigger than: " + AggregationV2MaxBatchSizeBytes);
+                                        }
+
+                                        SendV2Batch(sb, send_bytes_offset, num_batch_messages);
+                                        send_bytes_offset = send_start_offset;
+                                        num_batch_messages = 0;
+                                    }
+
+                                    Byte* msg = sb + send_bytes_offset;
+                                    Int32 msg_header_len = 0;
+
+                                    msg[msg_header_len++] = (Byte)MixedCodeConstants.AggregationMessageTypes.AGGR_DATA;
+                                    msg_header_len += WriteVarint(msg + msg_header_len, wireFormatV2Handle_);
+                                    msg_header_len += WriteVarint(msg + msg_header_len, ((UInt32)sendTask.TaskUniqueSalt << 16) | freeTaskIndex);
+                                    msg_header_len += WriteVarint(msg + msg_header_len, (UInt32)sendTask.RequestSize);
+
+                                    // Incrementing send statistics.
+                                    numRequestsSent_++;
+
+                                    Buffer.BlockCopy(sendTask.RequestBytes, 0, aggregateSendBlob_, send_bytes_offset + msg_header_len, sendTask.RequestSize);
+
+                                    // Shifting offset in the array.
+                                    send_bytes_offset += msg_header_len + sendTask.RequestSize;
+                                    num_batch_messages++;
+
+                                    // Optimization for GC.
+                                    sendTask.DetachBuffers();
+
+                                    continue;
+                                }
+
                                 // Checking if request fits.
                                 if (AggregationStructSizeBytes + sendTask.RequestSize >= AggregationBlobSizeBytes - send_bytes_offset) {
 
@@ -748,7 +966,9 @@ namespace Starcounter {
                             }
 
                             // Sending last processed requests.
-                            if (send_bytes_offset > 0) {
+                            if (num_batch_messages > 0) {
+                                SendV2Batch(sb, send_bytes_offset, num_batch_messages);
+                            } else if ((!wireFormatV2_) && (send_bytes_offset > 0)) {
                                 aggrSocket_.Send(aggregateSendBlob_, send_bytes_offset, SocketFlags.None);
                             }
                         }
@@ -967,6 +1187,16 @@ namespace Starcounter {
         /// </summary>
         AggregationStruct referenceAggrStruct_;
 
+        /// <summary>
+        /// Connection uses aggregation wire format v2.
+        /// </summary>
+        Boolean wireFormatV2_;
+
+        /// <summary>
+        /// Wire format v2 handle of the virtual socket given by gateway.
+        /// </summary>
+        UInt32 wireFormatV2Handle_;
+
         /// <summary>
         /// Send/Received balance.
         /// </summary>
@@ -245,6 +245,18 @@ namespace Starcounter
                     Marshal.Copy(new IntPtr(rawChunk + MixedCodeConstants.CHUNK_OFFSET_SOCKET_DATA + *(UInt32*)(rawChunk + MixedCodeConstants.CHUNK_OFFSET_USER_DATA_OFFSET_IN_SOCKET_DATA)), dataBytes, 0, dataBytes.Length);
                 }
 
+                if (Db.Environment.HasDatabase)
+                    TransactionManager.CreateImplicitAndSetCurrent(true);
+
+                // Checking if several datagrams are packed in this chunk.
+                if (((*(UInt32*)(rawChunk + MixedCodeConstants.CHUNK_OFFSET_SOCKET_FLAGS)) & (UInt32)MixedCodeConstants.SOCKET_DATA_FLAGS.SOCKET_DATA_FLAGS_UDP_BATCH) != 0) {
+
+                    ProcessUdpBatch(userCallback, dataBytes);
+                    *isHandled = true;
+
+                    return 0;
+                }
+
                 // Getting client IP.
                 UInt32 clientIpInt = *(UInt32*) (rawChunk + MixedCodeConstants.CHUNK_OFFSET_SOCKET_DATA + MixedCodeConstants.SOCKET_DATA_OFFSET_UDP_DESTINATION_IP);
 
@@ -254,9 +266,6 @@ namespace Starcounter
                 // Obtaining client's port.
                 UInt16 clientPort = *(UInt16*) (rawChunk + MixedCodeConstants.CHUNK_OFFSET_SOCKET_DATA + MixedCodeConstants.SOCKET_DATA_OFFSET_UDP_DESTINATION_PORT);
 
-                if (Db.Environment.HasDatabase)
-                    TransactionManager.CreateImplicitAndSetCurrent(true);
-
                 userCallback(clientIp, clientPort, dataBytes);
                 *isHandled = true;
 
@@ -280,6 +289,46 @@ namespace Starcounter
             return 0;
         }
 
+        /// <summary>
+        /// Calls UDP handler for each datagram packed by gateway.
+        /// </summary>
+        unsafe static void ProcessUdpBatch(
+            Action<IPAddress, UInt16, Byte[]> userCallback,
+            Byte[] batchBytes) {
+
+            fixed (Byte* batch = batchBytes) {
+
+                Int32 offset = 0;
+
+                while (offset < batchBytes.Length) {
+
+                    Byte* record = batch + offset;
+
+                    // Getting datagram source and length.
+                    IPAddress clientIp = new IPAddress(*(UInt32*)(record + MixedCodeConstants.UDP_BATCH_RECORD_OFFSET_IP));
+                    UInt16 clientPort = *(UInt16*)(record + MixedCodeConstants.UDP_BATCH_RECORD_OFFSET_PORT);
+                    Int32 dataLen = *(Int32*)(record + MixedCodeConstants.UDP_BATCH_RECORD_OFFSET_DATA_LEN);
+
+                    offset += MixedCodeConstants.UDP_BATCH_RECORD_HEADER_SIZE;
+
+                    if ((dataLen < 0) || (dataLen > batchBytes.Length - offset))
+                        throw ErrorCode.ToException(Error.SCERRUNSPECIFIED);
+
+                    Byte[] dataBytes = new Byte[dataLen];
+                    Buffer.BlockCopy(batchBytes, offset, dataBytes, 0, dataLen);
+
+                    offset += dataLen;
+
+                    // One failing datagram should not drop the rest of the batch.
+                    try {
+                        userCallback(clientIp, clientPort, dataBytes);
+                    } catch (Exception exc) {
+                        LogSources.Hosting.LogException(exc);
+                    }
+                }
+            }
+        }
+
         /// <summary>
         /// Handles TCP socket data.
         /// </summary>
@@ -0,0 +1,188 @@
+﻿using Starcounter;
+using System;
+using System.IO;
+using System.Net.Sockets;
+using System.Text;
+using Starcounter.Internal;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+class Http2ValidationTests {
+
+    const Byte FrameHeaders = 0x1;
+    const Byte FrameRstStream = 0x3;
+    const Byte FlagEndStream = 0x1;
+    const Byte FlagEndHeaders = 0x4;
+    const UInt32 ErrorProtocol = 0x1;
+
+    static readonly Byte[] Preface = Encoding.ASCII.GetBytes("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+
+    /// <summary>
+    /// Writes HPACK integer with given prefix.
+    /// </summary>
+    static void WriteHpackInteger(MemoryStream ms, Byte flags, Int32 prefixBits, Int32 value) {
+
+        Int32 maxPrefix = (1 << prefixBits) - 1;
+
+        if (value < maxPrefix) {
+            ms.WriteByte((Byte)(flags | value));
+            return;
+        }
+
+        ms.WriteByte((Byte)(flags | maxPrefix));
+        value -= maxPrefix;
+
+        while (value >= 128) {
+            ms.WriteByte((Byte)((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+
+        ms.WriteByte((Byte)value);
+    }
+
+    /// <summary>
+    /// Writes header field as HPACK literal without indexing (no Huffman coding).
+    /// </summary>
+    static void WriteLiteralField(MemoryStream ms, String name, String value) {
+
+        Byte[] nameBytes = Encoding.ASCII.GetBytes(name);
+        Byte[] valueBytes = Encoding.ASCII.GetBytes(value);
+
+        ms.WriteByte(0);
+        WriteHpackInteger(ms, 0, 7, nameBytes.Length);
+        ms.Write(nameBytes, 0, nameBytes.Length);
+        WriteHpackInteger(ms, 0, 7, valueBytes.Length);
+        ms.Write(valueBytes, 0, valueBytes.Length);
+    }
+
+    /// <summary>
+    /// Writes HTTP/2 frame.
+    /// </summary>
+    static void WriteFrame(Stream s, Byte type, Byte flags, UInt32 streamId, Byte[] payload) {
+
+        Byte[] header = new Byte[9];
+        header[0] = (Byte)(payload.Length >> 16);
+        header[1] = (Byte)(payload.Length >> 8);
+        header[2] = (Byte)payload.Length;
+        header[3] = type;
+        header[4] = flags;
+        header[5] = (Byte)(streamId >> 24);
+        header[6] = (Byte)(streamId >> 16);
+        header[7] = (Byte)(streamId >> 8);
+        header[8] = (Byte)streamId;
+
+        s.Write(header, 0, header.Length);
+        s.Write(payload, 0, payload.Length);
+    }
+
+    static void ReadExactly(Stream s, Byte[] buf, Int32 len) {
+
+        Int32 offset = 0;
+        while (offset < len) {
+
+            Int32 n = s.Read(buf, offset, len - offset);
+            if (0 == n)
+                throw new IOException("Connection closed by gateway.");
+
+            offset += n;
+        }
+    }
+
+    /// <summary>
+    /// Sends GET request with given path and extra header,
+    /// returns type of the first frame on the stream and RST_STREAM error code.
+    /// </summary>
+    static Byte SendRequest(Stream s, UInt32 streamId, String path, String headerValue, out UInt32 errorCode) {
+
+        MemoryStream block = new MemoryStream();
+        WriteLiteralField(block, ":method", "GET");
+        WriteLiteralField(block, ":scheme", "http");
+        WriteLiteralField(block, ":path", path);
+        WriteLiteralField(block, ":authority", "localhost");
+        WriteLiteralField(block, "x-test", headerValue);
+
+        WriteFrame(s, FrameHeaders, FlagEndStream | FlagEndHeaders, streamId, block.ToArray());
+
+        Byte[] header = new Byte[9];
+
+        while (true) {
+
+            ReadExactly(s, header, header.Length);
+
+            Int32 payloadLen = (header[0] << 16) | (header[1] << 8) | header[2];
+            UInt32 frameStreamId = (UInt32)(((header[5] & 0x7F) << 24) | (header[6] << 16) | (header[7] << 8) | header[8]);
+
+            Byte[] payload = new Byte[payloadLen];
+            ReadExactly(s, payload, payloadLen);
+
+            if (frameStreamId != streamId)
+                continue;
+
+            errorCode = 0;
+            if ((FrameRstStream == header[3]) && (4 == payloadLen))
+                errorCode = (UInt32)((payload[0] << 24) | (payload[1] << 16) | (payload[2] << 8) | payload[3]);
+
+            return header[3];
+        }
+    }
+
+    /// <summary>
+    /// Checks that CR and LF in HTTP/2 fields reset the stream instead of
+    /// reaching the handler as extra header lines.
+    /// </summary>
+    public static void TestCrLfInFields() {
+
+        Handle.GET("/http2validation", (Request req) => {
+            Assert.IsTrue(null == req.Headers["X-Injected"]);
+            return "ok";
+        });
+
+        using (TcpClient client = new TcpClient("localhost", StarcounterEnvironment.Default.UserHttpPort)) {
+
+            NetworkStream s = client.GetStream();
+            s.ReadTimeout = 10000;
+
+            s.Write(Preface, 0, Preface.Length);
+            WriteFrame(s, 0x4, 0, 0, new Byte[0]);
+
+            // Server preface starts with SETTINGS frame.
+            Byte[] header = new Byte[9];
+            ReadExactly(s, header, header.Length);
+
+            if (Encoding.ASCII.GetString(header, 0, 5) == "HTTP/") {
+                Console.WriteLine("HTTP/2 is not enabled in gateway, skipping HTTP/2 validation tests.");
+                Handle.UnregisterHttpHandler("GET", "/http2validation");
+                return;
+            }
+
+            Byte[] settings = new Byte[(header[0] << 16) | (header[1] << 8) | header[2]];
+            ReadExactly(s, settings, settings.Length);
+
+            UInt32 errorCode;
+
+            // CRLF in header value.
+            Byte frameType = SendRequest(s, 1, "/http2validation", "a\r\nX-Injected: b", out errorCode);
+            Assert.IsTrue((FrameRstStream == frameType) && (ErrorProtocol == errorCode));
+
+            // CRLF in path.
+            frameType = SendRequest(s, 3, "/http2validation HTTP/1.1\r\nX-Injected: b\r\n\r\nGET /http2validation", "a", out errorCode);
+            Assert.IsTrue((FrameRstStream == frameType) && (ErrorProtocol == errorCode));
+
+            // Valid request on the same connection still gets response.
+            frameType = SendRequest(s, 5, "/http2validation", "a", out errorCode);
+            Assert.IsTrue(FrameHeaders == frameType);
+        }
+
+        Handle.UnregisterHttpHandler("GET", "/http2validation");
+    }
+
+    public static Int32 Run() {
+
+        Console.WriteLine("Starting HTTP/2 validation tests...");
+
+        TestCrLfInFields();
+
+        Console.WriteLine("Finished HTTP/2 validation tests...");
+
+        return 0;
+    }
+}
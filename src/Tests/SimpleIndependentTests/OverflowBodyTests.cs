@@ -0,0 +1,101 @@
+﻿using Starcounter;
+using System;
+using System.Threading;
+using Starcounter.Internal;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+class OverflowBodyTests {
+
+    // Bigger than the biggest gateway chunk, so body arrives as a chain.
+    const Int32 BigBodyLength = 3 * 1024 * 1024;
+
+    const Int32 NumBigRequests = 8;
+
+    const Int32 NumSlowRequests = 2000;
+
+    static Byte[] CreateBody(Int32 len, Int32 seed) {
+
+        Byte[] body = new Byte[len];
+        for (Int32 i = 0; i < len; i++) {
+            body[i] = (Byte)(i * 31 + seed);
+        }
+
+        return body;
+    }
+
+    /// <summary>
+    /// Checks that bodies bigger than the biggest gateway chunk
+    /// reach the handler intact while the overflow queue is in use.
+    /// </summary>
+    public static void TestBigBodiesWithOverflow() {
+
+        String uri = "http://localhost:" + StarcounterEnvironment.Default.UserHttpPort;
+
+        // Slow handler keeps codehost busy, so gateway overflows.
+        Handle.POST("/overflowslow", (Request req) => {
+            Thread.Sleep(5);
+            return "slow";
+        });
+
+        Handle.POST("/overflowbig/{?}", (Int32 seed, Request req) => {
+
+            Byte[] body = req.BodyBytes;
+            Byte[] expected = CreateBody(BigBodyLength, seed);
+
+            if (body.Length != expected.Length)
+                return "length " + body.Length;
+
+            for (Int32 i = 0; i < body.Length; i++) {
+                if (body[i] != expected[i])
+                    return "mismatch at " + i;
+            }
+
+            return "ok";
+        });
+
+        Int32 numSlowResponses = 0;
+        Byte[] slowBody = new Byte[16];
+
+        for (Int32 i = 0; i < NumSlowRequests; i++) {
+            Http.POST(uri + "/overflowslow", slowBody, null, (Response resp) => {
+                Interlocked.Increment(ref numSlowResponses);
+            });
+        }
+
+        String[] results = new String[NumBigRequests];
+        Thread[] threads = new Thread[NumBigRequests];
+
+        for (Int32 i = 0; i < NumBigRequests; i++) {
+
+            Int32 seed = i;
+            threads[i] = new Thread(() => {
+                Response r = Http.POST(uri + "/overflowbig/" + seed, CreateBody(BigBodyLength, seed), null, 60);
+                results[seed] = r.Body;
+            });
+            threads[i].Start();
+        }
+
+        for (Int32 i = 0; i < NumBigRequests; i++) {
+            threads[i].Join();
+            Assert.IsTrue("ok" == results[i]);
+        }
+
+        while (numSlowResponses < NumSlowRequests) {
+            Thread.Sleep(10);
+        }
+
+        Handle.UnregisterHttpHandler("POST", "/overflowslow");
+        Handle.UnregisterHttpHandler("POST", "/overflowbig/{?}");
+    }
+
+    public static Int32 Run() {
+
+        Console.WriteLine("Starting overflow body tests...");
+
+        TestBigBodiesWithOverflow();
+
+        Console.WriteLine("Finished overflow body tests...");
+
+        return 0;
+    }
+}
@@ -13,6 +13,16 @@ namespace SimpleIndependentTests {
                 return errCode;
             }
 
+            errCode = Http2ValidationTests.Run();
+            if (0 != errCode) {
+                return errCode;
+            }
+
+            errCode = OverflowBodyTests.Run();
+            if (0 != errCode) {
+                return errCode;
+            }
+
             errCode = SchedulingPerfTest.Run();
             if (0 != errCode) {
                 return errCode;
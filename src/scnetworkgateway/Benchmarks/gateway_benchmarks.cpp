@@ -0,0 +1,370 @@
+#include "static_headers.hpp"
+#include "gateway.hpp"
+#include "handlers.hpp"
+#include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
+#include "http_proto.hpp"
+#include "socket_data.hpp"
+#include "worker_db_interface.hpp"
+#include "worker.hpp"
+
+#include "micro_benchmark.hpp"
+
+namespace starcounter {
+namespace network {
+
+// Worker which owns chunks and sockets used by benchmarks.
+GatewayWorker* g_bench_worker = NULL;
+
+// Maximum number of socket infos on benchmark worker.
+const int32_t kBenchMaxConnections = 1024;
+
+// Typical browser request.
+const char* const kBenchHttpRequest =
+    "GET /gw/benchmark/items/12345?view=full HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64)\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+// Header field names checked by DetermineField benchmark.
+const char* const kBenchHeaderFields[] = {
+    "Host",
+    "User-Agent",
+    "Accept",
+    "Accept-Encoding",
+    "Content-Length",
+    "Cookie",
+    "Connection",
+    "X-Requested-With"
+};
+
+const int32_t kBenchNumHeaderFields = sizeof(kBenchHeaderFields) / sizeof(kBenchHeaderFields[0]);
+
+// Session string as it appears in requests (salt, linear index, scheduler).
+const char* const kBenchSessionString = "7f3a9c21e4b5d60800002a03";
+
+// Size of WebSocket payload to mask.
+const int32_t kBenchWsPayloadLen = 4096;
+
+// Total number of shared memory chunks, including the ones pre-allocated for channels.
+const core::chunk_index kBenchNumShmChunks = static_cast<core::chunk_index>(core::channels + 4096);
+
+typedef core::shared_chunk_pool<core::chunk_index> bench_shared_chunk_pool_type;
+
+// Channel queue as used between gateway workers and schedulers.
+core::atomic_buffer<core::chunk_index, core::channel_capacity_bits> g_bench_channel;
+
+// Creates socket data attached to a new socket info.
+SocketDataChunk* CreateBenchSocketData()
+{
+    socket_index_type socket_index = g_bench_worker->ObtainFreeSocketIndex(
+        INVALID_SOCKET, 0, MixedCodeConstants::NetworkProtocolType::PROTOCOL_HTTP1, false);
+
+    if (INVALID_SOCKET_INDEX == socket_index)
+        return NULL;
+
+    SocketDataChunk* sd = NULL;
+    if (g_bench_worker->CreateSocketData(socket_index, sd))
+    {
+        g_bench_worker->ReleaseSocketIndex(socket_index);
+        return NULL;
+    }
+
+    return sd;
+}
+
+// Releases socket data and its socket info.
+void ReleaseBenchSocketData(SocketDataChunk* sd)
+{
+    socket_index_type socket_index = sd->get_socket_info_index();
+
+    g_bench_worker->GetWorkerChunks()->ReleaseChunk(sd);
+    g_bench_worker->ReleaseSocketIndex(socket_index);
+}
+
+void BM_GetMethodAndUri(BenchmarkState& state)
+{
+    char request[512];
+    uint32_t request_len = static_cast<uint32_t>(strlen(kBenchHttpRequest));
+    memcpy(request, kBenchHttpRequest, request_len);
+
+    uint32_t method_space_uri_len = 0, uri_offset = 0;
+
+    while (state.KeepRunning())
+    {
+        uint32_t err_code = GetMethodAndUri(
+            request,
+            request_len,
+            &method_space_uri_len,
+            &uri_offset,
+            MixedCodeConstants::MAX_URI_STRING_LEN);
+
+        DoNotOptimize(err_code + method_space_uri_len + uri_offset);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_DetermineField(BenchmarkState& state)
+{
+    size_t field_lens[kBenchNumHeaderFields];
+    for (int32_t i = 0; i < kBenchNumHeaderFields; i++)
+        field_lens[i] = strlen(kBenchHeaderFields[i]);
+
+    while (state.KeepRunning())
+    {
+        uint64_t fields_sum = 0;
+
+        for (int32_t i = 0; i < kBenchNumHeaderFields; i++)
+            fields_sum += DetermineField(kBenchHeaderFields[i], field_lens[i]);
+
+        DoNotOptimize(fields_sum);
+    }
+
+    state.SetItemsProcessed(state.iterations() * kBenchNumHeaderFields);
+}
+
+void BM_HttpParserExecute(BenchmarkState& state)
+{
+    SocketDataChunk* sd = CreateBenchSocketData();
+    if (NULL == sd)
+    {
+        state.SkipWithError("can't create socket data");
+        return;
+    }
+
+    int32_t request_len = static_cast<int32_t>(strlen(kBenchHttpRequest));
+    sd->ResetAccumBuffer();
+    memcpy(sd->get_data_blob_start(), kBenchHttpRequest, request_len);
+    sd->AddAccumulatedBytes(request_len);
+
+    HttpProto* http_proto = sd->get_http_proto();
+
+    while (state.KeepRunning())
+    {
+        size_t bytes_parsed = http_proto->ExecuteParser(g_bench_worker, sd);
+        if (bytes_parsed != static_cast<size_t>(request_len))
+        {
+            state.SkipWithError("HTTP parser did not consume the whole request");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * request_len);
+    state.SetItemsProcessed(state.iterations());
+
+    ReleaseBenchSocketData(sd);
+}
+
+void BM_WsMaskUnMask(BenchmarkState& state)
+{
+    uint8_t payload[kBenchWsPayloadLen];
+    for (int32_t i = 0; i < kBenchWsPayloadLen; i++)
+        payload[i] = static_cast<uint8_t>(i);
+
+    // WebSocket 4 bytes mask repeated to 8 bytes.
+    uint64_t mask_8bytes = 0x78563412;
+    mask_8bytes = (mask_8bytes << 32) | mask_8bytes;
+
+    WsProto ws_proto;
+
+    while (state.KeepRunning())
+    {
+        int8_t num_remaining_bytes = 0;
+        ws_proto.MaskUnMask(payload, kBenchWsPayloadLen, mask_8bytes, num_remaining_bytes);
+    }
+
+    DoNotOptimize(payload[kBenchWsPayloadLen - 1]);
+
+    state.SetBytesProcessed(state.iterations() * kBenchWsPayloadLen);
+}
+
+void BM_HexStringToUint64(BenchmarkState& state)
+{
+    while (state.KeepRunning())
+    {
+        DoNotOptimize(hex_string_to_uint64(kBenchSessionString, 16));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_SessionFillFromString(BenchmarkState& state)
+{
+    ScSessionStruct session;
+    session.Reset();
+
+    while (state.KeepRunning())
+    {
+        uint32_t err_code = session.FillFromString(kBenchSessionString, MixedCodeConstants::SESSION_STRING_LEN_CHARS);
+        DoNotOptimize(err_code + session.linear_index_);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_WorkerChunksObtainRelease(BenchmarkState& state)
+{
+    WorkerChunks* worker_chunks = g_bench_worker->GetWorkerChunks();
+
+    while (state.KeepRunning())
+    {
+        SocketDataChunk* sd = worker_chunks->ObtainChunk();
+        if (NULL == sd)
+        {
+            state.SkipWithError("can't obtain chunk");
+            break;
+        }
+
+        worker_chunks->ReleaseChunk(sd);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_WorkerChunksObtainReleaseBurst64(BenchmarkState& state)
+{
+    const int32_t kBurstSize = 64;
+    SocketDataChunk* sds[kBurstSize];
+    WorkerChunks* worker_chunks = g_bench_worker->GetWorkerChunks();
+
+    while (state.KeepRunning())
+    {
+        for (int32_t i = 0; i < kBurstSize; i++)
+        {
+            sds[i] = worker_chunks->ObtainChunk();
+            GW_ASSERT(NULL != sds[i]);
+        }
+
+        for (int32_t i = 0; i < kBurstSize; i++)
+            worker_chunks->ReleaseChunk(sds[i]);
+    }
+
+    state.SetItemsProcessed(state.iterations() * kBurstSize);
+}
+
+// Acquires and releases linked chains of given length from in-process shared chunk pool.
+void RunSharedChunkPoolBenchmark(BenchmarkState& state, std::size_t num_chunks_in_chain)
+{
+    core::chunk_type* chunks = (core::chunk_type*) VirtualAlloc(NULL, sizeof(core::chunk_type) * kBenchNumShmChunks,
+        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+    if (NULL == chunks)
+    {
+        state.SkipWithError("can't allocate shared memory chunks");
+        return;
+    }
+
+    bench_shared_chunk_pool_type* pool = GwNewConstructor2(bench_shared_chunk_pool_type, "scgwbench", kBenchNumShmChunks);
+
+    // Filling the pool with all chunks that are not pre-allocated for channels.
+    for (core::chunk_index i = core::channels; i < kBenchNumShmChunks - 1; i++)
+        chunks[i].set_link(i + 1);
+
+    chunks[kBenchNumShmChunks - 1].terminate_link();
+
+    core::chunk_index head = core::channels;
+    pool->release_linked_chunks(chunks, head, NULL);
+
+    while (state.KeepRunning())
+    {
+        if (!pool->acquire_linked_chunks_counted(chunks, head, num_chunks_in_chain, NULL))
+        {
+            state.SkipWithError("can't acquire chunks from shared chunk pool");
+            break;
+        }
+
+        pool->release_linked_chunks(chunks, head, NULL);
+    }
+
+    state.SetItemsProcessed(state.iterations() * num_chunks_in_chain);
+
+    GwDeleteSingle(pool);
+    VirtualFree(chunks, 0, MEM_RELEASE);
+}
+
+void BM_SharedChunkPoolAcquireRelease(BenchmarkState& state)
+{
+    RunSharedChunkPoolBenchmark(state, 1);
+}
+
+void BM_SharedChunkPoolAcquireReleaseChain8(BenchmarkState& state)
+{
+    RunSharedChunkPoolBenchmark(state, 8);
+}
+
+void BM_ChannelPushPop(BenchmarkState& state)
+{
+    core::chunk_index chunk_index = 0;
+
+    while (state.KeepRunning())
+    {
+        g_bench_channel.push_front(chunk_index);
+        g_bench_channel.pop_back(&chunk_index);
+    }
+
+    DoNotOptimize(chunk_index);
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ChannelPushPopBurst256(BenchmarkState& state)
+{
+    const core::chunk_index kBurstSize = 256;
+    core::chunk_index chunk_index = 0;
+
+    while (state.KeepRunning())
+    {
+        for (core::chunk_index i = 0; i < kBurstSize; i++)
+            g_bench_channel.push_front(i);
+
+        for (core::chunk_index i = 0; i < kBurstSize; i++)
+            g_bench_channel.pop_back(&chunk_index);
+    }
+
+    DoNotOptimize(chunk_index);
+
+    state.SetItemsProcessed(state.iterations() * kBurstSize);
+}
+
+// All gateway and IPC hot path benchmarks.
+const BenchmarkEntry kGatewayBenchmarks[] = {
+    { "BM_GetMethodAndUri", BM_GetMethodAndUri },
+    { "BM_DetermineField", BM_DetermineField },
+    { "BM_HttpParserExecute", BM_HttpParserExecute },
+    { "BM_WsMaskUnMask/4096", BM_WsMaskUnMask },
+    { "BM_HexStringToUint64", BM_HexStringToUint64 },
+    { "BM_SessionFillFromString", BM_SessionFillFromString },
+    { "BM_WorkerChunksObtainRelease", BM_WorkerChunksObtainRelease },
+    { "BM_WorkerChunksObtainRelease/burst:64", BM_WorkerChunksObtainReleaseBurst64 },
+    { "BM_SharedChunkPoolAcquireRelease", BM_SharedChunkPoolAcquireRelease },
+    { "BM_SharedChunkPoolAcquireRelease/chain:8", BM_SharedChunkPoolAcquireReleaseChain8 },
+    { "BM_ChannelPushPop", BM_ChannelPushPop },
+    { "BM_ChannelPushPop/burst:256", BM_ChannelPushPopBurst256 }
+};
+
+} // namespace network
+} // namespace starcounter
+
+int main(int argc, char* argv[])
+{
+    using namespace starcounter::network;
+
+    g_bench_worker = g_gateway.InitBenchmarkWorker(kBenchMaxConnections);
+    if (NULL == g_bench_worker)
+    {
+        fprintf(stderr, "Failed to initialize benchmark worker.\n");
+        return 1;
+    }
+
+    return RunBenchmarks(
+        kGatewayBenchmarks,
+        sizeof(kGatewayBenchmarks) / sizeof(kGatewayBenchmarks[0]),
+        argc,
+        argv);
+}
@@ -0,0 +1,375 @@
+#include <windows.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "micro_benchmark.hpp"
+
+namespace starcounter {
+namespace network {
+
+volatile uint64_t g_benchmark_sink = 0;
+
+// Default minimum time of one benchmark run in seconds.
+const double kDefaultBenchmarkMinTimeSeconds = 0.5;
+
+// Upper bound for calibrated number of iterations.
+const int64_t kMaxBenchmarkIterations = 1000000000;
+
+// Result of one benchmark run.
+struct BenchmarkResult
+{
+    std::string name_;
+    int64_t iterations_;
+    double real_time_ns_;
+    double cpu_time_ns_;
+    double bytes_per_second_;
+    double items_per_second_;
+    std::string error_message_;
+};
+
+uint64_t GetBenchmarkTicks()
+{
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return ticks.QuadPart;
+}
+
+uint64_t GetBenchmarkTicksPerSecond()
+{
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return freq.QuadPart;
+}
+
+// Returns kernel plus user time of the calling thread in 100 ns units.
+uint64_t GetThreadCpuTime100ns()
+{
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+        return 0;
+
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel_time.dwLowDateTime;
+    k.HighPart = kernel_time.dwHighDateTime;
+    u.LowPart = user_time.dwLowDateTime;
+    u.HighPart = user_time.dwHighDateTime;
+
+    return k.QuadPart + u.QuadPart;
+}
+
+BenchmarkState::BenchmarkState(int64_t max_iterations)
+{
+    max_iterations_ = max_iterations;
+    iterations_ = 0;
+    bytes_processed_ = 0;
+    items_processed_ = 0;
+    start_ticks_ = 0;
+    start_cpu_100ns_ = 0;
+    elapsed_ticks_ = 0;
+    elapsed_cpu_100ns_ = 0;
+    timing_ = false;
+    error_message_ = NULL;
+}
+
+void BenchmarkState::PauseTiming()
+{
+    elapsed_ticks_ += GetBenchmarkTicks() - start_ticks_;
+    elapsed_cpu_100ns_ += GetThreadCpuTime100ns() - start_cpu_100ns_;
+    timing_ = false;
+}
+
+void BenchmarkState::ResumeTiming()
+{
+    start_cpu_100ns_ = GetThreadCpuTime100ns();
+    start_ticks_ = GetBenchmarkTicks();
+    timing_ = true;
+}
+
+// Writes string as JSON string literal.
+void WriteJsonString(FILE* f, const char* s)
+{
+    fputc('"', f);
+
+    for (; *s; s++)
+    {
+        if (('"' == *s) || ('\\' == *s))
+        {
+            fputc('\\', f);
+            fputc(*s, f);
+        }
+        else if (static_cast<uint8_t>(*s) < 0x20)
+        {
+            fprintf(f, "\\u%04x", static_cast<uint8_t>(*s));
+        }
+        else
+        {
+            fputc(*s, f);
+        }
+    }
+
+    fputc('"', f);
+}
+
+// Writes results in Google Benchmark JSON format.
+void WriteBenchmarkJson(FILE* f, const std::vector<BenchmarkResult>& results)
+{
+    SYSTEMTIME now;
+    GetLocalTime(&now);
+
+    char date[64];
+    sprintf_s(date, sizeof(date), "%04d-%02d-%02d %02d:%02d:%02d",
+        now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond);
+
+    char host_name[MAX_COMPUTERNAME_LENGTH + 1] = "";
+    DWORD host_name_len = sizeof(host_name);
+    GetComputerNameA(host_name, &host_name_len);
+
+    char executable[MAX_PATH] = "";
+    GetModuleFileNameA(NULL, executable, MAX_PATH);
+
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+
+    DWORD mhz = 0;
+    DWORD mhz_size = sizeof(mhz);
+    RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0",
+        "~MHz", RRF_RT_REG_DWORD, NULL, &mhz, &mhz_size);
+
+    fprintf(f, "{\n  \"context\": {\n    \"date\": ");
+    WriteJsonString(f, date);
+    fprintf(f, ",\n    \"host_name\": ");
+    WriteJsonString(f, host_name);
+    fprintf(f, ",\n    \"executable\": ");
+    WriteJsonString(f, executable);
+    fprintf(f, ",\n    \"num_cpus\": %u,\n    \"mhz_per_cpu\": %u,\n", system_info.dwNumberOfProcessors, mhz);
+
+#ifdef _DEBUG
+    fprintf(f, "    \"library_build_type\": \"debug\"\n  },\n");
+#else
+    fprintf(f, "    \"library_build_type\": \"release\"\n  },\n");
+#endif
+
+    fprintf(f, "  \"benchmarks\": [");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& r = results[i];
+
+        fprintf(f, "%s\n    {\n      \"name\": ", (i > 0) ? "," : "");
+        WriteJsonString(f, r.name_.c_str());
+        fprintf(f, ",\n      \"run_name\": ");
+        WriteJsonString(f, r.name_.c_str());
+        fprintf(f, ",\n      \"run_type\": \"iteration\",\n      \"repetitions\": 1,\n      \"repetition_index\": 0,\n      \"threads\": 1");
+
+        if (!r.error_message_.empty())
+        {
+            fprintf(f, ",\n      \"error_occurred\": true,\n      \"error_message\": ");
+            WriteJsonString(f, r.error_message_.c_str());
+            fprintf(f, "\n    }");
+            continue;
+        }
+
+        fprintf(f, ",\n      \"iterations\": %lld,\n      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n      \"time_unit\": \"ns\"",
+            r.iterations_, r.real_time_ns_, r.cpu_time_ns_);
+
+        if (r.bytes_per_second_ > 0)
+            fprintf(f, ",\n      \"bytes_per_second\": %.4f", r.bytes_per_second_);
+
+        if (r.items_per_second_ > 0)
+            fprintf(f, ",\n      \"items_per_second\": %.4f", r.items_per_second_);
+
+        fprintf(f, "\n    }");
+    }
+
+    fprintf(f, "\n  ]\n}\n");
+}
+
+// Runs single benchmark calibrating the number of iterations.
+BenchmarkResult RunSingleBenchmark(const BenchmarkEntry& entry, double min_time_seconds, uint64_t ticks_per_second)
+{
+    BenchmarkResult result;
+    result.name_ = entry.name_;
+    result.iterations_ = 0;
+    result.real_time_ns_ = 0;
+    result.cpu_time_ns_ = 0;
+    result.bytes_per_second_ = 0;
+    result.items_per_second_ = 0;
+
+    int64_t num_iterations = 1;
+
+    while (true)
+    {
+        BenchmarkState state(num_iterations);
+        entry.func_(state);
+
+        if (NULL != state.error_message())
+        {
+            result.error_message_ = state.error_message();
+            return result;
+        }
+
+        if (state.iterations() != state.max_iterations())
+        {
+            result.error_message_ = "benchmark did not run all iterations";
+            return result;
+        }
+
+        double seconds = static_cast<double>(state.elapsed_ticks()) / ticks_per_second;
+
+        // Checking if the run was long enough to be reported.
+        if ((seconds >= min_time_seconds) || (num_iterations >= kMaxBenchmarkIterations))
+        {
+            result.iterations_ = num_iterations;
+            result.real_time_ns_ = seconds * 1e9 / num_iterations;
+            result.cpu_time_ns_ = static_cast<double>(state.elapsed_cpu_100ns()) * 100.0 / num_iterations;
+
+            if (seconds > 0)
+            {
+                result.bytes_per_second_ = state.bytes_processed() / seconds;
+                result.items_per_second_ = state.items_processed() / seconds;
+            }
+
+            return result;
+        }
+
+        // Predicting number of iterations needed, same way as Google Benchmark does.
+        double multiplier = 10.0;
+        if (seconds / min_time_seconds > 0.1)
+            multiplier = min_time_seconds * 1.4 / seconds;
+
+        if (multiplier < 2.0)
+            multiplier = 2.0;
+
+        double next_iterations = num_iterations * multiplier;
+        if (next_iterations > kMaxBenchmarkIterations)
+            next_iterations = kMaxBenchmarkIterations;
+
+        num_iterations = static_cast<int64_t>(next_iterations);
+    }
+}
+
+int32_t RunBenchmarks(
+    const BenchmarkEntry* entries,
+    int32_t num_entries,
+    int argc,
+    char* argv[])
+{
+    const char* filter = NULL;
+    const char* out_file = NULL;
+    bool json_to_console = false;
+    double min_time_seconds = kDefaultBenchmarkMinTimeSeconds;
+
+    // Parsing command line options.
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strncmp(argv[i], "--benchmark_filter=", 19))
+        {
+            filter = argv[i] + 19;
+            if ((0 == strcmp(filter, "all")) || (0 == strcmp(filter, ".")))
+                filter = NULL;
+        }
+        else if (0 == strncmp(argv[i], "--benchmark_out=", 16))
+        {
+            out_file = argv[i] + 16;
+        }
+        else if (0 == strncmp(argv[i], "--benchmark_min_time=", 21))
+        {
+            min_time_seconds = atof(argv[i] + 21);
+            if (min_time_seconds <= 0)
+                min_time_seconds = kDefaultBenchmarkMinTimeSeconds;
+        }
+        else if (0 == strcmp(argv[i], "--benchmark_format=json"))
+        {
+            json_to_console = true;
+        }
+        else if (0 == strcmp(argv[i], "--benchmark_format=console"))
+        {
+            json_to_console = false;
+        }
+        else if (0 == strcmp(argv[i], "--benchmark_list_tests"))
+        {
+            for (int32_t e = 0; e < num_entries; e++)
+                printf("%s\n", entries[e].name_);
+
+            return 0;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--benchmark_filter=<substring>] [--benchmark_min_time=<seconds>] "
+                "[--benchmark_out=<json file>] [--benchmark_format=<console|json>] [--benchmark_list_tests]\n", argv[0]);
+
+            return 1;
+        }
+    }
+
+    // Measuring on a fixed processor with high priority to reduce noise.
+    SetThreadAffinityMask(GetCurrentThread(), 1);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    uint64_t ticks_per_second = GetBenchmarkTicksPerSecond();
+    std::vector<BenchmarkResult> results;
+    int32_t num_failed = 0;
+
+    if (!json_to_console)
+    {
+        printf("%-44s %15s %15s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+        printf("-------------------------------------------------------------------------------------------\n");
+    }
+
+    for (int32_t e = 0; e < num_entries; e++)
+    {
+        if ((NULL != filter) && (NULL == strstr(entries[e].name_, filter)))
+            continue;
+
+        BenchmarkResult r = RunSingleBenchmark(entries[e], min_time_seconds, ticks_per_second);
+        results.push_back(r);
+
+        if (!r.error_message_.empty())
+            num_failed++;
+
+        if (json_to_console)
+            continue;
+
+        if (!r.error_message_.empty())
+        {
+            printf("%-44s ERROR OCCURRED: '%s'\n", r.name_.c_str(), r.error_message_.c_str());
+            continue;
+        }
+
+        printf("%-44s %12.1f ns %12.1f ns %12lld", r.name_.c_str(), r.real_time_ns_, r.cpu_time_ns_, r.iterations_);
+
+        if (r.bytes_per_second_ > 0)
+            printf(" bytes_per_second=%.1fM/s", r.bytes_per_second_ / (1024 * 1024));
+
+        if (r.items_per_second_ > 0)
+            printf(" items_per_second=%.1fM/s", r.items_per_second_ / 1e6);
+
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if (json_to_console)
+        WriteBenchmarkJson(stdout, results);
+
+    if (NULL != out_file)
+    {
+        FILE* f = NULL;
+        if (fopen_s(&f, out_file, "w") || (NULL == f))
+        {
+            fprintf(stderr, "Can't open benchmark output file: %s\n", out_file);
+            return 1;
+        }
+
+        WriteBenchmarkJson(f, results);
+        fclose(f);
+    }
+
+    return (num_failed > 0) ? 1 : 0;
+}
+
+} // namespace network
+} // namespace starcounter
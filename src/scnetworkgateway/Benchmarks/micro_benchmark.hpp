@@ -0,0 +1,157 @@
+#pragma once
+#ifndef MICRO_BENCHMARK_HPP
+#define MICRO_BENCHMARK_HPP
+
+#include <cstdint>
+
+namespace starcounter {
+namespace network {
+
+// Minimal microbenchmark harness following Google Benchmark conventions:
+// benchmark functions loop on KeepRunning(), iteration count is calibrated
+// until the run takes at least minimum time, results are printed as a table
+// and optionally written in Google Benchmark JSON format for trend tracking.
+
+// Sink that prevents the compiler from removing benchmarked code.
+extern volatile uint64_t g_benchmark_sink;
+
+// Consumes a computed value so that it is not optimized away.
+inline void DoNotOptimize(uint64_t value)
+{
+    g_benchmark_sink = value;
+}
+
+class BenchmarkState
+{
+    // Number of iterations to run.
+    int64_t max_iterations_;
+
+    // Number of iterations done so far.
+    int64_t iterations_;
+
+    // Bytes processed during the whole run, zero if not reported.
+    int64_t bytes_processed_;
+
+    // Items processed during the whole run, zero if not reported.
+    int64_t items_processed_;
+
+    // Performance counter and thread CPU time when timing was (re)started.
+    uint64_t start_ticks_;
+    uint64_t start_cpu_100ns_;
+
+    // Accumulated time while timing was running.
+    uint64_t elapsed_ticks_;
+    uint64_t elapsed_cpu_100ns_;
+
+    // Indicates that timing is currently running.
+    bool timing_;
+
+    // Set by the benchmark if it can't run.
+    const char* error_message_;
+
+public:
+
+    explicit BenchmarkState(int64_t max_iterations);
+
+    // Returns true while more iterations should be done.
+    bool KeepRunning()
+    {
+        if (iterations_ < max_iterations_)
+        {
+            if (0 == iterations_)
+                ResumeTiming();
+
+            iterations_++;
+            return true;
+        }
+
+        if (timing_)
+            PauseTiming();
+
+        return false;
+    }
+
+    // Excludes setup code inside the loop from measurement.
+    void PauseTiming();
+    void ResumeTiming();
+
+    void SetBytesProcessed(int64_t bytes)
+    {
+        bytes_processed_ = bytes;
+    }
+
+    void SetItemsProcessed(int64_t items)
+    {
+        items_processed_ = items;
+    }
+
+    // Marks the benchmark as failed.
+    void SkipWithError(const char* message)
+    {
+        error_message_ = message;
+        max_iterations_ = 0;
+    }
+
+    int64_t iterations()
+    {
+        return iterations_;
+    }
+
+    int64_t max_iterations()
+    {
+        return max_iterations_;
+    }
+
+    int64_t bytes_processed()
+    {
+        return bytes_processed_;
+    }
+
+    int64_t items_processed()
+    {
+        return items_processed_;
+    }
+
+    uint64_t elapsed_ticks()
+    {
+        return elapsed_ticks_;
+    }
+
+    uint64_t elapsed_cpu_100ns()
+    {
+        return elapsed_cpu_100ns_;
+    }
+
+    const char* error_message()
+    {
+        return error_message_;
+    }
+};
+
+// Benchmark function type.
+typedef void (*BenchmarkFunction)(BenchmarkState& state);
+
+// Registered benchmark.
+struct BenchmarkEntry
+{
+    // Benchmark name as it appears in the output.
+    const char* name_;
+
+    // Benchmark function.
+    BenchmarkFunction func_;
+};
+
+// Runs benchmarks according to command line options:
+// --benchmark_filter=<substring>, --benchmark_min_time=<seconds>,
+// --benchmark_out=<json file>, --benchmark_format=<console|json>.
+// Returns zero if all benchmarks succeeded.
+int32_t RunBenchmarks(
+    const BenchmarkEntry* entries,
+    int32_t num_entries,
+    int argc,
+    char* argv[]);
+
+} // namespace network
+} // namespace starcounter
+
+#endif // MICRO_BENCHMARK_HPP
@@ -0,0 +1,844 @@
+#include "load_generator.hpp"
+
+namespace starcounter {
+namespace network {
+
+// Performance counter frequency.
+uint64_t g_ticks_per_second = 0;
+
+// Performance counter values when load starts, measurement starts and load ends.
+uint64_t g_load_start_ticks = 0;
+uint64_t g_measure_start_ticks = 0;
+uint64_t g_load_end_ticks = 0;
+
+// Key used to mask WebSocket frames from client.
+const uint8_t kLoadWsMask[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+uint64_t GetLoadTicks()
+{
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return ticks.QuadPart;
+}
+
+LoadConnection::LoadConnection()
+{
+    sock_ = INVALID_SOCKET;
+    first_in_flight_ = 0;
+    num_in_flight_ = 0;
+    next_send_ticks_ = 0;
+    out_offset_ = 0;
+    recv_buf_ = new char[LOADGEN_RECV_BUFFER_SIZE];
+    recv_len_ = 0;
+    raw_pending_bytes_ = 0;
+    failed_ = false;
+}
+
+LoadConnection::~LoadConnection()
+{
+    Close();
+
+    delete[] recv_buf_;
+    recv_buf_ = NULL;
+}
+
+void LoadConnection::Close()
+{
+    if (INVALID_SOCKET != sock_)
+    {
+        closesocket(sock_);
+        sock_ = INVALID_SOCKET;
+    }
+
+    failed_ = true;
+}
+
+uint32_t LoadConnection::Connect(const sockaddr_in& addr, const LoadSettings& settings)
+{
+    sock_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (INVALID_SOCKET == sock_)
+        return WSAGetLastError();
+
+    // Requests are small and latency matters, so disabling Nagle.
+    int32_t on_flag = 1;
+    setsockopt(sock_, IPPROTO_TCP, TCP_NODELAY, (char*) &on_flag, sizeof(on_flag));
+
+    if (SOCKET_ERROR == connect(sock_, (const sockaddr*) &addr, sizeof(addr)))
+        return WSAGetLastError();
+
+    raw_pending_bytes_ = settings.body_size_;
+
+    // Upgrading to WebSocket before switching to non-blocking mode.
+    if (LOAD_MODE_WEBSOCKET == settings.mode_)
+    {
+        std::stringstream upgrade;
+        upgrade << "GET " << settings.uri_ << " HTTP/1.1\r\n"
+            "Host: " << settings.host_ << "\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+
+        std::string upgrade_str = upgrade.str();
+        if (SOCKET_ERROR == send(sock_, upgrade_str.c_str(), static_cast<int32_t>(upgrade_str.size()), 0))
+            return WSAGetLastError();
+
+        // Reading until the end of the upgrade response headers.
+        char* headers_end = NULL;
+        while (NULL == headers_end)
+        {
+            int32_t n = recv(sock_, recv_buf_ + recv_len_, LOADGEN_RECV_BUFFER_SIZE - 1 - recv_len_, 0);
+            if (n <= 0)
+                return WSAECONNRESET;
+
+            recv_len_ += n;
+            recv_buf_[recv_len_] = '\0';
+            headers_end = strstr(recv_buf_, "\r\n\r\n");
+        }
+
+        if (0 != strncmp(recv_buf_ + 8, " 101", 4))
+            return WSAECONNREFUSED;
+
+        // Keeping any bytes after the upgrade response.
+        int32_t headers_len = static_cast<int32_t>(headers_end + 4 - recv_buf_);
+        memmove(recv_buf_, recv_buf_ + headers_len, recv_len_ - headers_len);
+        recv_len_ -= headers_len;
+    }
+
+    u_long non_blocking = 1;
+    if (SOCKET_ERROR == ioctlsocket(sock_, FIONBIO, &non_blocking))
+        return WSAGetLastError();
+
+    failed_ = false;
+
+    return 0;
+}
+
+void LoadConnection::PushRequest(const std::string& request, uint64_t intended_ticks)
+{
+    intended_ticks_[(first_in_flight_ + num_in_flight_) % LOADGEN_MAX_PIPELINE_DEPTH] = intended_ticks;
+    num_in_flight_++;
+
+    out_.append(request);
+}
+
+uint32_t LoadConnection::Flush()
+{
+    while (out_offset_ < static_cast<int32_t>(out_.size()))
+    {
+        int32_t n = send(sock_, out_.c_str() + out_offset_, static_cast<int32_t>(out_.size()) - out_offset_, 0);
+
+        if (SOCKET_ERROR == n)
+        {
+            uint32_t err_code = WSAGetLastError();
+            if (WSAEWOULDBLOCK == err_code)
+                break;
+
+            failed_ = true;
+            return err_code;
+        }
+
+        out_offset_ += n;
+    }
+
+    // Dropping sent bytes.
+    if (out_offset_ == static_cast<int32_t>(out_.size()))
+    {
+        out_.clear();
+        out_offset_ = 0;
+    }
+
+    return 0;
+}
+
+int32_t LoadConnection::Receive(const LoadSettings& settings, uint64_t* intended_ticks, int32_t* num_errors, int64_t* bytes_received)
+{
+    int32_t num_completed = 0;
+
+    while (!failed_)
+    {
+        int32_t n = recv(sock_, recv_buf_ + recv_len_, LOADGEN_RECV_BUFFER_SIZE - recv_len_, 0);
+
+        if (0 == n)
+        {
+            failed_ = true;
+            break;
+        }
+
+        if (SOCKET_ERROR == n)
+        {
+            if (WSAEWOULDBLOCK != WSAGetLastError())
+                failed_ = true;
+
+            break;
+        }
+
+        *bytes_received += n;
+        recv_len_ += n;
+
+        // Completing all whole responses in the buffer.
+        int32_t offset = 0;
+        while ((offset < recv_len_) && (num_in_flight_ > 0))
+        {
+            int32_t len = 0;
+            bool is_complete = false;
+
+            switch (settings.mode_)
+            {
+                case LOAD_MODE_RAW:
+                {
+                    len = recv_len_ - offset;
+                    if (len > raw_pending_bytes_)
+                        len = raw_pending_bytes_;
+
+                    raw_pending_bytes_ -= len;
+                    if (0 == raw_pending_bytes_)
+                    {
+                        is_complete = true;
+                        raw_pending_bytes_ = settings.body_size_;
+                    }
+
+                    break;
+                }
+
+                case LOAD_MODE_WEBSOCKET:
+                {
+                    len = ParseWsFrameLength(recv_buf_ + offset, recv_len_ - offset, &is_complete);
+                    break;
+                }
+
+                default:
+                {
+                    bool is_error = false;
+                    len = ParseHttpResponseLength(recv_buf_ + offset, recv_len_ - offset, &is_error);
+
+                    if (len > 0)
+                    {
+                        is_complete = true;
+                        if (is_error)
+                            (*num_errors)++;
+                    }
+
+                    break;
+                }
+            }
+
+            // Waiting for more bytes.
+            if (0 == len)
+                break;
+
+            offset += len;
+
+            if (is_complete)
+            {
+                intended_ticks[num_completed] = intended_ticks_[first_in_flight_];
+                num_completed++;
+
+                first_in_flight_ = (first_in_flight_ + 1) % LOADGEN_MAX_PIPELINE_DEPTH;
+                num_in_flight_--;
+            }
+        }
+
+        memmove(recv_buf_, recv_buf_ + offset, recv_len_ - offset);
+        recv_len_ -= offset;
+
+        // Response does not fit into the receive buffer.
+        if (LOADGEN_RECV_BUFFER_SIZE == recv_len_)
+            failed_ = true;
+    }
+
+    return num_completed;
+}
+
+// Case insensitive search of a header in response headers.
+const char* FindLoadHeader(const char* headers, int32_t headers_len, const char* name)
+{
+    int32_t name_len = static_cast<int32_t>(strlen(name));
+
+    for (int32_t i = 0; i + name_len <= headers_len; i++)
+    {
+        if (0 == _strnicmp(headers + i, name, name_len))
+            return headers + i + name_len;
+    }
+
+    return NULL;
+}
+
+int32_t ParseHttpResponseLength(const char* buf, int32_t buf_len, bool* is_error)
+{
+    // Looking for the end of headers.
+    int32_t headers_len = 0;
+    for (int32_t i = 3; i < buf_len; i++)
+    {
+        if ((buf[i] == '\n') && (buf[i - 1] == '\r') && (buf[i - 2] == '\n') && (buf[i - 3] == '\r'))
+        {
+            headers_len = i + 1;
+            break;
+        }
+    }
+
+    if (0 == headers_len)
+        return 0;
+
+    // Checking for "HTTP/1.1 2xx".
+    *is_error = (headers_len < 12) || (buf[9] != '2');
+
+    int64_t content_len = 0;
+    const char* content_len_str = FindLoadHeader(buf, headers_len, "\r\nContent-Length:");
+    if (NULL != content_len_str)
+        content_len = _atoi64(content_len_str);
+
+    if (headers_len + content_len > buf_len)
+        return 0;
+
+    return static_cast<int32_t>(headers_len + content_len);
+}
+
+int32_t ParseWsFrameLength(const char* buf, int32_t buf_len, bool* is_data_frame)
+{
+    if (buf_len < 2)
+        return 0;
+
+    uint8_t b0 = static_cast<uint8_t>(buf[0]);
+    uint8_t b1 = static_cast<uint8_t>(buf[1]);
+
+    int64_t payload_len = b1 & 0x7F;
+    int32_t header_len = 2;
+
+    if (126 == payload_len)
+    {
+        if (buf_len < 4)
+            return 0;
+
+        payload_len = (static_cast<uint8_t>(buf[2]) << 8) | static_cast<uint8_t>(buf[3]);
+        header_len = 4;
+    }
+    else if (127 == payload_len)
+    {
+        if (buf_len < 10)
+            return 0;
+
+        payload_len = 0;
+        for (int32_t i = 0; i < 8; i++)
+            payload_len = (payload_len << 8) | static_cast<uint8_t>(buf[2 + i]);
+
+        header_len = 10;
+    }
+
+    // Masked frames carry the mask key.
+    if (b1 & 0x80)
+        header_len += 4;
+
+    if (header_len + payload_len > buf_len)
+        return 0;
+
+    // Only final text or binary frames count as responses.
+    int32_t opcode = b0 & 0x0F;
+    *is_data_frame = (0 != (b0 & 0x80)) && ((1 == opcode) || (2 == opcode) || (0 == opcode));
+
+    return static_cast<int32_t>(header_len + payload_len);
+}
+
+std::string BuildLoadRequest(const LoadSettings& settings)
+{
+    std::string body(settings.body_size_, 'x');
+
+    switch (settings.mode_)
+    {
+        case LOAD_MODE_RAW:
+        {
+            return body;
+        }
+
+        case LOAD_MODE_WEBSOCKET:
+        {
+            std::string frame;
+
+            // Final text frame.
+            frame.push_back(static_cast<char>(0x81));
+
+            if (settings.body_size_ < 126)
+            {
+                frame.push_back(static_cast<char>(0x80 | settings.body_size_));
+            }
+            else if (settings.body_size_ < 65536)
+            {
+                frame.push_back(static_cast<char>(0x80 | 126));
+                frame.push_back(static_cast<char>(settings.body_size_ >> 8));
+                frame.push_back(static_cast<char>(settings.body_size_ & 0xFF));
+            }
+            else
+            {
+                frame.push_back(static_cast<char>(0x80 | 127));
+                for (int32_t i = 7; i >= 0; i--)
+                    frame.push_back(static_cast<char>((static_cast<uint64_t>(settings.body_size_) >> (i * 8)) & 0xFF));
+            }
+
+            // Client frames must be masked.
+            for (int32_t i = 0; i < 4; i++)
+                frame.push_back(static_cast<char>(kLoadWsMask[i]));
+
+            for (int32_t i = 0; i < settings.body_size_; i++)
+                frame.push_back(static_cast<char>(body[i] ^ kLoadWsMask[i % 4]));
+
+            return frame;
+        }
+
+        default:
+        {
+            std::stringstream request;
+            request << settings.method_ << " " << settings.uri_ << " HTTP/1.1\r\n"
+                "Host: " << settings.host_ << "\r\n";
+
+            if ((settings.body_size_ > 0) || (settings.method_ != "GET"))
+                request << "Content-Length: " << settings.body_size_ << "\r\n";
+
+            request << "\r\n" << body;
+
+            return request.str();
+        }
+    }
+}
+
+LoadThread::LoadThread()
+{
+    settings_ = NULL;
+    connections_ = NULL;
+    num_connections_ = 0;
+    first_connection_index_ = 0;
+    num_responses_ = 0;
+    num_errors_ = 0;
+    bytes_sent_ = 0;
+    bytes_received_ = 0;
+    num_failed_connections_ = 0;
+    thread_handle_ = NULL;
+}
+
+LoadThread::~LoadThread()
+{
+    delete[] connections_;
+    connections_ = NULL;
+}
+
+uint32_t LoadThread::Init(const LoadSettings* settings, int32_t first_connection_index, int32_t num_connections, const sockaddr_in& addr)
+{
+    settings_ = settings;
+    first_connection_index_ = first_connection_index;
+    num_connections_ = num_connections;
+    request_ = BuildLoadRequest(*settings);
+
+    connections_ = new LoadConnection[num_connections];
+
+    for (int32_t i = 0; i < num_connections; i++)
+    {
+        uint32_t err_code = connections_[i].Connect(addr, *settings);
+        if (err_code)
+        {
+            std::cout << "Connection " << (first_connection_index + i) << " failed with error " << err_code << "." << std::endl;
+            connections_[i].Close();
+            num_failed_connections_++;
+        }
+    }
+
+    return 0;
+}
+
+void LoadThread::Run()
+{
+    bool fixed_rate = (settings_->rate_ > 0);
+    int32_t depth = settings_->pipeline_depth_;
+
+    // Each connection sends its share of the total rate.
+    uint64_t interval_ticks = 0;
+    if (fixed_rate)
+        interval_ticks = static_cast<uint64_t>(g_ticks_per_second * settings_->num_connections_ / settings_->rate_);
+
+    // Spreading first requests of all connections over one interval.
+    for (int32_t i = 0; i < num_connections_; i++)
+        connections_[i].set_next_send_ticks(g_load_start_ticks + interval_ticks * (first_connection_index_ + i) / settings_->num_connections_);
+
+    WSAPOLLFD* fds = new WSAPOLLFD[num_connections_];
+    uint64_t* completed_ticks = new uint64_t[LOADGEN_MAX_PIPELINE_DEPTH];
+    double ticks_per_us = g_ticks_per_second / 1000000.0;
+
+    while (true)
+    {
+        uint64_t now = GetLoadTicks();
+        if (now >= g_load_end_ticks)
+            break;
+
+        uint64_t next_wakeup_ticks = g_load_end_ticks;
+
+        for (int32_t i = 0; i < num_connections_; i++)
+        {
+            LoadConnection& c = connections_[i];
+
+            // Failed connections are ignored by poll.
+            fds[i].fd = c.get_failed() ? INVALID_SOCKET : c.get_socket();
+            fds[i].events = POLLRDNORM;
+            fds[i].revents = 0;
+
+            if (c.get_failed())
+                continue;
+
+            // Issuing requests that are due. In fixed rate mode the intended
+            // send time is the schedule, so time spent waiting for a free
+            // pipeline slot counts as latency (coordinated omission correction).
+            while (c.get_num_in_flight() < depth)
+            {
+                uint64_t intended_ticks = now;
+
+                if (fixed_rate)
+                {
+                    intended_ticks = c.get_next_send_ticks();
+                    if (intended_ticks > now)
+                        break;
+
+                    c.set_next_send_ticks(intended_ticks + interval_ticks);
+                }
+
+                c.PushRequest(request_, intended_ticks);
+                bytes_sent_ += request_.size();
+            }
+
+            if (fixed_rate && (c.get_next_send_ticks() < next_wakeup_ticks))
+                next_wakeup_ticks = c.get_next_send_ticks();
+
+            if (c.Flush())
+            {
+                num_errors_ += c.get_num_in_flight();
+                num_failed_connections_++;
+                c.Close();
+                fds[i].fd = INVALID_SOCKET;
+            }
+        }
+
+        // Sleeping in poll until data arrives or the next request is due.
+        int32_t timeout_ms = 10;
+        if (fixed_rate)
+        {
+            timeout_ms = 0;
+            if (next_wakeup_ticks > now)
+                timeout_ms = static_cast<int32_t>((next_wakeup_ticks - now) * 1000 / g_ticks_per_second);
+
+            if (timeout_ms > 10)
+                timeout_ms = 10;
+        }
+
+        if (WSAPoll(fds, num_connections_, timeout_ms) <= 0)
+            continue;
+
+        now = GetLoadTicks();
+
+        for (int32_t i = 0; i < num_connections_; i++)
+        {
+            if (0 == (fds[i].revents & (POLLRDNORM | POLLERR | POLLHUP)))
+                continue;
+
+            LoadConnection& c = connections_[i];
+
+            int32_t num_errors = 0;
+            int32_t num_completed = c.Receive(*settings_, completed_ticks, &num_errors, &bytes_received_);
+            num_errors_ += num_errors;
+
+            // Only responses to requests intended after warmup are measured.
+            for (int32_t k = 0; k < num_completed; k++)
+            {
+                if (completed_ticks[k] >= g_measure_start_ticks)
+                {
+                    histogram_.Record(static_cast<uint64_t>((now - completed_ticks[k]) / ticks_per_us));
+                    num_responses_++;
+                }
+            }
+
+            if (c.get_failed())
+            {
+                num_errors_ += c.get_num_in_flight();
+                num_failed_connections_++;
+                c.Close();
+            }
+        }
+    }
+
+    delete[] completed_ticks;
+    delete[] fds;
+}
+
+DWORD WINAPI LoadThreadRoutine(LPVOID params)
+{
+    ((LoadThread*) params)->Run();
+
+    return 0;
+}
+
+uint32_t LoadThread::Start()
+{
+    thread_handle_ = CreateThread(NULL, 0, LoadThreadRoutine, this, 0, NULL);
+    if (NULL == thread_handle_)
+        return GetLastError();
+
+    return 0;
+}
+
+void LoadThread::Join()
+{
+    if (NULL != thread_handle_)
+    {
+        WaitForSingleObject(thread_handle_, INFINITE);
+        CloseHandle(thread_handle_);
+        thread_handle_ = NULL;
+    }
+}
+
+void PrintLoadUsage()
+{
+    std::cout << "Usage: scgwloadgen [options]" << std::endl <<
+        "  --host=<address>       Target host (default 127.0.0.1)." << std::endl <<
+        "  --port=<port>          Target port (default 8080)." << std::endl <<
+        "  --mode=<mode>          http, pipelined, ws or raw (default http)." << std::endl <<
+        "  --method=<method>      HTTP method (default GET)." << std::endl <<
+        "  --uri=<uri>            HTTP or WebSocket upgrade URI (default /)." << std::endl <<
+        "  --body=<bytes>         Request body, frame payload or raw message size (default 0)." << std::endl <<
+        "  --connections=<n>      Total number of connections (default 16)." << std::endl <<
+        "  --threads=<n>          Number of load threads (default 1)." << std::endl <<
+        "  --depth=<n>            Requests in flight per connection (default 1, 16 for pipelined)." << std::endl <<
+        "  --rate=<n>             Total requests per second, 0 for closed loop (default 0)." << std::endl <<
+        "  --duration=<seconds>   Measured duration (default 10)." << std::endl <<
+        "  --warmup=<seconds>     Warmup before measuring (default 2)." << std::endl <<
+        "Example, gateway only HTTP echo at 20000 requests per second:" << std::endl <<
+        "  scgwloadgen --port=8181 --method=POST --uri=/gw/echo --body=64 --connections=64 --rate=20000" << std::endl;
+}
+
+// Gets option value if argument is given option.
+bool GetLoadOption(const char* arg, const char* name, std::string* value)
+{
+    size_t name_len = strlen(name);
+
+    if ((0 != strncmp(arg, name, name_len)) || (arg[name_len] != '='))
+        return false;
+
+    *value = arg + name_len + 1;
+
+    return true;
+}
+
+// Parses command line into settings, returns false on wrong arguments.
+bool ParseLoadSettings(int argc, char* argv[], LoadSettings* settings)
+{
+    bool depth_given = false;
+
+    for (int32_t i = 1; i < argc; i++)
+    {
+        std::string v;
+
+        if (GetLoadOption(argv[i], "--host", &v))
+            settings->host_ = v;
+        else if (GetLoadOption(argv[i], "--port", &v))
+            settings->port_ = static_cast<uint16_t>(atoi(v.c_str()));
+        else if (GetLoadOption(argv[i], "--method", &v))
+            settings->method_ = v;
+        else if (GetLoadOption(argv[i], "--uri", &v))
+            settings->uri_ = v;
+        else if (GetLoadOption(argv[i], "--body", &v))
+            settings->body_size_ = atoi(v.c_str());
+        else if (GetLoadOption(argv[i], "--connections", &v))
+            settings->num_connections_ = atoi(v.c_str());
+        else if (GetLoadOption(argv[i], "--threads", &v))
+            settings->num_threads_ = atoi(v.c_str());
+        else if (GetLoadOption(argv[i], "--rate", &v))
+            settings->rate_ = atof(v.c_str());
+        else if (GetLoadOption(argv[i], "--duration", &v))
+            settings->duration_seconds_ = atoi(v.c_str());
+        else if (GetLoadOption(argv[i], "--warmup", &v))
+            settings->warmup_seconds_ = atoi(v.c_str());
+        else if (GetLoadOption(argv[i], "--depth", &v))
+        {
+            settings->pipeline_depth_ = atoi(v.c_str());
+            depth_given = true;
+        }
+        else if (GetLoadOption(argv[i], "--mode", &v))
+        {
+            if (v == "http")
+                settings->mode_ = LOAD_MODE_HTTP;
+            else if (v == "pipelined")
+                settings->mode_ = LOAD_MODE_HTTP_PIPELINED;
+            else if (v == "ws")
+                settings->mode_ = LOAD_MODE_WEBSOCKET;
+            else if (v == "raw")
+                settings->mode_ = LOAD_MODE_RAW;
+            else
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Plain HTTP keep-alive has exactly one request in flight.
+    if (LOAD_MODE_HTTP == settings->mode_)
+        settings->pipeline_depth_ = 1;
+    else if ((LOAD_MODE_HTTP_PIPELINED == settings->mode_) && (!depth_given))
+        settings->pipeline_depth_ = 16;
+
+    if ((0 == settings->port_) ||
+        (settings->num_connections_ <= 0) ||
+        (settings->num_threads_ <= 0) ||
+        (settings->num_threads_ > LOADGEN_MAX_THREADS) ||
+        (settings->num_threads_ > settings->num_connections_) ||
+        (settings->pipeline_depth_ <= 0) ||
+        (settings->pipeline_depth_ > LOADGEN_MAX_PIPELINE_DEPTH) ||
+        (settings->body_size_ < 0) ||
+        (settings->rate_ < 0) ||
+        (settings->duration_seconds_ <= 0) ||
+        (settings->warmup_seconds_ < 0))
+    {
+        return false;
+    }
+
+    // Raw echo needs at least one byte to wait for.
+    if ((LOAD_MODE_RAW == settings->mode_) && (0 == settings->body_size_))
+        return false;
+
+    return true;
+}
+
+const char* GetLoadModeName(LOAD_MODE mode)
+{
+    switch (mode)
+    {
+        case LOAD_MODE_HTTP_PIPELINED: return "pipelined";
+        case LOAD_MODE_WEBSOCKET: return "ws";
+        case LOAD_MODE_RAW: return "raw";
+        default: return "http";
+    }
+}
+
+} // namespace network
+} // namespace starcounter
+
+using namespace starcounter::network;
+
+int main(int argc, char* argv[])
+{
+    LoadSettings settings;
+
+    if (!ParseLoadSettings(argc, argv, &settings))
+    {
+        PrintLoadUsage();
+        return 1;
+    }
+
+    WSADATA wsa_data;
+    if (0 != WSAStartup(MAKEWORD(2, 2), &wsa_data))
+    {
+        std::cout << "Can't initialize WinSock." << std::endl;
+        return 1;
+    }
+
+    // Resolving target address.
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addr_info = NULL;
+    if ((0 != getaddrinfo(settings.host_.c_str(), NULL, &hints, &addr_info)) || (NULL == addr_info))
+    {
+        std::cout << "Can't resolve host " << settings.host_ << "." << std::endl;
+        return 1;
+    }
+
+    sockaddr_in addr = *(sockaddr_in*) addr_info->ai_addr;
+    addr.sin_port = htons(settings.port_);
+    freeaddrinfo(addr_info);
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    g_ticks_per_second = freq.QuadPart;
+
+    // Spreading connections over threads.
+    LoadThread* threads = new LoadThread[settings.num_threads_];
+    int32_t first_connection_index = 0;
+
+    for (int32_t t = 0; t < settings.num_threads_; t++)
+    {
+        int32_t num_connections = settings.num_connections_ / settings.num_threads_;
+        if (t < (settings.num_connections_ % settings.num_threads_))
+            num_connections++;
+
+        threads[t].Init(&settings, first_connection_index, num_connections, addr);
+        first_connection_index += num_connections;
+    }
+
+    std::cout << "Running " << GetLoadModeName(settings.mode_) << " load against " << settings.host_ << ":" << settings.port_ << settings.uri_ <<
+        " with " << settings.num_connections_ << " connections, depth " << settings.pipeline_depth_ << ", ";
+
+    if (settings.rate_ > 0)
+        std::cout << settings.rate_ << " requests/s";
+    else
+        std::cout << "closed loop";
+
+    std::cout << ", " << settings.warmup_seconds_ << " s warmup and " << settings.duration_seconds_ << " s measured. . ." << std::endl;
+
+    g_load_start_ticks = GetLoadTicks();
+    g_measure_start_ticks = g_load_start_ticks + settings.warmup_seconds_ * g_ticks_per_second;
+    g_load_end_ticks = g_measure_start_ticks + settings.duration_seconds_ * g_ticks_per_second;
+
+    for (int32_t t = 0; t < settings.num_threads_; t++)
+        threads[t].Start();
+
+    // Merging results of all threads.
+    LoadLatencyHistogram histogram;
+    int64_t num_responses = 0, num_errors = 0, bytes_sent = 0, bytes_received = 0;
+    int32_t num_failed_connections = 0;
+
+    for (int32_t t = 0; t < settings.num_threads_; t++)
+    {
+        threads[t].Join();
+
+        histogram.Add(threads[t].get_histogram());
+        num_responses += threads[t].get_num_responses();
+        num_errors += threads[t].get_num_errors();
+        bytes_sent += threads[t].get_bytes_sent();
+        bytes_received += threads[t].get_bytes_received();
+        num_failed_connections += threads[t].get_num_failed_connections();
+    }
+
+    delete[] threads;
+
+    double seconds = settings.duration_seconds_;
+    double total_seconds = settings.duration_seconds_ + settings.warmup_seconds_;
+
+    std::cout << "Responses: " << num_responses << ", errors: " << num_errors << ", failed connections: " << num_failed_connections << std::endl;
+    std::cout << "Throughput: " << static_cast<int64_t>(num_responses / seconds) << " responses/s, " <<
+        (bytes_sent / total_seconds / (1024 * 1024)) << " MB/s sent, " <<
+        (bytes_received / total_seconds / (1024 * 1024)) << " MB/s received" << std::endl;
+    std::cout << "Latency (us, corrected for coordinated omission): p50 " << histogram.GetPercentile(50) <<
+        ", p90 " << histogram.GetPercentile(90) <<
+        ", p99 " << histogram.GetPercentile(99) <<
+        ", p99.9 " << histogram.GetPercentile(99.9) <<
+        ", max " << histogram.get_max_value_us() << std::endl;
+
+    // Machine readable summary for comparing releases.
+    std::cout << "{\"mode\":\"" << GetLoadModeName(settings.mode_) << "\"" <<
+        ",\"connections\":" << settings.num_connections_ <<
+        ",\"depth\":" << settings.pipeline_depth_ <<
+        ",\"rate\":" << settings.rate_ <<
+        ",\"body\":" << settings.body_size_ <<
+        ",\"responses\":" << num_responses <<
+        ",\"errors\":" << num_errors <<
+        ",\"failed_connections\":" << num_failed_connections <<
+        ",\"responses_per_second\":" << static_cast<int64_t>(num_responses / seconds) <<
+        ",\"p50_us\":" << histogram.GetPercentile(50) <<
+        ",\"p90_us\":" << histogram.GetPercentile(90) <<
+        ",\"p99_us\":" << histogram.GetPercentile(99) <<
+        ",\"p999_us\":" << histogram.GetPercentile(99.9) <<
+        ",\"max_us\":" << histogram.get_max_value_us() << "}" << std::endl;
+
+    WSACleanup();
+
+    // Non-zero exit code lets scripts fail on errors.
+    return ((num_errors > 0) || (num_failed_connections > 0)) ? 2 : 0;
+}
@@ -0,0 +1,368 @@
+#pragma once
+#ifndef LOAD_GENERATOR_HPP
+#define LOAD_GENERATOR_HPP
+
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <intrin.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+namespace starcounter {
+namespace network {
+
+// Load generator connection modes.
+enum LOAD_MODE
+{
+    // HTTP keep-alive, one request in flight per connection.
+    LOAD_MODE_HTTP,
+
+    // HTTP keep-alive with several pipelined requests in flight.
+    LOAD_MODE_HTTP_PIPELINED,
+
+    // WebSocket frames after an HTTP upgrade.
+    LOAD_MODE_WEBSOCKET,
+
+    // Raw bytes echoed back as is.
+    LOAD_MODE_RAW
+};
+
+// Maximum number of load threads.
+const int32_t LOADGEN_MAX_THREADS = 64;
+
+// Maximum number of requests in flight per connection.
+const int32_t LOADGEN_MAX_PIPELINE_DEPTH = 256;
+
+// Receive buffer size per connection.
+const int32_t LOADGEN_RECV_BUFFER_SIZE = 64 * 1024;
+
+// Number of sub-buckets per power of two in latency histograms (values below twice that are exact).
+const int32_t LOADGEN_HISTOGRAM_SUB_BUCKETS = 16;
+
+// Number of powers of two covered above exact values.
+const int32_t LOADGEN_HISTOGRAM_NUM_RANGES = 32;
+
+const int32_t LOADGEN_HISTOGRAM_NUM_BUCKETS = 2 * LOADGEN_HISTOGRAM_SUB_BUCKETS + LOADGEN_HISTOGRAM_NUM_RANGES * LOADGEN_HISTOGRAM_SUB_BUCKETS;
+
+// Log-linear histogram of latencies in microseconds with ~6% precision,
+// same bucketing as the gateway stage latency histograms.
+class LoadLatencyHistogram
+{
+    int64_t counts_[LOADGEN_HISTOGRAM_NUM_BUCKETS];
+
+    int64_t total_count_;
+
+    uint64_t max_value_us_;
+
+public:
+
+    LoadLatencyHistogram()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for (int32_t i = 0; i < LOADGEN_HISTOGRAM_NUM_BUCKETS; i++)
+            counts_[i] = 0;
+
+        total_count_ = 0;
+        max_value_us_ = 0;
+    }
+
+    // Gets bucket index for given value.
+    static int32_t GetBucketIndex(uint64_t value_us)
+    {
+        if (value_us < 2 * LOADGEN_HISTOGRAM_SUB_BUCKETS)
+            return static_cast<int32_t>(value_us);
+
+        unsigned long msb;
+        _BitScanReverse64(&msb, value_us);
+
+        // Keeping 4 significant bits below the most significant one.
+        int32_t shift = static_cast<int32_t>(msb) - 4;
+        if (shift > LOADGEN_HISTOGRAM_NUM_RANGES)
+            return LOADGEN_HISTOGRAM_NUM_BUCKETS - 1;
+
+        return 2 * LOADGEN_HISTOGRAM_SUB_BUCKETS + (shift - 1) * LOADGEN_HISTOGRAM_SUB_BUCKETS +
+            static_cast<int32_t>((value_us >> shift) - LOADGEN_HISTOGRAM_SUB_BUCKETS);
+    }
+
+    // Gets the highest value that falls into given bucket.
+    static uint64_t GetBucketHighestValue(int32_t index)
+    {
+        if (index < 2 * LOADGEN_HISTOGRAM_SUB_BUCKETS)
+            return index;
+
+        int32_t shift = (index - 2 * LOADGEN_HISTOGRAM_SUB_BUCKETS) / LOADGEN_HISTOGRAM_SUB_BUCKETS + 1;
+        uint64_t sub_bucket = (index - 2 * LOADGEN_HISTOGRAM_SUB_BUCKETS) % LOADGEN_HISTOGRAM_SUB_BUCKETS + LOADGEN_HISTOGRAM_SUB_BUCKETS;
+
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    void Record(uint64_t value_us)
+    {
+        counts_[GetBucketIndex(value_us)]++;
+        total_count_++;
+
+        if (value_us > max_value_us_)
+            max_value_us_ = value_us;
+    }
+
+    // Adds counts of given histogram to this one.
+    void Add(const LoadLatencyHistogram& h)
+    {
+        for (int32_t i = 0; i < LOADGEN_HISTOGRAM_NUM_BUCKETS; i++)
+            counts_[i] += h.counts_[i];
+
+        total_count_ += h.total_count_;
+
+        if (h.max_value_us_ > max_value_us_)
+            max_value_us_ = h.max_value_us_;
+    }
+
+    // Gets the value at given percentile (0 - 100).
+    uint64_t GetPercentile(double percentile)
+    {
+        if (0 == total_count_)
+            return 0;
+
+        int64_t target = static_cast<int64_t>((percentile / 100.0) * total_count_ + 0.5);
+        if (target < 1)
+            target = 1;
+
+        int64_t seen = 0;
+        for (int32_t i = 0; i < LOADGEN_HISTOGRAM_NUM_BUCKETS; i++)
+        {
+            seen += counts_[i];
+            if (seen >= target)
+            {
+                uint64_t v = GetBucketHighestValue(i);
+                return (v < max_value_us_) ? v : max_value_us_;
+            }
+        }
+
+        return max_value_us_;
+    }
+
+    uint64_t get_max_value_us()
+    {
+        return max_value_us_;
+    }
+
+    int64_t get_total_count()
+    {
+        return total_count_;
+    }
+};
+
+// Load generator settings.
+struct LoadSettings
+{
+    // Target host and port.
+    std::string host_;
+    uint16_t port_;
+
+    // Connection mode.
+    LOAD_MODE mode_;
+
+    // HTTP method and URI, also used for the WebSocket upgrade.
+    std::string method_;
+    std::string uri_;
+
+    // Request body, frame payload or raw message size.
+    int32_t body_size_;
+
+    // Total number of connections and threads driving them.
+    int32_t num_connections_;
+    int32_t num_threads_;
+
+    // Maximum requests in flight per connection.
+    int32_t pipeline_depth_;
+
+    // Total requests per second, 0 runs closed loop.
+    double rate_;
+
+    // Measured duration and warmup before it.
+    int32_t duration_seconds_;
+    int32_t warmup_seconds_;
+
+    LoadSettings()
+    {
+        host_ = "127.0.0.1";
+        port_ = 8080;
+        mode_ = LOAD_MODE_HTTP;
+        method_ = "GET";
+        uri_ = "/";
+        body_size_ = 0;
+        num_connections_ = 16;
+        num_threads_ = 1;
+        pipeline_depth_ = 1;
+        rate_ = 0;
+        duration_seconds_ = 10;
+        warmup_seconds_ = 2;
+    }
+};
+
+// One connection driven by a load thread.
+class LoadConnection
+{
+    SOCKET sock_;
+
+    // Intended send times of requests in flight, oldest first.
+    uint64_t intended_ticks_[LOADGEN_MAX_PIPELINE_DEPTH];
+    int32_t first_in_flight_;
+    int32_t num_in_flight_;
+
+    // Scheduled time of the next request in fixed rate mode.
+    uint64_t next_send_ticks_;
+
+    // Bytes not yet accepted by the socket.
+    std::string out_;
+    int32_t out_offset_;
+
+    // Received bytes not yet parsed into responses.
+    char* recv_buf_;
+    int32_t recv_len_;
+
+    // Remaining bytes of the current raw echo.
+    int32_t raw_pending_bytes_;
+
+    bool failed_;
+
+public:
+
+    LoadConnection();
+
+    ~LoadConnection();
+
+    // Connects and performs the WebSocket upgrade if needed.
+    uint32_t Connect(const sockaddr_in& addr, const LoadSettings& settings);
+
+    // Queues one request with its intended send time.
+    void PushRequest(const std::string& request, uint64_t intended_ticks);
+
+    // Sends as much of the queued bytes as the socket accepts.
+    uint32_t Flush();
+
+    // Receives available bytes and completes responses.
+    // Returns number of completed responses, their intended times are written to intended_ticks.
+    int32_t Receive(const LoadSettings& settings, uint64_t* intended_ticks, int32_t* num_errors, int64_t* bytes_received);
+
+    void Close();
+
+    SOCKET get_socket()
+    {
+        return sock_;
+    }
+
+    int32_t get_num_in_flight()
+    {
+        return num_in_flight_;
+    }
+
+    uint64_t get_next_send_ticks()
+    {
+        return next_send_ticks_;
+    }
+
+    void set_next_send_ticks(uint64_t ticks)
+    {
+        next_send_ticks_ = ticks;
+    }
+
+    bool get_failed()
+    {
+        return failed_;
+    }
+};
+
+// Thread driving a subset of connections.
+class LoadThread
+{
+    const LoadSettings* settings_;
+
+    // Connections owned by this thread.
+    LoadConnection* connections_;
+    int32_t num_connections_;
+
+    // Index of first connection among all connections.
+    int32_t first_connection_index_;
+
+    // Request bytes sent for each request.
+    std::string request_;
+
+    LoadLatencyHistogram histogram_;
+
+    int64_t num_responses_;
+    int64_t num_errors_;
+    int64_t bytes_sent_;
+    int64_t bytes_received_;
+    int32_t num_failed_connections_;
+
+    HANDLE thread_handle_;
+
+public:
+
+    LoadThread();
+
+    ~LoadThread();
+
+    uint32_t Init(const LoadSettings* settings, int32_t first_connection_index, int32_t num_connections, const sockaddr_in& addr);
+
+    // Runs the load between given performance counter values.
+    void Run();
+
+    uint32_t Start();
+
+    void Join();
+
+    LoadLatencyHistogram& get_histogram()
+    {
+        return histogram_;
+    }
+
+    int64_t get_num_responses()
+    {
+        return num_responses_;
+    }
+
+    int64_t get_num_errors()
+    {
+        return num_errors_;
+    }
+
+    int64_t get_bytes_sent()
+    {
+        return bytes_sent_;
+    }
+
+    int64_t get_bytes_received()
+    {
+        return bytes_received_;
+    }
+
+    int32_t get_num_failed_connections()
+    {
+        return num_failed_connections_;
+    }
+};
+
+// Builds request bytes for given settings.
+std::string BuildLoadRequest(const LoadSettings& settings);
+
+// Parses one HTTP response, returns its length or 0 if incomplete.
+int32_t ParseHttpResponseLength(const char* buf, int32_t buf_len, bool* is_error);
+
+// Parses one WebSocket frame, returns its length or 0 if incomplete.
+int32_t ParseWsFrameLength(const char* buf, int32_t buf_len, bool* is_data_frame);
+
+} // namespace network
+} // namespace starcounter
+
+#endif // LOAD_GENERATOR_HPP
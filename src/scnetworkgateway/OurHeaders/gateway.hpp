@@ -39,6 +39,7 @@
 
 // Internal includes.
 #include "utilities.hpp"
+#include "traffic_capture.hpp"
 
 //#pragma warning(pop)
 //#pragma warning(pop)
@@ -77,7 +78,6 @@ typedef uint32_t ws_group_id_type;
 //#define GW_SESSIONS_DIAG
 //#define GW_IOCP_IMMEDIATE_COMPLETION
 //#define WORKER_NO_SLEEP
-//#define LEAST_USED_SCHEDULING
 #define CASE_INSENSITIVE_URI_MATCHER
 #define DISCONNECT_SOCKETS_WHEN_CODEHOST_DIES
 //#define USE_OLD_IPC_MONITOR
@@ -141,9 +141,18 @@ const int32_t MAX_FETCHED_OVLS = 10;
 // Maximum number of attempts to push overflow SDs.
 const int32_t MAX_OVERFLOW_ATTEMPTS = 100;
 
-// Size of circular log buffer.
+// Size of each circular log ring (power of two).
 const int32_t GW_LOG_BUFFER_SIZE = 8192 * 32;
 
+// Alignment of log records in log rings.
+const int32_t GW_LOG_RECORD_ALIGNMENT = 16;
+
+// Record text length indicating that the rest of the ring is skipped.
+const int32_t GW_LOG_RECORD_WRAP = -1;
+
+// Size of each worker traffic capture ring (power of two).
+const int32_t GW_CAPTURE_BUFFER_SIZE = 8 * 1024 * 1024;
+
 // Maximum number of proxied URIs.
 const int32_t MAX_PROXIED_URIS = 32;
 
@@ -153,8 +162,29 @@ const int32_t MAX_URI_ALIASES = 32;
 // Maximum number of URI aliases string characters.
 const int32_t MAX_URI_ALIAS_CHARS = 128;
 
-// Number of sockets to increase the accept roof.
-const int32_t ACCEPT_ROOF_STEP_SIZE = 1;
+// Maximum number of static files routes.
+const int32_t MAX_STATIC_ROUTES = 32;
+
+// Maximum number of open static files cached per worker.
+const int32_t MAX_STATIC_FILES_CACHED_PER_WORKER = 256;
+
+// Interval after which cached static file is checked for changes.
+const uint32_t STATIC_FILES_REVALIDATE_INTERVAL_MS = 1000;
+
+// Maximum size of static file response headers.
+const int32_t MAX_STATIC_FILE_RESPONSE_HEADERS_BYTES = 512;
+
+// Maximum number of TLS protected ports.
+const int32_t MAX_TLS_PORTS = 16;
+
+// Chunk store for TLS receive buffers (fits the biggest TLS record).
+const int32_t TLS_RECEIVE_CHUNK_STORE_INDEX = 3;
+
+// Minimum number of pre-accepted sockets on a port.
+const int32_t MIN_ACCEPT_ROOF = 1;
+
+// Interval over which the accept rate is measured.
+const uint32_t ACCEPT_RATE_INTERVAL_MS = 100;
 
 // Maximum number of cached URI matchers.
 const int32_t MAX_CACHED_URI_MATCHERS = 32;
@@ -189,6 +219,9 @@ const uri_index_type INVALID_URI_INDEX = -1;
 // Bad reverse proxy index.
 const uri_index_type INVALID_RP_INDEX = -1;
 
+// Bad static route index.
+const int32_t INVALID_STATIC_ROUTE_INDEX = -1;
+
 // Invalid parameter index in user delegate.
 const uint8_t INVALID_PARAMETER_INDEX = 255;
 
@@ -242,12 +275,21 @@ const int32_t SOCKET_LIFETIME_MULTIPLIER = 5;
 // First port number used for binding.
 const uint16_t FIRST_BIND_PORT_NUM = 1500;
 
-// Size of the listening queue.
+// Default size of the listening queue.
 const int32_t LISTENING_SOCKET_QUEUE_SIZE = 256;
 
+// Default maximum number of pre-accepted sockets on a port.
+const int32_t MAX_ACCEPT_ROOF = 64;
+
 // Number of prepared UDP sockets.
 const int32_t NUM_PREPARED_UDP_SOCKETS_PER_WORKER = 256;
 
+// Default number of receives kept posted on each UDP socket.
+const int32_t NUM_UDP_RECEIVES_PER_SOCKET = 16;
+
+// Kernel send and receive buffer size of UDP sockets.
+const int32_t UDP_SOCKET_BUFFER_SIZE = 4 * 1024 * 1024;
+
 // Gateway mode.
 enum GatewayTestingMode
 {
@@ -313,6 +355,12 @@ const int32_t MAX_SOCKET_DATA_SIZE = GatewayChunkDataSizes[NumGatewayChunkSizes
 // Maximum size of UDP datagram.
 const int32_t MAX_UDP_DATAGRAM_SIZE = GatewayChunkDataSizes[3];
 
+// Maximum number of bytes of UDP datagrams packed into one push to codehost.
+const int32_t UDP_BATCH_MAX_SIZE = MixedCodeConstants::MAX_BYTES_EXTRA_LINKED_IPC_CHUNKS;
+
+// Largest chunk store used for request body chain segments.
+const int32_t BUFFER_CHAIN_MAX_SEGMENT_STORE_INDEX = 4;
+
 inline chunk_store_type ObtainGatewayChunkType(int32_t data_size)
 {
     for (int32_t i = 0; i < NumGatewayChunkSizes; i++) {
@@ -357,6 +405,98 @@ struct AggregationStruct
 
 const int32_t AggregationStructSizeBytes = sizeof(AggregationStruct);
 
+// Aggregation wire format v2, negotiated by AGGR_CREATE_SOCKET with AGGR_MSG_WIRE_FORMAT_V2 flag.
+// Batch: [varint payload length][varint number of messages] followed by messages.
+// Message: [uint8 type | test flags << 2][varint handle][varint aggregation index][varint size][payload].
+// AGGR_CREATE_SOCKET carries port number in aggregation index and gets new handle in reply (0 on failure).
+
+// Maximum size of v2 varint.
+const int32_t AggregationV2MaxVarintBytes = 5;
+
+// Space reserved for v2 batch header in front of messages.
+const int32_t AggregationV2BatchHeaderMaxBytes = 2 * AggregationV2MaxVarintBytes;
+
+// Maximum size of v2 message header.
+const int32_t AggregationV2MessageHeaderMaxBytes = 1 + 3 * AggregationV2MaxVarintBytes;
+
+// Virtual socket referenced by v2 handle.
+struct AggregationV2Socket
+{
+    socket_index_type socket_index_;
+    random_salt_type unique_socket_id_;
+};
+
+// State of aggregation connection that uses wire format v2.
+class AggregationV2Connection
+{
+    // Virtual sockets by handle (handle is index plus one).
+    std::vector<AggregationV2Socket> sockets_;
+
+    // Released handles available for reuse.
+    std::vector<uint32_t> free_handles_;
+
+    // Number of messages in batch being written.
+    uint32_t num_batch_messages_;
+
+public:
+
+    AggregationV2Connection()
+    {
+        num_batch_messages_ = 0;
+    }
+
+    // Assigns handle to virtual socket.
+    uint32_t AddSocket(socket_index_type socket_index, random_salt_type unique_socket_id)
+    {
+        AggregationV2Socket s;
+        s.socket_index_ = socket_index;
+        s.unique_socket_id_ = unique_socket_id;
+
+        if (!free_handles_.empty())
+        {
+            uint32_t handle = free_handles_.back();
+            free_handles_.pop_back();
+
+            sockets_[handle - 1] = s;
+            return handle;
+        }
+
+        sockets_.push_back(s);
+        return static_cast<uint32_t>(sockets_.size());
+    }
+
+    // Gets virtual socket by handle.
+    bool GetSocket(uint32_t handle, socket_index_type* socket_index, random_salt_type* unique_socket_id)
+    {
+        if ((0 == handle) || (handle > sockets_.size()) || (INVALID_SOCKET_INDEX == sockets_[handle - 1].socket_index_))
+            return false;
+
+        *socket_index = sockets_[handle - 1].socket_index_;
+        *unique_socket_id = sockets_[handle - 1].unique_socket_id_;
+
+        return true;
+    }
+
+    // Releases handle.
+    void RemoveSocket(uint32_t handle)
+    {
+        GW_ASSERT((handle > 0) && (handle <= sockets_.size()));
+
+        sockets_[handle - 1].socket_index_ = INVALID_SOCKET_INDEX;
+        free_handles_.push_back(handle);
+    }
+
+    uint32_t get_num_batch_messages()
+    {
+        return num_batch_messages_;
+    }
+
+    void set_num_batch_messages(uint32_t num_batch_messages)
+    {
+        num_batch_messages_ = num_batch_messages;
+    }
+};
+
 struct HttpTestInformation
 {
     const char* const method_and_uri_info;
@@ -396,11 +536,13 @@ enum SocketOperType
 {
     // Active connections statistics.
     RECEIVE_SOCKET_OPER,
+    ZERO_BYTE_RECEIVE_SOCKET_OPER,
     DISCONNECT_SOCKET_OPER,
 
     // Non-active connections.
     ACCEPT_SOCKET_OPER,
     SEND_SOCKET_OPER,
+    TRANSMIT_FILE_SOCKET_OPER,
     CONNECT_SOCKET_OPER,
     UNKNOWN_SOCKET_OPER
 };
@@ -450,6 +592,20 @@ uint32_t GatewayStatisticsInfo(
     SocketDataChunkRef sd,
     BMX_HANDLER_TYPE handler_info);
 
+// Machine readable metrics for Gateway.
+uint32_t GatewayMetrics(
+    HandlersList* hl,
+    GatewayWorker *gw,
+    SocketDataChunkRef sd,
+    BMX_HANDLER_TYPE handler_info);
+
+// Sampled request traces for Gateway.
+uint32_t GatewayRequestTraces(
+    HandlersList* hl,
+    GatewayWorker *gw,
+    SocketDataChunkRef sd,
+    BMX_HANDLER_TYPE handler_info);
+
 uint32_t GatewaySocketsStats(
     HandlersList* hl,
     GatewayWorker *gw,
@@ -462,6 +618,13 @@ uint32_t GatewayTestSample(
     SocketDataChunkRef sd,
     BMX_HANDLER_TYPE handler_info);
 
+// Echoes request body back.
+uint32_t GatewayEcho(
+    HandlersList* hl,
+    GatewayWorker *gw,
+    SocketDataChunkRef sd,
+    BMX_HANDLER_TYPE handler_info);
+
 // Updates configuration for Gateway.
 uint32_t GatewayUpdateConfiguration(
     HandlersList* hl,
@@ -496,6 +659,7 @@ extern std::string GetOperTypeString(SocketOperType typeOfOper);
 
 // Pointers to extended WinSock functions.
 extern LPFN_ACCEPTEX AcceptExFunc;
+extern LPFN_TRANSMITFILE TransmitFileFunc;
 extern LPFN_CONNECTEX ConnectExFunc;
 extern LPFN_DISCONNECTEX DisconnectExFunc;
 
@@ -753,6 +917,68 @@ enum SOCKET_FLAGS
 	SOCKET_FLAGS_CLONED_TO_RECEIVE = 2 << 5
 };
 
+// Socket data flags that are set only inside gateway.
+// NOTE: Bits are above the ones shared with codehost and are cleared on chunks from codehost.
+enum GATEWAY_SOCKET_DATA_FLAGS
+{
+    SOCKET_DATA_FLAGS_WS_BROADCAST_BUFFER = 2 << 29
+};
+
+// Progress of socket request used for latency measurements.
+enum SOCKET_LATENCY_STATE {
+    LATENCY_STATE_NONE,
+    LATENCY_STATE_ACCEPTED,
+    LATENCY_STATE_RECEIVED,
+    LATENCY_STATE_PUSHED,
+    LATENCY_STATE_RESPONDED
+};
+
+// Measured latency stages (stage N ends the latency state N + 1).
+enum LATENCY_STAGE {
+    LATENCY_STAGE_ACCEPT_TO_FIRST_BYTE,
+    LATENCY_STAGE_RECEIVE_TO_PUSH,
+    LATENCY_STAGE_PUSH_TO_RESPONSE,
+    LATENCY_STAGE_RESPONSE_TO_SEND,
+    LATENCY_STAGE_COUNT
+};
+
+// Time stamps of a sampled request trace.
+enum REQUEST_TRACE_STAMP {
+    TRACE_STAMP_RECEIVE,
+    TRACE_STAMP_PUSH,
+    TRACE_STAMP_SCHEDULER_POP,
+    TRACE_STAMP_RESPONSE_PUSH,
+    TRACE_STAMP_RESPONSE,
+    TRACE_STAMP_SEND,
+    TRACE_STAMP_COUNT
+};
+
+// Maximum number of requests traced at the same time by one worker.
+const int32_t MAX_ACTIVE_REQUEST_TRACES = 16;
+
+// Number of completed request traces kept by each worker.
+const int32_t REQUEST_TRACES_RING_SIZE = 1024;
+
+// Socket request is not traced.
+const int8_t INVALID_TRACE_SLOT = -1;
+
+// Sampled request trace.
+struct RequestTrace
+{
+    // Performance counter values for each trace stamp (zero if not stamped).
+    uint64_t ticks_[TRACE_STAMP_COUNT];
+
+    // Traced socket.
+    random_salt_type unique_socket_id_;
+
+    // Codehost and its scheduler that processed the request.
+    db_index_type db_index_;
+    scheduler_id_type sched_id_;
+
+    // Is this trace slot in use.
+    bool in_use_;
+};
+
 enum SOCKET_STATE {
     CREATED,
     ACCEPTING,
@@ -765,6 +991,10 @@ enum SOCKET_STATE {
     DISCONNECTED
 };
 
+struct StaticFileEntry;
+class TlsContext;
+class Http2Connection;
+
 // Structure that facilitates the socket.
 _declspec(align(MEMORY_ALLOCATION_ALIGNMENT)) struct ScSocketInfoStruct
 {
@@ -787,6 +1017,30 @@ _declspec(align(MEMORY_ALLOCATION_ALIGNMENT)) struct ScSocketInfoStruct
     // Socket number.
     SOCKET socket_;
 
+    // First segment of received request body chain.
+    SocketDataChunk* body_chain_head_;
+
+    // Last segment of received request body chain.
+    SocketDataChunk* body_chain_tail_;
+
+    // Cached static file being transmitted on this socket.
+    StaticFileEntry* static_file_entry_;
+
+    // TLS connection state (NULL for plain sockets).
+    TlsContext* tls_context_;
+
+    // HTTP/2 connection state (NULL for HTTP/1.1 connections).
+    Http2Connection* http2_connection_;
+
+    // Aggregation wire format v2 state (NULL for v1 or non-aggregation sockets).
+    AggregationV2Connection* aggr_v2_connection_;
+
+    // Performance counter value when current latency state was entered.
+    uint64_t latency_state_ticks_;
+
+    // Traffic capture connection identifier (0 if connection is not captured).
+    uint64_t capture_connection_id_;
+
     //////////////////////////////
     //////// 32 bits data ////////
     //////////////////////////////
@@ -803,9 +1057,30 @@ _declspec(align(MEMORY_ALLOCATION_ALIGNMENT)) struct ScSocketInfoStruct
     // Number of bytes left for accumulation.
     uint32_t accum_data_bytes_left_;
 
+    // Number of bytes in request body chain.
+    uint32_t body_chain_len_bytes_;
+
     // WebSockets group id.
     ws_group_id_type ws_group_id_;
 
+    // Next socket in the same WebSockets group on this worker.
+    socket_index_type ws_group_next_socket_index_;
+
+    // Previous socket in the same WebSockets group on this worker.
+    socket_index_type ws_group_prev_socket_index_;
+
+    // Next socket bound to the same database on this worker.
+    socket_index_type db_next_socket_index_;
+
+    // Previous socket bound to the same database on this worker.
+    socket_index_type db_prev_socket_index_;
+
+    // HTTP/2 stream identifier (0 if socket is not a stream).
+    uint32_t http2_stream_id_;
+
+    // Handle of aggregated socket on v2 aggregation connection (0 for v1).
+    uint32_t aggr_v2_handle_;
+
     //////////////////////////////
     //////// 16 bits data ////////
     //////////////////////////////
@@ -829,6 +1104,12 @@ _declspec(align(MEMORY_ALLOCATION_ALIGNMENT)) struct ScSocketInfoStruct
     // Socket state.
     uint8_t state_;
 
+    // Request progress for latency measurements.
+    uint8_t latency_state_;
+
+    // Slot of sampled request trace in worker active traces.
+    int8_t trace_slot_;
+
     // Set socket state.
     void SetState(uint8_t state) {
         state_ = state;
@@ -981,7 +1262,25 @@ _declspec(align(MEMORY_ALLOCATION_ALIGNMENT)) struct ScSocketInfoStruct
         dest_db_index_ = INVALID_DB_INDEX;
         proxy_socket_info_index_ = INVALID_SOCKET_INDEX;
         aggr_socket_info_index_ = INVALID_SOCKET_INDEX;
+        db_next_socket_index_ = INVALID_SOCKET_INDEX;
+        db_prev_socket_index_ = INVALID_SOCKET_INDEX;
         ws_group_id_ = MixedCodeConstants::INVALID_WS_CHANNEL_ID;
+        ws_group_next_socket_index_ = INVALID_SOCKET_INDEX;
+        ws_group_prev_socket_index_ = INVALID_SOCKET_INDEX;
+        latency_state_ = LATENCY_STATE_NONE;
+        latency_state_ticks_ = 0;
+        trace_slot_ = INVALID_TRACE_SLOT;
+        capture_connection_id_ = 0;
+        body_chain_head_ = NULL;
+        body_chain_tail_ = NULL;
+        body_chain_len_bytes_ = 0;
+        accum_data_bytes_left_ = 0;
+        static_file_entry_ = NULL;
+        tls_context_ = NULL;
+        http2_connection_ = NULL;
+        http2_stream_id_ = 0;
+        aggr_v2_connection_ = NULL;
+        aggr_v2_handle_ = 0;
     }
 
     bool IsReset() {
@@ -1030,6 +1329,12 @@ public:
         return shm_seg_name_;
     }
 
+    // Gets unique sequence number (invalid once deletion is started).
+    uint64_t get_unique_num()
+    {
+        return unique_num_unsafe_;
+    }
+
     // Printing the database information.
     void PrintInfo(std::stringstream& global_port_statistics_stream);
 
@@ -1206,6 +1511,15 @@ class ServerPort
     // Statistics.
     volatile int64_t num_accepting_sockets_unsafe_;
 
+    // Number of pre-accepted sockets kept on this port.
+    int32_t accept_roof_;
+
+    // Connections accepted during current accept rate interval.
+    int32_t num_accepted_in_interval_;
+
+    // Start of current accept rate interval.
+    uint32_t accept_interval_start_ms_;
+
     // Port handler.
 	HandlersList* port_handler_;
 
@@ -1379,6 +1693,21 @@ public:
         InterlockedAdd64(&num_accepting_sockets_unsafe_, change_value);
         return num_accepting_sockets_unsafe_;
     }
+
+    // Gets number of pre-accepted sockets kept on this port.
+    int32_t get_accept_roof()
+    {
+        return accept_roof_;
+    }
+
+    // Accounts accepted connection for the accept rate.
+    void AddAcceptedConnection()
+    {
+        num_accepted_in_interval_++;
+    }
+
+    // Adjusts number of pre-accepted sockets to the accept rate and returns it.
+    int32_t UpdateAcceptRoof(uint32_t cur_time_ms);
 };
 
 // Information about the reversed proxy.
@@ -1435,48 +1764,338 @@ struct ReverseProxyInfo
     }
 };
 
+// Information about the TLS protected port.
+struct TlsPortInfo
+{
+    // Server certificate thumbprint.
+    std::string certificate_thumbprint_;
+
+    // Certificate store name in local machine location.
+    std::string certificate_store_;
+
+    // Server certificate.
+    PCCERT_CONTEXT certificate_;
+
+    // Schannel credentials for accepting connections.
+    CredHandle credentials_;
+
+    // Lifetime of cached TLS sessions in seconds.
+    int32_t session_cache_seconds_;
+
+    // Protected port.
+    uint16_t port_;
+
+    // Resetting the port info.
+    void Reset() {
+
+        certificate_thumbprint_ = std::string();
+        certificate_store_ = "My";
+        certificate_ = NULL;
+        SecInvalidateHandle(&credentials_);
+        session_cache_seconds_ = 36000;
+        port_ = INVALID_PORT_NUMBER;
+    }
+
+    // Printing the TLS port info.
+    void PrintInfo(std::stringstream& stats_stream)
+    {
+        stats_stream << "{\"Port\":" << port_ << ",";
+        stats_stream << "\"CertificateThumbprint\":\"" << certificate_thumbprint_ << "\",";
+        stats_stream << "\"SessionCacheSeconds\":" << session_cache_seconds_;
+
+        stats_stream << "}";
+    }
+};
+
+// Information about the static files route.
+struct StaticRouteInfo
+{
+    // Lower case URI prefix that is served from directory.
+    std::string uri_prefix_;
+    int32_t uri_prefix_len_;
+
+    // Directory from which files are served.
+    std::wstring directory_;
+
+    // Cache-Control max-age in seconds (negative if not sent).
+    int32_t max_age_seconds_;
+
+    // Port on which files are served.
+    uint16_t port_;
+
+    // Resetting the route info.
+    void Reset() {
+
+        uri_prefix_ = std::string();
+        uri_prefix_len_ = 0;
+
+        directory_ = std::wstring();
+
+        max_age_seconds_ = -1;
+
+        port_ = INVALID_PORT_NUMBER;
+    }
+
+    // Printing the route info.
+    void PrintInfo(std::stringstream& stats_stream)
+    {
+        std::string directory(directory_.begin(), directory_.end());
+        std::replace(directory.begin(), directory.end(), '\\', '/');
+
+        stats_stream << "{\"UriPrefix\":\"" << uri_prefix_ << "\",";
+        stats_stream << "\"Directory\":\"" << directory << "\",";
+        stats_stream << "\"MaxAgeSeconds\":" << max_age_seconds_ << ",";
+        stats_stream << "\"Port\":" << port_;
+
+        stats_stream << "}";
+    }
+};
+
+// Header of each record in a log ring, followed by record text.
+struct GatewayLogRecordHeader
+{
+    // Time stamp used to order records from different rings.
+    int64_t timestamp_;
+
+    // Length of the record text or GW_LOG_RECORD_WRAP.
+    int32_t text_len_;
+
+    int32_t pad_;
+};
+
+// Single producer, single consumer ring of log records.
+class GatewayLogRing
+{
+    // Records buffer.
+    char* buf_;
+
+    // Size of records buffer (power of two).
+    int32_t buf_size_;
+
+    // Write position of record reserved by BeginWrite.
+    int64_t pending_write_pos_;
+
+    // Monotonic write position, only changed by producer.
+    volatile int64_t write_pos_;
+
+    // Monotonic read position, only changed by consumer.
+    volatile int64_t read_pos_;
+
+    // Number of records dropped because ring was full.
+    volatile int64_t num_dropped_records_;
+
+public:
+
+    void Init(char* buf, int32_t buf_size)
+    {
+        GW_ASSERT(0 == (buf_size & (buf_size - 1)));
+
+        buf_ = buf;
+        buf_size_ = buf_size;
+        pending_write_pos_ = 0;
+        write_pos_ = 0;
+        read_pos_ = 0;
+        num_dropped_records_ = 0;
+    }
+
+    // Space occupied by record with given text length.
+    static int32_t RecordLength(int32_t text_len)
+    {
+        return static_cast<int32_t>(sizeof(GatewayLogRecordHeader) + text_len + GW_LOG_RECORD_ALIGNMENT - 1) & ~(GW_LOG_RECORD_ALIGNMENT - 1);
+    }
+
+    // Writes a record, dropping it if ring is full.
+    void Write(int64_t timestamp, const char* text, int32_t text_len);
+
+    // Reserves a record and returns pointer to its text, or NULL if ring is full.
+    char* BeginWrite(int64_t timestamp, int32_t text_len);
+
+    // Makes record reserved by BeginWrite visible to consumer.
+    void EndWrite()
+    {
+        // NOTE: Volatile store has release semantics, so consumer sees the record contents.
+        write_pos_ = pending_write_pos_;
+    }
+
+    // Gets record at given read cursor, skipping the wrap marker.
+    // Returns NULL if the cursor reached the end.
+    GatewayLogRecordHeader* GetRecord(int64_t* cursor, int64_t end);
+
+    char* get_buf()
+    {
+        return buf_;
+    }
+
+    int64_t get_write_pos()
+    {
+        return write_pos_;
+    }
+
+    int64_t get_read_pos()
+    {
+        return read_pos_;
+    }
+
+    // Releases space up to given position to producer.
+    void set_read_pos(int64_t read_pos)
+    {
+        read_pos_ = read_pos;
+    }
+
+    int64_t get_num_dropped_records()
+    {
+        return num_dropped_records_;
+    }
+};
+
 class GatewayLogWriter
 {
-    // Critical section for exclusive writes.
+    // Critical section for writes from non-worker threads.
     CRITICAL_SECTION write_lock_;
 
-    // Circular buffer for log entries.
-    char log_buf_[GW_LOG_BUFFER_SIZE];
+    // Ring for non-worker threads, shared under write lock.
+    char shared_ring_buf_[GW_LOG_BUFFER_SIZE];
+
+    // Buffer for batching records before writing them to file.
+    char file_buf_[GW_LOG_BUFFER_SIZE];
+
+    // Current length of data in file buffer.
+    int32_t file_buf_len_;
 
-    // Current write position.
-    int32_t log_write_pos_;
+    // Log rings, shared one first and then one for each worker.
+    GatewayLogRing rings_[MAX_WORKER_THREADS + 1];
 
-    // Current log read position.
-    int32_t log_read_pos_;
+    // Number of used log rings.
+    int32_t num_rings_;
+
+    // Dropped records already reported in log file.
+    int64_t num_reported_dropped_records_;
 
     // Log file handle.
     HANDLE log_file_handle_;
 
-    // Length of accumulated but not dumped data.
-    int32_t accum_length_;
+    // Appends text to file buffer, writing buffer to file when full.
+    void AppendToFileBuffer(const char* text, int32_t text_len);
+
+    // Writes file buffer to log file.
+    void FlushFileBuffer();
 
 public:
 
-    void Init(const std::wstring& log_file_path);
+    GatewayLogWriter();
+
+    void Init(const std::wstring& log_file_path, int32_t num_workers);
 
     ~GatewayLogWriter()
     {
         DeleteCriticalSection(&write_lock_);
 
+        for (int32_t i = 1; i < num_rings_; i++) {
+            GwDeleteAligned(rings_[i].get_buf());
+        }
+
         CloseHandle(log_file_handle_);
     }
 
+    // Total number of dropped log records.
+    int64_t GetNumberOfDroppedRecords();
+
+    // Makes current thread write to the ring of given worker.
+    void SetCurrentThreadRing(worker_id_type worker_id);
+
 #ifdef GW_LOGGING_ON
 
-    // Writes given string to log buffer.
+    // Writes given string to log ring of current thread.
     void WriteToLog(const char* text, int32_t text_len);
 
-    // Dump accumulated logs in buffer to file.
+    // Dump accumulated logs in rings to file.
     void DumpToLogFile();
 
 #endif
 };
 
+// Records received bytes of accepted connections into a capture file.
+class GatewayTrafficCapture
+{
+    // Capture rings, one for each worker.
+    GatewayLogRing rings_[MAX_WORKER_THREADS];
+
+    // Number of used capture rings.
+    int32_t num_rings_;
+
+    // Buffer for batching records before writing them to file.
+    char* file_buf_;
+
+    // Current length of data in file buffer.
+    int32_t file_buf_len_;
+
+    // Performance counter value and frequency at capture start.
+    int64_t start_ticks_;
+    int64_t ticks_per_second_;
+
+    // Dropped records already reported in log.
+    int64_t num_reported_dropped_records_;
+
+    // Capture file handle.
+    HANDLE file_handle_;
+
+    // Appends bytes to file buffer, writing buffer to file when full.
+    void AppendToFileBuffer(const char* data, int32_t data_len);
+
+    // Writes file buffer to capture file.
+    void FlushFileBuffer();
+
+public:
+
+    GatewayTrafficCapture()
+    {
+        num_rings_ = 0;
+        file_buf_ = NULL;
+        file_buf_len_ = 0;
+        start_ticks_ = 0;
+        ticks_per_second_ = 1;
+        num_reported_dropped_records_ = 0;
+        file_handle_ = INVALID_HANDLE_VALUE;
+    }
+
+    ~GatewayTrafficCapture()
+    {
+        for (int32_t i = 0; i < num_rings_; i++) {
+            GwDeleteAligned(rings_[i].get_buf());
+        }
+
+        if (NULL != file_buf_)
+            GwDeleteAligned(file_buf_);
+
+        if (INVALID_HANDLE_VALUE != file_handle_)
+            CloseHandle(file_handle_);
+    }
+
+    // Creates capture file and worker rings.
+    uint32_t Init(const std::wstring& capture_file_path, int32_t num_workers);
+
+    // Checks if traffic is captured.
+    bool IsEnabled()
+    {
+        return (INVALID_HANDLE_VALUE != file_handle_);
+    }
+
+    // Writes capture record from given worker, dropping it if ring is full.
+    void Write(
+        worker_id_type worker_id,
+        uint8_t type,
+        uint64_t connection_id,
+        uint16_t port,
+        const uint8_t* data,
+        int32_t data_len);
+
+    // Total number of dropped capture records.
+    int64_t GetNumberOfDroppedRecords();
+
+    // Dumps captured records in rings to file.
+    void DumpToFile();
+};
+
 extern "C" uint32_t ScLLVMProduceModule(
 #ifdef _WIN32
     const wchar_t* const path_to_cache_dir,
@@ -1560,6 +2179,67 @@ class Gateway
     // Gateway aggregation port.
     uint16_t setting_aggregation_port_;
 
+    // Number of buffered aggregated bytes that triggers immediate send.
+    uint32_t setting_aggregation_flush_bytes_;
+
+    // Maximum time aggregated messages are held for coalescing while worker is busy.
+    uint32_t setting_aggregation_max_delay_us_;
+
+    // Waiting for readability with zero-byte receives on idle TCP sockets.
+    bool setting_zero_byte_receive_;
+
+    // Accepting HTTP/2 connections (prior knowledge or ALPN over TLS).
+    bool setting_http2_;
+
+    // One of this many requests is traced end-to-end (zero disables tracing).
+    uint32_t setting_trace_sampling_interval_;
+
+    // Number of chunks each worker can have queued towards one scheduler
+    // before it stops receiving on sockets feeding that scheduler (zero disables flow control).
+    int32_t setting_scheduler_credits_;
+
+    // New sessions and connections go to the least loaded scheduler instead of round-robin.
+    bool setting_least_loaded_scheduling_;
+
+    // Size of listening sockets backlog.
+    int32_t setting_listen_backlog_;
+
+    // Number of receives kept posted on each UDP socket.
+    int32_t setting_udp_receives_per_socket_;
+
+    // Maximum number of pre-accepted sockets on a port.
+    int32_t setting_max_pre_accepted_sockets_;
+
+    // Logical processor for each worker (empty if workers are not pinned).
+    std::vector<int32_t> setting_worker_cpus_;
+
+    // Logical processors for monitoring and cleanup threads (empty if not pinned).
+    std::vector<int32_t> setting_monitor_thread_cpus_;
+
+    // Logical processors for logging thread (empty if not pinned).
+    std::vector<int32_t> setting_logging_thread_cpus_;
+
+    // Logical processor of each codehost scheduler, used to find scheduler NUMA nodes.
+    std::vector<int32_t> setting_scheduler_cpus_;
+
+    // Traffic capture file (empty if capture is disabled).
+    std::wstring setting_traffic_capture_file_;
+
+    // Size of memory regions from which worker chunks are carved.
+    int32_t setting_chunk_slab_size_bytes_;
+
+    // Trying to back chunk slabs with large pages.
+    bool setting_chunk_large_pages_;
+
+    // Maximum number of chunks in each chunk store per worker.
+    int32_t setting_chunk_store_max_chunks_[NumGatewayChunkSizes];
+
+    // Number of free chunks kept in each chunk store before slabs are trimmed.
+    int32_t setting_chunk_store_free_watermarks_[NumGatewayChunkSizes];
+
+    // Large page size if large pages are enabled, otherwise 0.
+    SIZE_T large_page_size_;
+
     // Inactive socket timeout in seconds.
     int32_t setting_inactive_socket_timeout_seconds_;
     int32_t min_inactive_socket_life_seconds_;
@@ -1668,6 +2348,9 @@ class Gateway
     // Specific gateway log writer.
     GatewayLogWriter gw_log_writer_;
 
+    // Traffic capture writer.
+    GatewayTrafficCapture traffic_capture_;
+
     // All server ports.
     ServerPort server_ports_[MAX_PORTS_NUM];
 
@@ -1688,6 +2371,14 @@ class Gateway
     UriAliasInfo uri_aliases_[MAX_URI_ALIASES];
     int32_t num_uri_aliases_;
 
+    // List of static files routes.
+    StaticRouteInfo static_routes_[MAX_STATIC_ROUTES];
+    int32_t num_static_routes_;
+
+    // List of TLS protected ports.
+    TlsPortInfo tls_ports_[MAX_TLS_PORTS];
+    int32_t num_tls_ports_;
+
     // White list with allowed IP-addresses.
     LinearList<ip_info_type, MAX_BLACK_LIST_IPS_PER_WORKER> white_ips_list_;
 
@@ -1700,6 +2391,13 @@ class Gateway
     // Current global statistics stream.
     std::stringstream global_statistics_stream_;
 
+    // Last second rates published by statistics thread for lock-free metrics.
+    volatile int64_t last_second_recv_num_;
+    volatile int64_t last_second_sent_num_;
+    volatile int64_t last_second_bytes_received_;
+    volatile int64_t last_second_bytes_sent_;
+    volatile int64_t last_second_http_requests_;
+
     // Critical section for statistics.
     CRITICAL_SECTION cs_statistics_;
 
@@ -1748,6 +2446,50 @@ public:
         return reverse_proxies_ + reverse_proxy_index;
     }
 
+    // Finds TLS settings for given port (NULL if port is not protected).
+    TlsPortInfo* FindTlsPort(const uint16_t port) {
+
+        for (int32_t i = 0; i < num_tls_ports_; i++) {
+
+            if (tls_ports_[i].port_ == port)
+                return tls_ports_ + i;
+        }
+
+        return NULL;
+    }
+
+    StaticRouteInfo* GetStaticRouteInfo(int32_t static_route_index) {
+        GW_ASSERT(static_route_index >= 0);
+        GW_ASSERT(static_route_index < num_static_routes_);
+        return static_routes_ + static_route_index;
+    }
+
+    int32_t get_num_static_routes() {
+        return num_static_routes_;
+    }
+
+    // Finds static files route with longest URI prefix matching given lower case URI.
+    int32_t FindStaticRoute(const uint16_t port, const char* const lower_uri, const int32_t uri_len) {
+
+        int32_t found_index = INVALID_STATIC_ROUTE_INDEX;
+
+        for (int32_t i = 0; i < num_static_routes_; i++) {
+
+            if ((static_routes_[i].port_ == port) &&
+                (static_routes_[i].uri_prefix_len_ <= uri_len) &&
+                (0 == strncmp(lower_uri, static_routes_[i].uri_prefix_.c_str(), static_routes_[i].uri_prefix_len_))) {
+
+                if ((INVALID_STATIC_ROUTE_INDEX == found_index) ||
+                    (static_routes_[i].uri_prefix_len_ > static_routes_[found_index].uri_prefix_len_)) {
+
+                    found_index = i;
+                }
+            }
+        }
+
+        return found_index;
+    }
+
     // Comparing given host header with registered reverse proxies hosts.
     int32_t GetHostHeaderIndexInReverseProxy(const char* const host_header_value, const size_t value_len, const uint16_t port) {
 
@@ -1795,6 +2537,108 @@ public:
         return setting_aggregation_port_;
     }
 
+    // Gets number of buffered aggregated bytes that triggers immediate send.
+    uint32_t setting_aggregation_flush_bytes()
+    {
+        return setting_aggregation_flush_bytes_;
+    }
+
+    // Gets maximum coalescing delay for aggregated messages in microseconds.
+    uint32_t setting_aggregation_max_delay_us()
+    {
+        return setting_aggregation_max_delay_us_;
+    }
+
+    // Checks if idle TCP sockets wait for data with zero-byte receives.
+    bool setting_zero_byte_receive()
+    {
+        return setting_zero_byte_receive_;
+    }
+
+    // Gets request tracing sampling interval (zero if tracing is disabled).
+    uint32_t setting_trace_sampling_interval()
+    {
+        return setting_trace_sampling_interval_;
+    }
+
+    // Gets number of credits per worker and scheduler (zero if flow control is disabled).
+    int32_t setting_scheduler_credits()
+    {
+        return setting_scheduler_credits_;
+    }
+
+    // Checks if least loaded scheduler is selected for new sessions and connections.
+    bool setting_least_loaded_scheduling()
+    {
+        return setting_least_loaded_scheduling_;
+    }
+
+    // Gets size of listening sockets backlog.
+    int32_t setting_listen_backlog()
+    {
+        return setting_listen_backlog_;
+    }
+
+    // Gets number of receives kept posted on each UDP socket.
+    int32_t setting_udp_receives_per_socket()
+    {
+        return setting_udp_receives_per_socket_;
+    }
+
+    // Gets maximum number of pre-accepted sockets on a port.
+    int32_t setting_max_pre_accepted_sockets()
+    {
+        return setting_max_pre_accepted_sockets_;
+    }
+
+    // Gets NUMA node of given worker (NUMA_NO_PREFERRED_NODE if worker is not pinned).
+    uint32_t GetWorkerNumaNode(worker_id_type worker_id)
+    {
+        if (worker_id >= static_cast<int32_t>(setting_worker_cpus_.size()))
+            return NUMA_NO_PREFERRED_NODE;
+
+        return GetCpuNumaNode(setting_worker_cpus_[worker_id]);
+    }
+
+    // Gets NUMA node of given scheduler (NUMA_NO_PREFERRED_NODE if unknown).
+    uint32_t GetSchedulerNumaNode(int32_t sched_id)
+    {
+        if (sched_id >= static_cast<int32_t>(setting_scheduler_cpus_.size()))
+            return NUMA_NO_PREFERRED_NODE;
+
+        return GetCpuNumaNode(setting_scheduler_cpus_[sched_id]);
+    }
+
+    // Checks if HTTP/2 connections are accepted.
+    bool setting_http2()
+    {
+        return setting_http2_;
+    }
+
+    // Gets size of chunk slabs in bytes.
+    int32_t setting_chunk_slab_size_bytes()
+    {
+        return setting_chunk_slab_size_bytes_;
+    }
+
+    // Gets maximum number of chunks in given store.
+    int32_t setting_chunk_store_max_chunks(chunk_store_type store_index)
+    {
+        return setting_chunk_store_max_chunks_[store_index];
+    }
+
+    // Gets number of free chunks kept in given store.
+    int32_t setting_chunk_store_free_watermark(chunk_store_type store_index)
+    {
+        return setting_chunk_store_free_watermarks_[store_index];
+    }
+
+    // Gets large page size (0 if large pages are not used).
+    SIZE_T get_large_page_size()
+    {
+        return large_page_size_;
+    }
+
     // Checks if IP is on white list.
     bool CheckIpForWhiteList(ip_info_type ip)
     {
@@ -1818,12 +2662,21 @@ public:
     // Printing statistics for all reverse proxies.
     void PrintReverseProxiesStatistics(std::stringstream& stats_stream);
 
+    // Printing statistics for all static files routes.
+    void PrintStaticRoutesStatistics(std::stringstream& stats_stream);
+
+    // Printing statistics for all TLS protected ports.
+    void PrintTlsPortsStatistics(std::stringstream& stats_stream);
+
     // Printing statistics for all databases.
     void PrintDatabaseStatistics(std::stringstream& stats_stream);
 
     // Printing statistics for all workers.
     void PrintWorkersStatistics(std::stringstream& stats_stream);
 
+    // Printing latency percentiles merged from all workers.
+    void PrintLatencyStatistics(std::stringstream& stats_stream);
+
     // Printing statistics for all workers sockets.
     void PrintWorkersSockets(std::stringstream& stats_stream);
 
@@ -1882,6 +2735,12 @@ public:
         return &gw_log_writer_;
     }
 
+    // Getting traffic capture writer.
+    GatewayTrafficCapture* get_traffic_capture()
+    {
+        return &traffic_capture_;
+    }
+
     // Full path to gateway log file.
     const std::wstring& setting_log_file_path()
     {
@@ -1891,6 +2750,12 @@ public:
     // Current gateway statistics.
     std::string GetGatewayStatisticsString();
 
+    // Current gateway metrics in Prometheus text format, collected without locks.
+    std::string GetGatewayMetricsString();
+
+    // Completed request traces in Chrome trace JSON format.
+    std::string GetRequestTracesString();
+
     // Current gateway sockets statistics.
     std::string GetGatewaySocketsStatisticsString();
 
@@ -2286,9 +3151,24 @@ public:
     // Initialize the network gateway.
     uint32_t Init();
 
+    // Initializes a single worker without sockets and databases, used by microbenchmarks.
+    GatewayWorker* InitBenchmarkWorker(int32_t max_connections_per_worker);
+
+    // Allocates workers, each one in memory of its NUMA node.
+    void AllocateWorkers();
+
+    // Destroys workers and releases their memory.
+    void DeleteWorkers();
+
+    // Pins suspended thread to given logical processors and resumes it.
+    void PinAndResumeThread(HANDLE thread_handle, const std::vector<int32_t>& cpus);
+
     // Sends an APC signal for rebalancing sockets.
     void SendRebalanceAPC(worker_id_type worker_id);
 
+    // Sends an APC signal for sending queued WebSocket broadcasts.
+    void SendWsBroadcastAPC(worker_id_type worker_id);
+
     // Checking for database changes.
     uint32_t CheckDatabaseChanges(const std::set<std::string>& active_databases);
 
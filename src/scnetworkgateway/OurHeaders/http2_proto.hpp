@@ -0,0 +1,405 @@
+#pragma once
+#ifndef HTTP2_PROTO_HPP
+#define HTTP2_PROTO_HPP
+
+namespace starcounter {
+namespace network {
+
+class GatewayWorker;
+class SocketDataChunk;
+
+// Builds HPACK Huffman decoding tables.
+void Http2GlobalInit();
+
+// Client connection preface.
+const char* const kHttp2ConnectionPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const int32_t kHttp2ConnectionPrefaceLength = 24;
+
+// Size of frame header.
+const int32_t kHttp2FrameHeaderLength = 9;
+
+// Maximum frame payload we accept and send (protocol default).
+const int32_t kHttp2MaxFrameSize = 16384;
+
+// Maximum number of concurrently open streams per connection.
+const int32_t kHttp2MaxConcurrentStreams = 100;
+
+// Receive window advertised for each stream.
+const int32_t kHttp2StreamReceiveWindow = 1024 * 1024;
+
+// Receive window of the whole connection.
+const int32_t kHttp2ConnectionReceiveWindow = 16 * 1024 * 1024;
+
+// Flow control window before peer settings are applied.
+const int32_t kHttp2DefaultWindow = 65535;
+
+// Maximum flow control window size.
+const int64_t kHttp2MaxWindow = 0x7FFFFFFF;
+
+// Maximum size of header block collected from CONTINUATION frames.
+const uint32_t kHttp2MaxHeaderBlockSize = 64 * 1024;
+
+// Chunk store used for outgoing frames.
+const int32_t HTTP2_OUTPUT_CHUNK_STORE_INDEX = 4;
+
+// HPACK dynamic table size (protocol default, never changed by us).
+const uint32_t kHpackDefaultTableSize = 4096;
+
+// Number of entries in HPACK static table.
+const uint32_t kHpackStaticTableSize = 61;
+
+// Frame types.
+enum HTTP2_FRAME_TYPE
+{
+    HTTP2_FRAME_DATA = 0,
+    HTTP2_FRAME_HEADERS = 1,
+    HTTP2_FRAME_PRIORITY = 2,
+    HTTP2_FRAME_RST_STREAM = 3,
+    HTTP2_FRAME_SETTINGS = 4,
+    HTTP2_FRAME_PUSH_PROMISE = 5,
+    HTTP2_FRAME_PING = 6,
+    HTTP2_FRAME_GOAWAY = 7,
+    HTTP2_FRAME_WINDOW_UPDATE = 8,
+    HTTP2_FRAME_CONTINUATION = 9
+};
+
+// Frame flags.
+enum HTTP2_FRAME_FLAGS
+{
+    HTTP2_FLAG_END_STREAM = 0x1,
+    HTTP2_FLAG_ACK = 0x1,
+    HTTP2_FLAG_END_HEADERS = 0x4,
+    HTTP2_FLAG_PADDED = 0x8,
+    HTTP2_FLAG_PRIORITY = 0x20
+};
+
+// Settings identifiers.
+enum HTTP2_SETTINGS
+{
+    HTTP2_SETTINGS_HEADER_TABLE_SIZE = 1,
+    HTTP2_SETTINGS_ENABLE_PUSH = 2,
+    HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS = 3,
+    HTTP2_SETTINGS_INITIAL_WINDOW_SIZE = 4,
+    HTTP2_SETTINGS_MAX_FRAME_SIZE = 5,
+    HTTP2_SETTINGS_MAX_HEADER_LIST_SIZE = 6
+};
+
+// Error codes used in RST_STREAM and GOAWAY frames.
+enum HTTP2_ERROR_CODE
+{
+    HTTP2_ERROR_NO_ERROR = 0,
+    HTTP2_ERROR_PROTOCOL_ERROR = 1,
+    HTTP2_ERROR_INTERNAL_ERROR = 2,
+    HTTP2_ERROR_FLOW_CONTROL_ERROR = 3,
+    HTTP2_ERROR_SETTINGS_TIMEOUT = 4,
+    HTTP2_ERROR_STREAM_CLOSED = 5,
+    HTTP2_ERROR_FRAME_SIZE_ERROR = 6,
+    HTTP2_ERROR_REFUSED_STREAM = 7,
+    HTTP2_ERROR_CANCEL = 8,
+    HTTP2_ERROR_COMPRESSION_ERROR = 9,
+    HTTP2_ERROR_CONNECT_ERROR = 10,
+    HTTP2_ERROR_ENHANCE_YOUR_CALM = 11,
+    HTTP2_ERROR_INADEQUATE_SECURITY = 12,
+    HTTP2_ERROR_HTTP_1_1_REQUIRED = 13
+};
+
+// Decodes HPACK integer with given prefix.
+uint32_t HpackDecodeInteger(const uint8_t** pos, const uint8_t* end, int32_t prefix_bits, uint32_t* value);
+
+// Encodes HPACK integer with given prefix and first byte flags.
+void HpackEncodeInteger(std::string* out, uint8_t first_byte_flags, int32_t prefix_bits, uint32_t value);
+
+// Decodes Huffman encoded string.
+uint32_t HpackHuffmanDecode(const uint8_t* data, uint32_t data_len, std::string* out);
+
+// Encodes response status.
+void HpackEncodeStatus(std::string* out, int32_t status_code);
+
+// Encodes header field as literal without indexing.
+void HpackEncodeHeader(std::string* out, const char* name, uint32_t name_len, const char* value, uint32_t value_len);
+
+// Decoded header field.
+struct HpackField
+{
+    const char* name_;
+    uint32_t name_len_;
+    const char* value_;
+    uint32_t value_len_;
+};
+
+// Entry of HPACK dynamic table.
+struct HpackEntry
+{
+    std::string name_;
+    std::string value_;
+};
+
+// HPACK decoder state of one connection.
+class HpackDecoder
+{
+    // Dynamic table, newest entry first.
+    std::deque<HpackEntry> dynamic_table_;
+
+    // Current size of dynamic table.
+    uint32_t table_size_;
+
+    // Maximum size of dynamic table set by encoder.
+    uint32_t max_table_size_;
+
+    // Decoded literal name and value.
+    std::string name_buf_;
+    std::string value_buf_;
+
+    // Decodes string literal.
+    uint32_t DecodeString(const uint8_t** pos, const uint8_t* end, std::string* out);
+
+    // Gets table entry by HPACK index.
+    uint32_t GetEntry(uint32_t index, HpackField* field);
+
+    // Evicts entries until given number of bytes fits into table.
+    void Evict(uint32_t num_needed_bytes);
+
+    // Adds entry to dynamic table.
+    void AddEntry();
+
+public:
+
+    // Initializing decoder.
+    void Init()
+    {
+        dynamic_table_.clear();
+        table_size_ = 0;
+        max_table_size_ = kHpackDefaultTableSize;
+    }
+
+    // Decodes next representation from header block.
+    // NOTE: Field is valid until next call and is not set for table size updates.
+    uint32_t DecodeField(const uint8_t** pos, const uint8_t* end, HpackField* field, bool* has_field);
+};
+
+// State of one HTTP/2 stream.
+struct Http2Stream
+{
+    // Stream identifier (0 for free slot).
+    uint32_t stream_id_;
+
+    // Virtual socket representing this stream towards codehost.
+    socket_index_type socket_index_;
+    random_salt_type unique_socket_id_;
+
+    // HTTP/1.1 request being assembled (NULL after dispatch).
+    SocketDataChunk* request_sd_;
+
+    // Offset of Content-Length value in assembled request (-1 if none).
+    int32_t content_length_offset_;
+
+    // Number of received request body bytes.
+    uint32_t request_body_len_;
+
+    // Stream send window.
+    int64_t send_window_;
+
+    // Number of received bytes not yet returned to stream window.
+    uint32_t recv_window_consumed_;
+
+    // Response chunks waiting to be sent.
+    SocketDataChunk* pending_head_;
+    SocketDataChunk* pending_tail_;
+
+    // Number of response body bytes left (-1 when length is unknown).
+    int64_t response_bytes_left_;
+
+    // Request method is HEAD, so response has no body.
+    bool head_request_;
+
+    // Response headers are sent.
+    bool headers_sent_;
+
+    // Last response chunk of unknown length response is queued.
+    bool response_last_queued_;
+
+    // Codehost has sent the whole response.
+    bool response_received_;
+
+    // Stream was reset while codehost handles its request.
+    // NOTE: Slot is kept until response arrives, so reset requests still count as concurrent.
+    bool reset_;
+
+    void Reset()
+    {
+        stream_id_ = 0;
+        socket_index_ = INVALID_SOCKET_INDEX;
+        unique_socket_id_ = INVALID_SESSION_SALT;
+        request_sd_ = NULL;
+        content_length_offset_ = -1;
+        request_body_len_ = 0;
+        send_window_ = 0;
+        recv_window_consumed_ = 0;
+        pending_head_ = NULL;
+        pending_tail_ = NULL;
+        response_bytes_left_ = -1;
+        head_request_ = false;
+        headers_sent_ = false;
+        response_last_queued_ = false;
+        response_received_ = false;
+        reset_ = false;
+    }
+};
+
+// State of one HTTP/2 connection.
+class Http2Connection
+{
+    // Connection socket.
+    socket_index_type socket_index_;
+    random_salt_type unique_socket_id_;
+
+    // Port on which connection was accepted.
+    port_index_type port_index_;
+
+    // Client address passed with every stream request.
+    ip_info_type client_ip_info_;
+
+    // Streams table.
+    Http2Stream streams_[kHttp2MaxConcurrentStreams];
+    int32_t num_streams_;
+
+    // Highest stream identifier opened by client.
+    uint32_t last_stream_id_;
+
+    // Header compression state.
+    HpackDecoder hpack_decoder_;
+
+    // Header block collected from HEADERS and CONTINUATION frames.
+    std::string header_block_;
+    uint32_t continuation_stream_id_;
+    bool header_block_end_stream_;
+
+    // Connection send window and initial stream send window set by peer.
+    int64_t send_window_;
+    int64_t peer_initial_window_;
+
+    // Number of received bytes not yet returned to connection window.
+    uint32_t recv_window_consumed_;
+
+    // Chunk with frames being written.
+    SocketDataChunk* out_sd_;
+
+    // Scratch buffers for request and response headers.
+    std::string method_;
+    std::string path_;
+    std::string authority_;
+    std::string cookies_;
+    std::string header_line_;
+    std::string request_headers_;
+    std::string hpack_out_;
+
+    // Client preface was received.
+    bool preface_received_;
+
+    // GOAWAY was sent, new streams are ignored.
+    bool goaway_sent_;
+
+    // Finds stream by identifier (reset streams waiting for codehost only if asked).
+    Http2Stream* FindStream(uint32_t stream_id, bool with_reset = false);
+
+    // Opens new stream with its virtual socket.
+    Http2Stream* OpenStream(GatewayWorker* gw, uint32_t stream_id);
+
+    // Releases stream resources and its virtual socket.
+    void CloseStream(GatewayWorker* gw, Http2Stream* stream);
+
+    // Closes stream, or keeps its slot until codehost answers the dispatched request.
+    void AbortStream(GatewayWorker* gw, Http2Stream* stream);
+
+    // Sends RST_STREAM and closes the stream.
+    uint32_t ResetStream(GatewayWorker* gw, Http2Stream* stream, uint32_t stream_id, uint32_t error_code);
+
+    // Sends GOAWAY and returns error to close the connection.
+    uint32_t ConnectionError(GatewayWorker* gw, uint32_t error_code);
+
+    // Writes frame to output chunk.
+    uint32_t WriteFrame(GatewayWorker* gw, uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t payload_len);
+
+    // Writes WINDOW_UPDATE frame.
+    uint32_t WriteWindowUpdate(GatewayWorker* gw, uint32_t stream_id, uint32_t increment);
+
+    // Writes header block as HEADERS and CONTINUATION frames.
+    uint32_t WriteHeaderBlock(GatewayWorker* gw, uint32_t stream_id, bool end_stream);
+
+    // Processes one complete frame.
+    uint32_t ProcessFrame(GatewayWorker* gw, uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t payload_len);
+
+    // Processes HEADERS frame.
+    uint32_t ProcessHeadersFrame(GatewayWorker* gw, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t payload_len);
+
+    // Processes complete header block.
+    uint32_t ProcessHeaderBlock(GatewayWorker* gw, uint32_t stream_id, const uint8_t* block, uint32_t block_len, bool end_stream);
+
+    // Decodes header block into stream request (or just decodes it when stream is NULL).
+    uint32_t DecodeHeaderBlock(GatewayWorker* gw, Http2Stream* stream, const uint8_t* block, uint32_t block_len, bool* malformed);
+
+    // Processes DATA frame.
+    uint32_t ProcessDataFrame(GatewayWorker* gw, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t payload_len);
+
+    // Processes SETTINGS frame.
+    uint32_t ProcessSettingsFrame(GatewayWorker* gw, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t payload_len);
+
+    // Processes WINDOW_UPDATE frame.
+    uint32_t ProcessWindowUpdateFrame(GatewayWorker* gw, uint32_t stream_id, const uint8_t* payload, uint32_t payload_len);
+
+    // Appends data to stream request.
+    uint32_t AppendToRequest(GatewayWorker* gw, Http2Stream* stream, const char* data, uint32_t data_len);
+
+    // Writes request line and headers from validated header block.
+    uint32_t AppendRequestHead(GatewayWorker* gw, Http2Stream* stream);
+
+    // Passes assembled request to registered handlers.
+    uint32_t DispatchRequest(GatewayWorker* gw, Http2Stream* stream);
+
+    // Converts HTTP/1.1 response headers into HEADERS frames.
+    uint32_t WriteResponseHeaders(GatewayWorker* gw, Http2Stream* stream, const uint8_t* data, uint32_t data_len, uint32_t* headers_len);
+
+    // Sends queued response data allowed by flow control windows.
+    uint32_t SendPendingData(GatewayWorker* gw, Http2Stream* stream);
+
+    // Sends queued response data on all streams.
+    uint32_t SendPendingDataOnAllStreams(GatewayWorker* gw);
+
+public:
+
+    // Initializing new connection.
+    void Init(socket_index_type socket_index, random_salt_type unique_socket_id, port_index_type port_index, ip_info_type client_ip_info);
+
+    socket_index_type get_socket_index()
+    {
+        return socket_index_;
+    }
+
+    int32_t get_num_streams()
+    {
+        return num_streams_;
+    }
+
+    // Sends frames written so far.
+    uint32_t Flush(GatewayWorker* gw);
+
+    // Sends server connection preface.
+    uint32_t SendPreface(GatewayWorker* gw);
+
+    // Processes received frames.
+    uint32_t ProcessData(GatewayWorker* gw, SocketDataChunkRef sd);
+
+    // Sends codehost response on its stream.
+    uint32_t SendResponse(GatewayWorker* gw, SocketDataChunkRef sd);
+
+    // Resets stream whose virtual socket is being disconnected.
+    uint32_t CancelStream(GatewayWorker* gw, uint32_t stream_id);
+
+    // Releases all streams.
+    void Release(GatewayWorker* gw);
+};
+
+} // namespace network
+} // namespace starcounter
+
+#endif // HTTP2_PROTO_HPP
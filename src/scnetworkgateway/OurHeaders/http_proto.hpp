@@ -6,6 +6,15 @@ namespace starcounter {
 namespace network {
 
 void HttpGlobalInit();
+
+// Fetches method and URI from HTTP request data.
+uint32_t GetMethodAndUri(
+    char* http_data,
+    uint32_t http_data_len,
+    uint32_t* out_method_space_uri_len,
+    uint32_t* out_uri_offset,
+    uint32_t uri_max_len);
+
 class WsProto;
 class GatewayWorker;
 
@@ -468,6 +477,9 @@ public:
     // Resets the parser related fields.
     void ResetParser(GatewayWorker *gw, SocketDataChunkRef sd);
 
+    // Resets the parser and parses accumulated data of the first chunk.
+    size_t ExecuteParser(GatewayWorker *gw, SocketDataChunkRef sd);
+
     // Entry point for outer data processing.
     uint32_t HttpUriDispatcher(HandlersList* hl, GatewayWorker *gw, SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id);
 
@@ -488,6 +500,15 @@ public:
         SocketDataChunkRef sd,
         BMX_HANDLER_TYPE handler_id,
         int32_t reverse_proxy_index);
+
+    // Serves file from static route directory directly from gateway.
+    uint32_t ServeStaticFile(
+        GatewayWorker *gw,
+        SocketDataChunkRef sd,
+        int32_t static_route_index,
+        const char* uri,
+        int32_t uri_len,
+        bool* served);
 };
 
 int32_t ConstructHttp400(
@@ -114,9 +114,35 @@ public:
     // Checking there are enough space for receive.
     void CheckSpaceLeftForReceive() {
         GW_ASSERT(num_available_network_bytes_ > 0);
+
+        // Checking if receiving into request body chain segment.
+        if ((NULL != socket_info_) && (NULL != socket_info_->body_chain_tail_)) {
+            SocketDataChunk* tail = socket_info_->body_chain_tail_;
+            GW_ASSERT(cur_network_buf_ptr_ + num_available_network_bytes_ <= tail->get_data_blob_start() + tail->get_data_blob_size());
+            return;
+        }
+
         GW_ASSERT(cur_network_buf_ptr_ + num_available_network_bytes_ <= get_data_blob_start() + get_data_blob_size());
     }
 
+    // Points network buffer to given memory (e.g. body chain segment).
+    void SetNetworkBuffer(uint8_t* buf, uint32_t num_bytes) {
+        cur_network_buf_ptr_ = buf;
+        num_available_network_bytes_ = num_bytes;
+    }
+
+    // Getting next segment in request body chain.
+    // NOTE: Chain segments never participate in network operations,
+    // so the event handle of overlapped structure is free to use.
+    SocketDataChunk* get_next_chain_segment() {
+        return (SocketDataChunk*) ovl_.hEvent;
+    }
+
+    // Setting next segment in request body chain.
+    void set_next_chain_segment(SocketDataChunk* next_segment) {
+        ovl_.hEvent = (HANDLE) next_segment;
+    }
+
     uint8_t* get_data_blob_start() {
         return (uint8_t*)this + SOCKET_DATA_OFFSET_BLOB;
     }
@@ -189,6 +215,33 @@ public:
         GW_ASSERT(accumulated_len_bytes_ <= get_data_blob_size());
     }
 
+    // Adds received bytes either to this chunk or to request body chain.
+    void AddReceivedBytes(int32_t num_bytes)
+    {
+        GW_ASSERT_DEBUG(NULL != socket_info_);
+
+        // Checking if we are receiving into body chain segment.
+        if (NULL != socket_info_->body_chain_tail_)
+        {
+            socket_info_->body_chain_tail_->AddAccumulatedBytes(num_bytes);
+            socket_info_->body_chain_len_bytes_ += num_bytes;
+
+            cur_network_buf_ptr_ += num_bytes;
+            num_available_network_bytes_ -= num_bytes;
+        }
+        else
+        {
+            AddAccumulatedBytes(num_bytes);
+        }
+
+        // Checking if number of accumulated bytes is tracked.
+        if (socket_info_->accum_data_bytes_left_ > 0)
+        {
+            GW_ASSERT(socket_info_->accum_data_bytes_left_ >= static_cast<uint32_t>(num_bytes));
+            socket_info_->accum_data_bytes_left_ -= num_bytes;
+        }
+    }
+
     // Prepare buffer to proxy outside.
     void PrepareToSendOnProxy()
     {
@@ -291,6 +344,9 @@ public:
         // First copying socket data headers.
         PlainCopySocketDataInfoHeaders(ipc_sd);
 
+        // Codehost can't set gateway only flags.
+        reset_ws_broadcast_buffer_flag();
+
         // Resetting the WSABUF data pointer.
         cur_network_buf_ptr_ = get_data_blob_start();
 
@@ -401,6 +457,8 @@ public:
 
         std::cout << "public const int CHUNK_OFFSET_UPGRADE_PART_BYTES = "<< ((uint8_t*)&num_available_network_bytes_ - smc) << ";" << std::endl;
         std::cout << "public const int CHUNK_OFFSET_USER_DATA_TOTAL_LENGTH_FROM_DB = "<< ((uint8_t*)&accumulated_len_bytes_ - smc) << ";" << std::endl;
+        std::cout << "public const int CHUNK_OFFSET_TRACE_SCHEDULER_POP_TICKS = "<< ((uint8_t*)&ovl_.Offset - smc) << ";" << std::endl;
+        std::cout << "public const int CHUNK_OFFSET_TRACE_RESPONSE_PUSH_TICKS = "<< ((uint8_t*)&ovl_.hEvent - smc) << ";" << std::endl;
 
         GW_ASSERT(1 == sizeof(WsProto));
         GW_ASSERT(8 == sizeof(SOCKET));
@@ -462,6 +520,10 @@ public:
 
         GW_ASSERT(((uint8_t*)&accumulated_len_bytes_ - smc) == MixedCodeConstants::CHUNK_OFFSET_USER_DATA_TOTAL_LENGTH_FROM_DB);
 
+        GW_ASSERT(((uint8_t*)&ovl_.Offset - smc) == MixedCodeConstants::CHUNK_OFFSET_TRACE_SCHEDULER_POP_TICKS);
+
+        GW_ASSERT(((uint8_t*)&ovl_.hEvent - smc) == MixedCodeConstants::CHUNK_OFFSET_TRACE_RESPONSE_PUSH_TICKS);
+
         GW_ASSERT(sizeof(sockaddr_in) == 16);
 
         return 0;
@@ -622,6 +684,81 @@ public:
 		socket_info_->reset_streaming_response_body_flag();
 	}
 
+    bool get_ws_broadcast_flag()
+    {
+        return (flags_ & MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_WS_BROADCAST) != 0;
+    }
+
+    void set_ws_broadcast_flag()
+    {
+        flags_ |= MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_WS_BROADCAST;
+    }
+
+    void reset_ws_broadcast_flag()
+    {
+        flags_ &= ~MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_WS_BROADCAST;
+    }
+
+    // Parameters data holds pointer to shared broadcast buffer.
+    bool get_ws_broadcast_buffer_flag()
+    {
+        return (flags_ & GATEWAY_SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_WS_BROADCAST_BUFFER) != 0;
+    }
+
+    void set_ws_broadcast_buffer_flag()
+    {
+        flags_ |= GATEWAY_SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_WS_BROADCAST_BUFFER;
+    }
+
+    void reset_ws_broadcast_buffer_flag()
+    {
+        flags_ &= ~GATEWAY_SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_WS_BROADCAST_BUFFER;
+    }
+
+    // Data is a sequence of packed UDP datagrams.
+    bool get_udp_batch_flag()
+    {
+        return (flags_ & MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_UDP_BATCH) != 0;
+    }
+
+    void set_udp_batch_flag()
+    {
+        flags_ |= MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_UDP_BATCH;
+    }
+
+    bool get_traced_flag()
+    {
+        return (flags_ & MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_TRACED) != 0;
+    }
+
+    void set_traced_flag()
+    {
+        flags_ |= MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_TRACED;
+    }
+
+    void reset_traced_flag()
+    {
+        flags_ &= ~MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_FLAGS_TRACED;
+    }
+
+    // NOTE: Codehost trace stamps are placed in overlapped structure
+    // fields that are not used while socket data is in IPC chunks.
+    uint64_t GetTraceSchedulerPopTicks()
+    {
+        return *(uint64_t*)&ovl_.Offset;
+    }
+
+    uint64_t GetTraceResponsePushTicks()
+    {
+        return *(uint64_t*)&ovl_.hEvent;
+    }
+
+    void ResetCodehostTraceTicks()
+    {
+        *(uint64_t*)&ovl_.Offset = 0;
+        ovl_.hEvent = NULL;
+    }
+
     bool get_gateway_and_ipc_test_flag()
     {
         return (flags_ & MixedCodeConstants::SOCKET_DATA_FLAGS::SOCKET_DATA_GATEWAY_AND_IPC_TEST) != 0;
@@ -881,9 +1018,11 @@ public:
         SocketDataChunk* sd,
         int32_t user_data_len_bytes);
 
-    // Copies gateway chunk to IPC chunks.
+    // Copies gateway chunk and given request body chain to IPC chunks.
     uint32_t CopyGatewayChunkToIPCChunks(
         WorkerDbInterface* worker_db,
+        SocketDataChunk* body_chain_head,
+        uint32_t body_chain_len_bytes,
         SocketDataChunk** new_ipc_sd,
         core::chunk_index* db_chunk_index);
 
@@ -939,6 +1078,12 @@ public:
         return user_data_length_bytes_;
     }
 
+    // Setting size of user data in IPC chunk (can span several linked chunks).
+    void set_user_data_length_bytes_icp_chunk(uint32_t data_len) {
+
+        user_data_length_bytes_ = data_len;
+    }
+
     // Resets accumulating buffer to its default socket data values.
     void ResetAccumBuffer()
     {
@@ -983,12 +1128,21 @@ public:
     // Start receiving on socket.
     uint32_t ReceiveTcp(GatewayWorker *gw, uint32_t *num_bytes);
 
+    // Start waiting for data on socket without a receive buffer.
+    uint32_t ReceiveTcpZeroBytes(GatewayWorker *gw, uint32_t *num_bytes);
+
+    // Start receiving ciphertext into socket TLS buffer.
+    uint32_t ReceiveTls(GatewayWorker *gw, uint32_t *num_bytes);
+
     // Start sending on TCP socket.
     uint32_t SendTcp(GatewayWorker* gw, uint32_t *numBytes);
 
     // Start sending on UDP socket.
     uint32_t SendUdp(GatewayWorker* gw, uint32_t *numBytes);
 
+    // Start sending network buffer followed by file contents on TCP socket.
+    uint32_t TransmitFileTcp(GatewayWorker* gw, HANDLE file_handle, uint64_t file_offset, uint32_t num_file_bytes);
+
     // Start receiving on socket.
     uint32_t ReceiveUdp(GatewayWorker *gw, uint32_t *num_bytes);
 
@@ -1027,6 +1181,11 @@ public:
         SocketDataChunkRef sd,
         int32_t data_size = 0);
 
+    // Moves empty socket data to the smallest chunk store.
+    static uint32_t ChangeToSmallest(
+        GatewayWorker*gw,
+        SocketDataChunkRef sd);
+
     // Clone current socket data to simply send it.
     uint32_t CreateSocketDataFromBigBuffer(
         GatewayWorker*gw,
@@ -1156,6 +1315,30 @@ public:
         return socket_info_->accum_data_bytes_left_;
     }
 
+    // Getting first segment of fully received request body chain.
+    SocketDataChunk* GetBodyChainHead()
+    {
+        GW_ASSERT_DEBUG(NULL != socket_info_);
+
+        // Chain is only consumed when all bytes were received.
+        if (socket_info_->accum_data_bytes_left_ > 0)
+            return NULL;
+
+        return socket_info_->body_chain_head_;
+    }
+
+    // Getting number of bytes in fully received request body chain.
+    uint32_t GetBodyChainLength()
+    {
+        GW_ASSERT_DEBUG(NULL != socket_info_);
+
+        // Chain is only consumed when all bytes were received.
+        if (socket_info_->accum_data_bytes_left_ > 0)
+            return 0;
+
+        return socket_info_->body_chain_len_bytes_;
+    }
+
     void SetProxySocketIndex(socket_index_type proxy_socket_index)
     {
         GW_ASSERT_DEBUG(NULL != socket_info_);
@@ -1178,6 +1361,14 @@ public:
         return socket_info_->get_socket_aggregated_flag();
     }
 
+    // Checking if socket is a stream of HTTP/2 connection.
+    bool IsHttp2Stream()
+    {
+        GW_ASSERT_DEBUG(NULL != socket_info_);
+
+        return (0 != socket_info_->http2_stream_id_);
+    }
+
     // Getting aggregation socket index.
     socket_index_type GetAggregationSocketIndex()
     {
@@ -1208,13 +1399,6 @@ public:
         socket_info_->set_ws_close_already_sent_flag();
     }
 
-    void SetWebSocketGroupId(ws_group_id_type ws_group_id)
-    {
-        GW_ASSERT_DEBUG(NULL != socket_info_);
-
-        socket_info_->ws_group_id_ = ws_group_id;
-    }
-
     void FetchWebSocketGroupIdFromSocket()
     {
         GW_ASSERT_DEBUG(NULL != socket_info_);
@@ -1313,12 +1497,7 @@ public:
     }
 
     // Setting destination database index.
-    void SetDestDbIndex(db_index_type db_index)
-    {
-        GW_ASSERT_DEBUG(NULL != socket_info_);
-
-        socket_info_->dest_db_index_ = db_index;
-    }
+    void SetDestDbIndex(GatewayWorker* gw, db_index_type db_index);
 
     // Getting destination database index.
     db_index_type GetDestDbIndex()
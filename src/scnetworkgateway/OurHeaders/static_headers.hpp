@@ -12,6 +12,8 @@
 #include <iomanip>
 #include <limits>
 #include <list>
+#include <deque>
+#include <unordered_map>
 #include <cstdint>
 #include <bitset>
 
@@ -23,6 +25,10 @@
 #include <mmsystem.h>
 #include <strsafe.h>
 #include <mstcpip.h>
+#include <wincrypt.h>
+#define SECURITY_WIN32
+#include <security.h>
+#include <schannel.h>
 #undef WIN32_LEAN_AND_MEAN
 
 #include <conio.h>
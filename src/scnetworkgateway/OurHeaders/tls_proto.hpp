@@ -0,0 +1,205 @@
+#pragma once
+#ifndef TLS_PROTO_HPP
+#define TLS_PROTO_HPP
+
+namespace starcounter {
+namespace network {
+
+class GatewayWorker;
+class SocketDataChunk;
+struct TlsPortInfo;
+
+// Context requirements for accepted TLS connections.
+const ULONG kTlsContextRequirements =
+    ASC_REQ_SEQUENCE_DETECT |
+    ASC_REQ_REPLAY_DETECT |
+    ASC_REQ_CONFIDENTIALITY |
+    ASC_REQ_EXTENDED_ERROR |
+    ASC_REQ_ALLOCATE_MEMORY |
+    ASC_REQ_STREAM;
+
+// Loads port certificate and acquires Schannel credentials for it.
+uint32_t TlsAcquireCredentials(TlsPortInfo* tls_port);
+
+// Releases port credentials and certificate.
+void TlsReleaseCredentials(TlsPortInfo* tls_port);
+
+class TlsContext;
+
+// Encrypts given data into records at destination.
+uint32_t TlsEncryptRecords(TlsContext* tls, uint8_t* plain_ptr, uint32_t plain_len, uint8_t* dest, uint32_t* num_encrypted_bytes);
+
+// State of one TLS connection.
+class TlsContext
+{
+    // Schannel security context.
+    CtxtHandle context_;
+
+    // Record header, trailer and maximum message sizes.
+    SecPkgContext_StreamSizes stream_sizes_;
+
+    // Port settings this connection was accepted on.
+    TlsPortInfo* tls_port_;
+
+    // Chunk holding received ciphertext (NULL when nothing is buffered).
+    SocketDataChunk* recv_sd_;
+
+    // Number of ciphertext bytes at the beginning of receive chunk.
+    uint32_t cipher_len_;
+
+    // Decrypted data that did not fit into request buffer.
+    uint8_t* plain_ptr_;
+    uint32_t plain_len_;
+
+    // Ciphertext that follows the pending decrypted data.
+    uint8_t* extra_ptr_;
+    uint32_t extra_len_;
+
+    // Security context was created by the first handshake call.
+    bool context_created_;
+
+    // Handshake is completed and records are encrypted.
+    bool established_;
+
+    // Pending decrypted data was posted to worker completion port.
+    bool delivery_posted_;
+
+public:
+
+    // Initializing new connection context.
+    void Init(TlsPortInfo* tls_port)
+    {
+        SecInvalidateHandle(&context_);
+        memset(&stream_sizes_, 0, sizeof(stream_sizes_));
+        tls_port_ = tls_port;
+        recv_sd_ = NULL;
+        cipher_len_ = 0;
+        plain_ptr_ = NULL;
+        plain_len_ = 0;
+        extra_ptr_ = NULL;
+        extra_len_ = 0;
+        context_created_ = false;
+        established_ = false;
+        delivery_posted_ = false;
+    }
+
+    CtxtHandle* get_context()
+    {
+        return &context_;
+    }
+
+    SecPkgContext_StreamSizes* get_stream_sizes()
+    {
+        return &stream_sizes_;
+    }
+
+    TlsPortInfo* get_tls_port()
+    {
+        return tls_port_;
+    }
+
+    SocketDataChunk* get_recv_sd()
+    {
+        return recv_sd_;
+    }
+
+    void set_recv_sd(SocketDataChunk* recv_sd)
+    {
+        recv_sd_ = recv_sd;
+    }
+
+    uint32_t get_cipher_len()
+    {
+        return cipher_len_;
+    }
+
+    void set_cipher_len(uint32_t cipher_len)
+    {
+        cipher_len_ = cipher_len;
+    }
+
+    bool get_context_created_flag()
+    {
+        return context_created_;
+    }
+
+    void set_context_created_flag()
+    {
+        context_created_ = true;
+    }
+
+    bool get_established_flag()
+    {
+        return established_;
+    }
+
+    void set_established_flag()
+    {
+        established_ = true;
+    }
+
+    bool get_delivery_posted_flag()
+    {
+        return delivery_posted_;
+    }
+
+    void set_delivery_posted_flag(bool value)
+    {
+        delivery_posted_ = value;
+    }
+
+    // Beginning of buffered ciphertext.
+    uint8_t* GetCiphertext();
+
+    // Free space left for receiving ciphertext.
+    uint32_t GetReceiveSpace();
+
+    // Keeps only given ciphertext, moving it to the beginning of receive buffer.
+    void KeepCiphertext(uint8_t* cipher_ptr, uint32_t cipher_len);
+
+    // Checks if there is decrypted data waiting for delivery.
+    bool HasPendingData()
+    {
+        return plain_len_ > 0;
+    }
+
+    // Remembers decrypted data and ciphertext after it.
+    void SetPendingData(uint8_t* plain_ptr, uint32_t plain_len, uint8_t* extra_ptr, uint32_t extra_len)
+    {
+        plain_ptr_ = plain_ptr;
+        plain_len_ = plain_len;
+        extra_ptr_ = extra_ptr;
+        extra_len_ = extra_len;
+    }
+
+    // Copies pending decrypted data into given buffer and returns number of copied bytes.
+    uint32_t TakePendingData(uint8_t* buf, uint32_t buf_len)
+    {
+        uint32_t num_bytes = plain_len_;
+        if (num_bytes > buf_len)
+            num_bytes = buf_len;
+
+        memcpy(buf, plain_ptr_, num_bytes);
+
+        plain_ptr_ += num_bytes;
+        plain_len_ -= num_bytes;
+
+        return num_bytes;
+    }
+
+    // Ciphertext following last decrypted record.
+    uint8_t* get_extra_ptr()
+    {
+        return extra_ptr_;
+    }
+
+    uint32_t get_extra_len()
+    {
+        return extra_len_;
+    }
+};
+
+} // namespace network
+} // namespace starcounter
+
+#endif // TLS_PROTO_HPP
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef TRAFFIC_CAPTURE_HPP
+#define TRAFFIC_CAPTURE_HPP
+
+#include <cstdint>
+
+namespace starcounter {
+namespace network {
+
+// Traffic capture file format, shared by the gateway and the replay tool.
+// File starts with TrafficCaptureFileHeader followed by records in time order,
+// each TrafficCaptureRecord is followed by data_len_ bytes of received data.
+
+// Capture file signature.
+const char TRAFFIC_CAPTURE_MAGIC[8] = { 'S', 'C', 'G', 'W', 'C', 'A', 'P', 'T' };
+
+// Current capture file format version.
+const uint32_t TRAFFIC_CAPTURE_VERSION = 1;
+
+// Maximum data bytes in one record, bigger receives are split.
+const int32_t TRAFFIC_CAPTURE_MAX_RECORD_DATA = 64 * 1024;
+
+// Types of capture records.
+enum TRAFFIC_CAPTURE_RECORD_TYPE
+{
+    // Connection accepted.
+    TRAFFIC_CAPTURE_RECORD_OPEN = 1,
+
+    // Bytes received on connection (decrypted on TLS ports).
+    TRAFFIC_CAPTURE_RECORD_DATA = 2,
+
+    // Connection closed.
+    TRAFFIC_CAPTURE_RECORD_CLOSE = 3
+};
+
+#pragma pack(push, 1)
+
+struct TrafficCaptureFileHeader
+{
+    // TRAFFIC_CAPTURE_MAGIC.
+    char magic_[8];
+
+    // TRAFFIC_CAPTURE_VERSION.
+    uint32_t version_;
+
+    uint32_t reserved_;
+
+    // Wall clock time when capture started, as Windows FILETIME.
+    uint64_t start_filetime_;
+};
+
+struct TrafficCaptureRecord
+{
+    // Microseconds since capture start.
+    uint64_t time_us_;
+
+    // Connection identifier, unique within the capture.
+    uint64_t connection_id_;
+
+    // Number of data bytes following the record.
+    uint32_t data_len_;
+
+    // Gateway port the connection was accepted on.
+    uint16_t port_;
+
+    // TRAFFIC_CAPTURE_RECORD_TYPE.
+    uint8_t type_;
+
+    uint8_t reserved_;
+};
+
+#pragma pack(pop)
+
+} // namespace network
+} // namespace starcounter
+
+#endif // TRAFFIC_CAPTURE_HPP
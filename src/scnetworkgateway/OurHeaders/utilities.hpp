@@ -135,6 +135,18 @@ uint32_t PrintLastError(bool report_to_log = false);
 // Reports statistics 
 void ReportStatistics(const char* stat_name, const double stat_value);
 
+// Parses list of existing logical processors like "0,2,4-7".
+bool ParseCpuList(const char* cpu_list, std::vector<int32_t>& cpus);
+
+// Converts logical processor index counted over all processor groups to processor number.
+bool GetProcessorNumberFromCpuIndex(int32_t cpu_index, PROCESSOR_NUMBER* proc_number);
+
+// Returns NUMA node of given logical processor or NUMA_NO_PREFERRED_NODE if unknown.
+uint32_t GetCpuNumaNode(int32_t cpu_index);
+
+// Restricts thread to given logical processors, all of them should be in one processor group.
+uint32_t PinThreadToCpus(HANDLE thread_handle, const std::vector<int32_t>& cpus);
+
 // Invalid value of converted number from hexadecimal string.
 const uint64_t INVALID_CONVERTED_NUMBER = 0xFFFFFFFFFFFFFFFF;
 
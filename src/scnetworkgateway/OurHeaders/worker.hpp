@@ -5,29 +5,137 @@
 namespace starcounter {
 namespace network {
 
+// Contiguous memory region carved into equally sized chunks.
+struct ChunkSlab
+{
+    // Start of the region.
+    uint8_t* base_;
+
+    // Indexes of free chunks in this slab.
+    int32_t* free_chunks_;
+
+    // Number of free chunks.
+    int32_t num_free_chunks_;
+
+    // Total number of chunks in this slab.
+    int32_t num_chunks_;
+
+    // Region size in bytes.
+    SIZE_T size_bytes_;
+};
+
 class WorkerChunks
 {
-    // Chunk stores.
-    LinearQueue<SocketDataChunk*, MAX_WORKER_CHUNKS> worker_chunks_[NumGatewayChunkSizes];
+    // Slabs for each chunk store, sorted by base address.
+    std::vector<ChunkSlab> slabs_[NumGatewayChunkSizes];
+
+    // Lowest slab index that might have free chunks.
+    int32_t first_free_slab_[NumGatewayChunkSizes];
+
+    // Number of chunks in one slab for each chunk store.
+    int32_t chunks_per_slab_[NumGatewayChunkSizes];
 
     // Number of allocated chunks for each chunks store.
     int32_t num_allocated_chunks_[NumGatewayChunkSizes];
 
+    // Number of free chunks for each chunks store.
+    int32_t num_free_chunks_[NumGatewayChunkSizes];
+
+    // Number of chunks obtained without allocating a new slab.
+    int64_t num_hits_[NumGatewayChunkSizes];
+
+    // Number of chunks that needed a new slab or failed.
+    int64_t num_misses_[NumGatewayChunkSizes];
+
+    // Number of slabs returned to the operating system.
+    int64_t num_trimmed_slabs_;
+
+    // NUMA node slabs are allocated on.
+    uint32_t numa_node_;
+
+    // Allocates a new slab for given store.
+    bool AllocateSlab(chunk_store_type store_index);
+
+    // Returns given slab to the operating system.
+    void FreeSlab(chunk_store_type store_index, int32_t slab_index);
+
+    // Finds the slab containing given chunk.
+    int32_t FindSlab(chunk_store_type store_index, uint8_t* chunk)
+    {
+        std::vector<ChunkSlab>& slabs = slabs_[store_index];
+
+        int32_t low = 0, high = static_cast<int32_t>(slabs.size()) - 1;
+        while (low < high)
+        {
+            int32_t mid = (low + high + 1) / 2;
+            if (slabs[mid].base_ <= chunk)
+                low = mid;
+            else
+                high = mid - 1;
+        }
+
+        GW_ASSERT_DEBUG((chunk >= slabs[low].base_) && (chunk < slabs[low].base_ + slabs[low].size_bytes_));
+
+        return low;
+    }
+
 public:
 
     WorkerChunks()
     {
+        memset(first_free_slab_, 0, sizeof(first_free_slab_));
+        memset(chunks_per_slab_, 0, sizeof(chunks_per_slab_));
         memset(num_allocated_chunks_, 0, sizeof(num_allocated_chunks_));
+        memset(num_free_chunks_, 0, sizeof(num_free_chunks_));
+        memset(num_hits_, 0, sizeof(num_hits_));
+        memset(num_misses_, 0, sizeof(num_misses_));
+        num_trimmed_slabs_ = 0;
+        numa_node_ = NUMA_NO_PREFERRED_NODE;
+    }
+
+    ~WorkerChunks()
+    {
+        for (chunk_store_type i = 0; i < NumGatewayChunkSizes; i++)
+        {
+            while (slabs_[i].size())
+                FreeSlab(i, static_cast<int32_t>(slabs_[i].size()) - 1);
+        }
     }
 
+    // Calculates slab sizes from gateway settings.
+    void Init(uint32_t numa_node);
+
     void PrintInfo(std::stringstream& stats_stream)
     {
+        stats_stream << "\"allocatedChunks\":\"";
         for (int32_t i = 0; i < NumGatewayChunkSizes; i++) 
         {
             stats_stream << num_allocated_chunks_[i];
             if ((i + 1) < NumGatewayChunkSizes)
                 stats_stream << ", "; 
         }
+        stats_stream << "\",\"chunkHits\":\"";
+        for (int32_t i = 0; i < NumGatewayChunkSizes; i++) 
+        {
+            stats_stream << num_hits_[i];
+            if ((i + 1) < NumGatewayChunkSizes)
+                stats_stream << ", "; 
+        }
+        stats_stream << "\",\"chunkMisses\":\"";
+        for (int32_t i = 0; i < NumGatewayChunkSizes; i++) 
+        {
+            stats_stream << num_misses_[i];
+            if ((i + 1) < NumGatewayChunkSizes)
+                stats_stream << ", "; 
+        }
+        stats_stream << "\",\"chunkSlabs\":\"";
+        for (int32_t i = 0; i < NumGatewayChunkSizes; i++) 
+        {
+            stats_stream << slabs_[i].size();
+            if ((i + 1) < NumGatewayChunkSizes)
+                stats_stream << ", "; 
+        }
+        stats_stream << "\",\"trimmedSlabs\":" << num_trimmed_slabs_;
     }
 
     int32_t GetNumberAllocatedChunks(chunk_store_type store_index)
@@ -35,7 +143,24 @@ public:
         return num_allocated_chunks_[store_index];
     }
 
-    // Releasing existing chunk to the list.
+    // NOTE: Following getters are used by metrics scraping from another thread.
+    // Counters are only written by owning worker and aligned reads are atomic.
+    int32_t GetNumberFreeChunks(chunk_store_type store_index)
+    {
+        return num_free_chunks_[store_index];
+    }
+
+    int64_t GetNumberChunkHits(chunk_store_type store_index)
+    {
+        return num_hits_[store_index];
+    }
+
+    int64_t GetNumberChunkMisses(chunk_store_type store_index)
+    {
+        return num_misses_[store_index];
+    }
+
+    // Releasing existing chunk to its slab.
     void ReleaseChunk(SocketDataChunkRef sd)
     {
         chunk_store_type store_index = sd->get_chunk_store_index();
@@ -43,15 +168,23 @@ public:
         // Invalidating before returning.
         sd->InvalidateWhenReturning();
 
-        // Checking if we should completely dispose the chunk.
-        if (worker_chunks_[store_index].get_num_entries() > GatewayChunkStoresSizes[store_index])
-        {
-            GwDeleteAligned(sd);
-            num_allocated_chunks_[store_index]--;
-        }
-        else
+        int32_t slab_index = FindSlab(store_index, (uint8_t*) sd);
+        ChunkSlab& slab = slabs_[store_index][slab_index];
+
+        slab.free_chunks_[slab.num_free_chunks_] =
+            static_cast<int32_t>(((uint8_t*) sd - slab.base_) / GatewayChunkSizes[store_index]);
+        slab.num_free_chunks_++;
+        num_free_chunks_[store_index]++;
+
+        if (slab_index < first_free_slab_[store_index])
+            first_free_slab_[store_index] = slab_index;
+
+        // Checking if we should give the whole slab back to the system.
+        if ((slab.num_free_chunks_ == slab.num_chunks_) &&
+            (num_free_chunks_[store_index] - slab.num_chunks_ >= g_gateway.setting_chunk_store_free_watermark(store_index)))
         {
-            worker_chunks_[store_index].PushBack(sd);
+            FreeSlab(store_index, slab_index);
+            num_trimmed_slabs_++;
         }
 
         sd = NULL;
@@ -65,35 +198,202 @@ public:
         return ObtainChunkByStoreIndex(chunk_store_index);
     }
 
-    // Getting free chunk from the list or creating a new one.
+    // Getting free chunk from the slabs or allocating a new slab.
     SocketDataChunk* ObtainChunkByStoreIndex(chunk_store_type chunk_store_index)
     {
-        SocketDataChunk* sd;
-
         // Checking if a free chunk is available.
-        if (worker_chunks_[chunk_store_index].get_num_entries())
+        if (num_free_chunks_[chunk_store_index])
         {
-            sd = worker_chunks_[chunk_store_index].PopBack();
-            goto RETURN_SD;
+            num_hits_[chunk_store_index]++;
         }
+        else
+        {
+            num_misses_[chunk_store_index]++;
+
+            // Checking if we have allocated too many chunks for this store.
+            if (num_allocated_chunks_[chunk_store_index] >= g_gateway.setting_chunk_store_max_chunks(chunk_store_index)) {
+                return NULL;
+            }
 
-        // Checking if we have allocated too many chunks for this store.
-        if (num_allocated_chunks_[chunk_store_index] > GatewayChunkStoresSizes[chunk_store_index]) {
-            return NULL;
+            // Creating new slab.
+            if (!AllocateSlab(chunk_store_index))
+                return NULL;
         }
 
-        // Creating new chunk.
-        sd = (SocketDataChunk*) GwNewAligned(GatewayChunkSizes[chunk_store_index]);
-        GW_ASSERT(NULL != sd);
-        num_allocated_chunks_[chunk_store_index]++;
+        // Searching for the first slab with free chunks.
+        std::vector<ChunkSlab>& slabs = slabs_[chunk_store_index];
+        int32_t i = first_free_slab_[chunk_store_index];
+        while (0 == slabs[i].num_free_chunks_)
+            i++;
+
+        first_free_slab_[chunk_store_index] = i;
+
+        ChunkSlab& slab = slabs[i];
+        slab.num_free_chunks_--;
+        num_free_chunks_[chunk_store_index]--;
 
-RETURN_SD:
+        SocketDataChunk* sd = (SocketDataChunk*) (slab.base_ +
+            static_cast<SIZE_T>(slab.free_chunks_[slab.num_free_chunks_]) * GatewayChunkSizes[chunk_store_index]);
 
         sd->set_chunk_store_index(chunk_store_index);
         return sd;
     }
 };
 
+// Open file served by static files routes.
+struct StaticFileEntry
+{
+    // Full path to the file.
+    std::wstring path_;
+
+    // Open file handle.
+    HANDLE file_handle_;
+
+    // Size of the file in bytes.
+    uint64_t file_size_;
+
+    // Last write time of the file.
+    FILETIME last_write_time_;
+
+    // Entity tag (quoted).
+    char etag_[48];
+
+    // Last-Modified header value.
+    char last_modified_[40];
+
+    // Content type derived from file extension.
+    const char* content_type_;
+
+    // Tick when file was last checked for changes.
+    uint64_t checked_tick_;
+
+    // Tick when file was last served.
+    uint64_t used_tick_;
+
+    // Number of pending transmits using this handle.
+    int32_t num_users_;
+
+    // Entry is not in cache anymore and is deleted when not used.
+    bool detached_;
+};
+
+class StaticFilesCache
+{
+    // Cached files by full path.
+    std::unordered_map<std::wstring, StaticFileEntry*> entries_;
+
+    // Number of files served from open handles.
+    int64_t num_hits_;
+
+    // Number of files that needed to be opened.
+    int64_t num_misses_;
+
+    // Opens file and fills new entry.
+    StaticFileEntry* OpenEntry(const std::wstring& path);
+
+    // Closes file and deletes entry.
+    void DeleteEntry(StaticFileEntry* entry);
+
+    // Removes entry from cache, deleting it when not in use.
+    void DetachEntry(StaticFileEntry* entry);
+
+    // Makes space for a new entry by detaching least recently used one.
+    void EvictEntry();
+
+public:
+
+    StaticFilesCache()
+    {
+        num_hits_ = 0;
+        num_misses_ = 0;
+    }
+
+    ~StaticFilesCache();
+
+    // Obtains open file for given path (NULL if file can't be opened).
+    StaticFileEntry* Obtain(const std::wstring& path);
+
+    // Releases file obtained with Obtain.
+    void Release(StaticFileEntry* entry);
+
+    void PrintInfo(std::stringstream& stats_stream)
+    {
+        stats_stream << "\"staticFilesOpen\":" << entries_.size() << ",";
+        stats_stream << "\"staticFilesHits\":" << num_hits_ << ",";
+        stats_stream << "\"staticFilesMisses\":" << num_misses_;
+    }
+};
+
+// Number of sub-buckets per power of two in latency histograms (values below twice that are exact).
+const int32_t LATENCY_HISTOGRAM_SUB_BUCKETS = 16;
+
+// Number of powers of two covered above exact values (up to ~38 hours in microseconds).
+const int32_t LATENCY_HISTOGRAM_NUM_RANGES = 32;
+
+const int32_t LATENCY_HISTOGRAM_NUM_BUCKETS = 2 * LATENCY_HISTOGRAM_SUB_BUCKETS + LATENCY_HISTOGRAM_NUM_RANGES * LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+// Log-linear histogram of latencies in microseconds with ~6% precision.
+// NOTE: Only owning worker writes, readers merge counts without locking.
+class LatencyHistogram
+{
+    volatile int64_t counts_[LATENCY_HISTOGRAM_NUM_BUCKETS];
+
+public:
+
+    LatencyHistogram()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for (int32_t i = 0; i < LATENCY_HISTOGRAM_NUM_BUCKETS; i++)
+            counts_[i] = 0;
+    }
+
+    // Gets bucket index for given value.
+    static int32_t GetBucketIndex(uint64_t value_us)
+    {
+        if (value_us < 2 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+            return static_cast<int32_t>(value_us);
+
+        unsigned long msb;
+        _BitScanReverse64(&msb, value_us);
+
+        // Keeping 4 significant bits below the most significant one.
+        int32_t shift = static_cast<int32_t>(msb) - 4;
+        if (shift > LATENCY_HISTOGRAM_NUM_RANGES)
+            return LATENCY_HISTOGRAM_NUM_BUCKETS - 1;
+
+        return 2 * LATENCY_HISTOGRAM_SUB_BUCKETS + (shift - 1) * LATENCY_HISTOGRAM_SUB_BUCKETS +
+            static_cast<int32_t>((value_us >> shift) - LATENCY_HISTOGRAM_SUB_BUCKETS);
+    }
+
+    // Gets the highest value that falls into given bucket.
+    static uint64_t GetBucketHighestValue(int32_t index)
+    {
+        if (index < 2 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+            return index;
+
+        int32_t shift = (index - 2 * LATENCY_HISTOGRAM_SUB_BUCKETS) / LATENCY_HISTOGRAM_SUB_BUCKETS + 1;
+        uint64_t sub_bucket = (index - 2 * LATENCY_HISTOGRAM_SUB_BUCKETS) % LATENCY_HISTOGRAM_SUB_BUCKETS + LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    void Record(uint64_t value_us)
+    {
+        counts_[GetBucketIndex(value_us)]++;
+    }
+
+    // Adds counts of this histogram to given buckets.
+    void AddTo(int64_t* merged_counts)
+    {
+        for (int32_t i = 0; i < LATENCY_HISTOGRAM_NUM_BUCKETS; i++)
+            merged_counts[i] += counts_[i];
+    }
+};
+
 _declspec(align(MEMORY_ALLOCATION_ALIGNMENT)) class RebalancedSocketInfo {
 
     // NOTE: Lock-free SLIST_ENTRY should be the first field!
@@ -129,6 +429,22 @@ public:
     }
 };
 
+// Chunk waiting in worker overflow queue.
+struct OverflowChunk
+{
+    // Chunk to be pushed to database.
+    SocketDataChunk* sd_;
+
+    // Unique number of the database that accounted this chunk.
+    uint64_t unique_db_num_;
+
+    // Request body chain taken from the socket together with the chunk.
+    SocketDataChunk* body_chain_head_;
+
+    // Number of bytes in request body chain.
+    uint32_t body_chain_len_bytes_;
+};
+
 class Profiler;
 class WorkerDbInterface;
 class GatewayWorker
@@ -166,8 +482,14 @@ class GatewayWorker
     // Aggregation sockets waiting for send.
     LinearList<SocketDataChunk*, 256> aggr_sds_to_send_;
 
+    // Packed UDP datagrams waiting for push to codehost (one per UDP socket).
+    LinearList<SocketDataChunk*, MAX_PORTS_NUM + 1> udp_batch_sds_;
+
     // Overflow socket data chunks.
-    LinearQueue<SocketDataChunk*, MAX_WORKER_CHUNKS> overflow_sds_;
+    LinearQueue<OverflowChunk, MAX_WORKER_CHUNKS> overflow_sds_;
+
+    // Sockets waiting for scheduler credits before receiving.
+    LinearQueue<SocketDataChunk*, MAX_WORKER_CHUNKS> paused_receive_sds_;
 
     // Worker sockets infos.
     ScSocketInfoStruct* sockets_infos_;
@@ -175,11 +497,57 @@ class GatewayWorker
     // Indexes to free socket infos.
     LinearQueue<socket_index_type, MAX_WORKER_CHUNKS> free_sockets_infos_;
 
-    // Aggregation timer.
-    uint64_t aggr_timer_;
+    // Heads of per-database lists of sockets bound to each database.
+    socket_index_type db_sockets_heads_[MAX_ACTIVE_DATABASES];
+
+    // Heads of per-group lists of WebSocket sockets on this worker.
+    std::unordered_map<ws_group_id_type, socket_index_type> ws_group_heads_;
+
+    // Thread-safe list of broadcasts to be sent by this worker.
+    PSLIST_HEADER ws_broadcasts_;
+
+    // Performance counter ticks per millisecond.
+    uint64_t perf_ticks_per_ms_;
+
+    // Maximum coalescing delay of aggregated messages in performance counter ticks.
+    uint64_t aggr_max_delay_ticks_;
+
+    // Time by which buffered aggregated messages must be sent.
+    uint64_t aggr_flush_deadline_ticks_;
+
+    // Latency histograms for each measured stage.
+    LatencyHistogram latency_histograms_[LATENCY_STAGE_COUNT];
+
+    // Sampled request traces in progress.
+    RequestTrace active_traces_[MAX_ACTIVE_REQUEST_TRACES];
+
+    // Ring of completed request traces.
+    RequestTrace completed_traces_[REQUEST_TRACES_RING_SIZE];
+
+    // Total number of completed request traces.
+    volatile int64_t num_completed_traces_;
+
+    // Number of requests left until next traced one.
+    uint32_t requests_until_trace_;
+
+    // Number of connections captured by this worker.
+    uint64_t num_captured_connections_;
+
+    // Prints one Chrome trace complete event if both stamps exist.
+    void PrintTraceEvent(
+        std::stringstream& str,
+        const char* name,
+        int32_t pid,
+        int32_t tid,
+        uint64_t start_ticks,
+        uint64_t end_ticks,
+        RequestTrace* trace);
 
     // Worker chunks.
     WorkerChunks worker_chunks_;
+
+    // Open files served by static routes.
+    StaticFilesCache static_files_cache_;
     
     // Avoiding false sharing.
     uint8_t pad[CACHE_LINE_SIZE];
@@ -199,31 +567,105 @@ class GatewayWorker
     // Creating accepting sockets on all ports.
     void CheckAcceptingSocketsOnAllActivePorts();
 
+    // Sends broadcast frame to all its destination sockets on this worker.
+    void SendWsBroadcast(WsBroadcastBuffer* buf);
+
+    // Sends broadcast frame to one socket.
+    uint32_t SendWsBroadcastFrame(WsBroadcastBuffer* buf, socket_index_type socket_index);
+
 public:
 
+    // Pushes broadcast for sending by this worker.
+    void PushWsBroadcastTask(WsBroadcastTask* task) {
+        InterlockedPushEntrySList(ws_broadcasts_, (PSLIST_ENTRY) task);
+    }
+
+    // Frames broadcast from codehost once and distributes it to all workers.
+    uint32_t BroadcastWebSocketGroup(SocketDataChunkRef sd);
+
+    // Sends broadcasts queued for this worker.
+    void ProcessWsBroadcasts();
+
+    // Releases reference to broadcast buffer, deleting it when not used.
+    void ReleaseWsBroadcastBuffer(WsBroadcastBuffer* buf);
+
     // Processes socket info for aggregation loopback.
     void LoopbackForAggregation(SocketDataChunkRef sd);
 
     // Checks if there is anything in overflow buffer and pushes all chunks from there.
     void PushOverflowChunks(uint32_t* next_sleep_interval_ms);
 
+    // Checks if socket destination scheduler is out of credits.
+    bool IsOutOfSchedulerCredits(SocketDataChunk* sd);
+
+    // Posts receives on paused sockets whose schedulers got credits back.
+    void ResumePausedReceives();
+
+    // Number of sockets waiting for scheduler credits.
+    int32_t NumPausedReceives() {
+        return paused_receive_sds_.get_num_entries();
+    }
+
     // Worker chunks.
     WorkerChunks* GetWorkerChunks()
     {
         return &worker_chunks_;
     }
 
+    // Open files served by static routes.
+    StaticFilesCache* GetStaticFilesCache()
+    {
+        return &static_files_cache_;
+    }
+
+    void PushToOverflowQueue(OverflowChunk& entry) {
+
+        entry.unique_db_num_ = INVALID_UNIQUE_DB_NUMBER;
+
+        // Overflowed chunk takes credits from all schedulers of its database.
+        db_index_type db_index = entry.sd_->GetDestDbIndex();
+        if ((INVALID_DB_INDEX != db_index) && (NULL != worker_dbs_[db_index])) {
+            worker_dbs_[db_index]->AddOverflowChunk();
+            entry.unique_db_num_ = worker_dbs_[db_index]->get_unique_db_num();
+        }
+
+        overflow_sds_.PushBack(entry);
+    }
+
     void PushToOverflowQueue(SocketDataChunkRef sd) {
-        overflow_sds_.PushBack(sd);
+
+        OverflowChunk entry;
+        entry.sd_ = sd;
+
+        // Request body chain moves with the chunk, so socket can receive next request.
+        entry.body_chain_head_ = sd->GetBodyChainHead();
+        entry.body_chain_len_bytes_ = sd->GetBodyChainLength();
+
+        if (NULL != entry.body_chain_head_)
+            DetachBufferChain(sd->get_socket_info());
+
+        PushToOverflowQueue(entry);
         sd = NULL;
     }
 
-    SocketDataChunk* PopFromOverlowQueue() {
+    bool PopFromOverlowQueue(OverflowChunk* entry) {
+
+        if (overflow_sds_.get_num_entries() > 0) {
+
+            *entry = overflow_sds_.PopFront();
 
-        if (overflow_sds_.get_num_entries() > 0)
-            return overflow_sds_.PopFront();
+            // Credits are returned only to the database that took them,
+            // not to the one that got the same slot after it.
+            db_index_type db_index = entry->sd_->GetDestDbIndex();
+            if ((INVALID_DB_INDEX != db_index) && (NULL != worker_dbs_[db_index]) &&
+                (entry->unique_db_num_ == worker_dbs_[db_index]->get_unique_db_num())) {
+                worker_dbs_[db_index]->RemoveOverflowChunk();
+            }
+
+            return true;
+        }
 
-        return NULL;
+        return false;
     }
 
     int32_t NumOverflowChunks() {
@@ -252,6 +694,123 @@ public:
     // Processes all aggregated chunks.
     uint32_t SendAggregatedChunks();
 
+    // Removes aggregation socket data from the buffered list and sends it.
+    uint32_t SendAggregationSd(SocketDataChunkRef aggr_sd);
+
+    // Sends buffered aggregated messages when worker is idle or coalescing delay expired.
+    void FlushAggregatedChunks(bool worker_idle, uint32_t* next_sleep_interval_ms);
+
+    // Gets current performance counter value.
+    uint64_t GetPerfTicks()
+    {
+        LARGE_INTEGER ticks;
+        QueryPerformanceCounter(&ticks);
+
+        return ticks.QuadPart;
+    }
+
+    LatencyHistogram* get_latency_histogram(int32_t stage)
+    {
+        return latency_histograms_ + stage;
+    }
+
+    // Records finished latency stage if socket was in the preceding state and enters the new state.
+    void AdvanceSocketLatencyState(ScSocketInfoStruct* si, uint8_t from_state, uint8_t to_state)
+    {
+        if (from_state != si->latency_state_)
+            return;
+
+        uint64_t now_ticks = GetPerfTicks();
+
+        // NOTE: Stage N ends the latency state N + 1.
+        if (LATENCY_STATE_NONE != from_state)
+            latency_histograms_[from_state - 1].Record((now_ticks - si->latency_state_ticks_) * 1000 / perf_ticks_per_ms_);
+
+        si->latency_state_ = to_state;
+        si->latency_state_ticks_ = now_ticks;
+    }
+
+    // Virtual socket (HTTP/2 stream or aggregated request) takes over received state from its connection.
+    void InheritSocketLatencyState(ScSocketInfoStruct* conn_si, ScSocketInfoStruct* si)
+    {
+        // NOTE: Connection keeps ticks of its last receive for all requests found in it.
+        if (((LATENCY_STATE_RECEIVED != conn_si->latency_state_) && (LATENCY_STATE_NONE != conn_si->latency_state_)) ||
+            (0 == conn_si->latency_state_ticks_))
+        {
+            return;
+        }
+
+        si->latency_state_ = LATENCY_STATE_RECEIVED;
+        si->latency_state_ticks_ = conn_si->latency_state_ticks_;
+
+        // Connection is stamped again on its next receive.
+        conn_si->latency_state_ = LATENCY_STATE_NONE;
+    }
+
+    // Starts traffic capture of accepted connection if capture is enabled.
+    void StartTrafficCapture(SocketDataChunkRef sd);
+
+    // Captures connection event or received bytes.
+    void CaptureTraffic(ScSocketInfoStruct* si, uint8_t type, const uint8_t* data, int32_t data_len)
+    {
+        g_gateway.get_traffic_capture()->Write(
+            worker_id_,
+            type,
+            si->capture_connection_id_,
+            g_gateway.get_server_port(si->port_index_)->get_port_number(),
+            data,
+            data_len);
+    }
+
+    // Starts a trace if current socket request is sampled.
+    void StartRequestTrace(ScSocketInfoStruct* si);
+
+    // Stamps given trace point once if socket request is traced.
+    void StampRequestTrace(ScSocketInfoStruct* si, int32_t stamp)
+    {
+        if (INVALID_TRACE_SLOT == si->trace_slot_)
+            return;
+
+        RequestTrace* trace = active_traces_ + si->trace_slot_;
+        if (0 == trace->ticks_[stamp])
+            trace->ticks_[stamp] = GetPerfTicks();
+    }
+
+    // Marks socket data for codehost trace stamps if request is traced.
+    void MarkRequestTrace(SocketDataChunkRef sd, ScSocketInfoStruct* si)
+    {
+        if ((NULL != si) && (INVALID_TRACE_SLOT != si->trace_slot_)) {
+
+            sd->set_traced_flag();
+            sd->ResetCodehostTraceTicks();
+
+            active_traces_[si->trace_slot_].db_index_ = sd->GetDestDbIndex();
+
+        } else {
+
+            sd->reset_traced_flag();
+        }
+    }
+
+    // Collects codehost trace stamps when response arrives.
+    void StampRequestTraceResponse(SocketDataChunkRef sd, scheduler_id_type sched_id);
+
+    // Moves traced request to completed traces after response was sent.
+    void FinishRequestTrace(ScSocketInfoStruct* si);
+
+    // Drops unfinished request trace.
+    void DropRequestTrace(ScSocketInfoStruct* si)
+    {
+        if (INVALID_TRACE_SLOT == si->trace_slot_)
+            return;
+
+        active_traces_[si->trace_slot_].in_use_ = false;
+        si->trace_slot_ = INVALID_TRACE_SLOT;
+    }
+
+    // Prints completed request traces as Chrome trace events.
+    void PrintRequestTraces(std::stringstream& str);
+
     // Starting accumulation.
     uint32_t StartAccumulation(SocketDataChunkRef sd, uint32_t total_desired_bytes, uint32_t num_already_accumulated)
     {
@@ -272,15 +831,21 @@ public:
             return SCERRGWMAXDATASIZEREACHED;
         }
 
+        // Any chain left from previous request is not valid anymore.
+        ReleaseBufferChain(sd->get_socket_info());
+
         // Checking if data that needs accumulation fits into chunk.
         if (sd->get_data_blob_size() < total_desired_bytes)
         {
-            uint32_t err_code = SocketDataChunk::ChangeToBigger(this, sd, total_desired_bytes);
-            if (err_code)
-                return err_code;
-        }
+            // Receiving the rest into chained segments instead of copying to a bigger chunk.
+            sd->SetAccumulatedBytesLeft(total_desired_bytes - num_already_accumulated);
+
+            // Checking if there is still space left in current chunk.
+            if (!sd->IsNetworkBufferFull())
+                return 0;
 
-        GW_ASSERT(sd->get_data_blob_size() >= total_desired_bytes);
+            return AppendBufferChainSegment(sd);
+        }
 
         // Calculating the remaining number of bytes to accumulate.
         sd->set_num_available_network_bytes(total_desired_bytes - num_already_accumulated);
@@ -288,6 +853,24 @@ public:
         return 0;
     }
 
+    // Appends new segment to request body chain and receives into it.
+    uint32_t AppendBufferChainSegment(SocketDataChunkRef sd);
+
+    // Copies given data to the end of socket request body chain.
+    uint32_t CopyToBufferChain(ScSocketInfoStruct* si, const uint8_t* data, uint32_t data_len);
+
+    // Returns all request body chain segments to chunk stores.
+    void ReleaseBufferChain(ScSocketInfoStruct* si);
+
+    // Returns given request body chain segments to chunk stores.
+    void ReleaseBufferChainSegments(SocketDataChunk* segment);
+
+    // Takes request body chain from socket without releasing it.
+    void DetachBufferChain(ScSocketInfoStruct* si);
+
+    // Copies request body chain into socket data itself.
+    uint32_t FlattenBufferChain(SocketDataChunkRef sd, bool extend_user_data);
+
     // Clone made during last iteration.
     SocketDataChunkRef get_sd_receive_clone()
     {
@@ -393,6 +976,26 @@ public:
     // Deleting inactive database.
     void DeleteInactiveDatabase(db_index_type db_index);
 
+    // Defers scheduler notifications on all databases.
+    void StartDbPushBatch()
+    {
+        for (int32_t i = 0; i < g_gateway.get_num_dbs_slots(); i++)
+        {
+            if (worker_dbs_[i])
+                worker_dbs_[i]->StartPushBatch();
+        }
+    }
+
+    // Sends deferred scheduler notifications on all databases.
+    void FinishDbPushBatch()
+    {
+        for (int32_t i = 0; i < g_gateway.get_num_dbs_slots(); i++)
+        {
+            if (worker_dbs_[i])
+                worker_dbs_[i]->FinishPushBatch();
+        }
+    }
+
     // Sends given predefined response.
     uint32_t SendPredefinedMessage(
         SocketDataChunkRef sd,
@@ -466,9 +1069,11 @@ public:
         stats_stream << "\"packetsReceived\":" << worker_stats_recv_num_ << ",";
         stats_stream << "\"bytesSent\":" << worker_stats_bytes_sent_ << ",";
         stats_stream << "\"packetsSent\":" << worker_stats_sent_num_ << ",";
-        stats_stream << "\"allocatedChunks\":\"";
+        stats_stream << "\"pausedReceives\":" << NumPausedReceives() << ",";
         worker_chunks_.PrintInfo(stats_stream);
-        stats_stream << "\"}";
+        stats_stream << ",";
+        static_files_cache_.PrintInfo(stats_stream);
+        stats_stream << "}";
     }
 
     // Worker initialization function.
@@ -516,7 +1121,9 @@ public:
 
     // Functions to process finished IOCP events.
     uint32_t FinishReceive(SocketDataChunkRef sd, int32_t numBytesReceived, bool& called_from_receive);
+    uint32_t FinishZeroByteReceive(SocketDataChunkRef sd);
     uint32_t FinishSend(SocketDataChunkRef sd, int32_t numBytesSent);
+    uint32_t FinishTransmitFile(SocketDataChunkRef sd, int32_t numBytesSent);
     uint32_t FinishDisconnect(SocketDataChunkRef sd);
     uint32_t FinishConnect(SocketDataChunkRef sd);
     uint32_t FinishAccept(SocketDataChunkRef sd);
@@ -545,8 +1152,55 @@ public:
     // Running send on socket data.
     uint32_t SendOnUdp(SocketDataChunkRef sd);
 
+    // Sends prepared response headers followed by part of static file.
+    uint32_t SendStaticFile(SocketDataChunkRef sd, StaticFileEntry* entry, uint64_t offset, uint32_t num_bytes);
+
     // Running receive on socket data.
-    uint32_t Receive(SocketDataChunkRef sd);
+    uint32_t Receive(SocketDataChunkRef sd, bool data_is_ready = false);
+
+    // Creates TLS context for just accepted socket.
+    uint32_t TlsCreateContext(SocketDataChunkRef sd, TlsPortInfo* tls_port);
+
+    // Releases TLS context and its receive buffer.
+    void TlsReleaseContext(ScSocketInfoStruct* si);
+
+    // Makes sure there is a buffer to receive ciphertext into.
+    uint32_t TlsPrepareReceive(SocketDataChunkRef sd);
+
+    // Posts delivery of already decrypted data instead of receiving from network.
+    uint32_t TlsPostPendingData(SocketDataChunkRef sd);
+
+    // Sends handshake token as is.
+    uint32_t TlsSendToken(SocketDataChunkRef sd, uint8_t* token, uint32_t token_len);
+
+    // Runs server side handshake on buffered ciphertext.
+    uint32_t TlsHandshake(SocketDataChunkRef sd);
+
+    // Processes received ciphertext and copies decrypted data into socket data network buffer.
+    uint32_t TlsFinishReceive(SocketDataChunkRef sd, int32_t num_bytes_received, int32_t* num_plain_bytes);
+
+    // Replaces data prepared for send with TLS records.
+    uint32_t TlsEncrypt(SocketDataChunkRef sd);
+
+    // Creates HTTP/2 state for connection that sent client preface.
+    uint32_t Http2CreateConnection(SocketDataChunkRef sd);
+
+    // Releases HTTP/2 connection state with all its streams.
+    void Http2ReleaseConnection(ScSocketInfoStruct* si);
+
+    // Sends codehost response on HTTP/2 stream.
+    uint32_t Http2SendResponse(SocketDataChunkRef sd);
+
+    // Resets HTTP/2 stream whose virtual socket is being disconnected.
+    void Http2CancelStream(ScSocketInfoStruct* si);
+
+    // Checks if socket should wait for data without a receive buffer.
+    bool IsZeroByteReceiveNeeded(SocketDataChunkRef sd)
+    {
+        return g_gateway.setting_zero_byte_receive() &&
+            (!sd->get_accumulating_flag()) &&
+            (0 == sd->get_accumulated_len_bytes());
+    }
 
     // Running accept on socket data.
     uint32_t Accept(SocketDataChunkRef sd);
@@ -591,8 +1245,17 @@ public:
     // Push given chunk to database queue.
     uint32_t PushSocketDataToDb(SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id, bool disable_check_for_clone);
 
+    // Packs received UDP datagram into the batch of its socket.
+    uint32_t AddToUdpBatch(SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id);
+
+    // Pushes packed UDP datagrams to codehost.
+    uint32_t PushUdpBatch(SocketDataChunkRef batch_sd);
+
+    // Pushes all pending UDP batches to codehost.
+    void PushUdpBatches();
+
     // Push given chunk to database queue.
-    uint32_t PushSocketDataFromOverflowToDb(SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id, bool* again_for_overflow);
+    uint32_t PushSocketDataFromOverflowToDb(OverflowChunk* entry, bool* again_for_overflow);
 
     // Scans all channels for any incoming chunks.
     uint32_t ScanChannels(uint32_t* next_sleep_interval_ms);
@@ -636,6 +1299,124 @@ public:
         return sockets_infos_ + socket_index;
     }
 
+    // Binds socket to given database (links it into per-database list).
+    void SetSocketDestDbIndex(socket_index_type socket_index, db_index_type db_index)
+    {
+        GW_ASSERT_DEBUG(socket_index < g_gateway.setting_max_connections_per_worker());
+
+        ScSocketInfoStruct* si = sockets_infos_ + socket_index;
+
+        // Checking if socket is already bound to this database.
+        if (db_index == si->dest_db_index_)
+            return;
+
+        UnlinkSocketFromDb(socket_index);
+
+        si->dest_db_index_ = db_index;
+
+        if (INVALID_DB_INDEX == db_index)
+            return;
+
+        GW_ASSERT((db_index >= 0) && (db_index < MAX_ACTIVE_DATABASES));
+
+        // Inserting socket at the head of the database list.
+        socket_index_type head_index = db_sockets_heads_[db_index];
+        si->db_prev_socket_index_ = INVALID_SOCKET_INDEX;
+        si->db_next_socket_index_ = head_index;
+
+        if (INVALID_SOCKET_INDEX != head_index)
+            sockets_infos_[head_index].db_prev_socket_index_ = socket_index;
+
+        db_sockets_heads_[db_index] = socket_index;
+    }
+
+    // Sets WebSocket group of the socket (links it into per-group list).
+    void SetSocketWsGroupId(socket_index_type socket_index, ws_group_id_type ws_group_id)
+    {
+        GW_ASSERT_DEBUG(socket_index < g_gateway.setting_max_connections_per_worker());
+
+        ScSocketInfoStruct* si = sockets_infos_ + socket_index;
+
+        // Checking if socket is already in this group.
+        if (ws_group_id == si->ws_group_id_)
+            return;
+
+        UnlinkSocketFromWsGroup(socket_index);
+
+        si->ws_group_id_ = ws_group_id;
+
+        if (MixedCodeConstants::INVALID_WS_CHANNEL_ID == ws_group_id)
+            return;
+
+        // Inserting socket at the head of the group list.
+        std::unordered_map<ws_group_id_type, socket_index_type>::iterator it = ws_group_heads_.find(ws_group_id);
+
+        socket_index_type head_index = INVALID_SOCKET_INDEX;
+        if (it != ws_group_heads_.end())
+            head_index = it->second;
+
+        si->ws_group_prev_socket_index_ = INVALID_SOCKET_INDEX;
+        si->ws_group_next_socket_index_ = head_index;
+
+        if (INVALID_SOCKET_INDEX != head_index)
+            sockets_infos_[head_index].ws_group_prev_socket_index_ = socket_index;
+
+        ws_group_heads_[ws_group_id] = socket_index;
+    }
+
+    // Removes socket from the list of its WebSocket group.
+    void UnlinkSocketFromWsGroup(socket_index_type socket_index)
+    {
+        ScSocketInfoStruct* si = sockets_infos_ + socket_index;
+
+        ws_group_id_type ws_group_id = si->ws_group_id_;
+        if (MixedCodeConstants::INVALID_WS_CHANNEL_ID == ws_group_id)
+            return;
+
+        if (INVALID_SOCKET_INDEX != si->ws_group_prev_socket_index_)
+        {
+            sockets_infos_[si->ws_group_prev_socket_index_].ws_group_next_socket_index_ = si->ws_group_next_socket_index_;
+        }
+        else if (INVALID_SOCKET_INDEX != si->ws_group_next_socket_index_)
+        {
+            ws_group_heads_[ws_group_id] = si->ws_group_next_socket_index_;
+        }
+        else
+        {
+            // Last socket in the group.
+            ws_group_heads_.erase(ws_group_id);
+        }
+
+        if (INVALID_SOCKET_INDEX != si->ws_group_next_socket_index_)
+            sockets_infos_[si->ws_group_next_socket_index_].ws_group_prev_socket_index_ = si->ws_group_prev_socket_index_;
+
+        si->ws_group_next_socket_index_ = INVALID_SOCKET_INDEX;
+        si->ws_group_prev_socket_index_ = INVALID_SOCKET_INDEX;
+        si->ws_group_id_ = MixedCodeConstants::INVALID_WS_CHANNEL_ID;
+    }
+
+    // Removes socket from the list of its destination database.
+    void UnlinkSocketFromDb(socket_index_type socket_index)
+    {
+        ScSocketInfoStruct* si = sockets_infos_ + socket_index;
+
+        db_index_type db_index = si->dest_db_index_;
+        if (INVALID_DB_INDEX == db_index)
+            return;
+
+        if (INVALID_SOCKET_INDEX != si->db_prev_socket_index_)
+            sockets_infos_[si->db_prev_socket_index_].db_next_socket_index_ = si->db_next_socket_index_;
+        else
+            db_sockets_heads_[db_index] = si->db_next_socket_index_;
+
+        if (INVALID_SOCKET_INDEX != si->db_next_socket_index_)
+            sockets_infos_[si->db_next_socket_index_].db_prev_socket_index_ = si->db_prev_socket_index_;
+
+        si->db_next_socket_index_ = INVALID_SOCKET_INDEX;
+        si->db_prev_socket_index_ = INVALID_SOCKET_INDEX;
+        si->dest_db_index_ = INVALID_DB_INDEX;
+    }
+
     // Setting aggregated socket flag.
     void SetSocketAggregatedFlag(socket_index_type socket_index)
     {
@@ -716,7 +1497,7 @@ public:
     // Collects outdated sockets if any.
     uint32_t CollectInactiveSockets();
 
-	// Collects outdated sockets if any.
+	// Disconnects all sockets bound to given codehost.
 	uint32_t DisonnectCodehostSockets(db_index_type db_index);
 
     // Releases socket info index.
@@ -28,6 +28,30 @@ class WorkerDbInterface
     // An array of indexes to channels, unordered.
     core::channel_number* channels_;
 
+    // Schedulers that have to be notified when push batch finishes.
+    bool* pending_notify_schedulers_;
+
+    // Number of started push batches, scheduler notifications are deferred while non-zero.
+    int32_t push_batch_depth_;
+
+    // Number of scheduler wakeups sent.
+    int64_t num_scheduler_notifies_;
+
+    // Chunks pushed to each scheduler channel that scheduler did not take yet.
+    int32_t* num_unconsumed_chunks_;
+
+    // Chunks for this database waiting in worker overflow queue.
+    int32_t num_overflow_chunks_;
+
+    // Unique number of the database this interface was created for.
+    uint64_t unique_db_num_;
+
+    // Credits of each scheduler (zero if flow control is disabled).
+    int32_t max_scheduler_credits_;
+
+    // Schedulers that ran out of credits while a receive was waiting for them.
+    bool* credits_exhausted_;
+
     // Private chunk pool.
     core::chunk_pool<core::chunk_index> private_chunk_pool_;
 
@@ -49,10 +73,17 @@ class WorkerDbInterface
     // Number of active schedulers.
     int32_t num_schedulers_;
 
-#ifndef LEAST_USED_SCHEDULING
     // Current scheduler id.
     int32_t cur_scheduler_id_;
-#endif // !LEAST_USED_SCHEDULING
+
+    // HTTP requests pushed to each scheduler that were not responded yet.
+    int32_t* num_in_flight_requests_;
+
+    // Selecting least loaded scheduler instead of round-robin.
+    bool least_loaded_scheduling_;
+
+    // Schedulers on the NUMA node of this worker (all if nodes are unknown).
+    bool* local_schedulers_;
 
     // Acquires needed amount of chunks from shared pool.
     uint32_t AcquireIPCChunksFromSharedPool(int32_t num_ipc_chunks)
@@ -92,39 +123,198 @@ public:
     // Printing the database information.
     void PrintInfo(std::stringstream& stats_stream);
 
-#ifndef LEAST_USED_SCHEDULING
-    // Round-robin scheduler number.
-    uint32_t GenerateSchedulerId()
+    // Number of schedulers in this database.
+    int32_t get_num_schedulers()
     {
-        cur_scheduler_id_++;
-        if (cur_scheduler_id_ >= num_schedulers_)
-            cur_scheduler_id_ = 0;
+        return num_schedulers_;
+    }
 
-        return cur_scheduler_id_;
+    // Number of IPC chunks available in shared pool.
+    int64_t GetNumberAvailableChunks()
+    {
+        return shared_int_.size();
     }
-#endif // !LEAST_USED_SCHEDULING
 
-#ifdef LEAST_USED_SCHEDULING
-    uint32_t GenerateSchedulerId()
+    // Number of chunks in channel queue towards the scheduler.
+    int32_t GetChannelInDepth(int32_t sched_id)
+    {
+        return shared_int_.channel(channels_[sched_id]).in.count();
+    }
+
+    // Number of chunks in channel queue from the scheduler.
+    int32_t GetChannelOutDepth(int32_t sched_id)
+    {
+        return shared_int_.channel(channels_[sched_id]).out.count();
+    }
+
+    // Number of chunks this worker can still push to the scheduler.
+    int32_t GetSchedulerCredits(int32_t sched_id)
+    {
+        // Chunks the scheduler took from the channel give credits back.
+        int32_t in_depth = GetChannelInDepth(sched_id);
+        if (in_depth < num_unconsumed_chunks_[sched_id])
+            num_unconsumed_chunks_[sched_id] = in_depth;
+
+        return max_scheduler_credits_ - num_unconsumed_chunks_[sched_id] - num_overflow_chunks_;
+    }
+
+    // Checks if data from socket bound to given scheduler can be received.
+    bool HasCredits(scheduler_id_type sched_id)
+    {
+        // Checking if flow control is disabled.
+        if (0 == max_scheduler_credits_)
+            return true;
+
+        if (sched_id < num_schedulers_)
+        {
+            if (GetSchedulerCredits(sched_id) > 0)
+                return true;
+
+            credits_exhausted_[sched_id] = true;
+
+            return false;
+        }
+
+        // Socket is not bound to a scheduler so any scheduler with credits will do.
+        for (int32_t s = 0; s < num_schedulers_; s++)
+        {
+            if (GetSchedulerCredits(s) > 0)
+                return true;
+        }
+
+        for (int32_t s = 0; s < num_schedulers_; s++)
+            credits_exhausted_[s] = true;
+
+        return false;
+    }
+
+    // Checks if any scheduler that ran out of credits got them back.
+    bool CheckCreditsReturned()
     {
-        // Selects the scheduler with the least number of tasks enqueued on the
-        // channel reserved for the current worker.
+        bool credits_returned = false;
 
-        int32_t least_used_queue_length = INT32_MAX;
-        int32_t sched_id = 0;
         for (int32_t s = 0; s < num_schedulers_; s++)
         {
-            core::channel_type& the_channel = shared_int_.channel(channels_[s]);
-            int32_t queue_length = the_channel.in.count();
-            if (queue_length < least_used_queue_length)
+            if (credits_exhausted_[s] && (GetSchedulerCredits(s) > 0))
             {
-              least_used_queue_length = queue_length;
-              sched_id = s;
+                credits_exhausted_[s] = false;
+                credits_returned = true;
             }
         }
-        return (uint32_t)sched_id;
+
+        return credits_returned;
+    }
+
+    // Accounts chunk put to worker overflow queue.
+    void AddOverflowChunk()
+    {
+        num_overflow_chunks_++;
+    }
+
+    // Accounts chunk taken from worker overflow queue.
+    void RemoveOverflowChunk()
+    {
+        GW_ASSERT(num_overflow_chunks_ > 0);
+
+        num_overflow_chunks_--;
+    }
+
+    // Gets unique number of the database this interface was created for.
+    uint64_t get_unique_db_num()
+    {
+        return unique_db_num_;
+    }
+
+    // Load of the scheduler as seen by this worker.
+    int32_t GetSchedulerLoad(int32_t sched_id)
+    {
+        core::channel_type& the_channel = shared_int_.channel(channels_[sched_id]);
+
+        // Queued requests are part of in-flight ones, so taking the bigger of the two.
+        int32_t load = the_channel.in.count();
+        if (num_in_flight_requests_[sched_id] > load)
+            load = num_in_flight_requests_[sched_id];
+
+        // Responses not yet taken by this worker.
+        return load + the_channel.out.count();
+    }
+
+    // Finds least loaded scheduler starting from current one, optionally only on worker NUMA node.
+    int32_t FindLeastLoadedScheduler(bool only_local)
+    {
+        int32_t sched_id = -1;
+        int32_t least_load = INT32_MAX;
+
+        for (int32_t i = 0; (i < num_schedulers_) && (least_load > 0); i++)
+        {
+            int32_t s = cur_scheduler_id_ + i;
+            if (s >= num_schedulers_)
+                s -= num_schedulers_;
+
+            if (only_local && !local_schedulers_[s])
+                continue;
+
+            int32_t load = GetSchedulerLoad(s);
+            if (load < least_load)
+            {
+                least_load = load;
+                sched_id = s;
+            }
+        }
+
+        return sched_id;
+    }
+
+    // Selects scheduler for new connection or session.
+    uint32_t GenerateSchedulerId()
+    {
+        // Round-robin start also breaks ties between equally loaded schedulers.
+        cur_scheduler_id_++;
+        if (cur_scheduler_id_ >= num_schedulers_)
+            cur_scheduler_id_ = 0;
+
+        if (!least_loaded_scheduling_)
+        {
+            // Skipping schedulers on other NUMA nodes.
+            for (int32_t i = 0; i < num_schedulers_; i++)
+            {
+                if (local_schedulers_[cur_scheduler_id_])
+                    break;
+
+                cur_scheduler_id_++;
+                if (cur_scheduler_id_ >= num_schedulers_)
+                    cur_scheduler_id_ = 0;
+            }
+
+            return cur_scheduler_id_;
+        }
+
+        int32_t sched_id = FindLeastLoadedScheduler(true);
+
+        // Going to other NUMA nodes only when local schedulers are out of credits.
+        if ((sched_id < 0) || ((0 != max_scheduler_credits_) && (GetSchedulerCredits(sched_id) <= 0)))
+        {
+            int32_t any_sched_id = FindLeastLoadedScheduler(false);
+            if (any_sched_id >= 0)
+                sched_id = any_sched_id;
+        }
+
+        return sched_id;
+    }
+
+    // Accounts HTTP request pushed to scheduler.
+    void AddInFlightRequest(int32_t sched_id)
+    {
+        num_in_flight_requests_[sched_id]++;
+    }
+
+    // Accounts response popped from scheduler.
+    void RemoveInFlightRequest(int32_t sched_id)
+    {
+        // NOTE: Codehost can also send data without a request.
+        if (num_in_flight_requests_[sched_id] > 0)
+            num_in_flight_requests_[sched_id]--;
     }
-#endif // LEAST_USED_SCHEDULING
 
     // Getting shared interface.
     core::shared_interface* get_shared_int()
@@ -142,15 +332,91 @@ public:
         worker_id_ = INVALID_WORKER_INDEX;
 
         num_schedulers_ = 0;
-#ifndef LEAST_USED_SCHEDULING
         cur_scheduler_id_ = 0;
-#endif // !LEAST_USED_SCHEDULING
 
         if (channels_)
         {
             GwDeleteArray(channels_);
             channels_ = NULL;
         }
+
+        if (pending_notify_schedulers_)
+        {
+            GwDeleteArray(pending_notify_schedulers_);
+            pending_notify_schedulers_ = NULL;
+        }
+
+        if (num_unconsumed_chunks_)
+        {
+            GwDeleteArray(num_unconsumed_chunks_);
+            num_unconsumed_chunks_ = NULL;
+        }
+
+        if (num_in_flight_requests_)
+        {
+            GwDeleteArray(num_in_flight_requests_);
+            num_in_flight_requests_ = NULL;
+        }
+
+        if (credits_exhausted_)
+        {
+            GwDeleteArray(credits_exhausted_);
+            credits_exhausted_ = NULL;
+        }
+
+        if (local_schedulers_)
+        {
+            GwDeleteArray(local_schedulers_);
+            local_schedulers_ = NULL;
+        }
+
+        push_batch_depth_ = 0;
+        num_scheduler_notifies_ = 0;
+        num_overflow_chunks_ = 0;
+        unique_db_num_ = INVALID_UNIQUE_DB_NUMBER;
+    }
+
+    // Wakes up the scheduler or, during a push batch, marks it for wakeup.
+    void NotifyScheduler(int32_t sched_id)
+    {
+        if (push_batch_depth_ > 0)
+        {
+            pending_notify_schedulers_[sched_id] = true;
+            return;
+        }
+
+        core::channel_type& the_channel = shared_int_.channel(channels_[sched_id]);
+        the_channel.scheduler()->notify(shared_int_.scheduler_work_event
+            (the_channel.get_scheduler_number()));
+
+        num_scheduler_notifies_++;
+    }
+
+    // Starts deferring scheduler notifications.
+    // NOTE: Batches can be nested, notifications are sent when the outermost one finishes.
+    void StartPushBatch()
+    {
+        push_batch_depth_++;
+    }
+
+    // Notifies each scheduler that got or gave chunks during the batch once.
+    void FinishPushBatch()
+    {
+        // NOTE: Interface could be created in the middle of a batch.
+        if (push_batch_depth_ > 0)
+            push_batch_depth_--;
+
+        if (push_batch_depth_ > 0)
+            return;
+
+        for (int32_t s = 0; s < num_schedulers_; s++)
+        {
+            if (pending_notify_schedulers_[s])
+            {
+                pending_notify_schedulers_[s] = false;
+                NotifyScheduler(s);
+            }
+        }
     }
 
     // Allocates different channels and pools.
@@ -164,6 +430,21 @@ public:
         // Deleting channels.
         GwDeleteArray(channels_);
         channels_ = NULL;
+
+        GwDeleteArray(pending_notify_schedulers_);
+        pending_notify_schedulers_ = NULL;
+
+        GwDeleteArray(num_unconsumed_chunks_);
+        num_unconsumed_chunks_ = NULL;
+
+        GwDeleteArray(num_in_flight_requests_);
+        num_in_flight_requests_ = NULL;
+
+        GwDeleteArray(credits_exhausted_);
+        credits_exhausted_ = NULL;
+
+        GwDeleteArray(local_schedulers_);
+        local_schedulers_ = NULL;
     }
 
     // Tries pushing to channel and returns try if it did.
@@ -176,10 +457,11 @@ public:
         {
             // Successfully pushed the response message to the channel.
 
-            // A message on channel ch was received. Notify the database
-            // that the out queue in this channel is not full.
-            the_channel.scheduler()->notify(shared_int_.scheduler_work_event
-                (the_channel.get_scheduler_number()));
+            // Chunk takes one scheduler credit until scheduler takes it.
+            num_unconsumed_chunks_[the_channel.get_scheduler_number()]++;
+
+            // Notification is sent once when push batch finishes.
+            NotifyScheduler(the_channel.get_scheduler_number());
 
 #ifdef GW_CHUNKS_DIAG
             GW_PRINT_WORKER_DB << "   successfully pushed: chunk " << the_chunk_index << GW_ENDL;
@@ -197,7 +479,13 @@ public:
         int16_t scheduler_id,
         bool is_gateway_no_ipc_test);
 
-    uint32_t PushSocketDataToDb(GatewayWorker* gw, SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id, bool disable_check_for_clone);
+    uint32_t PushSocketDataToDb(
+        GatewayWorker* gw,
+        SocketDataChunkRef sd,
+        BMX_HANDLER_TYPE handler_id,
+        bool disable_check_for_clone,
+        SocketDataChunk* body_chain_head,
+        uint32_t body_chain_len_bytes);
 
     // Releases chunks from private chunk pool to the shared chunk pool.
     uint32_t ReleaseToSharedChunkPool(int32_t num_ipc_chunks);
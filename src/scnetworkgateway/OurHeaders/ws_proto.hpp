@@ -340,6 +340,146 @@ public:
     }
 };
 
+// Broadcast chunk from codehost has SOCKET_DATA_FLAGS_WS_BROADCAST flag and group id in parameters data.
+// When group id is INVALID_WS_CHANNEL_ID, user data starts with [int32 number of targets][targets].
+struct WsBroadcastTarget
+{
+    random_salt_type unique_socket_id_;
+    socket_index_type socket_info_index_;
+    worker_id_type worker_id_;
+    uint8_t pad_[3];
+};
+
+const int32_t WsBroadcastTargetSizeBytes = sizeof(WsBroadcastTarget);
+
+// WebSocket frame shared by all sends of one broadcast.
+class WsBroadcastBuffer
+{
+    // Number of workers and pending sends using this buffer.
+    volatile LONG num_refs_;
+
+    // Complete WebSocket frame.
+    uint8_t* frame_;
+    uint32_t frame_len_;
+
+    // Destination group (INVALID_WS_CHANNEL_ID when explicit targets are given).
+    ws_group_id_type group_id_;
+
+    // Explicit destination sockets.
+    WsBroadcastTarget* targets_;
+    int32_t num_targets_;
+
+public:
+
+    WsBroadcastBuffer()
+    {
+        num_refs_ = 1;
+        frame_ = NULL;
+        frame_len_ = 0;
+        group_id_ = MixedCodeConstants::INVALID_WS_CHANNEL_ID;
+        targets_ = NULL;
+        num_targets_ = 0;
+    }
+
+    // Copies frame header with payload and destination sockets.
+    void Init(
+        ws_group_id_type group_id,
+        const uint8_t* frame_header,
+        uint32_t frame_header_len,
+        const uint8_t* payload,
+        uint32_t payload_len,
+        const WsBroadcastTarget* targets,
+        int32_t num_targets)
+    {
+        group_id_ = group_id;
+
+        frame_len_ = frame_header_len + payload_len;
+        frame_ = GwNewArray(uint8_t, frame_len_);
+        memcpy(frame_, frame_header, frame_header_len);
+        memcpy(frame_ + frame_header_len, payload, payload_len);
+
+        num_targets_ = num_targets;
+
+        if (num_targets > 0)
+        {
+            targets_ = GwNewArray(WsBroadcastTarget, num_targets);
+            memcpy(targets_, targets, num_targets * WsBroadcastTargetSizeBytes);
+        }
+    }
+
+    ~WsBroadcastBuffer()
+    {
+        if (NULL != frame_)
+        {
+            GwDeleteArray(frame_);
+            frame_ = NULL;
+        }
+
+        if (NULL != targets_)
+        {
+            GwDeleteArray(targets_);
+            targets_ = NULL;
+        }
+    }
+
+    void AddRef()
+    {
+        InterlockedIncrement(&num_refs_);
+    }
+
+    // Returns true when buffer is not used anymore.
+    bool Release()
+    {
+        return (0 == InterlockedDecrement(&num_refs_));
+    }
+
+    uint8_t* get_frame()
+    {
+        return frame_;
+    }
+
+    uint32_t get_frame_len()
+    {
+        return frame_len_;
+    }
+
+    ws_group_id_type get_group_id()
+    {
+        return group_id_;
+    }
+
+    WsBroadcastTarget* get_targets()
+    {
+        return targets_;
+    }
+
+    int32_t get_num_targets()
+    {
+        return num_targets_;
+    }
+};
+
+_declspec(align(MEMORY_ALLOCATION_ALIGNMENT)) class WsBroadcastTask
+{
+    // NOTE: Lock-free SLIST_ENTRY should be the first field!
+    SLIST_ENTRY lockfree_entry_;
+
+    // Broadcast to be sent from receiving worker.
+    WsBroadcastBuffer* buffer_;
+
+public:
+
+    void Init(WsBroadcastBuffer* buffer)
+    {
+        buffer_ = buffer;
+    }
+
+    WsBroadcastBuffer* get_buffer()
+    {
+        return buffer_;
+    }
+};
+
 } // namespace network
 } // namespace starcounter
 
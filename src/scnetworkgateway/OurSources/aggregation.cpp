@@ -2,6 +2,8 @@
 #include "gateway.hpp"
 #include "handlers.hpp"
 #include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
 #include "http_proto.hpp"
 #include "socket_data.hpp"
 #include "worker_db_interface.hpp"
@@ -10,6 +12,331 @@
 namespace starcounter {
 namespace network {
 
+// Writes v2 varint and returns number of written bytes.
+int32_t AggregationV2WriteVarint(uint8_t* dest, uint32_t value)
+{
+    int32_t num_bytes = 0;
+
+    while (value >= 0x80)
+    {
+        dest[num_bytes++] = (uint8_t) ((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+
+    dest[num_bytes++] = (uint8_t) value;
+
+    return num_bytes;
+}
+
+// Reads v2 varint, returns false if more data is needed.
+bool AggregationV2ReadVarint(const uint8_t** pos, const uint8_t* end, uint32_t* value, bool* malformed)
+{
+    const uint8_t* p = *pos;
+    uint32_t v = 0;
+
+    for (int32_t i = 0; i < AggregationV2MaxVarintBytes; i++)
+    {
+        if (p >= end)
+            return false;
+
+        uint8_t b = *p;
+        p++;
+
+        v |= (uint32_t) (b & 0x7F) << (7 * i);
+
+        if (0 == (b & 0x80))
+        {
+            *value = v;
+            *pos = p;
+
+            return true;
+        }
+    }
+
+    *malformed = true;
+
+    return false;
+}
+
+// Writes v2 message header and returns its size.
+int32_t AggregationV2WriteMessageHeader(
+    uint8_t* dest,
+    MixedCodeConstants::AggregationMessageTypes msg_type,
+    uint8_t msg_flags,
+    uint32_t handle,
+    uint32_t aggr_index,
+    uint32_t size_bytes)
+{
+    int32_t num_bytes = 0;
+
+    dest[num_bytes++] = (uint8_t) (msg_type | (msg_flags << 2));
+    num_bytes += AggregationV2WriteVarint(dest + num_bytes, handle);
+    num_bytes += AggregationV2WriteVarint(dest + num_bytes, aggr_index);
+    num_bytes += AggregationV2WriteVarint(dest + num_bytes, size_bytes);
+
+    return num_bytes;
+}
+
+// Passes one aggregated request to handlers.
+uint32_t DispatchAggregatedData(
+    GatewayWorker *gw,
+    SocketDataChunkRef aggr_sd,
+    socket_index_type socket_index,
+    random_salt_type unique_socket_id,
+    int32_t unique_aggr_index,
+    uint8_t msg_flags,
+    uint8_t* data,
+    int32_t data_len)
+{
+    SocketDataChunk* new_sd = NULL;
+
+    // Cloning chunk to push it to database.
+    uint32_t err_code = aggr_sd->CreateSocketDataFromBigBuffer(gw, socket_index, data_len, data, &new_sd);
+    if (err_code)
+        return err_code;
+
+    // Applying special parameters to socket data.
+    gw->ApplySocketInfoToSocketData(new_sd, socket_index, unique_socket_id);
+
+    // Setting this aggregation socket.
+    gw->SetAggregationSocketInfo(
+        socket_index,
+        aggr_sd->get_socket_info_index(),
+        aggr_sd->get_unique_socket_id());
+
+    // Setting aggregation socket.
+    new_sd->set_unique_aggr_index(unique_aggr_index);
+    new_sd->set_aggregated_flag();
+
+    // FIXME: Obtaining the aggregation socket client IP instead of real client-client IP.
+    new_sd->set_client_ip_info(aggr_sd->get_client_ip_info());
+
+    // Changing accumulative buffer accordingly.
+    new_sd->SetAccumulation(data_len);
+
+    // Checking if its a no IPC test.
+    switch ((MixedCodeConstants::AggregationMessageFlags) msg_flags) {
+
+        case MixedCodeConstants::AggregationMessageFlags::AGGR_MSG_GATEWAY_NO_IPC:
+            new_sd->set_gateway_no_ipc_test_flag();
+            break;
+
+        case MixedCodeConstants::AggregationMessageFlags::AGGR_MSG_GATEWAY_AND_IPC:
+            new_sd->set_gateway_and_ipc_test_flag();
+            break;
+
+        case MixedCodeConstants::AggregationMessageFlags::AGGR_MSG_GATEWAY_NO_IPC_NO_CHUNKS:
+            new_sd->set_gateway_no_ipc_no_chunks_test_flag();
+            break;
+    }
+
+    g_gateway.num_aggregated_recv_messages_++;
+
+    // Measuring request latency on the virtual socket.
+    gw->InheritSocketLatencyState(aggr_sd->get_socket_info(), gw->GetSocketInfoReference(socket_index));
+
+    // Running handler.
+    err_code = gw->RunReceiveHandlers(new_sd);
+
+    if (err_code) {
+
+        // Releasing the cloned chunk.
+        if (NULL != new_sd)
+            gw->ReturnSocketDataChunksToPool(new_sd);
+
+        return err_code;
+    }
+
+    return 0;
+}
+
+// Creates aggregated socket for given port.
+socket_index_type CreateAggregatedSocket(GatewayWorker *gw, uint16_t port_num)
+{
+    // Getting port handler.
+    port_index_type port_index = g_gateway.FindServerPortIndex(port_num);
+    if (INVALID_PORT_INDEX == port_index)
+        return INVALID_SOCKET_INDEX;
+
+    // Getting new socket index.
+    socket_index_type socket_index = gw->ObtainFreeSocketIndex(
+        INVALID_SOCKET,
+        port_index,
+        MixedCodeConstants::NetworkProtocolType::PROTOCOL_UNKNOWN,
+        false);
+
+    // Checking if we can't obtain new socket index.
+    if (INVALID_SOCKET_INDEX == socket_index)
+        return INVALID_SOCKET_INDEX;
+
+    // Setting some socket options.
+    gw->SetSocketAggregatedFlag(socket_index);
+
+    return socket_index;
+}
+
+// Processes batches of aggregation wire format v2.
+uint32_t PortAggregatorV2(GatewayWorker *gw, SocketDataChunkRef aggr_sd)
+{
+    uint32_t err_code;
+
+    AggregationV2Connection* conn = aggr_sd->get_socket_info()->aggr_v2_connection_;
+    uint8_t* orig_data_ptr = aggr_sd->get_data_blob_start();
+    uint32_t num_accum_bytes = aggr_sd->get_accumulated_len_bytes(), num_processed_bytes = 0;
+
+    while (num_processed_bytes < num_accum_bytes)
+    {
+        const uint8_t* cur_data_ptr = orig_data_ptr + num_processed_bytes;
+        const uint8_t* end_data_ptr = orig_data_ptr + num_accum_bytes;
+
+        // Reading batch header.
+        uint32_t batch_len, num_messages;
+        bool malformed = false;
+
+        const uint8_t* pos = cur_data_ptr;
+        if ((!AggregationV2ReadVarint(&pos, end_data_ptr, &batch_len, &malformed)) ||
+            (!AggregationV2ReadVarint(&pos, end_data_ptr, &num_messages, &malformed)))
+        {
+            if (malformed)
+                return SCERRGWWRONGHTTPDATA;
+
+            // Waiting for the rest of the header.
+            aggr_sd->MoveDataToTopAndContinueReceive((uint8_t*) cur_data_ptr, num_accum_bytes - num_processed_bytes);
+            return gw->Receive(aggr_sd);
+        }
+
+        uint32_t batch_header_len = static_cast<uint32_t>(pos - cur_data_ptr);
+
+        if (batch_len > static_cast<uint32_t>(MAX_SOCKET_DATA_SIZE - AggregationV2BatchHeaderMaxBytes))
+            return SCERRGWMAXCHUNKSIZEREACHED;
+
+        // Checking if whole batch is received.
+        if (num_processed_bytes + batch_header_len + batch_len > num_accum_bytes)
+        {
+            aggr_sd->MoveDataToTopAndContinueReceive((uint8_t*) cur_data_ptr, num_accum_bytes - num_processed_bytes);
+
+            // Checking if batch fits into current chunk.
+            if (batch_header_len + batch_len > aggr_sd->get_data_blob_size())
+            {
+                err_code = SocketDataChunk::ChangeToBigger(gw, aggr_sd, batch_header_len + batch_len);
+                if (err_code)
+                    return err_code;
+            }
+
+            return gw->Receive(aggr_sd);
+        }
+
+        const uint8_t* batch_end = pos + batch_len;
+
+        // Deferring scheduler notifications until whole batch is pushed.
+        gw->StartDbPushBatch();
+
+        for (uint32_t m = 0; m < num_messages; m++)
+        {
+            uint32_t handle, aggr_index, size_bytes;
+
+            if (pos >= batch_end)
+            {
+                malformed = true;
+                break;
+            }
+
+            uint8_t msg_type = *pos & 0x03;
+            uint8_t msg_flags = *pos >> 2;
+            pos++;
+
+            if ((!AggregationV2ReadVarint(&pos, batch_end, &handle, &malformed)) ||
+                (!AggregationV2ReadVarint(&pos, batch_end, &aggr_index, &malformed)) ||
+                (!AggregationV2ReadVarint(&pos, batch_end, &size_bytes, &malformed)) ||
+                (size_bytes > static_cast<uint32_t>(batch_end - pos)))
+            {
+                malformed = true;
+                break;
+            }
+
+            uint8_t* payload = (uint8_t*) pos;
+            pos += size_bytes;
+
+            switch (msg_type)
+            {
+                case MixedCodeConstants::AGGR_CREATE_SOCKET:
+                {
+                    uint32_t new_handle = 0;
+
+                    // NOTE: Aggregation index carries port number.
+                    socket_index_type socket_index = CreateAggregatedSocket(gw, static_cast<uint16_t>(aggr_index));
+                    if (INVALID_SOCKET_INDEX != socket_index)
+                    {
+                        new_handle = conn->AddSocket(socket_index, gw->GetUniqueSocketId(socket_index));
+                        gw->GetSocketInfoReference(socket_index)->aggr_v2_handle_ = new_handle;
+                    }
+
+                    uint8_t reply[AggregationV2MessageHeaderMaxBytes];
+                    int32_t reply_len = AggregationV2WriteMessageHeader(reply, MixedCodeConstants::AGGR_CREATE_SOCKET, 0, new_handle, aggr_index, 0);
+
+                    // Sending data on aggregation socket.
+                    err_code = gw->SendOnAggregationSocket(
+                        aggr_sd->get_socket_info_index(),
+                        aggr_sd->get_unique_socket_id(),
+                        reply,
+                        reply_len);
+
+                    break;
+                }
+
+                case MixedCodeConstants::AGGR_DESTROY_SOCKET:
+                {
+                    socket_index_type socket_index;
+                    random_salt_type unique_socket_id;
+
+                    if (conn->GetSocket(handle, &socket_index, &unique_socket_id))
+                    {
+                        // Checking if socket is legitimate.
+                        if (gw->CompareUniqueSocketId(socket_index, unique_socket_id))
+                            gw->ReleaseSocketIndex(socket_index);
+
+                        conn->RemoveSocket(handle);
+                    }
+
+                    break;
+                }
+
+                case MixedCodeConstants::AGGR_DATA:
+                {
+                    socket_index_type socket_index;
+                    random_salt_type unique_socket_id;
+
+                    // NOTE: Requests on unknown or outdated handles are dropped.
+                    if ((!conn->GetSocket(handle, &socket_index, &unique_socket_id)) ||
+                        (!gw->CompareUniqueSocketId(socket_index, unique_socket_id)))
+                    {
+                        break;
+                    }
+
+                    DispatchAggregatedData(gw, aggr_sd, socket_index, unique_socket_id, aggr_index, msg_flags, payload, size_bytes);
+
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+
+        // Notifying schedulers once per batch.
+        gw->FinishDbPushBatch();
+
+        if (malformed)
+            return SCERRGWWRONGHTTPDATA;
+
+        num_processed_bytes += batch_header_len + batch_len;
+    }
+
+    // Returning socket to original receiving state.
+    aggr_sd->ResetAccumBuffer();
+    return gw->Receive(aggr_sd);
+}
+
 // Aggregation on gateway.
 uint32_t PortAggregator(
     HandlersList* hl,
@@ -19,13 +346,16 @@ uint32_t PortAggregator(
 {
     uint32_t err_code;
 
-    SocketDataChunk* new_sd = NULL;
     uint8_t* orig_data_ptr = aggr_sd->get_data_blob_start();
     int32_t num_accum_bytes = aggr_sd->get_accumulated_len_bytes(), num_processed_bytes = 0;
     AggregationStruct* ags;
 
     socket_index_type aggr_socket_info_index = aggr_sd->get_socket_info_index();
 
+    // Checking if connection switched to wire format v2.
+    if (NULL != aggr_sd->get_socket_info()->aggr_v2_connection_)
+        return PortAggregatorV2(gw, aggr_sd);
+
     while (num_processed_bytes < num_accum_bytes)
     {
         // Processing current frame.
@@ -54,13 +384,8 @@ uint32_t PortAggregator(
         {
             case MixedCodeConstants::AGGR_CREATE_SOCKET:
             {
-                uint16_t port_num = ags->port_number_;
-
-                // Getting port handler.
-                port_index_type port_index = g_gateway.FindServerPortIndex(port_num);
-
                 // Checking if port exists.
-                if ((0 != ags->size_bytes_) || (INVALID_PORT_INDEX == port_index)) {
+                if ((0 != ags->size_bytes_) || (INVALID_PORT_INDEX == g_gateway.FindServerPortIndex(ags->port_number_))) {
 
                     // Nullifying the aggregation structure.
                     memset(ags, 0, sizeof(AggregationStruct));
@@ -78,11 +403,7 @@ uint32_t PortAggregator(
                 }
                 
                 // Getting new socket index.
-                ags->socket_info_index_ = gw->ObtainFreeSocketIndex(
-                    INVALID_SOCKET,
-                    port_index,
-                    MixedCodeConstants::NetworkProtocolType::PROTOCOL_UNKNOWN,
-                    false);
+                ags->socket_info_index_ = CreateAggregatedSocket(gw, ags->port_number_);
 
                 // Checking if we can't obtain new socket index.
                 if (INVALID_SOCKET_INDEX == (ags->socket_info_index_)) {
@@ -94,8 +415,16 @@ uint32_t PortAggregator(
                 // Getting unique socket id.
                 ags->unique_socket_id_ = gw->GetUniqueSocketId(ags->socket_info_index_);
 
-                // Setting some socket options.
-                gw->SetSocketAggregatedFlag(ags->socket_info_index_);
+                // Checking if client asks for wire format v2.
+                AggregationV2Connection* conn = NULL;
+                if (MixedCodeConstants::AggregationMessageFlags::AGGR_MSG_WIRE_FORMAT_V2 == ags->msg_flags_) {
+
+                    conn = GwNewConstructor(AggregationV2Connection);
+
+                    // NOTE: Non-zero handle in reply confirms the switch.
+                    ags->unique_aggr_index_ = conn->AddSocket(ags->socket_info_index_, ags->unique_socket_id_);
+                    gw->GetSocketInfoReference(ags->socket_info_index_)->aggr_v2_handle_ = ags->unique_aggr_index_;
+                }
 
                 // Sending data on aggregation socket.
                 err_code = gw->SendOnAggregationSocket(
@@ -105,10 +434,35 @@ uint32_t PortAggregator(
                     AggregationStructSizeBytes);
 
                 if (err_code) {
+
+                    if (NULL != conn)
+                        GwDeleteSingle(conn);
+
                     // NOTE: If problems obtaining chunk, breaking the whole aggregated receive.
                     break;
                 }
 
+                if (NULL != conn) {
+
+                    // Sending the reply in old format before any v2 batch.
+                    SocketDataChunk* reply_sd = gw->FindAggregationSd(aggr_sd->get_socket_info_index(), aggr_sd->get_unique_socket_id());
+                    if (NULL != reply_sd) {
+
+                        err_code = gw->SendAggregationSd(reply_sd);
+                        if (err_code) {
+                            GwDeleteSingle(conn);
+                            return err_code;
+                        }
+                    }
+
+                    // From now on everything on this connection is in v2.
+                    aggr_sd->get_socket_info()->aggr_v2_connection_ = conn;
+
+                    // Processing the rest of received data as v2 batches.
+                    aggr_sd->MoveDataToTopAndContinueReceive(orig_data_ptr + num_processed_bytes, num_accum_bytes - num_processed_bytes);
+                    return PortAggregatorV2(gw, aggr_sd);
+                }
+
                 break;
             }
 
@@ -148,67 +502,20 @@ uint32_t PortAggregator(
                     break;
                 }
 
-                // Cloning chunk to push it to database.
-                err_code = aggr_sd->CreateSocketDataFromBigBuffer(gw, ags->socket_info_index_, ags->size_bytes_, orig_data_ptr + num_processed_bytes, &new_sd);
+                // NOTE: If problems obtaining chunk, breaking the whole aggregated receive.
+                DispatchAggregatedData(
+                    gw,
+                    aggr_sd,
+                    ags->socket_info_index_,
+                    ags->unique_socket_id_,
+                    ags->unique_aggr_index_,
+                    ags->msg_flags_,
+                    orig_data_ptr + num_processed_bytes,
+                    ags->size_bytes_);
 
                 // Payload size has been checked, so we can add payload as processed.
                 num_processed_bytes += static_cast<uint32_t>(ags->size_bytes_);
 
-                if (err_code) {
-                    // NOTE: If problems obtaining chunk, breaking the whole aggregated receive.
-                    break;
-                }
-
-                // Applying special parameters to socket data.
-                gw->ApplySocketInfoToSocketData(new_sd, ags->socket_info_index_, ags->unique_socket_id_);
-
-                // Setting this aggregation socket.
-                gw->SetAggregationSocketInfo(
-                    ags->socket_info_index_,
-                    aggr_sd->get_socket_info_index(),
-                    aggr_sd->get_unique_socket_id());
-
-                // Setting aggregation socket.
-                new_sd->set_unique_aggr_index(ags->unique_aggr_index_);
-                new_sd->set_aggregated_flag();
-
-                // FIXME: Obtaining the aggregation socket client IP instead of real client-client IP.
-                new_sd->set_client_ip_info(aggr_sd->get_client_ip_info());
-
-                // Changing accumulative buffer accordingly.
-                new_sd->SetAccumulation(ags->size_bytes_);
-
-                // Checking if its a no IPC test.
-                switch ((MixedCodeConstants::AggregationMessageFlags) ags->msg_flags_) {
-
-                    case MixedCodeConstants::AggregationMessageFlags::AGGR_MSG_GATEWAY_NO_IPC:
-                        new_sd->set_gateway_no_ipc_test_flag();
-                        break;
-
-                    case MixedCodeConstants::AggregationMessageFlags::AGGR_MSG_GATEWAY_AND_IPC:
-                        new_sd->set_gateway_and_ipc_test_flag();
-                        break;
-
-                    case MixedCodeConstants::AggregationMessageFlags::AGGR_MSG_GATEWAY_NO_IPC_NO_CHUNKS:
-                        new_sd->set_gateway_no_ipc_no_chunks_test_flag();
-                        break;
-                }
-
-                g_gateway.num_aggregated_recv_messages_++;
-
-                // Running handler.
-                err_code = gw->RunReceiveHandlers(new_sd);
-
-                if (err_code) {
-
-                    // Releasing the cloned chunk.
-                    if (NULL != new_sd)
-                        gw->ReturnSocketDataChunksToPool(new_sd);
-
-                    // NOTE: If problems obtaining chunk, breaking the whole aggregated receive.
-                    break;
-                }
-
                 break;
             }
 
@@ -227,27 +534,75 @@ uint32_t GatewayWorker::SendAggregatedChunks()
 {
     uint32_t err_code;
 
-    for (int32_t i = 0; i < aggr_sds_to_send_.get_num_entries(); i++)
+    while (!aggr_sds_to_send_.IsEmpty())
     {
-        SocketDataChunk* aggr_sd = aggr_sds_to_send_[i];
-
-        // Removing this aggregation socket data from list.
-        aggr_sds_to_send_.RemoveByIndex(i);
-
-        // Reverting accumulating buffer before send.
-        aggr_sd->RevertBeforeSend();
+        SocketDataChunk* aggr_sd = aggr_sds_to_send_[0];
 
         // Sending it.
-        err_code = Send(aggr_sd);
+        err_code = SendAggregationSd(aggr_sd);
         if (err_code)
             return err_code;
+    }
+
+    return 0;
+}
+
+// Removes aggregation socket data from the buffered list and sends it.
+uint32_t GatewayWorker::SendAggregationSd(SocketDataChunkRef aggr_sd)
+{
+    // Removing this aggregation socket data from list.
+    aggr_sds_to_send_.RemoveEntry(aggr_sd);
+
+    // Reverting accumulating buffer before send.
+    aggr_sd->RevertBeforeSend();
+
+    AggregationV2Connection* conn = aggr_sd->get_socket_info()->aggr_v2_connection_;
+    if (NULL != conn) {
+
+        // Writing batch header right before the first message.
+        uint8_t batch_header[AggregationV2BatchHeaderMaxBytes];
+        uint32_t batch_len = aggr_sd->get_num_available_network_bytes() - AggregationV2BatchHeaderMaxBytes;
+
+        int32_t batch_header_len = AggregationV2WriteVarint(batch_header, batch_len);
+        batch_header_len += AggregationV2WriteVarint(batch_header + batch_header_len, conn->get_num_batch_messages());
+
+        uint8_t* batch_start = aggr_sd->get_data_blob_start() + AggregationV2BatchHeaderMaxBytes - batch_header_len;
+        memcpy(batch_start, batch_header, batch_header_len);
 
-        GW_ASSERT(NULL == aggr_sd);
+        aggr_sd->SetNetworkBuffer(batch_start, batch_len + batch_header_len);
+        conn->set_num_batch_messages(0);
     }
 
+    // Sending it.
+    uint32_t err_code = Send(aggr_sd);
+    if (err_code)
+        return err_code;
+
+    GW_ASSERT(NULL == aggr_sd);
+
     return 0;
 }
 
+// Sends buffered aggregated messages when worker is idle or coalescing delay expired.
+void GatewayWorker::FlushAggregatedChunks(bool worker_idle, uint32_t* next_sleep_interval_ms)
+{
+    uint64_t now_ticks = GetPerfTicks();
+
+    // Nothing else to coalesce with, or messages waited long enough.
+    if (worker_idle || (now_ticks >= aggr_flush_deadline_ticks_))
+    {
+        // NOTE: Do nothing about error codes.
+        SendAggregatedChunks();
+
+        return;
+    }
+
+    // Waking up not later than the deadline (rounding up to whole milliseconds).
+    uint64_t wait_ms = (aggr_flush_deadline_ticks_ - now_ticks + perf_ticks_per_ms_ - 1) / perf_ticks_per_ms_;
+    if (wait_ms < *next_sleep_interval_ms)
+        *next_sleep_interval_ms = static_cast<uint32_t>(wait_ms);
+}
+
 // Tries to find current aggregation socket data from aggregation socket index.
 SocketDataChunk* GatewayWorker::FindAggregationSd(
     socket_index_type aggr_socket_info_index,
@@ -274,18 +629,40 @@ uint32_t GatewayWorker::SendOnAggregationSocket(SocketDataChunkRef sd, MixedCode
     // NOTE: Since we are sending, we need to get number of available bytes instead of user data length.
     int32_t data_len_bytes = sd->get_num_available_network_bytes();
 
-    uint32_t total_num_bytes = data_len_bytes + AggregationStructSizeBytes;
+    uint32_t err_code;
+
+    // Checking if aggregation connection uses wire format v2.
+    if (NULL != GetSocketInfoReference(aggr_socket_info_index)->aggr_v2_connection_) {
+
+        uint8_t msg_header[AggregationV2MessageHeaderMaxBytes];
+        int32_t msg_header_len = AggregationV2WriteMessageHeader(
+            msg_header,
+            msg_type,
+            0,
+            sd->get_socket_info()->aggr_v2_handle_,
+            sd->get_unique_aggr_index(),
+            data_len_bytes);
+
+        uint8_t* msg_start = sd->GetUserData() - msg_header_len;
+        memcpy(msg_start, msg_header, msg_header_len);
 
-    AggregationStruct* aggr_struct = (AggregationStruct*) (sd->GetUserData() - AggregationStructSizeBytes);
-    aggr_struct->port_number_ = g_gateway.get_server_port(sd->GetPortIndex())->get_port_number();
-    aggr_struct->size_bytes_ = data_len_bytes;
-    aggr_struct->socket_info_index_ = sd->get_socket_info_index();
-    aggr_struct->unique_socket_id_ = sd->get_unique_socket_id();
-    aggr_struct->unique_aggr_index_ = static_cast<int32_t>(sd->get_unique_aggr_index());
-    aggr_struct->msg_type_ = msg_type;
-    aggr_struct->msg_flags_ = 0;
+        err_code = SendOnAggregationSocket(aggr_socket_info_index, aggr_unique_socket_id, msg_start, data_len_bytes + msg_header_len);
 
-    uint32_t err_code = SendOnAggregationSocket(aggr_socket_info_index, aggr_unique_socket_id, (uint8_t*) aggr_struct, total_num_bytes);
+    } else {
+
+        uint32_t total_num_bytes = data_len_bytes + AggregationStructSizeBytes;
+
+        AggregationStruct* aggr_struct = (AggregationStruct*) (sd->GetUserData() - AggregationStructSizeBytes);
+        aggr_struct->port_number_ = g_gateway.get_server_port(sd->GetPortIndex())->get_port_number();
+        aggr_struct->size_bytes_ = data_len_bytes;
+        aggr_struct->socket_info_index_ = sd->get_socket_info_index();
+        aggr_struct->unique_socket_id_ = sd->get_unique_socket_id();
+        aggr_struct->unique_aggr_index_ = static_cast<int32_t>(sd->get_unique_aggr_index());
+        aggr_struct->msg_type_ = msg_type;
+        aggr_struct->msg_flags_ = 0;
+
+        err_code = SendOnAggregationSocket(aggr_socket_info_index, aggr_unique_socket_id, (uint8_t*) aggr_struct, total_num_bytes);
+    }
 
     if (!err_code) {
         // Releasing the chunk.
@@ -343,40 +720,32 @@ WRITE_TO_AGGR_SD:
             // Writing given buffer to send.
             aggr_sd->WriteBytesToSend((void*)data, total_num_bytes);
 
-            // Checking if aggregation buffer is filled.
-            if (AggregationStructSizeBytes > aggr_sd->get_num_available_network_bytes())
-            {
-                // Removing this aggregation socket data from list.
-                aggr_sds_to_send_.RemoveEntry(aggr_sd);
+            // Counting messages for v2 batch header.
+            AggregationV2Connection* conn = aggr_sd->get_socket_info()->aggr_v2_connection_;
+            if (NULL != conn)
+                conn->set_num_batch_messages(conn->get_num_batch_messages() + 1);
 
-                // Reverting accumulating buffer before send.
-                aggr_sd->RevertBeforeSend();
+            uint32_t num_buffered_bytes = aggr_sd->get_data_blob_size() - aggr_sd->get_num_available_network_bytes();
 
+            // Checking if aggregation buffer is filled or big enough to be sent right away.
+            if ((AggregationStructSizeBytes > aggr_sd->get_num_available_network_bytes()) ||
+                (num_buffered_bytes >= g_gateway.setting_aggregation_flush_bytes()))
+            {
                 // Sending it.
-                err_code = Send(aggr_sd);
+                err_code = SendAggregationSd(aggr_sd);
                 if (err_code)
                     return err_code;
-
-                GW_ASSERT(NULL == aggr_sd);
             }
 
             return 0;
         }
         else
         {
-            // Removing this aggregation socket data from list.
-            aggr_sds_to_send_.RemoveEntry(aggr_sd);
-
-            // Reverting accumulating buffer before send.
-            aggr_sd->RevertBeforeSend();
-
             // Sending it.
-            err_code = Send(aggr_sd);
+            err_code = SendAggregationSd(aggr_sd);
             if (err_code)
                 return err_code;
 
-            GW_ASSERT(NULL == aggr_sd);
-
             goto WRITE_TO_AGGR_SD;
         }
     }
@@ -390,6 +759,19 @@ WRITE_TO_AGGR_SD:
         // Checking if socket is correct.
         GW_ASSERT(aggr_sd->CompareUniqueSocketId());
 
+        // Reserving space for v2 batch header.
+        AggregationV2Connection* conn = aggr_sd->get_socket_info()->aggr_v2_connection_;
+        if (NULL != conn) {
+
+            uint8_t batch_header_space[AggregationV2BatchHeaderMaxBytes] = { 0 };
+            aggr_sd->WriteBytesToSend(batch_header_space, AggregationV2BatchHeaderMaxBytes);
+            conn->set_num_batch_messages(0);
+        }
+
+        // First buffered message defines when everything has to be sent.
+        if (aggr_sds_to_send_.IsEmpty())
+            aggr_flush_deadline_ticks_ = GetPerfTicks() + aggr_max_delay_ticks_;
+
         // Adding new aggregation sd to list.
         aggr_sds_to_send_.Add(aggr_sd);
 
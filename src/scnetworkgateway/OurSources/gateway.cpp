@@ -2,6 +2,8 @@
 #include "gateway.hpp"
 #include "handlers.hpp"
 #include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
 #include "http_proto.hpp"
 #include "socket_data.hpp"
 #include "worker_db_interface.hpp"
@@ -10,6 +12,8 @@
 
 #pragma comment(lib, "Ws2_32.lib")
 #pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "secur32.lib")
+#pragma comment(lib, "crypt32.lib")
 
 namespace starcounter {
 
@@ -22,10 +26,12 @@ Gateway g_gateway;
 
 // Pointers to extended WinSock functions.
 LPFN_ACCEPTEX AcceptExFunc = NULL;
+LPFN_TRANSMITFILE TransmitFileFunc = NULL;
 LPFN_CONNECTEX ConnectExFunc = NULL;
 LPFN_DISCONNECTEX DisconnectExFunc = NULL;
 
 GUID AcceptExGuid = WSAID_ACCEPTEX,
+    TransmitFileGuid = WSAID_TRANSMITFILE,
     ConnectExGuid = WSAID_CONNECTEX,
     DisconnectExGuid = WSAID_DISCONNECTEX;
 
@@ -58,7 +64,9 @@ std::string GetOperTypeString(SocketOperType typeOfOper)
     switch (typeOfOper)
     {
         case SEND_SOCKET_OPER: return "SEND_SOCKET_OPER";
+        case TRANSMIT_FILE_SOCKET_OPER: return "TRANSMIT_FILE_SOCKET_OPER";
         case RECEIVE_SOCKET_OPER: return "RECEIVE_SOCKET_OPER";
+        case ZERO_BYTE_RECEIVE_SOCKET_OPER: return "ZERO_BYTE_RECEIVE_SOCKET_OPER";
         case ACCEPT_SOCKET_OPER: return "ACCEPT_SOCKET_OPER";
         case CONNECT_SOCKET_OPER: return "CONNECT_SOCKET_OPER";
         case DISCONNECT_SOCKET_OPER: return "DISCONNECT_SOCKET_OPER";
@@ -102,16 +110,108 @@ CoutSafe::~CoutSafe()
 #endif
 }
 
-void GatewayLogWriter::Init(const std::wstring& log_file_path)
+// Index of the log ring used by current thread, shared ring by default.
+__declspec(thread) int32_t g_ts_log_ring_index_ = 0;
+
+// Writes a record, dropping it if ring is full.
+void GatewayLogRing::Write(int64_t timestamp, const char* text, int32_t text_len)
+{
+    char* record_text = BeginWrite(timestamp, text_len);
+    if (NULL == record_text)
+        return;
+
+    memcpy(record_text, text, text_len);
+
+    EndWrite();
+}
+
+// Reserves a record and returns pointer to its text, or NULL if ring is full.
+char* GatewayLogRing::BeginWrite(int64_t timestamp, int32_t text_len)
+{
+    int64_t write_pos = write_pos_;
+    int32_t offset = static_cast<int32_t>(write_pos & (buf_size_ - 1));
+    int32_t record_len = RecordLength(text_len);
+
+    // Record is placed from the beginning if it does not fit before the end.
+    int32_t skip_len = 0;
+    if (record_len > buf_size_ - offset)
+        skip_len = buf_size_ - offset;
+
+    // Checking if there is enough free space (or the ring is not initialized yet).
+    if ((NULL == buf_) ||
+        (record_len + skip_len > buf_size_ - (write_pos - read_pos_)))
+    {
+        num_dropped_records_++;
+        return NULL;
+    }
+
+    // Marking the rest of the ring as skipped.
+    if (skip_len)
+    {
+        GatewayLogRecordHeader* wrap_header = (GatewayLogRecordHeader*) (buf_ + offset);
+        wrap_header->text_len_ = GW_LOG_RECORD_WRAP;
+
+        write_pos += skip_len;
+        offset = 0;
+    }
+
+    GatewayLogRecordHeader* header = (GatewayLogRecordHeader*) (buf_ + offset);
+    header->timestamp_ = timestamp;
+    header->text_len_ = text_len;
+
+    pending_write_pos_ = write_pos + record_len;
+
+    return (char*) (header + 1);
+}
+
+// Gets record at given read cursor, skipping the wrap marker.
+GatewayLogRecordHeader* GatewayLogRing::GetRecord(int64_t* cursor, int64_t end)
 {
-    log_write_pos_ = 0;
+    if (*cursor == end)
+        return NULL;
+
+    int32_t offset = static_cast<int32_t>(*cursor & (buf_size_ - 1));
+    GatewayLogRecordHeader* header = (GatewayLogRecordHeader*) (buf_ + offset);
 
-    log_read_pos_ = 0;
+    if (GW_LOG_RECORD_WRAP == header->text_len_)
+    {
+        *cursor += buf_size_ - offset;
+
+        // Wrap marker is always followed by a record.
+        GW_ASSERT(*cursor != end);
+
+        header = (GatewayLogRecordHeader*) buf_;
+    }
 
-    accum_length_ = 0;
+    return header;
+}
 
+GatewayLogWriter::GatewayLogWriter()
+{
     InitializeCriticalSection(&write_lock_);
 
+    // Only shared ring exists until initialization.
+    rings_[0].Init(shared_ring_buf_, GW_LOG_BUFFER_SIZE);
+    for (int32_t i = 1; i < MAX_WORKER_THREADS + 1; i++) {
+        rings_[i].Init(NULL, GW_LOG_BUFFER_SIZE);
+    }
+    num_rings_ = 1;
+
+    file_buf_len_ = 0;
+    num_reported_dropped_records_ = 0;
+    log_file_handle_ = INVALID_HANDLE_VALUE;
+}
+
+void GatewayLogWriter::Init(const std::wstring& log_file_path, int32_t num_workers)
+{
+    GW_ASSERT(num_workers <= MAX_WORKER_THREADS);
+
+    // Creating a ring for each worker.
+    for (int32_t i = 1; i <= num_workers; i++) {
+        rings_[i].Init((char*) GwNewAligned(GW_LOG_BUFFER_SIZE), GW_LOG_BUFFER_SIZE);
+    }
+    num_rings_ = num_workers + 1;
+
 #ifdef GW_LOG_TO_FILE
 
     // Opening log file for writes.
@@ -139,121 +239,351 @@ void GatewayLogWriter::Init(const std::wstring& log_file_path)
 #endif   
 }
 
-// Writes given string to log buffer.
+// Makes current thread write to the ring of given worker.
+void GatewayLogWriter::SetCurrentThreadRing(worker_id_type worker_id)
+{
+    g_ts_log_ring_index_ = worker_id + 1;
+}
+
+// Total number of dropped log records.
+int64_t GatewayLogWriter::GetNumberOfDroppedRecords()
+{
+    int64_t num_dropped_records = 0;
+    for (int32_t i = 0; i < num_rings_; i++) {
+        num_dropped_records += rings_[i].get_num_dropped_records();
+    }
+
+    return num_dropped_records;
+}
+
+// Writes given string to log ring of current thread.
 #ifdef GW_LOGGING_ON
 void GatewayLogWriter::WriteToLog(const char* text, int32_t text_len)
 {
-    EnterCriticalSection(&write_lock_);
+    int32_t ring_index = g_ts_log_ring_index_;
+
+    // Non-worker threads share one ring.
+    if (0 == ring_index)
+        EnterCriticalSection(&write_lock_);
 
 #ifdef GW_LOG_TO_FILE
 
-    int32_t left_space = GW_LOG_BUFFER_SIZE - log_write_pos_;
+    LARGE_INTEGER timestamp;
+    QueryPerformanceCounter(&timestamp);
+
+    rings_[ring_index].Write(timestamp.QuadPart, text, text_len);
+
+#endif
+
+    if (0 == ring_index)
+        LeaveCriticalSection(&write_lock_);
+
+    // Printing everything to console as well.
+    // NOTE: Console is shared by all threads so lines are serialized.
+#ifdef GW_LOG_TO_CONSOLE
+    EnterCriticalSection(&write_lock_);
+    std::cout << text;
+    LeaveCriticalSection(&write_lock_);
+#endif
+}
+
+// Writes file buffer to log file.
+void GatewayLogWriter::FlushFileBuffer()
+{
+    if (0 == file_buf_len_)
+        return;
+
+    BOOL err_code = WriteFile(
+        log_file_handle_,
+        file_buf_,
+        file_buf_len_,
+        NULL,
+        NULL
+        );
+
+    GW_ASSERT(TRUE == err_code);
+
+    file_buf_len_ = 0;
+}
 
-    // Checking if text fits in the buffer.
-    if (text_len <= left_space)
+// Appends text to file buffer, writing buffer to file when full.
+void GatewayLogWriter::AppendToFileBuffer(const char* text, int32_t text_len)
+{
+    while (text_len > 0)
     {
-        memcpy(log_buf_ + log_write_pos_, text, text_len);
-        log_write_pos_ += text_len;
+        if (file_buf_len_ == GW_LOG_BUFFER_SIZE)
+            FlushFileBuffer();
+
+        int32_t copy_len = GW_LOG_BUFFER_SIZE - file_buf_len_;
+        if (copy_len > text_len)
+            copy_len = text_len;
+
+        memcpy(file_buf_ + file_buf_len_, text, copy_len);
+        file_buf_len_ += copy_len;
+        text += copy_len;
+        text_len -= copy_len;
     }
-    // Checking if we should write to the beginning.
-    else if (left_space == 0)
+}
+
+// Dump accumulated logs in rings to file.
+void GatewayLogWriter::DumpToLogFile()
+{
+    int64_t cursors[MAX_WORKER_THREADS + 1];
+    int64_t ends[MAX_WORKER_THREADS + 1];
+    GatewayLogRecordHeader* records[MAX_WORKER_THREADS + 1];
+
+    // Taking snapshot of what is written in each ring.
+    for (int32_t i = 0; i < num_rings_; i++)
     {
-        memcpy(log_buf_, text, text_len);
-        log_write_pos_ = text_len;
+        cursors[i] = rings_[i].get_read_pos();
+        ends[i] = rings_[i].get_write_pos();
+        records[i] = rings_[i].GetRecord(cursors + i, ends[i]);
     }
-    // Splitted write.
-    else
+
+    // Merging records from all rings in time stamp order.
+    while (true)
     {
-        memcpy(log_buf_ + log_write_pos_, text, left_space);
-        memcpy(log_buf_, text + left_space, text_len - left_space);
-        log_write_pos_ = text_len - left_space;
+        int32_t oldest = -1;
+        for (int32_t i = 0; i < num_rings_; i++)
+        {
+            if ((NULL != records[i]) &&
+                ((oldest < 0) || (records[i]->timestamp_ < records[oldest]->timestamp_)))
+            {
+                oldest = i;
+            }
+        }
+
+        if (oldest < 0)
+            break;
+
+        AppendToFileBuffer((const char*) (records[oldest] + 1), records[oldest]->text_len_);
+
+        cursors[oldest] += GatewayLogRing::RecordLength(records[oldest]->text_len_);
+        records[oldest] = rings_[oldest].GetRecord(cursors + oldest, ends[oldest]);
     }
 
-    // Adjusting accumulated log size.
-    accum_length_ += text_len;
-    GW_ASSERT(accum_length_ < GW_LOG_BUFFER_SIZE);
+    // Releasing consumed space back to producers.
+    for (int32_t i = 0; i < num_rings_; i++) {
+        rings_[i].set_read_pos(cursors[i]);
+    }
 
-#endif
+    // Reporting records dropped since last dump.
+    int64_t num_dropped_records = GetNumberOfDroppedRecords();
+    if (num_dropped_records != num_reported_dropped_records_)
+    {
+        char temp[128];
+        int32_t temp_len = sprintf_s(temp, sizeof(temp), "Gateway log dropped %lld records because log ring was full.\n",
+            num_dropped_records - num_reported_dropped_records_);
 
-    // Printing everything to console as well.
-#ifdef GW_LOG_TO_CONSOLE
-    std::cout << text;
+        AppendToFileBuffer(temp, temp_len);
+
+        num_reported_dropped_records_ = num_dropped_records;
+    }
+
+    FlushFileBuffer();
+}
 #endif
 
-    LeaveCriticalSection(&write_lock_);
+// Creates capture file and worker rings.
+uint32_t GatewayTrafficCapture::Init(const std::wstring& capture_file_path, int32_t num_workers)
+{
+    GW_ASSERT(num_workers <= MAX_WORKER_THREADS);
+
+    file_handle_ = CreateFile(
+        capture_file_path.c_str(),
+        GENERIC_WRITE,
+        FILE_SHARE_READ,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+
+    if (INVALID_HANDLE_VALUE == file_handle_)
+    {
+        std::wstring msg = L"Can't create traffic capture file: " + capture_file_path;
+        g_gateway.LogWriteCritical(msg.c_str());
+
+        return SCERRBADGATEWAYCONFIG;
+    }
+
+    // Creating a ring for each worker.
+    for (int32_t i = 0; i < num_workers; i++) {
+        rings_[i].Init((char*) GwNewAligned(GW_CAPTURE_BUFFER_SIZE), GW_CAPTURE_BUFFER_SIZE);
+    }
+    num_rings_ = num_workers;
+
+    file_buf_ = (char*) GwNewAligned(GW_CAPTURE_BUFFER_SIZE);
+
+    LARGE_INTEGER ticks;
+    QueryPerformanceFrequency(&ticks);
+    ticks_per_second_ = ticks.QuadPart;
+    QueryPerformanceCounter(&ticks);
+    start_ticks_ = ticks.QuadPart;
+
+    // Writing file header.
+    TrafficCaptureFileHeader header;
+    memcpy(header.magic_, TRAFFIC_CAPTURE_MAGIC, sizeof(header.magic_));
+    header.version_ = TRAFFIC_CAPTURE_VERSION;
+    header.reserved_ = 0;
+
+    FILETIME start_time;
+    GetSystemTimeAsFileTime(&start_time);
+    header.start_filetime_ = ((uint64_t) start_time.dwHighDateTime << 32) | start_time.dwLowDateTime;
+
+    AppendToFileBuffer((const char*) &header, sizeof(header));
+    FlushFileBuffer();
+
+    return 0;
 }
 
-// Dump accumulated logs in buffer to file.
-void GatewayLogWriter::DumpToLogFile()
+// Writes capture record from given worker, dropping it if ring is full.
+void GatewayTrafficCapture::Write(
+    worker_id_type worker_id,
+    uint8_t type,
+    uint64_t connection_id,
+    uint16_t port,
+    const uint8_t* data,
+    int32_t data_len)
 {
-    if (log_write_pos_ == log_read_pos_)
+    LARGE_INTEGER timestamp;
+    QueryPerformanceCounter(&timestamp);
+
+    // Splitting big receives so that each record fits into the ring.
+    do
+    {
+        int32_t record_data_len = data_len;
+        if (record_data_len > TRAFFIC_CAPTURE_MAX_RECORD_DATA)
+            record_data_len = TRAFFIC_CAPTURE_MAX_RECORD_DATA;
+
+        char* text = rings_[worker_id].BeginWrite(timestamp.QuadPart, sizeof(TrafficCaptureRecord) + record_data_len);
+        if (NULL == text)
+            return;
+
+        // NOTE: Time is filled in when record is dumped.
+        TrafficCaptureRecord* record = (TrafficCaptureRecord*) text;
+        record->time_us_ = 0;
+        record->connection_id_ = connection_id;
+        record->data_len_ = record_data_len;
+        record->port_ = port;
+        record->type_ = type;
+        record->reserved_ = 0;
+
+        memcpy(record + 1, data, record_data_len);
+
+        rings_[worker_id].EndWrite();
+
+        data += record_data_len;
+        data_len -= record_data_len;
+
+    } while (data_len > 0);
+}
+
+// Total number of dropped capture records.
+int64_t GatewayTrafficCapture::GetNumberOfDroppedRecords()
+{
+    int64_t num_dropped_records = 0;
+    for (int32_t i = 0; i < num_rings_; i++) {
+        num_dropped_records += rings_[i].get_num_dropped_records();
+    }
+
+    return num_dropped_records;
+}
+
+// Writes file buffer to capture file.
+void GatewayTrafficCapture::FlushFileBuffer()
+{
+    if (0 == file_buf_len_)
         return;
 
-    // Saving current write position of log.
-    int32_t log_write_pos = log_write_pos_;
-    int32_t num_bytes_to_write;
-    BOOL err_code;
+    DWORD num_written = 0;
+    BOOL err_code = WriteFile(
+        file_handle_,
+        file_buf_,
+        file_buf_len_,
+        &num_written,
+        NULL
+        );
+
+    GW_ASSERT(TRUE == err_code);
+
+    file_buf_len_ = 0;
+}
 
-    // Simplest case when writes are linear in log buffer.
-    if (log_write_pos > log_read_pos_)
+// Appends bytes to file buffer, writing buffer to file when full.
+void GatewayTrafficCapture::AppendToFileBuffer(const char* data, int32_t data_len)
+{
+    while (data_len > 0)
     {
-        num_bytes_to_write = log_write_pos - log_read_pos_;
-
-        err_code = WriteFile(
-            log_file_handle_,
-            log_buf_ + log_read_pos_,
-            num_bytes_to_write,
-            NULL,
-            NULL
-            );
+        if (file_buf_len_ == GW_CAPTURE_BUFFER_SIZE)
+            FlushFileBuffer();
 
-        GW_ASSERT(TRUE == err_code);
+        int32_t copy_len = GW_CAPTURE_BUFFER_SIZE - file_buf_len_;
+        if (copy_len > data_len)
+            copy_len = data_len;
+
+        memcpy(file_buf_ + file_buf_len_, data, copy_len);
+        file_buf_len_ += copy_len;
+        data += copy_len;
+        data_len -= copy_len;
     }
-    else
+}
+
+// Dumps captured records in rings to file.
+void GatewayTrafficCapture::DumpToFile()
+{
+    int64_t cursors[MAX_WORKER_THREADS];
+    int64_t ends[MAX_WORKER_THREADS];
+    GatewayLogRecordHeader* records[MAX_WORKER_THREADS];
+
+    // Taking snapshot of what is written in each ring.
+    for (int32_t i = 0; i < num_rings_; i++)
     {
-        num_bytes_to_write = GW_LOG_BUFFER_SIZE - log_read_pos_;
+        cursors[i] = rings_[i].get_read_pos();
+        ends[i] = rings_[i].get_write_pos();
+        records[i] = rings_[i].GetRecord(cursors + i, ends[i]);
+    }
 
-        if (num_bytes_to_write)
+    // Merging records from all rings in time stamp order.
+    while (true)
+    {
+        int32_t oldest = -1;
+        for (int32_t i = 0; i < num_rings_; i++)
         {
-            // Write log_read_pos_ to LOG_BUFFER_SIZE.
-            err_code = WriteFile(
-                log_file_handle_,
-                log_buf_ + log_read_pos_,
-                num_bytes_to_write,
-                NULL,
-                NULL
-                );
-
-            GW_ASSERT(TRUE == err_code);
+            if ((NULL != records[i]) &&
+                ((oldest < 0) || (records[i]->timestamp_ < records[oldest]->timestamp_)))
+            {
+                oldest = i;
+            }
         }
 
-        num_bytes_to_write = log_write_pos;
+        if (oldest < 0)
+            break;
+
+        TrafficCaptureRecord* record = (TrafficCaptureRecord*) (records[oldest] + 1);
+        record->time_us_ = (records[oldest]->timestamp_ - start_ticks_) * 1000000 / ticks_per_second_;
 
-        if (num_bytes_to_write)
-        {
-            // Write 0 to log_write_pos.
-            err_code = WriteFile(
-                log_file_handle_,
-                log_buf_,
-                num_bytes_to_write,
-                NULL,
-                NULL
-                );
+        AppendToFileBuffer((const char*) record, records[oldest]->text_len_);
 
-            GW_ASSERT(TRUE == err_code);
-        }
+        cursors[oldest] += GatewayLogRing::RecordLength(records[oldest]->text_len_);
+        records[oldest] = rings_[oldest].GetRecord(cursors + oldest, ends[oldest]);
+    }
 
-        num_bytes_to_write =  GW_LOG_BUFFER_SIZE - log_read_pos_ + log_write_pos;
+    // Releasing consumed space back to producers.
+    for (int32_t i = 0; i < num_rings_; i++) {
+        rings_[i].set_read_pos(cursors[i]);
     }
 
-    // Shifting log read position.
-    log_read_pos_ = log_write_pos;
+    FlushFileBuffer();
+
+    // Reporting records dropped since last dump, captured streams of their connections are incomplete.
+    int64_t num_dropped_records = GetNumberOfDroppedRecords();
+    if (num_dropped_records != num_reported_dropped_records_)
+    {
+        GW_COUT << "Traffic capture dropped " << (num_dropped_records - num_reported_dropped_records_) << " records because capture ring was full." << GW_ENDL;
 
-    // Adjusting accumulated log size.
-    accum_length_ -= num_bytes_to_write;
-    GW_ASSERT(accum_length_ >= 0);
+        num_reported_dropped_records_ = num_dropped_records;
+    }
 }
-#endif
 
 Gateway::Gateway()
 {
@@ -266,6 +596,44 @@ Gateway::Gateway()
     // Default inactive socket timeout in seconds.
     setting_inactive_socket_timeout_seconds_ = 60 * 20;
 
+    // Aggregated messages are sent when a TCP segment is filled or after half a millisecond.
+    setting_aggregation_flush_bytes_ = 1460;
+    setting_aggregation_max_delay_us_ = 500;
+
+    // Idle sockets receive into chunks by default.
+    setting_zero_byte_receive_ = false;
+
+    // HTTP/2 is off by default.
+    setting_http2_ = false;
+
+    // Request tracing is off by default.
+    setting_trace_sampling_interval_ = 0;
+
+    // Quarter of a channel can be queued before receiving stops.
+    setting_scheduler_credits_ = core::channel_capacity / 4;
+
+    // Schedulers are selected by load by default.
+    setting_least_loaded_scheduling_ = true;
+
+    // Default accept queues.
+    setting_listen_backlog_ = LISTENING_SOCKET_QUEUE_SIZE;
+    setting_max_pre_accepted_sockets_ = MAX_ACCEPT_ROOF;
+
+    // Default number of posted UDP receives.
+    setting_udp_receives_per_socket_ = NUM_UDP_RECEIVES_PER_SOCKET;
+
+    // Default chunk slabs are of a large page size.
+    setting_chunk_slab_size_bytes_ = 2 * 1024 * 1024;
+    setting_chunk_large_pages_ = false;
+    large_page_size_ = 0;
+
+    // Default chunk stores sizes.
+    for (int32_t i = 0; i < NumGatewayChunkSizes; i++)
+    {
+        setting_chunk_store_max_chunks_[i] = GatewayChunkStoresSizes[i];
+        setting_chunk_store_free_watermarks_[i] = GatewayChunkStoresSizes[i] / 10;
+    }
+
     // Starcounter server type.
     setting_sc_server_type_upper_ = MixedCodeConstants::DefaultPersonalServerNameUpper;
 
@@ -288,6 +656,8 @@ Gateway::Gateway()
     // No reverse proxies by default.
     num_reversed_proxies_ = 0;
     num_uri_aliases_ = 0;
+    num_static_routes_ = 0;
+    num_tls_ports_ = 0;
 
     // Starting linear unique socket with 0.
     unique_socket_id_ = 0;
@@ -316,6 +686,12 @@ Gateway::Gateway()
     // First bind interface number.
     last_bind_interface_num_unsafe_ = 0;
 
+    last_second_recv_num_ = 0;
+    last_second_sent_num_ = 0;
+    last_second_bytes_received_ = 0;
+    last_second_bytes_sent_ = 0;
+    last_second_http_requests_ = 0;
+
     // Resetting Starcounter log handle.
     sc_log_handle_ = MixedCodeConstants::INVALID_SERVER_LOG_HANDLE;
 
@@ -430,6 +806,42 @@ void ServerPort::Init(port_index_type port_index, uint16_t port_number, bool is_
 void ServerPort::Reset()
 {
     InterlockedAnd64(&num_accepting_sockets_unsafe_, 0);
+
+    accept_roof_ = MIN_ACCEPT_ROOF;
+    num_accepted_in_interval_ = 0;
+    accept_interval_start_ms_ = timeGetTime();
+}
+
+// Adjusts number of pre-accepted sockets to the accept rate and returns it.
+int32_t ServerPort::UpdateAcceptRoof(uint32_t cur_time_ms)
+{
+    // Growing as soon as more connections arrive than there are pre-accepted sockets,
+    // so that connection bursts are taken by the pool instead of the listen backlog.
+    if (num_accepted_in_interval_ > accept_roof_)
+    {
+        accept_roof_ *= 2;
+        if (accept_roof_ > g_gateway.setting_max_pre_accepted_sockets())
+            accept_roof_ = g_gateway.setting_max_pre_accepted_sockets();
+
+        num_accepted_in_interval_ = 0;
+        accept_interval_start_ms_ = cur_time_ms;
+    }
+    else if (cur_time_ms - accept_interval_start_ms_ >= ACCEPT_RATE_INTERVAL_MS)
+    {
+        // Shrinking slowly when the pool is mostly idle.
+        // NOTE: Extra sockets are not closed, they are just not replaced when accepted.
+        if (num_accepted_in_interval_ < accept_roof_ / 4)
+        {
+            accept_roof_ /= 2;
+            if (accept_roof_ < MIN_ACCEPT_ROOF)
+                accept_roof_ = MIN_ACCEPT_ROOF;
+        }
+
+        num_accepted_in_interval_ = 0;
+        accept_interval_start_ms_ = cur_time_ms;
+    }
+
+    return accept_roof_;
 }
 
 // Removes this port.
@@ -1015,6 +1427,128 @@ uint32_t Gateway::LoadReverseProxies()
         return SCERRBADGATEWAYCONFIG;
     }
 
+    StaticRouteInfo static_routes[MAX_STATIC_ROUTES];
+    int32_t num_static_routes = 0;
+
+    try {
+
+        // Checking if we have static files routes.
+        xml_node<char>* static_routes_node = root_elem->first_node("StaticRoutes");
+        if (static_routes_node)
+        {
+            xml_node<char>* static_route_node = static_routes_node->first_node("StaticRoute");
+
+            while (static_route_node)
+            {
+                if (num_static_routes >= MAX_STATIC_ROUTES) {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Too many static routes specified (maximum 32 are allowed).");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                // Resetting info.
+                static_routes[num_static_routes].Reset();
+
+                node_elem = static_route_node->first_node("Port");
+                if (!node_elem)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Can't read static route Port property.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                int32_t port = atoi(node_elem->value());
+                if ((port <= 0) || (port >= 65536)) {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Static route has incorrect port number.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                static_routes[num_static_routes].port_ = static_cast<uint16_t>(port);
+
+                node_elem = static_route_node->first_node("UriPrefix");
+                if (!node_elem)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Can't read static route UriPrefix property.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                std::string uri_prefix = node_elem->value();
+
+                if ((0 == uri_prefix.length()) || ('/' != uri_prefix[0])) {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Static route UriPrefix should start with slash.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                // Prefix always covers whole path segments.
+                if ('/' != uri_prefix[uri_prefix.length() - 1])
+                    uri_prefix += "/";
+
+                if (uri_prefix.length() >= MAX_URI_ALIAS_CHARS) {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Too long static route UriPrefix supplied.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                // Converting UriPrefix to lower.
+                std::transform(uri_prefix.begin(), uri_prefix.end(), uri_prefix.begin(), ::tolower);
+
+                static_routes[num_static_routes].uri_prefix_ = uri_prefix;
+                static_routes[num_static_routes].uri_prefix_len_ = static_cast<int32_t>(uri_prefix.length());
+
+                node_elem = static_route_node->first_node("Directory");
+                if (!node_elem)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Can't read static route Directory property.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                wchar_t directory[MAX_PATH];
+                int32_t directory_len = MultiByteToWideChar(CP_UTF8, 0, node_elem->value(), -1, directory, MAX_PATH);
+                if (directory_len <= 1) {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Static route has incorrect Directory property.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                std::wstring directory_str = directory;
+                std::replace(directory_str.begin(), directory_str.end(), L'/', L'\\');
+
+                // Removing trailing slashes.
+                while ((directory_str.length() > 1) && (L'\\' == directory_str[directory_str.length() - 1]))
+                    directory_str.erase(directory_str.length() - 1);
+
+                DWORD attributes = GetFileAttributesW(directory_str.c_str());
+                if ((INVALID_FILE_ATTRIBUTES == attributes) || (0 == (attributes & FILE_ATTRIBUTE_DIRECTORY))) {
+
+                    std::wstring temp = L"Gateway XML: Static route directory does not exist: ";
+                    temp += directory_str;
+
+                    g_gateway.LogWriteCritical(temp.c_str());
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                static_routes[num_static_routes].directory_ = directory_str;
+
+                node_elem = static_route_node->first_node("MaxAgeSeconds");
+                if (node_elem) {
+
+                    static_routes[num_static_routes].max_age_seconds_ = atoi(node_elem->value());
+                    if (static_routes[num_static_routes].max_age_seconds_ < 0) {
+                        g_gateway.LogWriteCritical(L"Gateway XML: Static route has incorrect MaxAgeSeconds property.");
+                        return SCERRBADGATEWAYCONFIG;
+                    }
+                }
+
+                // Getting next static route information.
+                static_route_node = static_route_node->next_sibling("StaticRoute");
+
+                num_static_routes++;
+            }
+        }
+
+    } catch (...) {
+
+        g_gateway.LogWriteCritical(L"Gateway XML: Internal error occurred when loading static routes settings.");
+        GW_COUT << "Error loading gateway XML settings!" << GW_ENDL;
+        return SCERRBADGATEWAYCONFIG;
+    }
+
     // Applying new proxy settings.
     num_reversed_proxies_ = num_proxies;
 
@@ -1031,6 +1565,14 @@ uint32_t Gateway::LoadReverseProxies()
         uri_aliases_[i] = uri_aliases[i];
     }
 
+    // Applying new static routes settings.
+    num_static_routes_ = num_static_routes;
+
+    for (int32_t i = 0; i < num_static_routes; i++) {
+
+        static_routes_[i] = static_routes[i];
+    }
+
     return 0;
 }
 
@@ -1166,6 +1708,341 @@ uint32_t Gateway::LoadSettings()
             }
         }
 
+        // Getting aggregation flush threshold.
+        node_elem = root_elem->first_node("AggregationFlushBytes");
+        if (node_elem)
+        {
+            setting_aggregation_flush_bytes_ = atoi(node_elem->value());
+
+            if ((setting_aggregation_flush_bytes_ <= 0) ||
+                (setting_aggregation_flush_bytes_ > static_cast<uint32_t>(GatewayChunkDataSizes[DefaultGatewayChunkSizeType])))
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported AggregationFlushBytes value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+        }
+
+        // Getting aggregation coalescing delay.
+        node_elem = root_elem->first_node("AggregationMaxDelayMicroseconds");
+        if (node_elem)
+        {
+            setting_aggregation_max_delay_us_ = atoi(node_elem->value());
+
+            if (setting_aggregation_max_delay_us_ > 1000000)
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported AggregationMaxDelayMicroseconds value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+        }
+
+        // Getting request tracing sampling interval.
+        node_elem = root_elem->first_node("RequestTraceSamplingInterval");
+        if (node_elem)
+        {
+            int32_t sampling_interval = atoi(node_elem->value());
+
+            if (sampling_interval < 0)
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported RequestTraceSamplingInterval value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+
+            setting_trace_sampling_interval_ = sampling_interval;
+        }
+
+        // Getting number of credits per worker and scheduler.
+        node_elem = root_elem->first_node("SchedulerCredits");
+        if (node_elem)
+        {
+            setting_scheduler_credits_ = atoi(node_elem->value());
+
+            if ((setting_scheduler_credits_ < 0) ||
+                (setting_scheduler_credits_ > static_cast<int32_t>(core::channel_capacity)))
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported SchedulerCredits value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+        }
+
+        // Getting scheduler selection policy.
+        node_elem = root_elem->first_node("SchedulerSelection");
+        if (node_elem)
+        {
+            if (0 == strcmp(node_elem->value(), "LeastLoaded"))
+            {
+                setting_least_loaded_scheduling_ = true;
+            }
+            else if (0 == strcmp(node_elem->value(), "RoundRobin"))
+            {
+                setting_least_loaded_scheduling_ = false;
+            }
+            else
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported SchedulerSelection value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+        }
+
+        // Getting listening sockets backlog size.
+        node_elem = root_elem->first_node("ListenBacklog");
+        if (node_elem)
+        {
+            setting_listen_backlog_ = atoi(node_elem->value());
+            if ((setting_listen_backlog_ <= 0) || (setting_listen_backlog_ > 65535))
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported ListenBacklog value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+        }
+
+        // Getting maximum number of pre-accepted sockets on a port.
+        node_elem = root_elem->first_node("MaxPreAcceptedSockets");
+        if (node_elem)
+        {
+            setting_max_pre_accepted_sockets_ = atoi(node_elem->value());
+            if ((setting_max_pre_accepted_sockets_ < MIN_ACCEPT_ROOF) || (setting_max_pre_accepted_sockets_ > 4096))
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported MaxPreAcceptedSockets value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+        }
+
+        // Getting number of receives posted on each UDP socket.
+        node_elem = root_elem->first_node("UdpReceivesPerSocket");
+        if (node_elem)
+        {
+            setting_udp_receives_per_socket_ = atoi(node_elem->value());
+            if ((setting_udp_receives_per_socket_ <= 0) || (setting_udp_receives_per_socket_ > 256))
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported UdpReceivesPerSocket value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+        }
+
+        // Getting traffic capture file.
+        node_elem = root_elem->first_node("TrafficCaptureFile");
+        if (node_elem)
+        {
+            wchar_t capture_file[MAX_PATH];
+            int32_t capture_file_len = MultiByteToWideChar(CP_UTF8, 0, node_elem->value(), -1, capture_file, MAX_PATH);
+            if (capture_file_len <= 0)
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Unsupported TrafficCaptureFile value.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+
+            setting_traffic_capture_file_ = capture_file;
+        }
+
+        // Getting zero-byte receive mode.
+        node_elem = root_elem->first_node("ZeroByteReceive");
+        if (node_elem)
+        {
+            setting_zero_byte_receive_ = (0 != atoi(node_elem->value()));
+        }
+
+        // Getting HTTP/2 mode.
+        node_elem = root_elem->first_node("Http2");
+        if (node_elem)
+        {
+            setting_http2_ = (0 != atoi(node_elem->value()));
+        }
+
+        // Getting chunk stores settings.
+        xml_node<>* stores_elem = root_elem->first_node("ChunkStores");
+        if (stores_elem)
+        {
+            node_elem = stores_elem->first_node("SlabSizeBytes");
+            if (node_elem)
+            {
+                setting_chunk_slab_size_bytes_ = atoi(node_elem->value());
+                if (setting_chunk_slab_size_bytes_ < GatewayChunkSizes[0] || setting_chunk_slab_size_bytes_ > 256 * 1024 * 1024)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Unsupported SlabSizeBytes value.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+            }
+
+            node_elem = stores_elem->first_node("UseLargePages");
+            if (node_elem)
+            {
+                setting_chunk_large_pages_ = (0 != atoi(node_elem->value()));
+            }
+
+            xml_node<>* store_elem = stores_elem->first_node("ChunkStore");
+            while (store_elem)
+            {
+                node_elem = store_elem->first_node("ChunkSizeBytes");
+                if (!node_elem)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Can't read ChunkStore ChunkSizeBytes property.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                // Finding the store with given chunk size.
+                int32_t chunk_size_bytes = atoi(node_elem->value());
+                int32_t store_index = 0;
+                while ((store_index < NumGatewayChunkSizes) && (GatewayChunkSizes[store_index] != chunk_size_bytes))
+                    store_index++;
+
+                if (store_index == NumGatewayChunkSizes)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Unsupported ChunkStore ChunkSizeBytes value.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                node_elem = store_elem->first_node("MaxChunks");
+                if (node_elem)
+                {
+                    setting_chunk_store_max_chunks_[store_index] = atoi(node_elem->value());
+                    if (setting_chunk_store_max_chunks_[store_index] <= 0)
+                    {
+                        g_gateway.LogWriteCritical(L"Gateway XML: Unsupported ChunkStore MaxChunks value.");
+                        return SCERRBADGATEWAYCONFIG;
+                    }
+                }
+
+                node_elem = store_elem->first_node("FreeWatermark");
+                if (node_elem)
+                {
+                    setting_chunk_store_free_watermarks_[store_index] = atoi(node_elem->value());
+                    if (setting_chunk_store_free_watermarks_[store_index] < 0)
+                    {
+                        g_gateway.LogWriteCritical(L"Gateway XML: Unsupported ChunkStore FreeWatermark value.");
+                        return SCERRBADGATEWAYCONFIG;
+                    }
+                }
+
+                store_elem = store_elem->next_sibling("ChunkStore");
+            }
+
+            // Overflow queues are sized for the default total number of chunks.
+            int64_t total_max_chunks = 0;
+            for (int32_t i = 0; i < NumGatewayChunkSizes; i++) {
+                total_max_chunks += setting_chunk_store_max_chunks_[i];
+            }
+
+            if (total_max_chunks > MAX_WORKER_CHUNKS)
+            {
+                g_gateway.LogWriteCritical(L"Gateway XML: Total number of chunks in ChunkStores exceeds maximum.");
+                return SCERRBADGATEWAYCONFIG;
+            }
+        }
+
+        // Getting CPU pinning of gateway threads.
+        xml_node<>* affinity_elem = root_elem->first_node("CpuAffinity");
+        if (affinity_elem)
+        {
+            node_elem = affinity_elem->first_node("WorkerCpus");
+            if (node_elem)
+            {
+                // Each worker needs its own processor.
+                if ((!ParseCpuList(node_elem->value(), setting_worker_cpus_)) ||
+                    (static_cast<int32_t>(setting_worker_cpus_.size()) < setting_num_workers_))
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Unsupported CpuAffinity WorkerCpus value.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+            }
+
+            node_elem = affinity_elem->first_node("MonitorThreadCpus");
+            if (node_elem)
+            {
+                if (!ParseCpuList(node_elem->value(), setting_monitor_thread_cpus_))
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Unsupported CpuAffinity MonitorThreadCpus value.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+            }
+
+            node_elem = affinity_elem->first_node("LoggingThreadCpus");
+            if (node_elem)
+            {
+                if (!ParseCpuList(node_elem->value(), setting_logging_thread_cpus_))
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Unsupported CpuAffinity LoggingThreadCpus value.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+            }
+
+            node_elem = affinity_elem->first_node("SchedulerCpus");
+            if (node_elem)
+            {
+                if (!ParseCpuList(node_elem->value(), setting_scheduler_cpus_))
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Unsupported CpuAffinity SchedulerCpus value.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+            }
+        }
+
+        // Getting TLS protected ports.
+        xml_node<>* tls_ports_elem = root_elem->first_node("TlsPorts");
+        if (tls_ports_elem)
+        {
+            xml_node<>* tls_port_elem = tls_ports_elem->first_node("TlsPort");
+            while (tls_port_elem)
+            {
+                if (num_tls_ports_ >= MAX_TLS_PORTS)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Too many TlsPort entries.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                TlsPortInfo* tls_port = tls_ports_ + num_tls_ports_;
+                tls_port->Reset();
+
+                node_elem = tls_port_elem->first_node("Port");
+                if (!node_elem)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Can't read TlsPort Port property.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+
+                int32_t port_num = atoi(node_elem->value());
+                if ((port_num <= 0) || (port_num >= 65536) || (NULL != FindTlsPort((uint16_t) port_num)))
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Unsupported TlsPort Port value.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+                tls_port->port_ = (uint16_t) port_num;
+
+                node_elem = tls_port_elem->first_node("CertificateThumbprint");
+                if (!node_elem)
+                {
+                    g_gateway.LogWriteCritical(L"Gateway XML: Can't read TlsPort CertificateThumbprint property.");
+                    return SCERRBADGATEWAYCONFIG;
+                }
+                tls_port->certificate_thumbprint_ = node_elem->value();
+
+                node_elem = tls_port_elem->first_node("CertificateStore");
+                if (node_elem)
+                {
+                    tls_port->certificate_store_ = node_elem->value();
+                }
+
+                node_elem = tls_port_elem->first_node("SessionCacheSeconds");
+                if (node_elem)
+                {
+                    tls_port->session_cache_seconds_ = atoi(node_elem->value());
+                    if (tls_port->session_cache_seconds_ < 0)
+                    {
+                        g_gateway.LogWriteCritical(L"Gateway XML: Unsupported TlsPort SessionCacheSeconds value.");
+                        return SCERRBADGATEWAYCONFIG;
+                    }
+                }
+
+                // Loading the certificate and acquiring credentials.
+                uint32_t err_code = TlsAcquireCredentials(tls_port);
+                if (err_code)
+                    return err_code;
+
+                num_tls_ports_++;
+
+                tls_port_elem = tls_port_elem->next_sibling("TlsPort");
+            }
+        }
+
         // Just enforcing minimum socket timeout multiplier.
         if ((setting_inactive_socket_timeout_seconds_ % SOCKET_LIFETIME_MULTIPLIER) != 0)
         {
@@ -1300,8 +2177,13 @@ uint32_t Gateway::CreateListeningSocketAndBindToPort(GatewayWorker *gw, uint16_t
         return SCERRNETWORKPORTISOCCUPIED;
     }
 
+    // Windows limits plain backlog values to 200, bigger ones have to be given as a hint.
+    int32_t backlog = setting_listen_backlog_;
+    if (backlog > 200)
+        backlog = SOMAXCONN_HINT(backlog);
+
     // Listening to connections.
-    if (listen(sock, LISTENING_SOCKET_QUEUE_SIZE))
+    if (listen(sock, backlog))
     {
         PrintLastError(true);
         closesocket(sock);
@@ -1347,6 +2229,14 @@ void __stdcall RebalanceSocketApcFunction(ULONG_PTR arg) {
     g_gateway.get_worker(worker_id)->ProcessRebalancedSockets();
 }
 
+// APC function that is used for sending WebSocket broadcasts.
+void __stdcall WsBroadcastApcFunction(ULONG_PTR arg) {
+
+    worker_id_type worker_id = (worker_id_type) arg;
+
+    g_gateway.get_worker(worker_id)->ProcessWsBroadcasts();
+}
+
 // Sends an APC signal for rebalancing sockets.
 void Gateway::SendRebalanceAPC(worker_id_type worker_id) {
     
@@ -1356,6 +2246,15 @@ void Gateway::SendRebalanceAPC(worker_id_type worker_id) {
     QueueUserAPC(RebalanceSocketApcFunction, worker_thread_handle, worker_id);
 }
 
+// Sends an APC signal for sending queued WebSocket broadcasts.
+void Gateway::SendWsBroadcastAPC(worker_id_type worker_id) {
+
+    // Obtaining worker thread handle to call an APC event.
+    HANDLE worker_thread_handle = g_gateway.get_worker_thread_handle(worker_id);
+
+    QueueUserAPC(WsBroadcastApcFunction, worker_thread_handle, worker_id);
+}
+
 // Waking up a thread using APC.
 void WakeUpThreadUsingAPC(HANDLE thread_handle)
 {
@@ -2199,18 +3098,109 @@ bool ActiveDatabase::IsReadyForCleanup()
 
     LeaveCriticalSection(&cs_db_checks_);
 
-    return is_ready_for_cleanup_;
+    return is_ready_for_cleanup_;
+}
+
+// Makes this database slot empty.
+void ActiveDatabase::StartDeletion()
+{
+    // Deleting all associated info with this database from ports.
+    uint err_code = g_gateway.EraseDatabaseFromPorts(db_index_);
+    GW_ASSERT(0 == err_code);
+
+    // Resetting slot.
+    Reset(false);
+}
+
+// Acquires lock memory privilege and returns large page size (0 on failure).
+SIZE_T EnableLargePages()
+{
+    SIZE_T large_page_size = GetLargePageMinimum();
+    if (0 == large_page_size)
+        return 0;
+
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return 0;
+
+    TOKEN_PRIVILEGES tp;
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    BOOL success = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid) &&
+        AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL) &&
+        (ERROR_SUCCESS == GetLastError());
+
+    CloseHandle(token);
+
+    return success ? large_page_size : 0;
+}
+
+// Initializes a single worker without sockets and databases, used by microbenchmarks.
+GatewayWorker* Gateway::InitBenchmarkWorker(int32_t max_connections_per_worker)
+{
+    // Checking if already initialized.
+    GW_ASSERT((gw_workers_ == NULL) && (worker_thread_handles_ == NULL));
+
+    setting_num_workers_ = 1;
+    setting_max_connections_per_worker_ = max_connections_per_worker;
+
+    // Global HTTP init.
+    HttpGlobalInit();
+
+    AllocateWorkers();
+
+    int32_t err_code = gw_workers_[0].Init(0);
+    if (err_code)
+        return NULL;
+
+    return gw_workers_;
+}
+
+// Allocates workers, each one in memory of its NUMA node.
+void Gateway::AllocateWorkers()
+{
+    // Only reserving, worker pages are committed on worker nodes.
+    SIZE_T workers_size_bytes = sizeof(GatewayWorker) * setting_num_workers_;
+    uint8_t* workers_mem = (uint8_t*) VirtualAlloc(NULL, workers_size_bytes, MEM_RESERVE, PAGE_READWRITE);
+    GW_ASSERT(NULL != workers_mem);
+
+    for (int32_t i = 0; i < setting_num_workers_; i++)
+    {
+        uint8_t* worker_mem = workers_mem + sizeof(GatewayWorker) * i;
+
+        // NOTE: Page shared with previous worker stays on the node of the previous worker.
+        void* committed_mem = VirtualAllocExNuma(GetCurrentProcess(), worker_mem, sizeof(GatewayWorker),
+            MEM_COMMIT, PAGE_READWRITE, GetWorkerNumaNode(i));
+        GW_ASSERT(NULL != committed_mem);
+
+        new (worker_mem) GatewayWorker();
+    }
+
+    gw_workers_ = (GatewayWorker*) workers_mem;
+}
+
+// Destroys workers and releases their memory.
+void Gateway::DeleteWorkers()
+{
+    for (int32_t i = 0; i < setting_num_workers_; i++)
+        gw_workers_[i].~GatewayWorker();
+
+    VirtualFree(gw_workers_, 0, MEM_RELEASE);
+    gw_workers_ = NULL;
 }
 
-// Makes this database slot empty.
-void ActiveDatabase::StartDeletion()
+// Pins suspended thread to given logical processors and resumes it.
+void Gateway::PinAndResumeThread(HANDLE thread_handle, const std::vector<int32_t>& cpus)
 {
-    // Deleting all associated info with this database from ports.
-    uint err_code = g_gateway.EraseDatabaseFromPorts(db_index_);
-    GW_ASSERT(0 == err_code);
+    if (cpus.size())
+    {
+        uint32_t err_code = PinThreadToCpus(thread_handle, cpus);
+        if (err_code)
+            g_gateway.LogWriteWarning(L"Can't set gateway thread CPU affinity, processors should be in one processor group.");
+    }
 
-    // Resetting slot.
-    Reset(false);
+    ResumeThread(thread_handle);
 }
 
 // Initializes WinSock, all core data structures, binds server sockets.
@@ -2219,8 +3209,16 @@ uint32_t Gateway::Init()
     // Checking if already initialized.
     GW_ASSERT((gw_workers_ == NULL) && (worker_thread_handles_ == NULL));
 
+    // Enabling large pages for chunk slabs if requested.
+    if (setting_chunk_large_pages_)
+    {
+        large_page_size_ = EnableLargePages();
+        if (0 == large_page_size_)
+            g_gateway.LogWriteWarning(L"Can't use large pages for gateway chunks (SeLockMemoryPrivilege is needed), using normal pages.");
+    }
+
     // Allocating workers data.
-    gw_workers_ = GwNewArray(GatewayWorker, setting_num_workers_);
+    AllocateWorkers();
     worker_thread_handles_ = GwNewArray(HANDLE, setting_num_workers_);
 	worker_suspend_events_ = GwNewArray(HANDLE, setting_num_workers_);
 
@@ -2260,7 +3258,7 @@ uint32_t Gateway::Init()
         GW_ERR_CHECK(err_code);
     }
 
-    // Obtaining function pointers (AcceptEx, ConnectEx, DisconnectEx).
+    // Obtaining function pointers (AcceptEx, TransmitFile, ConnectEx, DisconnectEx).
     uint32_t temp;
     SOCKET temp_socket = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED);
     if (temp_socket == INVALID_SOCKET)
@@ -2275,6 +3273,12 @@ uint32_t Gateway::Init()
         return PrintLastError();
     }
 
+    if (WSAIoctl(temp_socket, SIO_GET_EXTENSION_FUNCTION_POINTER, &TransmitFileGuid, sizeof(TransmitFileGuid), &TransmitFileFunc, sizeof(TransmitFileFunc), (LPDWORD)&temp, NULL, NULL))
+    {
+        GW_COUT << "Failed WSAIoctl(TransmitFile)." << GW_ENDL;
+        return PrintLastError();
+    }
+
     if (WSAIoctl(temp_socket, SIO_GET_EXTENSION_FUNCTION_POINTER, &ConnectExGuid, sizeof(ConnectExGuid), &ConnectExFunc, sizeof(ConnectExFunc), (LPDWORD)&temp, NULL, NULL))
     {
         GW_COUT << "Failed WSAIoctl(ConnectEx)." << GW_ENDL;
@@ -2291,8 +3295,19 @@ uint32_t Gateway::Init()
     // Global HTTP init.
     HttpGlobalInit();
 
+    // Global HTTP/2 init.
+    Http2GlobalInit();
+
     // Initializing Gateway logger.
-    gw_log_writer_.Init(setting_log_file_path_);
+    gw_log_writer_.Init(setting_log_file_path_, setting_num_workers_);
+
+    // Starting traffic capture if configured.
+    if (!setting_traffic_capture_file_.empty())
+    {
+        uint32_t err_code = traffic_capture_.Init(setting_traffic_capture_file_, setting_num_workers_);
+        if (err_code)
+            return err_code;
+    }
     
     // Loading URI codegen matcher.
     codegen_uri_matcher_ = GwNewConstructor(CodegenUriMatcher);
@@ -2581,6 +3596,38 @@ uint32_t Gateway::RegisterGatewayHandlers() {
     if (err_code)
         return err_code;
 
+    // Registering URI handler for gateway metrics.
+    err_code = AddUriHandler(
+        &gw_workers_[0],
+        setting_internal_system_port_,
+        "gateway",
+        "GET /gw/metrics",
+        NULL,
+        0,
+        bmx::BMX_INVALID_HANDLER_INFO,
+        INVALID_DB_INDEX,
+        GatewayMetrics,
+        true);
+
+    if (err_code)
+        return err_code;
+
+    // Registering URI handler for sampled request traces.
+    err_code = AddUriHandler(
+        &gw_workers_[0],
+        setting_internal_system_port_,
+        "gateway",
+        "GET /gw/traces",
+        NULL,
+        0,
+        bmx::BMX_INVALID_HANDLER_INFO,
+        INVALID_DB_INDEX,
+        GatewayRequestTraces,
+        true);
+
+    if (err_code)
+        return err_code;
+
     // Registering URI handler for gateway statistics.
     err_code = AddUriHandler(
         &gw_workers_[0],
@@ -2597,6 +3644,22 @@ uint32_t Gateway::RegisterGatewayHandlers() {
     if (err_code)
         return err_code;
 
+    // Registering URI handler for gateway echo used by the load generator.
+    err_code = AddUriHandler(
+        &gw_workers_[0],
+        setting_internal_system_port_,
+        "gateway",
+        "POST /gw/echo",
+        NULL,
+        0,
+        bmx::BMX_INVALID_HANDLER_INFO,
+        INVALID_DB_INDEX,
+        GatewayEcho,
+        true);
+
+    if (err_code)
+        return err_code;
+
     // Registering URI handler for gateway statistics.
     err_code = AddUriHandler(
         &gw_workers_[0],
@@ -2669,6 +3732,74 @@ uint32_t Gateway::RegisterGatewayHandlers() {
     return 0;
 }
 
+// Names of latency stages in statistics.
+const char* const kLatencyStageNames[LATENCY_STAGE_COUNT] = {
+    "acceptToFirstByte",
+    "receiveToPush",
+    "pushToResponse",
+    "responseToSend"
+};
+
+// Printing latency percentiles merged from all workers.
+void Gateway::PrintLatencyStatistics(std::stringstream& str)
+{
+    const int32_t kNumPercentiles = 5;
+    const int64_t kPercentilesPerMille[kNumPercentiles] = { 500, 900, 990, 999, 1000 };
+    const char* const kPercentileNames[kNumPercentiles] = { "p50Us", "p90Us", "p99Us", "p999Us", "maxUs" };
+
+    int64_t merged_counts[LATENCY_HISTOGRAM_NUM_BUCKETS];
+
+    str << "{";
+
+    for (int32_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+    {
+        // Merging histograms of all workers.
+        for (int32_t i = 0; i < LATENCY_HISTOGRAM_NUM_BUCKETS; i++)
+            merged_counts[i] = 0;
+
+        for (int32_t w = 0; w < setting_num_workers_; w++)
+            gw_workers_[w].get_latency_histogram(stage)->AddTo(merged_counts);
+
+        int64_t total_count = 0;
+        for (int32_t i = 0; i < LATENCY_HISTOGRAM_NUM_BUCKETS; i++)
+            total_count += merged_counts[i];
+
+        if (stage > 0)
+            str << ",";
+
+        str << "\"" << kLatencyStageNames[stage] << "\":{\"count\":" << total_count;
+
+        // Going through buckets once for all percentiles.
+        int64_t cur_count = 0;
+        int32_t bucket = 0;
+
+        for (int32_t p = 0; p < kNumPercentiles; p++)
+        {
+            uint64_t value_us = 0;
+
+            if (total_count > 0)
+            {
+                // Rounding up so that percentile covers at least one value.
+                int64_t target_count = (total_count * kPercentilesPerMille[p] + 999) / 1000;
+
+                while (cur_count + merged_counts[bucket] < target_count)
+                {
+                    cur_count += merged_counts[bucket];
+                    bucket++;
+                }
+
+                value_us = LatencyHistogram::GetBucketHighestValue(bucket);
+            }
+
+            str << ",\"" << kPercentileNames[p] << "\":" << value_us;
+        }
+
+        str << "}";
+    }
+
+    str << "}";
+}
+
 // Printing statistics for all workers.
 void Gateway::PrintWorkersStatistics(std::stringstream& str)
 {
@@ -2794,6 +3925,50 @@ void Gateway::PrintReverseProxiesStatistics(std::stringstream& stats_stream)
     stats_stream << "]";
 }
 
+// Printing statistics for all TLS protected ports.
+void Gateway::PrintTlsPortsStatistics(std::stringstream& stats_stream)
+{
+    bool first = true;
+
+    // Emptying the statistics stream.
+    stats_stream.str(std::string());
+
+    // Going through all TLS ports.
+    stats_stream << "[";
+    for (int32_t i = 0; i < num_tls_ports_; i++)
+    {
+        if (!first)
+            stats_stream << ",";
+        first = false;
+
+        tls_ports_[i].PrintInfo(stats_stream);
+    }
+
+    stats_stream << "]";
+}
+
+// Printing statistics for all static files routes.
+void Gateway::PrintStaticRoutesStatistics(std::stringstream& stats_stream)
+{
+    bool first = true;
+
+    // Emptying the statistics stream.
+    stats_stream.str(std::string());
+
+    // Going through all static routes.
+    stats_stream << "[";
+    for (int32_t r = 0; r < num_static_routes_; r++)
+    {
+        if (!first)
+            stats_stream << ",";
+        first = false;
+
+        static_routes_[r].PrintInfo(stats_stream);
+    }
+
+    stats_stream << "]";
+}
+
 // Printing statistics for all databases.
 void Gateway::PrintDatabaseStatistics(std::stringstream& stats_stream)
 {
@@ -2891,7 +4066,10 @@ std::string Gateway::GetGatewayStatisticsString()
     std::stringstream port_statistics_stream;
     std::stringstream databases_statistics_stream;
     std::stringstream reverse_proxies_statistics_stream;
+    std::stringstream static_routes_statistics_stream;
+    std::stringstream tls_ports_statistics_stream;
     std::stringstream workers_statistics_stream;
+    std::stringstream latency_statistics_stream;
 
     EnterCriticalSection(&cs_statistics_);
 
@@ -2904,9 +4082,18 @@ std::string Gateway::GetGatewayStatisticsString()
     // Printing reverse proxies statistics.
     PrintReverseProxiesStatistics(reverse_proxies_statistics_stream);
 
+    // Printing static routes statistics.
+    PrintStaticRoutesStatistics(static_routes_statistics_stream);
+
+    // Printing TLS ports statistics.
+    PrintTlsPortsStatistics(tls_ports_statistics_stream);
+
     // Printing workers statistics.
     PrintWorkersStatistics(workers_statistics_stream);
 
+    // Printing latency statistics.
+    PrintLatencyStatistics(latency_statistics_stream);
+
     // Filing everything into one stream.
     std::stringstream stats_body_stream;
 
@@ -2921,9 +4108,18 @@ std::string Gateway::GetGatewayStatisticsString()
     stats_body_stream << ",\"workers\":";
     stats_body_stream << workers_statistics_stream.str();
 
+    stats_body_stream << ",\"latency\":";
+    stats_body_stream << latency_statistics_stream.str();
+
     stats_body_stream << ",\"reverseproxies\":";
     stats_body_stream << reverse_proxies_statistics_stream.str();
 
+    stats_body_stream << ",\"staticroutes\":";
+    stats_body_stream << static_routes_statistics_stream.str();
+
+    stats_body_stream << ",\"tlsports\":";
+    stats_body_stream << tls_ports_statistics_stream.str();
+
     stats_body_stream << ",\"global\":";
     stats_body_stream << global_statistics_stream_.str();
 
@@ -2942,6 +4138,212 @@ std::string Gateway::GetGatewayStatisticsString()
     return all_stats_stream.str();
 }
 
+// Completed request traces in Chrome trace JSON format.
+// NOTE: Traces rings are read without locks, so a trace that is
+// overwritten by its worker while printing can appear inconsistent.
+std::string Gateway::GetRequestTracesString()
+{
+    std::stringstream str;
+
+    // Naming gateway and codehosts processes.
+    str << "{\"traceEvents\":[";
+    str << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"gateway\"}}";
+
+    for (int32_t d = 0; d < num_dbs_slots_; d++)
+    {
+        if (!active_databases_[d].IsEmpty())
+        {
+            str << ",{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << (d + 1)
+                << ",\"args\":{\"name\":\"" << active_databases_[d].get_db_name() << "\"}}";
+        }
+    }
+
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+        gw_workers_[w].PrintRequestTraces(str);
+
+    str << "],\"displayTimeUnit\":\"ms\"}";
+
+    std::string traces_body_string = str.str();
+
+    std::stringstream traces_stream;
+    traces_stream << "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Cache-control: no-store\r\n"
+        "Content-Length: " << traces_body_string.length() << "\r\n\r\n" << traces_body_string;
+
+    return traces_stream.str();
+}
+
+// Current gateway metrics in Prometheus text format.
+// NOTE: Should be called under global lock: other workers own the database
+// interfaces read here and delete them when a database goes down.
+std::string Gateway::GetGatewayMetricsString()
+{
+    std::stringstream m;
+
+    m << "# TYPE gateway_received_bytes_total counter\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+        m << "gateway_received_bytes_total{worker=\"" << w << "\"} " << gw_workers_[w].get_worker_stats_bytes_received() << "\n";
+
+    m << "# TYPE gateway_sent_bytes_total counter\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+        m << "gateway_sent_bytes_total{worker=\"" << w << "\"} " << gw_workers_[w].get_worker_stats_bytes_sent() << "\n";
+
+    m << "# TYPE gateway_receives_total counter\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+        m << "gateway_receives_total{worker=\"" << w << "\"} " << gw_workers_[w].get_worker_stats_recv_num() << "\n";
+
+    m << "# TYPE gateway_sends_total counter\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+        m << "gateway_sends_total{worker=\"" << w << "\"} " << gw_workers_[w].get_worker_stats_sent_num() << "\n";
+
+    m << "# TYPE gateway_http_requests_total counter\n";
+    m << "gateway_http_requests_total " << get_num_processed_http_requests() << "\n";
+
+    // Last second rates calculated by statistics thread.
+    m << "# TYPE gateway_receives_per_second gauge\n";
+    m << "gateway_receives_per_second " << last_second_recv_num_ << "\n";
+    m << "# TYPE gateway_sends_per_second gauge\n";
+    m << "gateway_sends_per_second " << last_second_sent_num_ << "\n";
+    m << "# TYPE gateway_received_bytes_per_second gauge\n";
+    m << "gateway_received_bytes_per_second " << last_second_bytes_received_ << "\n";
+    m << "# TYPE gateway_sent_bytes_per_second gauge\n";
+    m << "gateway_sent_bytes_per_second " << last_second_bytes_sent_ << "\n";
+    m << "# TYPE gateway_http_requests_per_second gauge\n";
+    m << "gateway_http_requests_per_second " << last_second_http_requests_ << "\n";
+
+    // Chunk stores usage.
+    m << "# TYPE gateway_chunks_allocated gauge\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+    {
+        for (chunk_store_type i = 0; i < NumGatewayChunkSizes; i++)
+        {
+            m << "gateway_chunks_allocated{worker=\"" << w << "\",store=\"" << GatewayChunkSizes[i] << "\"} "
+                << gw_workers_[w].GetWorkerChunks()->GetNumberAllocatedChunks(i) << "\n";
+        }
+    }
+
+    m << "# TYPE gateway_chunks_free gauge\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+    {
+        for (chunk_store_type i = 0; i < NumGatewayChunkSizes; i++)
+        {
+            m << "gateway_chunks_free{worker=\"" << w << "\",store=\"" << GatewayChunkSizes[i] << "\"} "
+                << gw_workers_[w].GetWorkerChunks()->GetNumberFreeChunks(i) << "\n";
+        }
+    }
+
+    m << "# TYPE gateway_chunk_hits_total counter\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+    {
+        for (chunk_store_type i = 0; i < NumGatewayChunkSizes; i++)
+        {
+            m << "gateway_chunk_hits_total{worker=\"" << w << "\",store=\"" << GatewayChunkSizes[i] << "\"} "
+                << gw_workers_[w].GetWorkerChunks()->GetNumberChunkHits(i) << "\n";
+        }
+    }
+
+    m << "# TYPE gateway_chunk_misses_total counter\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+    {
+        for (chunk_store_type i = 0; i < NumGatewayChunkSizes; i++)
+        {
+            m << "gateway_chunk_misses_total{worker=\"" << w << "\",store=\"" << GatewayChunkSizes[i] << "\"} "
+                << gw_workers_[w].GetWorkerChunks()->GetNumberChunkMisses(i) << "\n";
+        }
+    }
+
+    // Overflow queues depths.
+    m << "# TYPE gateway_overflow_chunks gauge\n";
+    for (int32_t w = 0; w < setting_num_workers_; w++)
+        m << "gateway_overflow_chunks{worker=\"" << w << "\"} " << gw_workers_[w].NumOverflowChunks() << "\n";
+
+    // Databases IPC chunks and channels depths.
+    m << "# TYPE gateway_db_available_ipc_chunks gauge\n";
+    for (int32_t d = 0; d < num_dbs_slots_; d++)
+    {
+        if (active_databases_[d].IsEmpty())
+            continue;
+
+        for (int32_t w = 0; w < setting_num_workers_; w++)
+        {
+            WorkerDbInterface* db = gw_workers_[w].GetWorkerDb(d);
+            if (NULL == db)
+                continue;
+
+            m << "gateway_db_available_ipc_chunks{db=\"" << active_databases_[d].get_db_name() << "\",worker=\"" << w << "\"} "
+                << db->GetNumberAvailableChunks() << "\n";
+        }
+    }
+
+    m << "# TYPE gateway_db_channel_in_depth gauge\n";
+    for (int32_t d = 0; d < num_dbs_slots_; d++)
+    {
+        if (active_databases_[d].IsEmpty())
+            continue;
+
+        for (int32_t w = 0; w < setting_num_workers_; w++)
+        {
+            WorkerDbInterface* db = gw_workers_[w].GetWorkerDb(d);
+            if (NULL == db)
+                continue;
+
+            for (int32_t s = 0; s < db->get_num_schedulers(); s++)
+            {
+                m << "gateway_db_channel_in_depth{db=\"" << active_databases_[d].get_db_name() << "\",worker=\"" << w << "\",scheduler=\"" << s << "\"} "
+                    << db->GetChannelInDepth(s) << "\n";
+            }
+        }
+    }
+
+    m << "# TYPE gateway_db_channel_out_depth gauge\n";
+    for (int32_t d = 0; d < num_dbs_slots_; d++)
+    {
+        if (active_databases_[d].IsEmpty())
+            continue;
+
+        for (int32_t w = 0; w < setting_num_workers_; w++)
+        {
+            WorkerDbInterface* db = gw_workers_[w].GetWorkerDb(d);
+            if (NULL == db)
+                continue;
+
+            for (int32_t s = 0; s < db->get_num_schedulers(); s++)
+            {
+                m << "gateway_db_channel_out_depth{db=\"" << active_databases_[d].get_db_name() << "\",worker=\"" << w << "\",scheduler=\"" << s << "\"} "
+                    << db->GetChannelOutDepth(s) << "\n";
+            }
+        }
+    }
+
+    m << "# TYPE gateway_log_dropped_records_total counter\n";
+    m << "gateway_log_dropped_records_total " << gw_log_writer_.GetNumberOfDroppedRecords() << "\n";
+
+    // Active connections on each port.
+    m << "# TYPE gateway_port_active_connections gauge\n";
+    for (int32_t p = 0; p < num_server_ports_slots_; p++)
+    {
+        if (server_ports_[p].IsEmpty())
+            continue;
+
+        for (int32_t w = 0; w < setting_num_workers_; w++)
+        {
+            m << "gateway_port_active_connections{port=\"" << server_ports_[p].get_port_number() << "\",worker=\"" << w << "\"} "
+                << server_ports_[p].GetNumberOfActiveSocketsForWorker(w) << "\n";
+        }
+    }
+
+    std::string metrics_body_string = m.str();
+
+    std::stringstream metrics_stream;
+    metrics_stream << "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Cache-control: no-store\r\n"
+        "Content-Length: " << metrics_body_string.length() << "\r\n\r\n" << metrics_body_string;
+
+    return metrics_stream.str();
+}
+
 // Check and wait for global lock.
 void Gateway::SuspendWorker(GatewayWorker* gw)
 {
@@ -3206,6 +4608,9 @@ uint32_t __stdcall GatewayWorkerRoutine(LPVOID params)
 	// Catching all unhandled exceptions in this thread.
 	GW_SC_BEGIN_FUNC
 
+    // Worker logs into its own ring.
+    g_gateway.get_gw_log_writer()->SetCurrentThreadRing(((GatewayWorker *)params)->get_worker_id());
+
     uint32_t err_code = ((GatewayWorker *)params)->WorkerRoutine();
 
     wchar_t temp[256];
@@ -3252,10 +4657,19 @@ uint32_t __stdcall GatewayLoggingRoutine(LPVOID params)
     // Catching all unhandled exceptions in this thread.
     GW_SC_BEGIN_FUNC
 
+    GatewayTrafficCapture* traffic_capture = g_gateway.get_traffic_capture();
+
     while (true)
     {
-        // Sleeping some interval.
-        Sleep(5000);
+        // Sleeping some interval, shorter one when capturing since capture rings fill much faster.
+        if (traffic_capture->IsEnabled())
+            Sleep(20);
+        else
+            Sleep(500);
+
+        // Dumping captured traffic.
+        if (traffic_capture->IsEnabled())
+            traffic_capture->DumpToFile();
 
         // Dumping to gateway log file (if anything new was logged).
 #ifdef GW_LOG_TO_FILE
@@ -3290,6 +4704,10 @@ uint32_t __stdcall GatewayMonitorRoutine(LPVOID params)
 // Cleaning up all global resources.
 uint32_t Gateway::GlobalCleanup()
 {
+    // Releasing TLS credentials.
+    for (int32_t i = 0; i < num_tls_ports_; i++)
+        TlsReleaseCredentials(tls_ports_ + i);
+
     // Cleanup WinSock.
     WSACleanup();
 
@@ -3434,6 +4852,13 @@ uint32_t Gateway::StatisticsAndMonitoringRoutine()
         prevRecvNumAllWorkers = newRecvNumAllWorkers;
         prevProcessedHttpRequestsAllWorkers = newProcessedHttpRequestsAllWorkers;
 
+        // Publishing last second rates for metrics.
+        last_second_recv_num_ = diffRecvNumAllWorkers;
+        last_second_sent_num_ = diffSentNumAllWorkers;
+        last_second_bytes_received_ = diffBytesReceivedAllWorkers;
+        last_second_bytes_sent_ = diffBytesSentAllWorkers;
+        last_second_http_requests_ = diffProcessedHttpRequestsAllWorkers;
+
         // Calculating bandwidth.
         double recv_bandwidth_mbit_total = ((diffBytesReceivedAllWorkers * 8) / 1000000.0);
         double send_bandwidth_mbit_total = ((diffBytesSentAllWorkers * 8) / 1000000.0);
@@ -3502,6 +4927,7 @@ uint32_t Gateway::StatisticsAndMonitoringRoutine()
                     << "{\"port\":" << server_ports_[p].get_port_number() 
                     << ",\"activeSockets\":" << server_ports_[p].NumberOfActiveSockets()
                     << ",\"acceptingSockets\":" << server_ports_[p].get_num_accepting_sockets()
+                    << ",\"acceptRoof\":" << server_ports_[p].get_accept_roof()
 
                     << "}";
             }
@@ -3546,11 +4972,18 @@ uint32_t Gateway::StartWorkerAndManagementThreads(
             0, // Use default stack size.
             workerRoutine, // Thread function name.
             &gw_workers_[i], // Argument to thread function.
-            0, // Use default creation flags.
+            CREATE_SUSPENDED, // Started after pinning.
             (LPDWORD)&worker_thread_ids[i]); // Returns the thread identifier.
 
         // Checking if threads are created.
         GW_ASSERT(worker_thread_handles_[i] != NULL);
+
+        // Pinning worker to its processor.
+        std::vector<int32_t> worker_cpus;
+        if (i < static_cast<int32_t>(setting_worker_cpus_.size()))
+            worker_cpus.push_back(setting_worker_cpus_[i]);
+
+        PinAndResumeThread(worker_thread_handles_[i], worker_cpus);
     }
 
 #ifdef USE_OLD_IPC_MONITOR
@@ -3563,12 +4996,14 @@ uint32_t Gateway::StartWorkerAndManagementThreads(
         0, // Use default stack size.
         monitorDatabasesRoutine, // Thread function name.
         NULL, // Argument to thread function.
-        0, // Use default creation flags.
+        CREATE_SUSPENDED, // Started after pinning.
         (LPDWORD)&dbScanThreadId); // Returns the thread identifier.
 
     // Checking if thread is created.
     GW_ASSERT(db_monitor_thread_handle_ != NULL);
 
+    PinAndResumeThread(db_monitor_thread_handle_, setting_monitor_thread_cpus_);
+
 #endif
 
     uint32_t inactiveSocketsCleanupThreadId;
@@ -3579,12 +5014,14 @@ uint32_t Gateway::StartWorkerAndManagementThreads(
         0, // Use default stack size.
         inactiveSocketsCleanupRoutine, // Thread function name.
         NULL, // Argument to thread function.
-        0, // Use default creation flags.
+        CREATE_SUSPENDED, // Started after pinning.
         (LPDWORD)&inactiveSocketsCleanupThreadId); // Returns the thread identifier.
 
     // Checking if thread is created.
     GW_ASSERT(dead_sockets_cleanup_thread_handle_ != NULL);
 
+    PinAndResumeThread(dead_sockets_cleanup_thread_handle_, setting_monitor_thread_cpus_);
+
     uint32_t gatewayLogRoutineThreadId;
 
     // Starting dead sockets cleanup thread.
@@ -3593,24 +5030,35 @@ uint32_t Gateway::StartWorkerAndManagementThreads(
         0, // Use default stack size.
         gatewayLoggingRoutine, // Thread function name.
         NULL, // Argument to thread function.
-        0, // Use default creation flags.
+        CREATE_SUSPENDED, // Started after pinning.
         (LPDWORD)&gatewayLogRoutineThreadId); // Returns the thread identifier.
 
     // Checking if thread is created.
     GW_ASSERT(gateway_logging_thread_handle_ != NULL);
 
+    PinAndResumeThread(gateway_logging_thread_handle_, setting_logging_thread_cpus_);
+
     // Starting dead sockets cleanup thread.
     all_threads_monitor_handle_ = CreateThread(
         NULL, // Default security attributes.
         0, // Use default stack size.
         allThreadsMonitorRoutine, // Thread function name.
         NULL, // Argument to thread function.
-        0, // Use default creation flags.
+        CREATE_SUSPENDED, // Started after pinning.
         (LPDWORD)&gatewayLogRoutineThreadId); // Returns the thread identifier.
 
     // Checking if thread is created.
     GW_ASSERT(all_threads_monitor_handle_ != NULL);
 
+    PinAndResumeThread(all_threads_monitor_handle_, setting_monitor_thread_cpus_);
+
+    // Statistics are printed on this thread, pinning it together with other monitoring threads.
+    if (setting_monitor_thread_cpus_.size())
+    {
+        if (PinThreadToCpus(GetCurrentThread(), setting_monitor_thread_cpus_))
+            g_gateway.LogWriteWarning(L"Can't set gateway thread CPU affinity, processors should be in one processor group.");
+    }
+
     // Printing statistics.
     uint32_t err_code = g_gateway.StatisticsAndMonitoringRoutine();
 
@@ -3620,8 +5068,7 @@ uint32_t Gateway::StartWorkerAndManagementThreads(
 
     GwDeleteArray(worker_thread_ids);
     GwDeleteArray(worker_thread_handles_);
-    GwDeleteArray(gw_workers_);
-    gw_workers_ = NULL;
+    DeleteWorkers();
 
     // Checking if any error occurred.
     GW_ERR_CHECK(err_code);
@@ -3634,10 +5081,7 @@ Gateway::~Gateway()
 {
     // Deleting only necessary stuff.
     if (gw_workers_)
-    {
-        GwDeleteArray(gw_workers_);
-        gw_workers_ = NULL;
-    }
+        DeleteWorkers();
 }
 
 int32_t Gateway::StartGateway()
@@ -4111,6 +5555,8 @@ VOID LogGatewayCrash(VOID *pc, const char *str)
     starcounter::network::g_gateway.LogWriteCritical(str);
 }
 
+#ifndef GW_BENCHMARKS
+
 int wmain(int argc, wchar_t* argv[], wchar_t* envp[])
 {
     // Catching all unhandled exceptions in this thread.
@@ -4147,4 +5593,5 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[])
 
     // Catching all unhandled exceptions in this thread.
     GW_SC_END_FUNC
-}
\ No newline at end of file
+}
+#endif // GW_BENCHMARKS
@@ -2,6 +2,8 @@
 #include "gateway.hpp"
 #include "handlers.hpp"
 #include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
 #include "http_proto.hpp"
 #include "socket_data.hpp"
 #include "worker_db_interface.hpp"
@@ -80,7 +82,7 @@ uint32_t UdpPortProcessData(
         sd->SetUserData(sd->get_data_blob_start(), sd->get_accumulated_len_bytes());
 
         // Setting matched URI index.
-        sd->SetDestDbIndex(hl->get_db_index());
+        sd->SetDestDbIndex(gw, hl->get_db_index());
 
         // Checking if we need to send back UDP datagram here.
         if (sd->GetPortNumber() == 55555) {
@@ -103,8 +105,8 @@ uint32_t UdpPortProcessData(
             if (err_code)
                 return err_code;
 
-            // Push chunk to corresponding channel/scheduler.
-            err_code = gw->PushSocketDataToDb(sd, user_handler_id, false);
+            // Datagram is pushed together with others received in this worker iteration.
+            err_code = gw->AddToUdpBatch(sd, user_handler_id);
             if (err_code)
                 return err_code;
         }
@@ -170,7 +172,7 @@ uint32_t TcpPortProcessData(
         sd->SetUserData(sd->get_data_blob_start(), sd->get_accumulated_len_bytes());
 
         // Setting matched URI index.
-        sd->SetDestDbIndex(hl->get_db_index());
+        sd->SetDestDbIndex(gw, hl->get_db_index());
 
         // Posting cloning receive since all data is accumulated.
         err_code = sd->CloneToReceive(gw);
@@ -0,0 +1,2081 @@
+#include "static_headers.hpp"
+#include "gateway.hpp"
+#include "handlers.hpp"
+#include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
+#include "http_proto.hpp"
+#include "socket_data.hpp"
+#include "worker_db_interface.hpp"
+#include "worker.hpp"
+
+namespace starcounter {
+namespace network {
+
+// HPACK static table (RFC 7541, Appendix A).
+const char* const kHpackStaticTable[kHpackStaticTableSize][2] = {
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" }
+};
+
+// Lengths of HPACK Huffman codes for every symbol (RFC 7541, Appendix B).
+// NOTE: Codes are canonical, so lengths are enough to rebuild them.
+const uint8_t kHpackHuffmanCodeLengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30
+};
+
+// Longest HPACK Huffman code.
+const int32_t kHpackHuffmanMaxCodeLength = 30;
+
+// End of string symbol that must never be decoded.
+const int32_t kHpackHuffmanEos = 256;
+
+// Canonical Huffman decoding tables indexed by code length.
+uint32_t g_hpack_huffman_first_code[kHpackHuffmanMaxCodeLength + 1];
+uint16_t g_hpack_huffman_first_index[kHpackHuffmanMaxCodeLength + 1];
+uint16_t g_hpack_huffman_count[kHpackHuffmanMaxCodeLength + 1];
+
+// Symbols sorted by code length and symbol value.
+uint16_t g_hpack_huffman_symbols[257];
+
+// Builds HPACK Huffman decoding tables.
+void Http2GlobalInit()
+{
+    memset(g_hpack_huffman_count, 0, sizeof(g_hpack_huffman_count));
+
+    for (int32_t s = 0; s <= kHpackHuffmanEos; s++)
+        g_hpack_huffman_count[kHpackHuffmanCodeLengths[s]]++;
+
+    // Assigning first code of each length the canonical way.
+    uint32_t code = 0;
+    uint16_t index = 0;
+    for (int32_t len = 1; len <= kHpackHuffmanMaxCodeLength; len++)
+    {
+        code = (code + g_hpack_huffman_count[len - 1]) << 1;
+        g_hpack_huffman_first_code[len] = code;
+        g_hpack_huffman_first_index[len] = index;
+        index += g_hpack_huffman_count[len];
+    }
+
+    uint16_t next_index[kHpackHuffmanMaxCodeLength + 1];
+    memcpy(next_index, g_hpack_huffman_first_index, sizeof(next_index));
+
+    for (int32_t s = 0; s <= kHpackHuffmanEos; s++)
+        g_hpack_huffman_symbols[next_index[kHpackHuffmanCodeLengths[s]]++] = (uint16_t) s;
+}
+
+// Decodes Huffman encoded string.
+uint32_t HpackHuffmanDecode(const uint8_t* data, uint32_t data_len, std::string* out)
+{
+    uint32_t code = 0;
+    int32_t code_len = 0;
+
+    for (uint32_t i = 0; i < data_len; i++)
+    {
+        for (int32_t bit = 7; bit >= 0; bit--)
+        {
+            code = (code << 1) | ((data[i] >> bit) & 1);
+            code_len++;
+
+            if (code_len > kHpackHuffmanMaxCodeLength)
+                return SCERRGWHTTPPROCESSFAILED;
+
+            // NOTE: Codes below the first code of this length wrap around and fail the check.
+            uint32_t offset = code - g_hpack_huffman_first_code[code_len];
+            if (offset < g_hpack_huffman_count[code_len])
+            {
+                uint16_t symbol = g_hpack_huffman_symbols[g_hpack_huffman_first_index[code_len] + offset];
+                if (kHpackHuffmanEos == symbol)
+                    return SCERRGWHTTPPROCESSFAILED;
+
+                out->push_back((char) symbol);
+
+                code = 0;
+                code_len = 0;
+            }
+        }
+    }
+
+    // Padding must be shorter than a byte and consist of EOS prefix (all ones).
+    if ((code_len > 7) || (code != (1u << code_len) - 1))
+        return SCERRGWHTTPPROCESSFAILED;
+
+    return 0;
+}
+
+// Decodes HPACK integer with given prefix.
+uint32_t HpackDecodeInteger(const uint8_t** pos, const uint8_t* end, int32_t prefix_bits, uint32_t* value)
+{
+    const uint8_t* p = *pos;
+    if (p >= end)
+        return SCERRGWHTTPPROCESSFAILED;
+
+    uint32_t max_prefix = (1u << prefix_bits) - 1;
+    uint64_t v = *p & max_prefix;
+    p++;
+
+    if (v == max_prefix)
+    {
+        int32_t shift = 0;
+        while (true)
+        {
+            if (p >= end)
+                return SCERRGWHTTPPROCESSFAILED;
+
+            uint8_t b = *p;
+            p++;
+
+            v += (uint64_t) (b & 0x7F) << shift;
+            shift += 7;
+
+            // Values used in HTTP/2 always fit into 31 bits.
+            if (v > kHttp2MaxWindow)
+                return SCERRGWHTTPPROCESSFAILED;
+
+            if (0 == (b & 0x80))
+                break;
+
+            if (shift > 28)
+                return SCERRGWHTTPPROCESSFAILED;
+        }
+    }
+
+    *value = (uint32_t) v;
+    *pos = p;
+
+    return 0;
+}
+
+// Encodes HPACK integer with given prefix and first byte flags.
+void HpackEncodeInteger(std::string* out, uint8_t first_byte_flags, int32_t prefix_bits, uint32_t value)
+{
+    uint32_t max_prefix = (1u << prefix_bits) - 1;
+
+    if (value < max_prefix)
+    {
+        out->push_back((char) (first_byte_flags | value));
+        return;
+    }
+
+    out->push_back((char) (first_byte_flags | max_prefix));
+    value -= max_prefix;
+
+    while (value >= 0x80)
+    {
+        out->push_back((char) ((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+
+    out->push_back((char) value);
+}
+
+// Encodes response status.
+void HpackEncodeStatus(std::string* out, int32_t status_code)
+{
+    // Fully indexed statuses from static table.
+    for (uint32_t i = 7; i < 14; i++)
+    {
+        const char* value = kHpackStaticTable[i][1];
+        if (status_code == atoi(value))
+        {
+            HpackEncodeInteger(out, 0x80, 7, i + 1);
+            return;
+        }
+    }
+
+    char status_str[16];
+    int32_t status_len = WriteUIntToString(status_str, status_code);
+
+    // Literal without indexing with ":status" name from static table.
+    HpackEncodeInteger(out, 0x00, 4, 8);
+    HpackEncodeInteger(out, 0x00, 7, status_len);
+    out->append(status_str, status_len);
+}
+
+// Encodes header field as literal without indexing.
+void HpackEncodeHeader(std::string* out, const char* name, uint32_t name_len, const char* value, uint32_t value_len)
+{
+    uint32_t name_index = 0;
+
+    // Looking for the name in static table (regular headers start after pseudo-headers).
+    for (uint32_t i = 14; i < kHpackStaticTableSize; i++)
+    {
+        const char* static_name = kHpackStaticTable[i][0];
+        if ((strlen(static_name) == name_len) && (0 == memcmp(static_name, name, name_len)))
+        {
+            name_index = i + 1;
+            break;
+        }
+    }
+
+    HpackEncodeInteger(out, 0x00, 4, name_index);
+
+    if (0 == name_index)
+    {
+        HpackEncodeInteger(out, 0x00, 7, name_len);
+        out->append(name, name_len);
+    }
+
+    HpackEncodeInteger(out, 0x00, 7, value_len);
+    out->append(value, value_len);
+}
+
+// Decodes string literal.
+uint32_t HpackDecoder::DecodeString(const uint8_t** pos, const uint8_t* end, std::string* out)
+{
+    if (*pos >= end)
+        return SCERRGWHTTPPROCESSFAILED;
+
+    bool huffman = (0 != (**pos & 0x80));
+
+    uint32_t len;
+    uint32_t err_code = HpackDecodeInteger(pos, end, 7, &len);
+    if (err_code)
+        return err_code;
+
+    if (len > static_cast<uint32_t>(end - *pos))
+        return SCERRGWHTTPPROCESSFAILED;
+
+    out->clear();
+
+    if (huffman)
+    {
+        err_code = HpackHuffmanDecode(*pos, len, out);
+        if (err_code)
+            return err_code;
+    }
+    else
+    {
+        out->assign((const char*) *pos, len);
+    }
+
+    *pos += len;
+
+    return 0;
+}
+
+// Gets table entry by HPACK index.
+uint32_t HpackDecoder::GetEntry(uint32_t index, HpackField* field)
+{
+    if (0 == index)
+        return SCERRGWHTTPPROCESSFAILED;
+
+    if (index <= kHpackStaticTableSize)
+    {
+        field->name_ = kHpackStaticTable[index - 1][0];
+        field->name_len_ = static_cast<uint32_t>(strlen(field->name_));
+        field->value_ = kHpackStaticTable[index - 1][1];
+        field->value_len_ = static_cast<uint32_t>(strlen(field->value_));
+
+        return 0;
+    }
+
+    index -= kHpackStaticTableSize + 1;
+    if (index >= dynamic_table_.size())
+        return SCERRGWHTTPPROCESSFAILED;
+
+    HpackEntry& entry = dynamic_table_[index];
+    field->name_ = entry.name_.data();
+    field->name_len_ = static_cast<uint32_t>(entry.name_.length());
+    field->value_ = entry.value_.data();
+    field->value_len_ = static_cast<uint32_t>(entry.value_.length());
+
+    return 0;
+}
+
+// Evicts entries until given number of bytes fits into table.
+void HpackDecoder::Evict(uint32_t num_needed_bytes)
+{
+    while ((!dynamic_table_.empty()) && (table_size_ + num_needed_bytes > max_table_size_))
+    {
+        HpackEntry& entry = dynamic_table_.back();
+        table_size_ -= static_cast<uint32_t>(entry.name_.length() + entry.value_.length() + 32);
+        dynamic_table_.pop_back();
+    }
+}
+
+// Adds decoded literal to dynamic table.
+void HpackDecoder::AddEntry()
+{
+    uint32_t entry_size = static_cast<uint32_t>(name_buf_.length() + value_buf_.length() + 32);
+
+    // Entry bigger than the table just empties it.
+    if (entry_size > max_table_size_)
+    {
+        dynamic_table_.clear();
+        table_size_ = 0;
+        return;
+    }
+
+    Evict(entry_size);
+
+    dynamic_table_.push_front(HpackEntry());
+    dynamic_table_.front().name_ = name_buf_;
+    dynamic_table_.front().value_ = value_buf_;
+
+    table_size_ += entry_size;
+}
+
+// Decodes next representation from header block.
+uint32_t HpackDecoder::DecodeField(const uint8_t** pos, const uint8_t* end, HpackField* field, bool* has_field)
+{
+    uint32_t err_code, index;
+    uint8_t b = **pos;
+
+    *has_field = false;
+
+    // Indexed header field.
+    if (b & 0x80)
+    {
+        err_code = HpackDecodeInteger(pos, end, 7, &index);
+        if (err_code)
+            return err_code;
+
+        err_code = GetEntry(index, field);
+        if (err_code)
+            return err_code;
+
+        *has_field = true;
+
+        return 0;
+    }
+
+    // Dynamic table size update.
+    if (0x20 == (b & 0xE0))
+    {
+        uint32_t max_size;
+        err_code = HpackDecodeInteger(pos, end, 5, &max_size);
+        if (err_code)
+            return err_code;
+
+        // Encoder can't use more than we announced.
+        if (max_size > kHpackDefaultTableSize)
+            return SCERRGWHTTPPROCESSFAILED;
+
+        max_table_size_ = max_size;
+        Evict(0);
+
+        return 0;
+    }
+
+    // Literal header field with incremental indexing, without indexing or never indexed.
+    bool add_to_table = (0x40 == (b & 0xC0));
+
+    err_code = HpackDecodeInteger(pos, end, add_to_table ? 6 : 4, &index);
+    if (err_code)
+        return err_code;
+
+    if (0 == index)
+    {
+        err_code = DecodeString(pos, end, &name_buf_);
+        if (err_code)
+            return err_code;
+    }
+    else
+    {
+        HpackField name_field;
+        err_code = GetEntry(index, &name_field);
+        if (err_code)
+            return err_code;
+
+        name_buf_.assign(name_field.name_, name_field.name_len_);
+    }
+
+    err_code = DecodeString(pos, end, &value_buf_);
+    if (err_code)
+        return err_code;
+
+    if (add_to_table)
+        AddEntry();
+
+    field->name_ = name_buf_.data();
+    field->name_len_ = static_cast<uint32_t>(name_buf_.length());
+    field->value_ = value_buf_.data();
+    field->value_len_ = static_cast<uint32_t>(value_buf_.length());
+
+    *has_field = true;
+
+    return 0;
+}
+
+// Checks if header is specific to HTTP/1.1 connection and can't be used with HTTP/2.
+bool Http2IsConnectionSpecificHeader(const char* name, uint32_t name_len)
+{
+    switch (name_len)
+    {
+        case 2:
+            return (0 == _strnicmp(name, "te", 2));
+
+        case 7:
+            return (0 == _strnicmp(name, "upgrade", 7));
+
+        case 10:
+            return (0 == _strnicmp(name, "connection", 10)) ||
+                (0 == _strnicmp(name, "keep-alive", 10));
+
+        case 16:
+            return (0 == _strnicmp(name, "proxy-connection", 16));
+
+        case 17:
+            return (0 == _strnicmp(name, "transfer-encoding", 17));
+    }
+
+    return false;
+}
+
+// Checks if header name equals given lower case string.
+inline bool Http2HeaderNameEquals(const char* name, uint32_t name_len, const char* lower_name, uint32_t lower_name_len)
+{
+    return (name_len == lower_name_len) && (0 == _strnicmp(name, lower_name, name_len));
+}
+
+// Checks if character is allowed in HTTP token (RFC 9110 5.6.2).
+inline bool Http2IsTokenChar(uint8_t c)
+{
+    if (((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')))
+        return true;
+
+    return (NULL != strchr("!#$%&'*+-.^_`|~", c)) && (0 != c);
+}
+
+// Checks if value is a non-empty HTTP token.
+bool Http2IsToken(const char* s, uint32_t len)
+{
+    if (0 == len)
+        return false;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if (!Http2IsTokenChar((uint8_t) s[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// Checks field name: lower case token, colon allowed only as first character of pseudo-header.
+bool Http2IsValidFieldName(const char* name, uint32_t name_len)
+{
+    if (0 == name_len)
+        return false;
+
+    for (uint32_t i = 0; i < name_len; i++)
+    {
+        uint8_t c = (uint8_t) name[i];
+
+        if ((':' == c) && (0 == i) && (name_len > 1))
+            continue;
+
+        if ((!Http2IsTokenChar(c)) || ((c >= 'A') && (c <= 'Z')))
+            return false;
+    }
+
+    return true;
+}
+
+// Checks field value: no NUL, CR or LF, and no leading or trailing whitespace.
+bool Http2IsValidFieldValue(const char* value, uint32_t value_len)
+{
+    if (value_len > 0)
+    {
+        if ((' ' == value[0]) || ('\t' == value[0]) ||
+            (' ' == value[value_len - 1]) || ('\t' == value[value_len - 1]))
+        {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < value_len; i++)
+    {
+        if (('\0' == value[i]) || ('\r' == value[i]) || ('\n' == value[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// Checks if value consists only of visible ASCII characters.
+bool Http2IsVisibleAscii(const char* s, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint8_t c = (uint8_t) s[i];
+
+        if ((c <= ' ') || (c >= 0x7F))
+            return false;
+    }
+
+    return true;
+}
+
+// Checks :scheme value (RFC 3986 3.1).
+bool Http2IsValidScheme(const char* scheme, uint32_t scheme_len)
+{
+    if ((0 == scheme_len) || (!isalpha((uint8_t) scheme[0])))
+        return false;
+
+    for (uint32_t i = 1; i < scheme_len; i++)
+    {
+        uint8_t c = (uint8_t) scheme[i];
+
+        if ((!isalnum(c)) && ('+' != c) && ('-' != c) && ('.' != c))
+            return false;
+    }
+
+    return true;
+}
+
+// Checks :path value: origin form, or asterisk for OPTIONS.
+bool Http2IsValidPath(const char* path, uint32_t path_len, bool options_request)
+{
+    if ((0 == path_len) || (!Http2IsVisibleAscii(path, path_len)))
+        return false;
+
+    if ('/' == path[0])
+        return true;
+
+    return options_request && (1 == path_len) && ('*' == path[0]);
+}
+
+// Checks :authority value (empty when not present).
+bool Http2IsValidAuthority(const char* authority, uint32_t authority_len)
+{
+    return Http2IsVisibleAscii(authority, authority_len) &&
+        (NULL == memchr(authority, '@', authority_len)) &&
+        (NULL == memchr(authority, '/', authority_len));
+}
+
+// Appends HTTP/1.1 header line restoring usual name case (HTTP/2 names are lower case).
+void Http2AppendHeaderLine(std::string* out, const char* name, uint32_t name_len, const char* value, uint32_t value_len)
+{
+    bool word_start = true;
+    for (uint32_t i = 0; i < name_len; i++)
+    {
+        char c = name[i];
+
+        if (word_start && (c >= 'a') && (c <= 'z'))
+            c = c - 'a' + 'A';
+
+        word_start = ('-' == c);
+        out->push_back(c);
+    }
+
+    out->append(": ");
+    out->append(value, value_len);
+    out->append("\r\n");
+}
+
+// Reads 24 bit big endian value.
+inline uint32_t Http2ReadUInt24(const uint8_t* p)
+{
+    return ((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2];
+}
+
+// Reads 32 bit big endian value.
+inline uint32_t Http2ReadUInt32(const uint8_t* p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+// Writes 32 bit big endian value.
+inline void Http2WriteUInt32(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t) (value >> 24);
+    p[1] = (uint8_t) (value >> 16);
+    p[2] = (uint8_t) (value >> 8);
+    p[3] = (uint8_t) value;
+}
+
+// Initializing new connection.
+void Http2Connection::Init(
+    socket_index_type socket_index,
+    random_salt_type unique_socket_id,
+    port_index_type port_index,
+    ip_info_type client_ip_info)
+{
+    socket_index_ = socket_index;
+    unique_socket_id_ = unique_socket_id;
+    port_index_ = port_index;
+    client_ip_info_ = client_ip_info;
+
+    for (int32_t i = 0; i < kHttp2MaxConcurrentStreams; i++)
+        streams_[i].Reset();
+
+    num_streams_ = 0;
+    last_stream_id_ = 0;
+
+    hpack_decoder_.Init();
+
+    header_block_.clear();
+    continuation_stream_id_ = 0;
+    header_block_end_stream_ = false;
+
+    send_window_ = kHttp2DefaultWindow;
+    peer_initial_window_ = kHttp2DefaultWindow;
+    recv_window_consumed_ = 0;
+
+    out_sd_ = NULL;
+
+    preface_received_ = false;
+    goaway_sent_ = false;
+}
+
+// Finds stream by identifier.
+Http2Stream* Http2Connection::FindStream(uint32_t stream_id, bool with_reset)
+{
+    if ((0 == stream_id) || (0 == num_streams_))
+        return NULL;
+
+    for (int32_t i = 0; i < kHttp2MaxConcurrentStreams; i++)
+    {
+        if (stream_id == streams_[i].stream_id_)
+            return ((!streams_[i].reset_) || with_reset) ? (streams_ + i) : NULL;
+    }
+
+    return NULL;
+}
+
+// Opens new stream with its virtual socket.
+Http2Stream* Http2Connection::OpenStream(GatewayWorker* gw, uint32_t stream_id)
+{
+    if (num_streams_ >= kHttp2MaxConcurrentStreams)
+        return NULL;
+
+    Http2Stream* stream = NULL;
+    for (int32_t i = 0; i < kHttp2MaxConcurrentStreams; i++)
+    {
+        if (0 == streams_[i].stream_id_)
+        {
+            stream = streams_ + i;
+            break;
+        }
+    }
+
+    GW_ASSERT(NULL != stream);
+
+    // Every stream is a separate virtual socket for codehost.
+    socket_index_type stream_socket_index = gw->ObtainFreeSocketIndex(
+        INVALID_SOCKET,
+        port_index_,
+        MixedCodeConstants::NetworkProtocolType::PROTOCOL_HTTP1,
+        false);
+
+    if (INVALID_SOCKET_INDEX == stream_socket_index)
+        return NULL;
+
+    SocketDataChunk* request_sd;
+    uint32_t err_code = gw->CreateSocketData(stream_socket_index, request_sd);
+    if (err_code)
+    {
+        gw->ReleaseSocketIndex(stream_socket_index);
+        return NULL;
+    }
+
+    // Linking stream socket to its connection.
+    gw->SetAggregationSocketInfo(stream_socket_index, socket_index_, unique_socket_id_);
+    gw->GetSocketInfoReference(stream_socket_index)->http2_stream_id_ = stream_id;
+
+    stream->Reset();
+    stream->stream_id_ = stream_id;
+    stream->socket_index_ = stream_socket_index;
+    stream->unique_socket_id_ = gw->GetUniqueSocketId(stream_socket_index);
+    stream->request_sd_ = request_sd;
+    stream->send_window_ = peer_initial_window_;
+
+    num_streams_++;
+
+    return stream;
+}
+
+// Releases stream resources and its virtual socket.
+void Http2Connection::CloseStream(GatewayWorker* gw, Http2Stream* stream)
+{
+    GW_ASSERT(0 != stream->stream_id_);
+
+    if (NULL != stream->request_sd_)
+        gw->ReturnSocketDataChunksToPool(stream->request_sd_);
+
+    while (NULL != stream->pending_head_)
+    {
+        SocketDataChunk* sd = stream->pending_head_;
+        stream->pending_head_ = sd->get_next_chain_segment();
+
+        gw->ReturnSocketDataChunksToPool(sd);
+    }
+
+    // Responses that arrive later will find the socket released.
+    if (gw->CompareUniqueSocketId(stream->socket_index_, stream->unique_socket_id_))
+        gw->ReleaseSocketIndex(stream->socket_index_);
+
+    stream->Reset();
+    num_streams_--;
+}
+
+// Closes stream, or keeps its slot until codehost answers the dispatched request.
+void Http2Connection::AbortStream(GatewayWorker* gw, Http2Stream* stream)
+{
+    // Nothing runs in codehost for this stream.
+    if ((NULL != stream->request_sd_) || stream->response_received_)
+    {
+        CloseStream(gw, stream);
+        return;
+    }
+
+    while (NULL != stream->pending_head_)
+    {
+        SocketDataChunk* sd = stream->pending_head_;
+        stream->pending_head_ = sd->get_next_chain_segment();
+
+        gw->ReturnSocketDataChunksToPool(sd);
+    }
+
+    stream->pending_tail_ = NULL;
+    stream->reset_ = true;
+}
+
+// Sends RST_STREAM and closes the stream.
+uint32_t Http2Connection::ResetStream(GatewayWorker* gw, Http2Stream* stream, uint32_t stream_id, uint32_t error_code)
+{
+    if (NULL != stream)
+        AbortStream(gw, stream);
+
+    uint8_t payload[4];
+    Http2WriteUInt32(payload, error_code);
+
+    return WriteFrame(gw, HTTP2_FRAME_RST_STREAM, 0, stream_id, payload, sizeof(payload));
+}
+
+// Sends GOAWAY and returns error to close the connection.
+uint32_t Http2Connection::ConnectionError(GatewayWorker* gw, uint32_t error_code)
+{
+#ifdef GW_WARNINGS_DIAG
+    GW_COUT << "HTTP/2 connection error " << error_code << " on socket index: " << socket_index_ << GW_ENDL;
+#endif
+
+    if (!goaway_sent_)
+    {
+        goaway_sent_ = true;
+
+        uint8_t payload[8];
+        Http2WriteUInt32(payload, last_stream_id_);
+        Http2WriteUInt32(payload + 4, error_code);
+
+        WriteFrame(gw, HTTP2_FRAME_GOAWAY, 0, 0, payload, sizeof(payload));
+        Flush(gw);
+    }
+
+    return SCERRGWHTTPPROCESSFAILED;
+}
+
+// Writes frame to output chunk.
+uint32_t Http2Connection::WriteFrame(
+    GatewayWorker* gw,
+    uint8_t type,
+    uint8_t flags,
+    uint32_t stream_id,
+    const uint8_t* payload,
+    uint32_t payload_len)
+{
+    GW_ASSERT(payload_len <= kHttp2MaxFrameSize);
+
+    uint32_t err_code;
+    uint32_t frame_len = kHttp2FrameHeaderLength + payload_len;
+
+    // Sending what we have if frame does not fit.
+    if ((NULL != out_sd_) && (out_sd_->get_num_available_network_bytes() < frame_len))
+    {
+        err_code = Flush(gw);
+        if (err_code)
+            return err_code;
+    }
+
+    if (NULL == out_sd_)
+    {
+        err_code = gw->CreateSocketData(socket_index_, out_sd_, GatewayChunkDataSizes[HTTP2_OUTPUT_CHUNK_STORE_INDEX]);
+        if (err_code)
+            return err_code;
+    }
+
+    uint8_t* p = out_sd_->get_cur_network_buf_ptr();
+    p[0] = (uint8_t) (payload_len >> 16);
+    p[1] = (uint8_t) (payload_len >> 8);
+    p[2] = (uint8_t) payload_len;
+    p[3] = type;
+    p[4] = flags;
+    Http2WriteUInt32(p + 5, stream_id & 0x7FFFFFFF);
+
+    if (payload_len > 0)
+        memcpy(p + kHttp2FrameHeaderLength, payload, payload_len);
+
+    out_sd_->AddAccumulatedBytes(frame_len);
+
+    return 0;
+}
+
+// Writes WINDOW_UPDATE frame.
+uint32_t Http2Connection::WriteWindowUpdate(GatewayWorker* gw, uint32_t stream_id, uint32_t increment)
+{
+    uint8_t payload[4];
+    Http2WriteUInt32(payload, increment);
+
+    return WriteFrame(gw, HTTP2_FRAME_WINDOW_UPDATE, 0, stream_id, payload, sizeof(payload));
+}
+
+// Writes encoded header block as HEADERS and CONTINUATION frames.
+uint32_t Http2Connection::WriteHeaderBlock(GatewayWorker* gw, uint32_t stream_id, bool end_stream)
+{
+    const uint8_t* block = (const uint8_t*) hpack_out_.data();
+    uint32_t block_len = static_cast<uint32_t>(hpack_out_.length());
+
+    uint8_t type = HTTP2_FRAME_HEADERS;
+    uint8_t flags = end_stream ? HTTP2_FLAG_END_STREAM : 0;
+
+    while (true)
+    {
+        uint32_t fragment_len = block_len;
+        if (fragment_len > kHttp2MaxFrameSize)
+            fragment_len = kHttp2MaxFrameSize;
+
+        if (fragment_len == block_len)
+            flags |= HTTP2_FLAG_END_HEADERS;
+
+        uint32_t err_code = WriteFrame(gw, type, flags, stream_id, block, fragment_len);
+        if (err_code)
+            return err_code;
+
+        block += fragment_len;
+        block_len -= fragment_len;
+
+        if (0 == block_len)
+            return 0;
+
+        type = HTTP2_FRAME_CONTINUATION;
+        flags = 0;
+    }
+}
+
+// Sends frames written so far.
+uint32_t Http2Connection::Flush(GatewayWorker* gw)
+{
+    if (NULL == out_sd_)
+        return 0;
+
+    SocketDataChunk* sd = out_sd_;
+    out_sd_ = NULL;
+
+    sd->PrepareForSend(sd->get_data_blob_start(), sd->get_accumulated_len_bytes());
+
+    uint32_t err_code = gw->Send(sd);
+    if (err_code) {
+        // Releasing the frames chunk.
+        gw->ReturnSocketDataChunksToPool(sd);
+        return err_code;
+    }
+
+    return 0;
+}
+
+// Sends server connection preface.
+uint32_t Http2Connection::SendPreface(GatewayWorker* gw)
+{
+    uint8_t payload[12];
+
+    Http2WriteUInt32(payload, HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS << 16);
+    Http2WriteUInt32(payload + 2, kHttp2MaxConcurrentStreams);
+    Http2WriteUInt32(payload + 6, HTTP2_SETTINGS_INITIAL_WINDOW_SIZE << 16);
+    Http2WriteUInt32(payload + 8, kHttp2StreamReceiveWindow);
+
+    uint32_t err_code = WriteFrame(gw, HTTP2_FRAME_SETTINGS, 0, 0, payload, sizeof(payload));
+    if (err_code)
+        return err_code;
+
+    // Connection window can only be changed with WINDOW_UPDATE.
+    return WriteWindowUpdate(gw, 0, kHttp2ConnectionReceiveWindow - kHttp2DefaultWindow);
+}
+
+// Processes received frames.
+uint32_t Http2Connection::ProcessData(GatewayWorker* gw, SocketDataChunkRef sd)
+{
+    uint32_t err_code;
+    uint8_t* data = sd->get_data_blob_start();
+    uint32_t num_accum_bytes = sd->get_accumulated_len_bytes();
+    uint32_t num_processed_bytes = 0;
+    uint32_t num_needed_bytes = kHttp2FrameHeaderLength;
+
+    // Skipping client preface (checked by dispatcher).
+    if (!preface_received_)
+    {
+        GW_ASSERT(num_accum_bytes >= kHttp2ConnectionPrefaceLength);
+
+        preface_received_ = true;
+        num_processed_bytes = kHttp2ConnectionPrefaceLength;
+    }
+
+    while (num_accum_bytes - num_processed_bytes >= kHttp2FrameHeaderLength)
+    {
+        uint8_t* frame = data + num_processed_bytes;
+
+        uint32_t payload_len = Http2ReadUInt24(frame);
+        uint8_t type = frame[3];
+        uint8_t flags = frame[4];
+        uint32_t stream_id = Http2ReadUInt32(frame + 5) & 0x7FFFFFFF;
+
+        if (payload_len > kHttp2MaxFrameSize)
+            return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+        // Checking if whole frame is received.
+        num_needed_bytes = kHttp2FrameHeaderLength + payload_len;
+        if (num_accum_bytes - num_processed_bytes < num_needed_bytes)
+            break;
+
+        err_code = ProcessFrame(gw, type, flags, stream_id, frame + kHttp2FrameHeaderLength, payload_len);
+        if (err_code)
+            return err_code;
+
+        num_processed_bytes += num_needed_bytes;
+        num_needed_bytes = kHttp2FrameHeaderLength;
+    }
+
+    // Sending all frames produced by this portion of data.
+    err_code = Flush(gw);
+    if (err_code)
+        return err_code;
+
+    if (num_processed_bytes == num_accum_bytes)
+    {
+        // Returning socket to original receiving state.
+        sd->ResetAccumBuffer();
+        return gw->Receive(sd);
+    }
+
+    // Checking if we need to move current data up.
+    sd->MoveDataToTopAndContinueReceive(data + num_processed_bytes, num_accum_bytes - num_processed_bytes);
+
+    // Checking if the rest of the frame fits into current chunk.
+    if (num_needed_bytes > sd->get_data_blob_size())
+    {
+        err_code = SocketDataChunk::ChangeToBigger(gw, sd, num_needed_bytes);
+        if (err_code)
+            return err_code;
+    }
+
+    // Returning socket to receiving state.
+    return gw->Receive(sd);
+}
+
+// Processes one complete frame.
+uint32_t Http2Connection::ProcessFrame(
+    GatewayWorker* gw,
+    uint8_t type,
+    uint8_t flags,
+    uint32_t stream_id,
+    const uint8_t* payload,
+    uint32_t payload_len)
+{
+    // Header block must not be interrupted by other frames.
+    if ((0 != continuation_stream_id_) &&
+        ((HTTP2_FRAME_CONTINUATION != type) || (stream_id != continuation_stream_id_)))
+    {
+        return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+    }
+
+    switch (type)
+    {
+        case HTTP2_FRAME_DATA:
+            return ProcessDataFrame(gw, flags, stream_id, payload, payload_len);
+
+        case HTTP2_FRAME_HEADERS:
+            return ProcessHeadersFrame(gw, flags, stream_id, payload, payload_len);
+
+        case HTTP2_FRAME_PRIORITY:
+        {
+            // Priorities are ignored, all streams are dispatched as they come.
+            if (0 == stream_id)
+                return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+            if (5 != payload_len)
+                return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+            return 0;
+        }
+
+        case HTTP2_FRAME_RST_STREAM:
+        {
+            if (0 == stream_id)
+                return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+            if (4 != payload_len)
+                return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+            // NOTE: Dispatched request keeps its slot until answered, so reset loops can't queue unbounded work.
+            Http2Stream* stream = FindStream(stream_id);
+            if (NULL != stream)
+                AbortStream(gw, stream);
+
+            return 0;
+        }
+
+        case HTTP2_FRAME_SETTINGS:
+            return ProcessSettingsFrame(gw, flags, stream_id, payload, payload_len);
+
+        case HTTP2_FRAME_PUSH_PROMISE:
+        {
+            // Clients can't push.
+            return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+        }
+
+        case HTTP2_FRAME_PING:
+        {
+            if (0 != stream_id)
+                return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+            if (8 != payload_len)
+                return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+            if (flags & HTTP2_FLAG_ACK)
+                return 0;
+
+            return WriteFrame(gw, HTTP2_FRAME_PING, HTTP2_FLAG_ACK, 0, payload, payload_len);
+        }
+
+        case HTTP2_FRAME_GOAWAY:
+        {
+            if (0 != stream_id)
+                return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+            // NOTE: Client stops opening streams, already opened ones are finished normally.
+            return 0;
+        }
+
+        case HTTP2_FRAME_WINDOW_UPDATE:
+            return ProcessWindowUpdateFrame(gw, stream_id, payload, payload_len);
+
+        case HTTP2_FRAME_CONTINUATION:
+        {
+            if (0 == continuation_stream_id_)
+                return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+            if (header_block_.length() + payload_len > kHttp2MaxHeaderBlockSize)
+                return ConnectionError(gw, HTTP2_ERROR_ENHANCE_YOUR_CALM);
+
+            header_block_.append((const char*) payload, payload_len);
+
+            if (0 == (flags & HTTP2_FLAG_END_HEADERS))
+                return 0;
+
+            continuation_stream_id_ = 0;
+
+            return ProcessHeaderBlock(
+                gw,
+                stream_id,
+                (const uint8_t*) header_block_.data(),
+                static_cast<uint32_t>(header_block_.length()),
+                header_block_end_stream_);
+        }
+
+        default:
+        {
+            // Unknown frame types must be ignored.
+            return 0;
+        }
+    }
+}
+
+// Processes HEADERS frame.
+uint32_t Http2Connection::ProcessHeadersFrame(
+    GatewayWorker* gw,
+    uint8_t flags,
+    uint32_t stream_id,
+    const uint8_t* payload,
+    uint32_t payload_len)
+{
+    // Client streams are odd.
+    if ((0 == stream_id) || (0 == (stream_id & 1)))
+        return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+    uint32_t pad_len = 0;
+
+    if (flags & HTTP2_FLAG_PADDED)
+    {
+        if (payload_len < 1)
+            return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+        pad_len = payload[0];
+        payload++;
+        payload_len--;
+    }
+
+    // Skipping priority information.
+    if (flags & HTTP2_FLAG_PRIORITY)
+    {
+        if (payload_len < 5)
+            return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+        payload += 5;
+        payload_len -= 5;
+    }
+
+    if (pad_len > payload_len)
+        return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+    payload_len -= pad_len;
+
+    bool end_stream = (0 != (flags & HTTP2_FLAG_END_STREAM));
+
+    // Collecting header block from following CONTINUATION frames.
+    if (0 == (flags & HTTP2_FLAG_END_HEADERS))
+    {
+        header_block_.assign((const char*) payload, payload_len);
+        continuation_stream_id_ = stream_id;
+        header_block_end_stream_ = end_stream;
+
+        return 0;
+    }
+
+    return ProcessHeaderBlock(gw, stream_id, payload, payload_len, end_stream);
+}
+
+// Processes complete header block.
+uint32_t Http2Connection::ProcessHeaderBlock(
+    GatewayWorker* gw,
+    uint32_t stream_id,
+    const uint8_t* block,
+    uint32_t block_len,
+    bool end_stream)
+{
+    uint32_t err_code;
+    bool malformed = false;
+
+    Http2Stream* stream = FindStream(stream_id);
+
+    // Checking if these are trailers of already opened stream.
+    if ((NULL != stream) || (stream_id <= last_stream_id_))
+    {
+        // NOTE: Block is always decoded to keep compression state in sync.
+        err_code = DecodeHeaderBlock(gw, NULL, block, block_len, &malformed);
+        if (err_code)
+            return ConnectionError(gw, HTTP2_ERROR_COMPRESSION_ERROR);
+
+        // Trailers are dropped, they must end the request.
+        if ((NULL != stream) && (NULL != stream->request_sd_) && end_stream)
+            return DispatchRequest(gw, stream);
+
+        return ResetStream(gw, stream, stream_id, (NULL != stream) ? HTTP2_ERROR_PROTOCOL_ERROR : HTTP2_ERROR_STREAM_CLOSED);
+    }
+
+    last_stream_id_ = stream_id;
+
+    // Ignoring new streams after GOAWAY or when out of resources.
+    if (!goaway_sent_)
+        stream = OpenStream(gw, stream_id);
+
+    err_code = DecodeHeaderBlock(gw, stream, block, block_len, &malformed);
+    if (err_code)
+        return ConnectionError(gw, HTTP2_ERROR_COMPRESSION_ERROR);
+
+    if (goaway_sent_)
+        return 0;
+
+    if (NULL == stream)
+        return ResetStream(gw, NULL, stream_id, HTTP2_ERROR_REFUSED_STREAM);
+
+    if (malformed)
+        return ResetStream(gw, stream, stream_id, HTTP2_ERROR_PROTOCOL_ERROR);
+
+    // Reserving Content-Length value, it is known only when body is received.
+    if (!end_stream)
+    {
+        const char* kContentLengthHeader = "Content-Length:           \r\n";
+
+        stream->content_length_offset_ = stream->request_sd_->get_accumulated_len_bytes() + 16;
+
+        err_code = AppendToRequest(gw, stream, kContentLengthHeader, static_cast<uint32_t>(strlen(kContentLengthHeader)));
+        if (err_code)
+            return ResetStream(gw, stream, stream_id, HTTP2_ERROR_PROTOCOL_ERROR);
+    }
+
+    err_code = AppendToRequest(gw, stream, "\r\n", 2);
+    if (err_code)
+        return ResetStream(gw, stream, stream_id, HTTP2_ERROR_PROTOCOL_ERROR);
+
+    if (end_stream)
+        return DispatchRequest(gw, stream);
+
+    return 0;
+}
+
+// Decodes header block into stream request (or just decodes it when stream is NULL).
+// NOTE: Request head is appended only when the whole block is decoded and valid.
+uint32_t Http2Connection::DecodeHeaderBlock(
+    GatewayWorker* gw,
+    Http2Stream* stream,
+    const uint8_t* block,
+    uint32_t block_len,
+    bool* malformed)
+{
+    uint32_t err_code;
+    const uint8_t* pos = block;
+    const uint8_t* end = block + block_len;
+    bool regular_header_seen = false, scheme_seen = false;
+
+    method_.clear();
+    path_.clear();
+    authority_.clear();
+    cookies_.clear();
+    request_headers_.clear();
+
+    while (pos < end)
+    {
+        HpackField field;
+        bool has_field;
+
+        err_code = hpack_decoder_.DecodeField(&pos, end, &field, &has_field);
+        if (err_code)
+            return err_code;
+
+        if ((!has_field) || (NULL == stream) || (*malformed))
+            continue;
+
+        // Field must be representable as HTTP/1.1 header line (RFC 9113 8.2.1).
+        if ((!Http2IsValidFieldName(field.name_, field.name_len_)) ||
+            (!Http2IsValidFieldValue(field.value_, field.value_len_)))
+        {
+            *malformed = true;
+            continue;
+        }
+
+        // Pseudo-headers must come before regular ones and only once.
+        if (':' == field.name_[0])
+        {
+            std::string* pseudo_value = NULL;
+
+            if (regular_header_seen)
+                *malformed = true;
+            else if (Http2HeaderNameEquals(field.name_, field.name_len_, ":method", 7))
+                pseudo_value = &method_;
+            else if (Http2HeaderNameEquals(field.name_, field.name_len_, ":path", 5))
+                pseudo_value = &path_;
+            else if (Http2HeaderNameEquals(field.name_, field.name_len_, ":authority", 10))
+                pseudo_value = &authority_;
+            else if (Http2HeaderNameEquals(field.name_, field.name_len_, ":scheme", 7) && (!scheme_seen))
+                *malformed = !Http2IsValidScheme(field.value_, field.value_len_);
+            else
+                *malformed = true;
+
+            if (Http2HeaderNameEquals(field.name_, field.name_len_, ":scheme", 7))
+                scheme_seen = true;
+
+            if (NULL != pseudo_value)
+            {
+                if (!pseudo_value->empty())
+                    *malformed = true;
+                else
+                    pseudo_value->assign(field.value_, field.value_len_);
+            }
+
+            continue;
+        }
+
+        regular_header_seen = true;
+
+        // Cookies may be split into several fields, joining them back.
+        if (Http2HeaderNameEquals(field.name_, field.name_len_, "cookie", 6))
+        {
+            if (!cookies_.empty())
+                cookies_.append("; ");
+
+            cookies_.append(field.value_, field.value_len_);
+            continue;
+        }
+
+        // Content length is set from received body and host from authority.
+        if (Http2HeaderNameEquals(field.name_, field.name_len_, "content-length", 14) ||
+            (Http2HeaderNameEquals(field.name_, field.name_len_, "host", 4) && (!authority_.empty())) ||
+            Http2IsConnectionSpecificHeader(field.name_, field.name_len_))
+        {
+            continue;
+        }
+
+        Http2AppendHeaderLine(&request_headers_, field.name_, field.name_len_, field.value_, field.value_len_);
+    }
+
+    if ((NULL == stream) || (*malformed))
+        return 0;
+
+    // Checking mandatory pseudo-headers (RFC 9113 8.3.1).
+    // NOTE: CONNECT method is not supported.
+    if ((!scheme_seen) ||
+        (!Http2IsToken(method_.data(), static_cast<uint32_t>(method_.length()))) ||
+        ("CONNECT" == method_) ||
+        (!Http2IsValidPath(path_.data(), static_cast<uint32_t>(path_.length()), "OPTIONS" == method_)) ||
+        (!Http2IsValidAuthority(authority_.data(), static_cast<uint32_t>(authority_.length()))))
+    {
+        *malformed = true;
+        return 0;
+    }
+
+    if (AppendRequestHead(gw, stream))
+        *malformed = true;
+
+    return 0;
+}
+
+// Appends data to stream request.
+uint32_t Http2Connection::AppendToRequest(GatewayWorker* gw, Http2Stream* stream, const char* data, uint32_t data_len)
+{
+    if (stream->request_sd_->get_num_available_network_bytes() < data_len)
+    {
+        uint32_t num_needed_bytes = stream->request_sd_->get_accumulated_len_bytes() + data_len;
+        if (num_needed_bytes > static_cast<uint32_t>(MAX_SOCKET_DATA_SIZE))
+            return SCERRGWMAXCHUNKSIZEREACHED;
+
+        uint32_t err_code = SocketDataChunk::ChangeToBigger(gw, stream->request_sd_, num_needed_bytes);
+        if (err_code)
+            return err_code;
+    }
+
+    memcpy(stream->request_sd_->get_cur_network_buf_ptr(), data, data_len);
+    stream->request_sd_->AddAccumulatedBytes(data_len);
+
+    return 0;
+}
+
+// Writes request line and headers from validated header block.
+uint32_t Http2Connection::AppendRequestHead(GatewayWorker* gw, Http2Stream* stream)
+{
+    stream->head_request_ = ("HEAD" == method_);
+
+    header_line_ = method_;
+    header_line_.push_back(' ');
+    header_line_.append(path_);
+    header_line_.append(" HTTP/1.1\r\n");
+
+    if (!authority_.empty())
+        Http2AppendHeaderLine(&header_line_, "host", 4, authority_.data(), static_cast<uint32_t>(authority_.length()));
+
+    header_line_.append(request_headers_);
+
+    if (!cookies_.empty())
+        Http2AppendHeaderLine(&header_line_, "cookie", 6, cookies_.data(), static_cast<uint32_t>(cookies_.length()));
+
+    return AppendToRequest(gw, stream, header_line_.data(), static_cast<uint32_t>(header_line_.length()));
+}
+
+// Passes assembled request to registered handlers.
+uint32_t Http2Connection::DispatchRequest(GatewayWorker* gw, Http2Stream* stream)
+{
+    uint32_t stream_id = stream->stream_id_;
+
+    SocketDataChunk* request_sd = stream->request_sd_;
+    stream->request_sd_ = NULL;
+
+    // Filling reserved Content-Length value.
+    if (stream->content_length_offset_ >= 0)
+        WriteUIntToString((char*) request_sd->get_data_blob_start() + stream->content_length_offset_, stream->request_body_len_);
+
+    // Applying special parameters to socket data.
+    gw->ApplySocketInfoToSocketData(request_sd, stream->socket_index_, stream->unique_socket_id_);
+    request_sd->set_client_ip_info(client_ip_info_);
+
+    // Measuring request latency on the stream socket.
+    gw->InheritSocketLatencyState(gw->GetSocketInfoReference(socket_index_), gw->GetSocketInfoReference(stream->socket_index_));
+
+    // Running handler.
+    // NOTE: Handler can respond immediately, so stream is searched again after it.
+    uint32_t err_code = gw->RunReceiveHandlers(request_sd);
+
+    if (err_code) {
+
+        // Releasing the request chunk.
+        if (NULL != request_sd)
+            gw->ReturnSocketDataChunksToPool(request_sd);
+
+        // Request did not reach codehost, so slot is released right away.
+        Http2Stream* failed_stream = FindStream(stream_id);
+        if (NULL != failed_stream)
+            CloseStream(gw, failed_stream);
+
+        return ResetStream(gw, NULL, stream_id, HTTP2_ERROR_INTERNAL_ERROR);
+    }
+
+    return 0;
+}
+
+// Processes DATA frame.
+uint32_t Http2Connection::ProcessDataFrame(
+    GatewayWorker* gw,
+    uint8_t flags,
+    uint32_t stream_id,
+    const uint8_t* payload,
+    uint32_t payload_len)
+{
+    uint32_t err_code;
+
+    if (0 == stream_id)
+        return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+    // Whole frame counts against flow control windows.
+    uint32_t frame_len = payload_len;
+
+    // Peer must not send more than the window we advertised.
+    if (recv_window_consumed_ + frame_len > static_cast<uint32_t>(kHttp2ConnectionReceiveWindow))
+        return ConnectionError(gw, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+
+    recv_window_consumed_ += frame_len;
+    if (recv_window_consumed_ >= kHttp2ConnectionReceiveWindow / 2)
+    {
+        err_code = WriteWindowUpdate(gw, 0, recv_window_consumed_);
+        if (err_code)
+            return err_code;
+
+        recv_window_consumed_ = 0;
+    }
+
+    if (flags & HTTP2_FLAG_PADDED)
+    {
+        if (payload_len < 1)
+            return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+        uint32_t pad_len = payload[0];
+        payload++;
+        payload_len--;
+
+        if (pad_len > payload_len)
+            return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+        payload_len -= pad_len;
+    }
+
+    Http2Stream* stream = FindStream(stream_id);
+
+    // Checking if stream still receives request body.
+    if ((NULL == stream) || (NULL == stream->request_sd_))
+    {
+        if (stream_id > last_stream_id_)
+            return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+        return ResetStream(gw, stream, stream_id, HTTP2_ERROR_STREAM_CLOSED);
+    }
+
+    if (stream->recv_window_consumed_ + frame_len > static_cast<uint32_t>(kHttp2StreamReceiveWindow))
+        return ResetStream(gw, stream, stream_id, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+
+    // Checking maximum request body size.
+    if (stream->request_body_len_ + payload_len > g_gateway.setting_maximum_receive_content_length())
+        return ResetStream(gw, stream, stream_id, HTTP2_ERROR_CANCEL);
+
+    // Body that does not fit in biggest chunk continues in request body chain, as with HTTP/1.1.
+    ScSocketInfoStruct* stream_si = gw->GetSocketInfoReference(stream->socket_index_);
+    if ((NULL != stream_si->body_chain_head_) ||
+        (stream->request_sd_->get_accumulated_len_bytes() + payload_len > static_cast<uint32_t>(MAX_SOCKET_DATA_SIZE)))
+    {
+        err_code = gw->CopyToBufferChain(stream_si, payload, payload_len);
+    }
+    else
+    {
+        err_code = AppendToRequest(gw, stream, (const char*) payload, payload_len);
+    }
+
+    if (err_code)
+        return ResetStream(gw, stream, stream_id, HTTP2_ERROR_CANCEL);
+
+    stream->request_body_len_ += payload_len;
+
+    if (flags & HTTP2_FLAG_END_STREAM)
+        return DispatchRequest(gw, stream);
+
+    stream->recv_window_consumed_ += frame_len;
+    if (stream->recv_window_consumed_ >= kHttp2StreamReceiveWindow / 2)
+    {
+        err_code = WriteWindowUpdate(gw, stream_id, stream->recv_window_consumed_);
+        if (err_code)
+            return err_code;
+
+        stream->recv_window_consumed_ = 0;
+    }
+
+    return 0;
+}
+
+// Processes SETTINGS frame.
+uint32_t Http2Connection::ProcessSettingsFrame(
+    GatewayWorker* gw,
+    uint8_t flags,
+    uint32_t stream_id,
+    const uint8_t* payload,
+    uint32_t payload_len)
+{
+    if (0 != stream_id)
+        return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+    if (flags & HTTP2_FLAG_ACK)
+    {
+        if (0 != payload_len)
+            return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+        return 0;
+    }
+
+    if (0 != (payload_len % 6))
+        return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+    bool window_changed = false;
+
+    for (uint32_t i = 0; i < payload_len; i += 6)
+    {
+        uint16_t id = (uint16_t) ((payload[i] << 8) | payload[i + 1]);
+        uint32_t value = Http2ReadUInt32(payload + i + 2);
+
+        switch (id)
+        {
+            case HTTP2_SETTINGS_ENABLE_PUSH:
+            {
+                if (value > 1)
+                    return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+                break;
+            }
+
+            case HTTP2_SETTINGS_INITIAL_WINDOW_SIZE:
+            {
+                if (value > kHttp2MaxWindow)
+                    return ConnectionError(gw, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+
+                // Applying the difference to all open streams.
+                int64_t delta = (int64_t) value - peer_initial_window_;
+                for (int32_t s = 0; s < kHttp2MaxConcurrentStreams; s++)
+                {
+                    if (0 != streams_[s].stream_id_)
+                        streams_[s].send_window_ += delta;
+                }
+
+                peer_initial_window_ = value;
+                window_changed = true;
+
+                break;
+            }
+
+            case HTTP2_SETTINGS_MAX_FRAME_SIZE:
+            {
+                // NOTE: We never send frames bigger than the default size.
+                if ((value < kHttp2MaxFrameSize) || (value > 0xFFFFFF))
+                    return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+                break;
+            }
+
+            default:
+            {
+                // Header table size is not used by our encoder and other settings don't apply.
+                break;
+            }
+        }
+    }
+
+    uint32_t err_code = WriteFrame(gw, HTTP2_FRAME_SETTINGS, HTTP2_FLAG_ACK, 0, NULL, 0);
+    if (err_code)
+        return err_code;
+
+    if (window_changed)
+        return SendPendingDataOnAllStreams(gw);
+
+    return 0;
+}
+
+// Processes WINDOW_UPDATE frame.
+uint32_t Http2Connection::ProcessWindowUpdateFrame(
+    GatewayWorker* gw,
+    uint32_t stream_id,
+    const uint8_t* payload,
+    uint32_t payload_len)
+{
+    if (4 != payload_len)
+        return ConnectionError(gw, HTTP2_ERROR_FRAME_SIZE_ERROR);
+
+    uint32_t increment = Http2ReadUInt32(payload) & 0x7FFFFFFF;
+
+    if (0 == stream_id)
+    {
+        if (0 == increment)
+            return ConnectionError(gw, HTTP2_ERROR_PROTOCOL_ERROR);
+
+        send_window_ += increment;
+        if (send_window_ > kHttp2MaxWindow)
+            return ConnectionError(gw, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+
+        return SendPendingDataOnAllStreams(gw);
+    }
+
+    Http2Stream* stream = FindStream(stream_id);
+    if (NULL == stream)
+        return 0;
+
+    if (0 == increment)
+        return ResetStream(gw, stream, stream_id, HTTP2_ERROR_PROTOCOL_ERROR);
+
+    stream->send_window_ += increment;
+    if (stream->send_window_ > kHttp2MaxWindow)
+        return ResetStream(gw, stream, stream_id, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+
+    return SendPendingData(gw, stream);
+}
+
+// Converts HTTP/1.1 response headers into HEADERS frames.
+uint32_t Http2Connection::WriteResponseHeaders(
+    GatewayWorker* gw,
+    Http2Stream* stream,
+    const uint8_t* data,
+    uint32_t data_len,
+    uint32_t* headers_len)
+{
+    const char* p = (const char*) data;
+    const char* end = p + data_len;
+
+    // Parsing status line.
+    const char* line_end = (const char*) memchr(p, '\n', data_len);
+    if ((NULL == line_end) || (data_len < 12) || (0 != strncmp(p, "HTTP/", 5)))
+        return SCERRGWHTTPPROCESSFAILED;
+
+    const char* status_ptr = (const char*) memchr(p, ' ', line_end - p);
+    if ((NULL == status_ptr) || (line_end - status_ptr < 4))
+        return SCERRGWHTTPPROCESSFAILED;
+
+    int32_t status_code = 0;
+    for (int32_t i = 1; i <= 3; i++)
+    {
+        char c = status_ptr[i];
+        if ((c < '0') || (c > '9'))
+            return SCERRGWHTTPPROCESSFAILED;
+
+        status_code = status_code * 10 + (c - '0');
+    }
+
+    hpack_out_.clear();
+    HpackEncodeStatus(&hpack_out_, status_code);
+
+    int64_t content_length = -1;
+
+    p = line_end + 1;
+
+    // Converting header lines until the empty one.
+    while (true)
+    {
+        if (p >= end)
+            return SCERRGWHTTPPROCESSFAILED;
+
+        line_end = (const char*) memchr(p, '\n', end - p);
+        if (NULL == line_end)
+            return SCERRGWHTTPPROCESSFAILED;
+
+        const char* value_end = line_end;
+        if ((value_end > p) && ('\r' == *(value_end - 1)))
+            value_end--;
+
+        // Empty line ends the headers.
+        if (value_end == p)
+        {
+            p = line_end + 1;
+            break;
+        }
+
+        const char* colon = (const char*) memchr(p, ':', value_end - p);
+        if ((NULL == colon) || (colon == p))
+        {
+            p = line_end + 1;
+            continue;
+        }
+
+        uint32_t name_len = static_cast<uint32_t>(colon - p);
+
+        const char* value = colon + 1;
+        while ((value < value_end) && ((' ' == *value) || ('\t' == *value)))
+            value++;
+
+        while ((value_end > value) && ((' ' == *(value_end - 1)) || ('\t' == *(value_end - 1))))
+            value_end--;
+
+        uint32_t value_len = static_cast<uint32_t>(value_end - value);
+
+        if (!Http2IsConnectionSpecificHeader(p, name_len))
+        {
+            // HTTP/2 header names are lower case.
+            header_line_.assign(p, name_len);
+            for (uint32_t i = 0; i < name_len; i++)
+            {
+                char c = header_line_[i];
+                if ((c >= 'A') && (c <= 'Z'))
+                    header_line_[i] = c - 'A' + 'a';
+            }
+
+            if (Http2HeaderNameEquals(header_line_.data(), name_len, "content-length", 14))
+                content_length = _strtoi64(value, NULL, 10);
+
+            HpackEncodeHeader(&hpack_out_, header_line_.data(), name_len, value, value_len);
+        }
+
+        p = line_end + 1;
+    }
+
+    *headers_len = static_cast<uint32_t>(p - (const char*) data);
+
+    // Checking if response has a body.
+    bool no_body = stream->head_request_ ||
+        (204 == status_code) ||
+        (304 == status_code) ||
+        (0 == content_length);
+
+    stream->response_bytes_left_ = no_body ? 0 : content_length;
+    stream->headers_sent_ = true;
+
+    return WriteHeaderBlock(gw, stream->stream_id_, no_body);
+}
+
+// Sends queued response data allowed by flow control windows.
+uint32_t Http2Connection::SendPendingData(GatewayWorker* gw, Http2Stream* stream)
+{
+    uint32_t err_code;
+
+    while (NULL != stream->pending_head_)
+    {
+        SocketDataChunk* sd = stream->pending_head_;
+
+        uint8_t* data = sd->get_cur_network_buf_ptr();
+        uint32_t num_available_bytes = sd->get_num_available_network_bytes();
+        uint32_t len = num_available_bytes;
+
+        // Bytes beyond declared content length are dropped.
+        bool response_ends;
+        if (stream->response_bytes_left_ >= 0)
+        {
+            if (len > stream->response_bytes_left_)
+                len = static_cast<uint32_t>(stream->response_bytes_left_);
+
+            response_ends = (len == stream->response_bytes_left_);
+        }
+        else
+        {
+            response_ends = (NULL == sd->get_next_chain_segment()) && stream->response_last_queued_;
+        }
+
+        // Taking as much as both windows allow.
+        int64_t window = send_window_;
+        if (stream->send_window_ < window)
+            window = stream->send_window_;
+
+        uint32_t num_send_bytes = len;
+        if (num_send_bytes > kHttp2MaxFrameSize)
+            num_send_bytes = kHttp2MaxFrameSize;
+
+        if (num_send_bytes > window)
+            num_send_bytes = (window > 0) ? static_cast<uint32_t>(window) : 0;
+
+        // Waiting for WINDOW_UPDATE.
+        if ((0 == num_send_bytes) && (len > 0))
+            return 0;
+
+        if ((num_send_bytes > 0) || response_ends)
+        {
+            bool end_stream = response_ends && (num_send_bytes == len);
+
+            err_code = WriteFrame(gw, HTTP2_FRAME_DATA, end_stream ? HTTP2_FLAG_END_STREAM : 0, stream->stream_id_, data, num_send_bytes);
+            if (err_code)
+                return err_code;
+
+            send_window_ -= num_send_bytes;
+            stream->send_window_ -= num_send_bytes;
+
+            if (stream->response_bytes_left_ >= 0)
+                stream->response_bytes_left_ -= num_send_bytes;
+
+            // Whole response is sent.
+            if (end_stream)
+            {
+                CloseStream(gw, stream);
+                return 0;
+            }
+
+            sd->SetNetworkBuffer(data + num_send_bytes, num_available_bytes - num_send_bytes);
+
+            if (num_send_bytes < len)
+                continue;
+        }
+
+        // Chunk is fully sent.
+        stream->pending_head_ = sd->get_next_chain_segment();
+        if (NULL == stream->pending_head_)
+            stream->pending_tail_ = NULL;
+
+        gw->ReturnSocketDataChunksToPool(sd);
+    }
+
+    return 0;
+}
+
+// Sends queued response data on all streams.
+uint32_t Http2Connection::SendPendingDataOnAllStreams(GatewayWorker* gw)
+{
+    for (int32_t i = 0; i < kHttp2MaxConcurrentStreams; i++)
+    {
+        if ((0 != streams_[i].stream_id_) && (NULL != streams_[i].pending_head_))
+        {
+            uint32_t err_code = SendPendingData(gw, streams_ + i);
+            if (err_code)
+                return err_code;
+        }
+    }
+
+    return 0;
+}
+
+// Sends codehost response on its stream.
+uint32_t Http2Connection::SendResponse(GatewayWorker* gw, SocketDataChunkRef sd)
+{
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    uint32_t stream_id = si->http2_stream_id_;
+
+    Http2Stream* stream = FindStream(stream_id, true);
+    if ((NULL == stream) || (stream->socket_index_ != sd->get_socket_info_index()))
+        return SCERRGWOPERATIONONWRONGSOCKET;
+
+    // Streamed response has more parts until the flag is cleared.
+    bool last_part = !si->get_streaming_response_body_flag();
+
+    // Response of reset stream is dropped and slot is released when response is complete.
+    if (stream->reset_)
+    {
+        if (last_part)
+            CloseStream(gw, stream);
+
+        gw->ReturnSocketDataChunksToPool(sd);
+
+        return 0;
+    }
+
+    stream->response_received_ = last_part;
+
+    uint32_t err_code;
+
+    // First response chunk starts with HTTP/1.1 headers.
+    if (!stream->headers_sent_)
+    {
+        uint32_t headers_len;
+        err_code = WriteResponseHeaders(gw, stream, sd->get_cur_network_buf_ptr(), sd->get_num_available_network_bytes(), &headers_len);
+        if (err_code)
+        {
+            ResetStream(gw, stream, stream_id, HTTP2_ERROR_INTERNAL_ERROR);
+            Flush(gw);
+
+            return err_code;
+        }
+
+        sd->SetNetworkBuffer(sd->get_cur_network_buf_ptr() + headers_len, sd->get_num_available_network_bytes() - headers_len);
+
+        // Response without body ends with headers.
+        if (0 == stream->response_bytes_left_)
+        {
+            CloseStream(gw, stream);
+            gw->ReturnSocketDataChunksToPool(sd);
+
+            return Flush(gw);
+        }
+    }
+
+    // Length of streamed responses is known only when the last part arrives.
+    if ((stream->response_bytes_left_ < 0) && last_part)
+        stream->response_last_queued_ = true;
+
+    // Queuing chunk until flow control allows sending it.
+    sd->set_next_chain_segment(NULL);
+
+    if (NULL == stream->pending_tail_)
+        stream->pending_head_ = sd;
+    else
+        stream->pending_tail_->set_next_chain_segment(sd);
+
+    stream->pending_tail_ = sd;
+
+    // NOTE: Setting socket data to null, so other
+    // manipulations on it are not possible.
+    sd = NULL;
+
+    err_code = SendPendingData(gw, stream);
+    if (err_code)
+        return err_code;
+
+    return Flush(gw);
+}
+
+// Resets stream whose virtual socket is being disconnected.
+uint32_t Http2Connection::CancelStream(GatewayWorker* gw, uint32_t stream_id)
+{
+    Http2Stream* stream = FindStream(stream_id, true);
+    if (NULL == stream)
+        return 0;
+
+    // Client has already reset this stream.
+    if (stream->reset_)
+    {
+        CloseStream(gw, stream);
+        return 0;
+    }
+
+    uint32_t err_code = ResetStream(gw, stream, stream_id, HTTP2_ERROR_CANCEL);
+    if (err_code)
+        return err_code;
+
+    return Flush(gw);
+}
+
+// Releases all streams.
+void Http2Connection::Release(GatewayWorker* gw)
+{
+    for (int32_t i = 0; i < kHttp2MaxConcurrentStreams; i++)
+    {
+        if (0 != streams_[i].stream_id_)
+            CloseStream(gw, streams_ + i);
+    }
+
+    if (NULL != out_sd_)
+        gw->ReturnSocketDataChunksToPool(out_sd_);
+}
+
+// Creates HTTP/2 state for connection that sent client preface.
+uint32_t GatewayWorker::Http2CreateConnection(SocketDataChunkRef sd)
+{
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    GW_ASSERT(NULL == si->http2_connection_);
+
+    Http2Connection* conn = GwNewConstructor(Http2Connection);
+    conn->Init(sd->get_socket_info_index(), sd->get_unique_socket_id(), sd->GetPortIndex(), sd->get_client_ip_info());
+
+    si->http2_connection_ = conn;
+
+    // Changing network protocol for the connection itself.
+    sd->SetTypeOfNetworkProtocol(MixedCodeConstants::NetworkProtocolType::PROTOCOL_HTTP2);
+
+    return conn->SendPreface(this);
+}
+
+// Releases HTTP/2 connection state with all its streams.
+void GatewayWorker::Http2ReleaseConnection(ScSocketInfoStruct* si)
+{
+    Http2Connection* conn = si->http2_connection_;
+    if (NULL == conn)
+        return;
+
+    si->http2_connection_ = NULL;
+
+    conn->Release(this);
+
+    GwDeleteSingle(conn);
+}
+
+// Sends codehost response on HTTP/2 stream.
+uint32_t GatewayWorker::Http2SendResponse(SocketDataChunkRef sd)
+{
+    ScSocketInfoStruct* si = sd->get_socket_info();
+
+    // Checking that connection is still alive.
+    if (!CompareUniqueSocketId(si->aggr_socket_info_index_, si->aggr_unique_socket_id_))
+        return SCERRGWOPERATIONONWRONGSOCKET;
+
+    Http2Connection* conn = sockets_infos_[si->aggr_socket_info_index_].http2_connection_;
+    if (NULL == conn)
+        return SCERRGWOPERATIONONWRONGSOCKET;
+
+    return conn->SendResponse(this, sd);
+}
+
+// Resets HTTP/2 stream whose virtual socket is being disconnected.
+void GatewayWorker::Http2CancelStream(ScSocketInfoStruct* si)
+{
+    socket_index_type conn_socket_index = si->aggr_socket_info_index_;
+
+    if (CompareUniqueSocketId(conn_socket_index, si->aggr_unique_socket_id_) &&
+        (NULL != sockets_infos_[conn_socket_index].http2_connection_))
+    {
+        // Stream and its socket are released by the connection.
+        sockets_infos_[conn_socket_index].http2_connection_->CancelStream(this, si->http2_stream_id_);
+        return;
+    }
+
+    ReleaseSocketIndex(si->read_only_index_);
+}
+
+} // namespace network
+} // namespace starcounter
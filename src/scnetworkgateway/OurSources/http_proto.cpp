@@ -2,6 +2,8 @@
 #include "gateway.hpp"
 #include "handlers.hpp"
 #include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
 #include "http_proto.hpp"
 #include "socket_data.hpp"
 #include "worker_db_interface.hpp"
@@ -156,7 +158,7 @@ uint32_t RegisteredUri::RunHandlers(GatewayWorker *gw, SocketDataChunkRef sd)
 }
 
 // Fetches method and URI from HTTP request data.
-inline uint32_t GetMethodAndUri(
+uint32_t GetMethodAndUri(
     char* http_data,
     uint32_t http_data_len,
     uint32_t* out_method_space_uri_len,
@@ -531,6 +533,37 @@ uint32_t HttpProto::HttpUriDispatcher(
     // Checking if data goes to user code.
     if (sd->get_to_database_direction_flag())
     {
+        // Checking if connection already talks HTTP/2.
+        ScSocketInfoStruct* si = sd->get_socket_info();
+        if (NULL != si->http2_connection_) {
+            return si->http2_connection_->ProcessData(gw, sd);
+        }
+
+        // Checking for HTTP/2 client preface on new connection.
+        if (g_gateway.setting_http2() &&
+            sd->get_socket_representer_flag() &&
+            (!sd->GetSocketAggregatedFlag()) &&
+            (!sd->is_web_socket()) &&
+            (sd->get_accumulated_len_bytes() > 0)) {
+
+            uint32_t num_preface_bytes = sd->get_accumulated_len_bytes();
+            if (num_preface_bytes > kHttp2ConnectionPrefaceLength)
+                num_preface_bytes = kHttp2ConnectionPrefaceLength;
+
+            if (0 == memcmp(sd->get_data_blob_start(), kHttp2ConnectionPreface, num_preface_bytes)) {
+
+                // Returning socket to receiving state for the rest of the preface.
+                if (num_preface_bytes < kHttp2ConnectionPrefaceLength)
+                    return gw->Receive(sd);
+
+                uint32_t err_code = gw->Http2CreateConnection(sd);
+                if (err_code)
+                    return err_code;
+
+                return si->http2_connection_->ProcessData(gw, sd);
+            }
+        }
+
         // Checking if we are already passed the WebSockets handshake.
 		if (sd->is_web_socket()) {
 			return sd->get_ws_proto()->ProcessWsDataToDb(gw, sd, handler_id);
@@ -641,18 +674,27 @@ uint32_t HttpProto::HttpUriDispatcher(
 
 #endif
 
-		// Resetting the parsing structure.
-		ResetParser(gw, sd);
+		// Executing HTTP parser on accumulated data.
+		size_t bytes_parsed = ExecuteParser(gw, sd);
+
+		// Total number of received request bytes including body chain.
+		uint32_t request_bytes_received = sd->get_accumulated_len_bytes() + sd->GetBodyChainLength();
 
-		// We can immediately set the request offset.
-		http_request_.request_offset_ = sd->GetAccumOrigBufferSocketDataOffset();
+		// Continuing parsing over request body chain segments.
+		if (bytes_parsed == sd->get_accumulated_len_bytes()) {
 
-		// Executing HTTP parser.
-		size_t bytes_parsed = http_parser_execute(
-			&g_ts_http_parser_,
-			&g_httpParserSettings,
-			(const char *)sd->get_data_blob_start(),
-			sd->get_accumulated_len_bytes());
+			SocketDataChunk* chain_segment = sd->GetBodyChainHead();
+			while (NULL != chain_segment) {
+
+				bytes_parsed += http_parser_execute(
+					&g_ts_http_parser_,
+					&g_httpParserSettings,
+					(const char *)chain_segment->get_data_blob_start(),
+					chain_segment->get_accumulated_len_bytes());
+
+				chain_segment = chain_segment->get_next_chain_segment();
+			}
+		}
 
 		// Checking if we have a reverse proxy on host.
 		if (INVALID_RP_INDEX != g_ts_reverse_proxy_index_) {
@@ -685,9 +727,9 @@ uint32_t HttpProto::HttpUriDispatcher(
 		http_request_.request_len_bytes_ = http_request_.content_offset_ - http_request_.request_offset_ + http_request_.content_len_bytes_;
 
 		// Handle error. Usually just close the connection.
-		if (bytes_parsed != (sd->get_accumulated_len_bytes()))
+		if (bytes_parsed != request_bytes_received)
 		{
-			GW_ASSERT(bytes_parsed < sd->get_accumulated_len_bytes());
+			GW_ASSERT(bytes_parsed < request_bytes_received);
 			GW_COUT << "HTTP packet has incorrect data!" << GW_ENDL;
 
 			return SCERRGWHTTPINCORRECTDATA;
@@ -741,7 +783,7 @@ uint32_t HttpProto::HttpUriDispatcher(
 				GW_ASSERT(http_request_.content_offset_ > http_request_.headers_offset_);
 
 				// Checking if we need to continue receiving the content.
-				if (http_request_.request_len_bytes_ > sd->get_accumulated_len_bytes())
+				if (http_request_.request_len_bytes_ > request_bytes_received)
 				{
 					// Checking for maximum supported HTTP request content size.
 					if (http_request_.content_len_bytes_ > g_gateway.setting_maximum_receive_content_length())
@@ -784,8 +826,34 @@ uint32_t HttpProto::HttpUriDispatcher(
 			g_gateway.IncrementNumProcessedHttpRequests();
 		}
 
-		// Checking correct buffers.
-		GW_ASSERT(sd->get_accumulated_len_bytes() == (sd->get_cur_network_buf_ptr() - sd->get_data_blob_start()));
+		// Checking correct buffers (network buffer points to the chain otherwise).
+		if (0 == sd->GetBodyChainLength()) {
+			GW_ASSERT(sd->get_accumulated_len_bytes() == (sd->get_cur_network_buf_ptr() - sd->get_data_blob_start()));
+		}
+
+        // Checking if request can be served from a static files route.
+        // NOTE: Files are transmitted by the kernel, so TLS sockets are excluded.
+        if ((g_gateway.get_num_static_routes() > 0) &&
+            ((MixedCodeConstants::HTTP_METHODS::GET == http_request_.http_method_) ||
+            (MixedCodeConstants::HTTP_METHODS::HEAD == http_request_.http_method_)) &&
+            sd->get_socket_representer_flag() &&
+            (!sd->GetSocketAggregatedFlag()) &&
+            (!sd->get_internal_request_flag()) &&
+            (NULL == sd->get_socket_info()->tls_context_))
+        {
+            int32_t uri_len = method_space_uri_space_len - uri_offset - 1;
+            int32_t static_route_index = g_gateway.FindStaticRoute(port_num, lower_method_space_uri_space + uri_offset, uri_len);
+
+            if (INVALID_STATIC_ROUTE_INDEX != static_route_index) {
+
+                bool served = false;
+                err_code = ServeStaticFile(gw, sd, static_route_index, method_space_uri_space + uri_offset, uri_len, &served);
+
+                // Files that are not found go to registered handlers.
+                if (served || err_code)
+                    return err_code;
+            }
+        }
 
         // Now we have method and URI and ready to search specific URI handler.
         // Getting the corresponding port number.
@@ -881,7 +949,7 @@ HANDLER_MATCHED:
         RegisteredUri* matched_uri = port_uris->GetEntryByIndex(matched_index);
 
         // Setting matched URI index.
-        sd->SetDestDbIndex(matched_uri->GetFirstDbIndex());
+        sd->SetDestDbIndex(gw, matched_uri->GetFirstDbIndex());
 
         // Checking if we have a session parameter.
         if (matched_uri->get_session_param_index() != INVALID_PARAMETER_INDEX)
@@ -898,6 +966,25 @@ HANDLER_MATCHED:
         sd->get_http_proto()->http_request_.uri_offset_ = sd->GetAccumOrigBufferSocketDataOffset() + uri_offset;
         sd->get_http_proto()->http_request_.uri_len_bytes_ = method_space_uri_space_len - uri_offset - 1;
 
+        // Gateway handlers work only on contiguous request data.
+        if (INVALID_DB_INDEX == matched_uri->GetFirstDbIndex()) {
+
+            // Checking if request does not fit into the biggest chunk.
+            if ((sd->get_accumulated_len_bytes() + sd->GetBodyChainLength() > static_cast<uint32_t>(MAX_SOCKET_DATA_SIZE)) &&
+                sd->get_socket_representer_flag()) {
+
+                // Setting disconnect after send flag.
+                sd->set_disconnect_after_send_flag();
+
+                // Sending corresponding HTTP response.
+                return gw->SendPredefinedMessage(sd, kHttpTooBigUpload, kHttpTooBigUploadLength);
+            }
+
+            err_code = gw->FlattenBufferChain(sd, false);
+            if (err_code)
+                return err_code;
+        }
+
         // Running determined handler now.
         return matched_uri->RunHandlers(gw, sd);
     }
@@ -926,6 +1013,22 @@ void HttpProto::ResetParser(GatewayWorker *gw, SocketDataChunkRef sd)
     http_parser_init(&g_ts_http_parser_, HTTP_REQUEST);
 }
 
+// Resets the parser and parses accumulated data of the first chunk.
+size_t HttpProto::ExecuteParser(GatewayWorker *gw, SocketDataChunkRef sd)
+{
+    // Resetting the parsing structure.
+    ResetParser(gw, sd);
+
+    // We can immediately set the request offset.
+    http_request_.request_offset_ = sd->GetAccumOrigBufferSocketDataOffset();
+
+    return http_parser_execute(
+        &g_ts_http_parser_,
+        &g_httpParserSettings,
+        (const char *)sd->get_data_blob_start(),
+        sd->get_accumulated_len_bytes());
+}
+
 // Parses the HTTP request and pushes processed data to database.
 uint32_t HttpProto::AppsHttpWsProcessData(
     HandlersList* hl,
@@ -1130,6 +1233,32 @@ uint32_t GatewayStatisticsInfo(HandlersList* hl, GatewayWorker *gw, SocketDataCh
         static_cast<int32_t>(stats_page_string.length()));
 }
 
+// Machine readable metrics for Gateway.
+uint32_t GatewayMetrics(HandlersList* hl, GatewayWorker *gw, SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id)
+{
+    gw->WorkerEnterGlobalLock();
+
+    std::string metrics_string = g_gateway.GetGatewayMetricsString();
+
+    gw->WorkerLeaveGlobalLock();
+
+    return gw->SendPredefinedMessage(
+        sd,
+        metrics_string.c_str(),
+        static_cast<int32_t>(metrics_string.length()));
+}
+
+// Sampled request traces for Gateway.
+uint32_t GatewayRequestTraces(HandlersList* hl, GatewayWorker *gw, SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id)
+{
+    std::string traces_string = g_gateway.GetRequestTracesString();
+
+    return gw->SendPredefinedMessage(
+        sd,
+        traces_string.c_str(),
+        static_cast<int32_t>(traces_string.length()));
+}
+
 // Updates configuration for Gateway.
 uint32_t GatewayUpdateConfiguration(HandlersList* hl, GatewayWorker *gw, SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id)
 {
@@ -1169,6 +1298,32 @@ uint32_t GatewayTestSample(HandlersList* hl, GatewayWorker *gw, SocketDataChunkR
     return gw->SendHttp200WithBody(sd, test_msg, (int32_t)strlen(test_msg));
 }
 
+// Echoes request body back, used as a gateway only target for load generation.
+uint32_t GatewayEcho(HandlersList* hl, GatewayWorker *gw, SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id)
+{
+    char* request_begin = (char*)(sd->get_data_blob_start());
+    request_begin[sd->get_accumulated_len_bytes()] = '\0';
+
+    // Looking for the end of headers.
+    char* body_begin = strstr(request_begin, "\r\n\r\n");
+    if (NULL == body_begin)
+        return SCERRGWWRONGHTTPDATA;
+
+    body_begin += 4;
+    int32_t body_len = sd->get_accumulated_len_bytes() - (int32_t)(body_begin - request_begin);
+
+    // Response has to fit into the temporary buffer.
+    if (body_len >= TEMP_BIG_BUFFER_SIZE - 512) {
+
+        char temp_buf[TEMP_BIG_BUFFER_SIZE];
+        int32_t size_bytes = ConstructHttp400(temp_buf, TEMP_BIG_BUFFER_SIZE, "Echo body is too big.", SCERRGWWRONGHTTPDATA);
+
+        return gw->SendPredefinedMessage(sd, temp_buf, size_bytes);
+    }
+
+    return gw->SendHttp200WithBody(sd, body_begin, body_len);
+}
+
 // Profilers statistics for Gateway.
 uint32_t GatewayProfilersInfo(HandlersList* hl, GatewayWorker *gw, SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id)
 {
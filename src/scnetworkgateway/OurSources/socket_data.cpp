@@ -2,6 +2,8 @@
 #include "gateway.hpp"
 #include "handlers.hpp"
 #include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
 #include "http_proto.hpp"
 #include "socket_data.hpp"
 #include "worker_db_interface.hpp"
@@ -62,6 +64,50 @@ uint32_t SocketDataChunk::ReceiveTcp(GatewayWorker *gw, uint32_t *num_bytes)
     return WSARecv(GetSocket(), GetWSABUF(), 1, (LPDWORD)num_bytes, flags, &ovl_, NULL);
 }
 
+// Start waiting for data on socket without a receive buffer.
+uint32_t SocketDataChunk::ReceiveTcpZeroBytes(GatewayWorker *gw, uint32_t *num_bytes)
+{
+    // Checking correct unique socket.
+    GW_ASSERT(true == CompareUniqueSocketId());
+
+    set_type_of_network_oper(ZERO_BYTE_RECEIVE_SOCKET_OPER);
+
+    memset(&ovl_, 0, OVERLAPPED_SIZE);
+
+    DWORD* flags = (DWORD*)(accept_or_params_or_temp_data_ + MixedCodeConstants::PARAMS_INFO_MAX_SIZE_BYTES - sizeof(DWORD));
+    *flags = 0;
+
+    // NOTE: Buffers array is captured by the provider, so it can be on stack.
+    WSABUF zero_buf;
+    zero_buf.buf = NULL;
+    zero_buf.len = 0;
+
+    return WSARecv(GetSocket(), &zero_buf, 1, (LPDWORD)num_bytes, flags, &ovl_, NULL);
+}
+
+// Start receiving ciphertext into socket TLS buffer.
+uint32_t SocketDataChunk::ReceiveTls(GatewayWorker *gw, uint32_t *num_bytes)
+{
+    // Checking correct unique socket.
+    GW_ASSERT(true == CompareUniqueSocketId());
+
+    set_type_of_network_oper(RECEIVE_SOCKET_OPER);
+
+    memset(&ovl_, 0, OVERLAPPED_SIZE);
+
+    DWORD* flags = (DWORD*)(accept_or_params_or_temp_data_ + MixedCodeConstants::PARAMS_INFO_MAX_SIZE_BYTES - sizeof(DWORD));
+    *flags = 0;
+
+    TlsContext* tls = socket_info_->tls_context_;
+
+    // NOTE: Buffers array is captured by the provider, so it can be on stack.
+    WSABUF tls_buf;
+    tls_buf.buf = (char*) (tls->GetCiphertext() + tls->get_cipher_len());
+    tls_buf.len = tls->GetReceiveSpace();
+
+    return WSARecv(GetSocket(), &tls_buf, 1, (LPDWORD)num_bytes, flags, &ovl_, NULL);
+}
+
 // Start sending on socket.
 uint32_t SocketDataChunk::SendTcp(GatewayWorker* gw, uint32_t *numBytes)
 {
@@ -77,6 +123,36 @@ uint32_t SocketDataChunk::SendTcp(GatewayWorker* gw, uint32_t *numBytes)
     return WSASend(GetSocket(), GetWSABUF(), 1, (LPDWORD)numBytes, 0, &ovl_, NULL);
 }
 
+// Start sending network buffer followed by file contents on TCP socket.
+uint32_t SocketDataChunk::TransmitFileTcp(GatewayWorker* gw, HANDLE file_handle, uint64_t file_offset, uint32_t num_file_bytes)
+{
+    // Checking correct unique socket.
+    GW_ASSERT(true == CompareUniqueSocketId());
+
+    GW_ASSERT(get_num_available_network_bytes() > 0);
+    GW_ASSERT(num_file_bytes > 0);
+
+    set_type_of_network_oper(TRANSMIT_FILE_SOCKET_OPER);
+
+    memset(&ovl_, 0, OVERLAPPED_SIZE);
+
+    // File is opened for overlapped access so the position is taken from here.
+    ovl_.Offset = static_cast<DWORD>(file_offset);
+    ovl_.OffsetHigh = static_cast<DWORD>(file_offset >> 32);
+
+    // Network buffer contains response headers that go before the file.
+    TRANSMIT_FILE_BUFFERS* tfb = (TRANSMIT_FILE_BUFFERS*) accept_or_params_or_temp_data_;
+    tfb->Head = get_cur_network_buf_ptr();
+    tfb->HeadLength = get_num_available_network_bytes();
+    tfb->Tail = NULL;
+    tfb->TailLength = 0;
+
+    if (TransmitFileFunc(GetSocket(), file_handle, num_file_bytes, 0, &ovl_, tfb, 0))
+        return 0;
+
+    return SOCKET_ERROR;
+}
+
 // Start receiving on socket.
 uint32_t SocketDataChunk::ReceiveUdp(GatewayWorker *gw, uint32_t *num_bytes)
 {
@@ -213,7 +289,7 @@ void SocketDataChunk::PreInitSocketDataFromDb(GatewayWorker* gw, const scheduler
 
     // Checking if WebSocket handshake was approved.
     if (get_ws_upgrade_approved_flag()) {
-        SetWebSocketGroupId(*(ws_group_id_type*)accept_or_params_or_temp_data_);
+        gw->SetSocketWsGroupId(socket_info_index_, *(ws_group_id_type*)accept_or_params_or_temp_data_);
     }
 
 	// Getting socket streaming flag.
@@ -271,6 +347,14 @@ void SocketDataChunk::set_socket_info_reference(GatewayWorker* gw)
     socket_info_ = gw->GetSocketInfoReference(socket_info_index_);
 }
 
+// Setting destination database index.
+void SocketDataChunk::SetDestDbIndex(GatewayWorker* gw, db_index_type db_index)
+{
+    GW_ASSERT_DEBUG(NULL != socket_info_);
+
+    gw->SetSocketDestDbIndex(socket_info_index_, db_index);
+}
+
 // Clones existing socket data chunk for receiving.
 uint32_t SocketDataChunk::CloneToReceive(GatewayWorker *gw)
 {
@@ -283,6 +367,9 @@ uint32_t SocketDataChunk::CloneToReceive(GatewayWorker *gw)
     uint32_t err_code;
     if (IsUdp()) {
         err_code = gw->CreateSocketData(socket_info_index_, sd_clone, MAX_UDP_DATAGRAM_SIZE);
+    } else if (g_gateway.setting_zero_byte_receive()) {
+        // Smallest chunk is enough to wait for data.
+        err_code = gw->CreateSocketData(socket_info_index_, sd_clone, GatewayChunkDataSizes[0]);
     } else {
         err_code = gw->CreateSocketData(socket_info_index_, sd_clone);
     }
@@ -424,6 +511,34 @@ uint32_t SocketDataChunk::ChangeToBigger(
     return 0;
 }
 
+// Moves empty socket data to the smallest chunk store.
+uint32_t SocketDataChunk::ChangeToSmallest(
+    GatewayWorker*gw,
+    SocketDataChunkRef sd)
+{
+    // Checking if already in the smallest store.
+    if (0 == sd->get_chunk_store_index())
+        return 0;
+
+    GW_ASSERT(0 == sd->get_accumulated_len_bytes());
+
+    SocketDataChunk* new_sd = gw->GetWorkerChunks()->ObtainChunkByStoreIndex(0);
+
+    // Checking if couldn't obtain chunk.
+    if (NULL == new_sd)
+        return SCERRGWMAXCHUNKSNUMBERREACHED;
+
+    // Copying the socket data headers.
+    new_sd->CopyFromAnotherSocketData(sd);
+
+    // Releasing chunk.
+    gw->GetWorkerChunks()->ReleaseChunk(sd);
+
+    sd = new_sd;
+
+    return 0;
+}
+
 // Clone current socket data to push it.
 uint32_t SocketDataChunk::CloneToPush(GatewayWorker* gw, int32_t data_size, SocketDataChunk** new_sd)
 {
@@ -541,18 +656,26 @@ void SocketDataChunk::CopyIPCChunksToGatewayChunk(
     GW_ASSERT(user_data_len_bytes == data_bytes_offset);
 }
 
-// Copies gateway chunk to IPC chunks.
+// Copies gateway chunk and given request body chain to IPC chunks.
 uint32_t SocketDataChunk::CopyGatewayChunkToIPCChunks(
     WorkerDbInterface* worker_db,
+    SocketDataChunk* body_chain_head,
+    uint32_t body_chain_len_bytes,
     SocketDataChunk** new_ipc_sd,
     core::chunk_index* ipc_first_chunk_index)
 {
     // Maximum number of bytes that will be written in this call.
     int32_t cur_chunk_num_copy_bytes = MixedCodeConstants::SOCKET_DATA_MAX_SIZE - SOCKET_DATA_OFFSET_BLOB;
 
-    int32_t data_len_bytes = get_user_data_length_bytes();
+    int32_t user_data_len_bytes = get_user_data_length_bytes();
+
+    // Request body chain (if any) continues right after user data.
+    SocketDataChunk* chain_segment = body_chain_head;
+    int32_t data_len_bytes = user_data_len_bytes + body_chain_len_bytes;
 
+    // Current piece of data being copied.
     uint8_t* data = GetUserData();
+    int32_t data_piece_bytes_left = user_data_len_bytes;
 
     // Number of IPC chunks to use.
     int32_t num_chunks = 1, total_num_copied_bytes = 0;
@@ -596,6 +719,9 @@ uint32_t SocketDataChunk::CopyGatewayChunkToIPCChunks(
     // NOTE: Adjusting the user data offset because we copy directly to start of the blob.
     (*new_ipc_sd)->set_user_data_offset_in_socket_data(SOCKET_DATA_OFFSET_BLOB);
 
+    // User data in IPC chunks includes the request body chain.
+    (*new_ipc_sd)->set_user_data_length_bytes_icp_chunk(data_len_bytes);
+
 	// Checking if there are any bytes to copy at all.
 	if (0 == data_len_bytes) {
 		GW_ASSERT(1 == num_chunks);
@@ -605,12 +731,34 @@ uint32_t SocketDataChunk::CopyGatewayChunkToIPCChunks(
     // Copying all data.
     for (int32_t i = 0; i < num_chunks; i++) {
 
-        // Writing to first chunk.
-        memcpy(cur_chunk_buf + cur_offset_in_chunk, data, cur_chunk_num_copy_bytes);
+        // Filling current chunk, possibly from several data pieces.
+        while (cur_chunk_num_copy_bytes > 0) {
+
+            // Switching to the next chain segment when current piece is copied.
+            if (0 == data_piece_bytes_left) {
+
+                GW_ASSERT(NULL != chain_segment);
 
-        // Adjusting the data pointer.
-        data += cur_chunk_num_copy_bytes;
-        total_num_copied_bytes += cur_chunk_num_copy_bytes;
+                data = chain_segment->get_data_blob_start();
+                data_piece_bytes_left = chain_segment->get_accumulated_len_bytes();
+                chain_segment = chain_segment->get_next_chain_segment();
+
+                continue;
+            }
+
+            int32_t num_copy_bytes = cur_chunk_num_copy_bytes;
+            if (num_copy_bytes > data_piece_bytes_left)
+                num_copy_bytes = data_piece_bytes_left;
+
+            memcpy(cur_chunk_buf + cur_offset_in_chunk, data, num_copy_bytes);
+
+            // Adjusting the data pointer.
+            data += num_copy_bytes;
+            data_piece_bytes_left -= num_copy_bytes;
+            cur_offset_in_chunk += num_copy_bytes;
+            cur_chunk_num_copy_bytes -= num_copy_bytes;
+            total_num_copied_bytes += num_copy_bytes;
+        }
 
         // All subsequent chunks are getting zero offset.
         cur_offset_in_chunk = 0;
@@ -634,9 +782,9 @@ uint32_t SocketDataChunk::CopyGatewayChunkToIPCChunks(
     
     // Checking that we wrote correctly.
     GW_ASSERT(0 == cur_chunk_num_copy_bytes);
-    GW_ASSERT(total_num_copied_bytes == get_user_data_length_bytes());
+    GW_ASSERT(total_num_copied_bytes == data_len_bytes);
     GW_ASSERT(INVALID_CHUNK_INDEX == cur_chunk_index);
-    GW_ASSERT(total_num_copied_bytes == (data - GetUserData()));
+    GW_ASSERT((NULL == chain_segment) && (0 == data_piece_bytes_left));
 
     return 0;
 }
@@ -0,0 +1,671 @@
+#include "static_headers.hpp"
+#include "gateway.hpp"
+#include "handlers.hpp"
+#include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
+#include "http_proto.hpp"
+#include "socket_data.hpp"
+#include "worker_db_interface.hpp"
+#include "worker.hpp"
+
+namespace starcounter {
+namespace network {
+
+// Content type for given file extension.
+struct StaticFileContentType
+{
+    const char* extension_;
+    const char* content_type_;
+};
+
+const StaticFileContentType kStaticFileContentTypes[] = {
+    { "html", "text/html; charset=utf-8" },
+    { "htm", "text/html; charset=utf-8" },
+    { "css", "text/css; charset=utf-8" },
+    { "js", "application/javascript; charset=utf-8" },
+    { "json", "application/json; charset=utf-8" },
+    { "map", "application/json; charset=utf-8" },
+    { "xml", "text/xml; charset=utf-8" },
+    { "txt", "text/plain; charset=utf-8" },
+    { "svg", "image/svg+xml" },
+    { "png", "image/png" },
+    { "jpg", "image/jpeg" },
+    { "jpeg", "image/jpeg" },
+    { "gif", "image/gif" },
+    { "ico", "image/x-icon" },
+    { "webp", "image/webp" },
+    { "woff", "font/woff" },
+    { "woff2", "font/woff2" },
+    { "ttf", "font/ttf" },
+    { "wasm", "application/wasm" },
+    { "pdf", "application/pdf" },
+    { "mp4", "video/mp4" }
+};
+
+const char* const kHttpDayNames[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+
+const char* const kHttpMonthNames[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+// Result of parsing the Range header.
+enum ByteRangeResult
+{
+    BYTE_RANGE_IGNORED,
+    BYTE_RANGE_SATISFIABLE,
+    BYTE_RANGE_NOT_SATISFIABLE
+};
+
+// Determines content type from file extension.
+const char* GetStaticFileContentType(const std::wstring& path)
+{
+    size_t dot_pos = path.find_last_of(L'.');
+    size_t slash_pos = path.find_last_of(L'\\');
+
+    if ((std::wstring::npos == dot_pos) || ((std::wstring::npos != slash_pos) && (dot_pos < slash_pos)))
+        return "application/octet-stream";
+
+    std::string extension;
+    for (size_t i = dot_pos + 1; i < path.length(); i++)
+    {
+        if (path[i] > 127)
+            return "application/octet-stream";
+
+        extension += static_cast<char>(tolower(path[i]));
+    }
+
+    for (int32_t i = 0; i < _countof(kStaticFileContentTypes); i++)
+    {
+        if (extension == kStaticFileContentTypes[i].extension_)
+            return kStaticFileContentTypes[i].content_type_;
+    }
+
+    return "application/octet-stream";
+}
+
+// Formats file time as HTTP date.
+void FormatHttpDate(const FILETIME& file_time, char* dest, int32_t dest_max_bytes)
+{
+    SYSTEMTIME st;
+    FileTimeToSystemTime(&file_time, &st);
+
+    sprintf_s(dest, dest_max_bytes, "%s, %02d %s %04d %02d:%02d:%02d GMT",
+        kHttpDayNames[st.wDayOfWeek], st.wDay, kHttpMonthNames[st.wMonth - 1], st.wYear,
+        st.wHour, st.wMinute, st.wSecond);
+}
+
+// Builds full file path inside static route directory for given URI.
+bool GetStaticFilePath(
+    StaticRouteInfo* route,
+    const char* uri,
+    const int32_t uri_len,
+    std::wstring& path)
+{
+    char rel_path[MixedCodeConstants::MAX_URI_STRING_LEN];
+    int32_t rel_path_len = 0;
+
+    // Index file name length including terminating zero.
+    const int32_t index_file_len = 11;
+
+    for (int32_t i = route->uri_prefix_len_; i < uri_len; i++)
+    {
+        char c = uri[i];
+
+        // Query and fragment are not part of the file path.
+        if (('?' == c) || ('#' == c))
+            break;
+
+        // Decoding percent-encoded character.
+        if ('%' == c)
+        {
+            if ((i + 2 >= uri_len) || (!isxdigit((uint8_t) uri[i + 1])) || (!isxdigit((uint8_t) uri[i + 2])))
+                return false;
+
+            char hex[3] = { uri[i + 1], uri[i + 2], '\0' };
+            c = static_cast<char>(strtol(hex, NULL, 16));
+            i += 2;
+        }
+
+        // Characters that could leave the directory or address a stream.
+        if (('\\' == c) || (':' == c) || ('\0' == c))
+            return false;
+
+        if (rel_path_len >= MixedCodeConstants::MAX_URI_STRING_LEN - index_file_len)
+            return false;
+
+        rel_path[rel_path_len] = ('/' == c) ? '\\' : c;
+        rel_path_len++;
+    }
+
+    // Serving index file for directories.
+    if ((0 == rel_path_len) || ('\\' == rel_path[rel_path_len - 1]))
+    {
+        memcpy(rel_path + rel_path_len, "index.html", index_file_len - 1);
+        rel_path_len += index_file_len - 1;
+    }
+
+    rel_path[rel_path_len] = '\0';
+
+    // Rejecting segments that consist of dots and spaces only,
+    // since Windows treats them as references to parent directories.
+    int32_t segment_start = 0;
+    for (int32_t i = 0; i <= rel_path_len; i++)
+    {
+        if ((i == rel_path_len) || ('\\' == rel_path[i]))
+        {
+            bool only_dots = (i > segment_start);
+
+            for (int32_t k = segment_start; k < i; k++)
+            {
+                if (('.' != rel_path[k]) && (' ' != rel_path[k]))
+                {
+                    only_dots = false;
+                    break;
+                }
+            }
+
+            if (only_dots)
+                return false;
+
+            segment_start = i + 1;
+        }
+    }
+
+    wchar_t w_rel_path[MixedCodeConstants::MAX_URI_STRING_LEN];
+    if (MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, rel_path, rel_path_len + 1, w_rel_path, MixedCodeConstants::MAX_URI_STRING_LEN) <= 0)
+        return false;
+
+    path = route->directory_;
+    path += L'\\';
+    path += w_rel_path;
+
+    return true;
+}
+
+// Finds value of given header in raw request headers.
+const char* FindHttpHeaderValue(
+    const char* headers,
+    const int32_t headers_len,
+    const char* name,
+    const int32_t name_len,
+    int32_t* value_len)
+{
+    const char* headers_end = headers + headers_len;
+    const char* line = headers;
+
+    while (line < headers_end)
+    {
+        const char* line_end = line;
+        while ((line_end < headers_end) && ('\r' != *line_end) && ('\n' != *line_end))
+            line_end++;
+
+        if ((line_end - line > name_len) && (':' == line[name_len]) && (0 == _strnicmp(line, name, name_len)))
+        {
+            const char* value = line + name_len + 1;
+            while ((value < line_end) && ((' ' == *value) || ('\t' == *value)))
+                value++;
+
+            const char* value_end = line_end;
+            while ((value_end > value) && ((' ' == *(value_end - 1)) || ('\t' == *(value_end - 1))))
+                value_end--;
+
+            *value_len = static_cast<int32_t>(value_end - value);
+            return value;
+        }
+
+        line = line_end;
+        while ((line < headers_end) && (('\r' == *line) || ('\n' == *line)))
+            line++;
+    }
+
+    return NULL;
+}
+
+// Parses decimal number from given string.
+bool ParseRangeNumber(const char* str, const int32_t str_len, uint64_t* number)
+{
+    // Too big numbers are not supported.
+    if ((str_len <= 0) || (str_len > 18))
+        return false;
+
+    *number = 0;
+    for (int32_t i = 0; i < str_len; i++)
+    {
+        if (!isdigit((uint8_t) str[i]))
+            return false;
+
+        *number = *number * 10 + (str[i] - '0');
+    }
+
+    return true;
+}
+
+// Parses single byte range from Range header value.
+// NOTE: Multiple ranges are ignored and whole file is sent instead.
+ByteRangeResult ParseByteRange(
+    const char* value,
+    const int32_t value_len,
+    const uint64_t file_size,
+    uint64_t* first_byte,
+    uint64_t* last_byte)
+{
+    const char* const units = "bytes=";
+    const int32_t units_len = 6;
+
+    if ((value_len <= units_len) || (0 != _strnicmp(value, units, units_len)))
+        return BYTE_RANGE_IGNORED;
+
+    const char* range = value + units_len;
+    int32_t range_len = value_len - units_len;
+
+    int32_t dash_pos = -1;
+    for (int32_t i = 0; i < range_len; i++)
+    {
+        if (',' == range[i])
+            return BYTE_RANGE_IGNORED;
+
+        if (('-' == range[i]) && (dash_pos < 0))
+            dash_pos = i;
+    }
+
+    if (dash_pos < 0)
+        return BYTE_RANGE_IGNORED;
+
+    uint64_t first, last;
+
+    // Checking if its a suffix range.
+    if (0 == dash_pos)
+    {
+        if (!ParseRangeNumber(range + 1, range_len - 1, &last))
+            return BYTE_RANGE_IGNORED;
+
+        if ((0 == last) || (0 == file_size))
+            return BYTE_RANGE_NOT_SATISFIABLE;
+
+        *first_byte = (file_size > last) ? (file_size - last) : 0;
+        *last_byte = file_size - 1;
+
+        return BYTE_RANGE_SATISFIABLE;
+    }
+
+    if (!ParseRangeNumber(range, dash_pos, &first))
+        return BYTE_RANGE_IGNORED;
+
+    // Checking if range is open ended.
+    if (dash_pos == range_len - 1)
+    {
+        last = file_size - 1;
+    }
+    else
+    {
+        if (!ParseRangeNumber(range + dash_pos + 1, range_len - dash_pos - 1, &last))
+            return BYTE_RANGE_IGNORED;
+
+        if (last < first)
+            return BYTE_RANGE_IGNORED;
+
+        if (last >= file_size)
+            last = file_size - 1;
+    }
+
+    if (first >= file_size)
+        return BYTE_RANGE_NOT_SATISFIABLE;
+
+    *first_byte = first;
+    *last_byte = last;
+
+    return BYTE_RANGE_SATISFIABLE;
+}
+
+// Opens file and fills new entry.
+StaticFileEntry* StaticFilesCache::OpenEntry(const std::wstring& path)
+{
+    // File is opened for overlapped access, so that each transmit specifies its own offset.
+    HANDLE file_handle = CreateFileW(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+
+    if (INVALID_HANDLE_VALUE == file_handle)
+        return NULL;
+
+    // Only regular files are served (no devices or pipes).
+    BY_HANDLE_FILE_INFORMATION file_info;
+    if ((FILE_TYPE_DISK != GetFileType(file_handle)) ||
+        (!GetFileInformationByHandle(file_handle, &file_info)) ||
+        (file_info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        CloseHandle(file_handle);
+        return NULL;
+    }
+
+    StaticFileEntry* entry = GwNewConstructor(StaticFileEntry);
+
+    entry->path_ = path;
+    entry->file_handle_ = file_handle;
+    entry->file_size_ = (static_cast<uint64_t>(file_info.nFileSizeHigh) << 32) | file_info.nFileSizeLow;
+    entry->last_write_time_ = file_info.ftLastWriteTime;
+
+    uint64_t last_write_time = (static_cast<uint64_t>(file_info.ftLastWriteTime.dwHighDateTime) << 32) |
+        file_info.ftLastWriteTime.dwLowDateTime;
+
+    sprintf_s(entry->etag_, "\"%llx-%llx\"", last_write_time, entry->file_size_);
+    FormatHttpDate(file_info.ftLastWriteTime, entry->last_modified_, sizeof(entry->last_modified_));
+
+    entry->content_type_ = GetStaticFileContentType(path);
+    entry->checked_tick_ = GetTickCount64();
+    entry->used_tick_ = entry->checked_tick_;
+    entry->num_users_ = 0;
+    entry->detached_ = false;
+
+    return entry;
+}
+
+// Closes file and deletes entry.
+void StaticFilesCache::DeleteEntry(StaticFileEntry* entry)
+{
+    GW_ASSERT(0 == entry->num_users_);
+
+    CloseHandle(entry->file_handle_);
+
+    GwDeleteSingle(entry);
+}
+
+// Removes entry from cache, deleting it when not in use.
+void StaticFilesCache::DetachEntry(StaticFileEntry* entry)
+{
+    entries_.erase(entry->path_);
+
+    if (0 == entry->num_users_)
+        DeleteEntry(entry);
+    else
+        entry->detached_ = true;
+}
+
+// Makes space for a new entry by detaching least recently used one.
+void StaticFilesCache::EvictEntry()
+{
+    StaticFileEntry* lru_entry = NULL;
+
+    for (std::unordered_map<std::wstring, StaticFileEntry*>::iterator it = entries_.begin(); it != entries_.end(); it++)
+    {
+        if ((NULL == lru_entry) || (it->second->used_tick_ < lru_entry->used_tick_))
+            lru_entry = it->second;
+    }
+
+    if (NULL != lru_entry)
+        DetachEntry(lru_entry);
+}
+
+// Obtains open file for given path (NULL if file can't be opened).
+StaticFileEntry* StaticFilesCache::Obtain(const std::wstring& path)
+{
+    uint64_t cur_tick = GetTickCount64();
+    StaticFileEntry* entry = NULL;
+
+    std::unordered_map<std::wstring, StaticFileEntry*>::iterator it = entries_.find(path);
+    if (it != entries_.end())
+    {
+        entry = it->second;
+
+        // Checking if file was changed since it was opened.
+        if (cur_tick - entry->checked_tick_ >= STATIC_FILES_REVALIDATE_INTERVAL_MS)
+        {
+            WIN32_FILE_ATTRIBUTE_DATA file_attr;
+
+            if (GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &file_attr) &&
+                (0 == CompareFileTime(&file_attr.ftLastWriteTime, &entry->last_write_time_)) &&
+                (entry->file_size_ == ((static_cast<uint64_t>(file_attr.nFileSizeHigh) << 32) | file_attr.nFileSizeLow)))
+            {
+                entry->checked_tick_ = cur_tick;
+            }
+            else
+            {
+                // Pending transmits keep using the old handle.
+                DetachEntry(entry);
+                entry = NULL;
+            }
+        }
+    }
+
+    if (NULL != entry)
+    {
+        num_hits_++;
+    }
+    else
+    {
+        num_misses_++;
+
+        entry = OpenEntry(path);
+        if (NULL == entry)
+            return NULL;
+
+        if (entries_.size() >= MAX_STATIC_FILES_CACHED_PER_WORKER)
+            EvictEntry();
+
+        entries_[path] = entry;
+    }
+
+    entry->used_tick_ = cur_tick;
+    entry->num_users_++;
+
+    return entry;
+}
+
+// Releases file obtained with Obtain.
+void StaticFilesCache::Release(StaticFileEntry* entry)
+{
+    GW_ASSERT(entry->num_users_ > 0);
+
+    entry->num_users_--;
+
+    if (entry->detached_ && (0 == entry->num_users_))
+        DeleteEntry(entry);
+}
+
+StaticFilesCache::~StaticFilesCache()
+{
+    for (std::unordered_map<std::wstring, StaticFileEntry*>::iterator it = entries_.begin(); it != entries_.end(); it++)
+    {
+        CloseHandle(it->second->file_handle_);
+        GwDeleteSingle(it->second);
+    }
+
+    entries_.clear();
+}
+
+// Serves file from static route directory directly from gateway.
+uint32_t HttpProto::ServeStaticFile(
+    GatewayWorker *gw,
+    SocketDataChunkRef sd,
+    int32_t static_route_index,
+    const char* uri,
+    int32_t uri_len,
+    bool* served)
+{
+    *served = false;
+
+    StaticRouteInfo* route = g_gateway.GetStaticRouteInfo(static_route_index);
+
+    // Requests that can't be mapped to a file go to registered handlers.
+    std::wstring path;
+    if (!GetStaticFilePath(route, uri, uri_len, path))
+        return 0;
+
+    StaticFilesCache* cache = gw->GetStaticFilesCache();
+
+    StaticFileEntry* entry = cache->Obtain(path);
+    if (NULL == entry)
+        return 0;
+
+    // TransmitFile sends at most 2GB in one call.
+    if (entry->file_size_ > INT32_MAX - 1)
+    {
+        cache->Release(entry);
+        return 0;
+    }
+
+    *served = true;
+
+    const char* headers = (const char*) sd + http_request_.headers_offset_;
+    int32_t headers_len = http_request_.headers_len_bytes_;
+    if (0 == http_request_.headers_offset_)
+        headers_len = 0;
+
+    int32_t etag_len = static_cast<int32_t>(strlen(entry->etag_));
+    int32_t last_modified_len = static_cast<int32_t>(strlen(entry->last_modified_));
+
+    // Checking conditional request headers.
+    bool not_modified = false;
+    int32_t value_len;
+
+    const char* value = FindHttpHeaderValue(headers, headers_len, "If-None-Match", 13, &value_len);
+    if (NULL != value)
+    {
+        not_modified = ((1 == value_len) && ('*' == value[0])) ||
+            (std::string::npos != std::string(value, value_len).find(entry->etag_));
+    }
+    else
+    {
+        // Date is compared exactly to the one that was sent.
+        value = FindHttpHeaderValue(headers, headers_len, "If-Modified-Since", 17, &value_len);
+        if (NULL != value)
+            not_modified = (value_len == last_modified_len) && (0 == strncmp(value, entry->last_modified_, value_len));
+    }
+
+    char cache_control[64];
+    cache_control[0] = '\0';
+    if (route->max_age_seconds_ >= 0)
+        sprintf_s(cache_control, "Cache-Control: max-age=%d\r\n", route->max_age_seconds_);
+
+    char resp[MAX_STATIC_FILE_RESPONSE_HEADERS_BYTES];
+    int32_t resp_len;
+
+    if (not_modified)
+    {
+        resp_len = sprintf_s(resp,
+            "HTTP/1.1 304 Not Modified\r\n"
+            "ETag: %s\r\n"
+            "Last-Modified: %s\r\n"
+            "%s"
+            "\r\n",
+            entry->etag_, entry->last_modified_, cache_control);
+
+        cache->Release(entry);
+
+        return gw->SendPredefinedMessage(sd, resp, resp_len);
+    }
+
+    uint64_t first_byte = 0, last_byte = entry->file_size_ - 1;
+    bool partial = false;
+
+    value = FindHttpHeaderValue(headers, headers_len, "Range", 5, &value_len);
+    if (NULL != value)
+    {
+        // Range applies only if If-Range still matches the file.
+        int32_t if_range_len;
+        const char* if_range = FindHttpHeaderValue(headers, headers_len, "If-Range", 8, &if_range_len);
+
+        if ((NULL == if_range) ||
+            ((if_range_len == etag_len) && (0 == strncmp(if_range, entry->etag_, etag_len))) ||
+            ((if_range_len == last_modified_len) && (0 == strncmp(if_range, entry->last_modified_, last_modified_len))))
+        {
+            switch (ParseByteRange(value, value_len, entry->file_size_, &first_byte, &last_byte))
+            {
+                case BYTE_RANGE_SATISFIABLE:
+                {
+                    partial = true;
+                    break;
+                }
+
+                case BYTE_RANGE_NOT_SATISFIABLE:
+                {
+                    resp_len = sprintf_s(resp,
+                        "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                        "Content-Range: bytes */%llu\r\n"
+                        "Content-Length: 0\r\n"
+                        "\r\n",
+                        entry->file_size_);
+
+                    cache->Release(entry);
+
+                    return gw->SendPredefinedMessage(sd, resp, resp_len);
+                }
+
+                default:
+                {
+                    first_byte = 0;
+                    last_byte = entry->file_size_ - 1;
+                }
+            }
+        }
+    }
+
+    uint64_t content_len = entry->file_size_;
+
+    if (partial)
+    {
+        content_len = last_byte - first_byte + 1;
+
+        resp_len = sprintf_s(resp,
+            "HTTP/1.1 206 Partial Content\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %llu\r\n"
+            "Content-Range: bytes %llu-%llu/%llu\r\n"
+            "ETag: %s\r\n"
+            "Last-Modified: %s\r\n"
+            "Accept-Ranges: bytes\r\n"
+            "%s"
+            "\r\n",
+            entry->content_type_, content_len, first_byte, last_byte, entry->file_size_,
+            entry->etag_, entry->last_modified_, cache_control);
+    }
+    else
+    {
+        resp_len = sprintf_s(resp,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %llu\r\n"
+            "ETag: %s\r\n"
+            "Last-Modified: %s\r\n"
+            "Accept-Ranges: bytes\r\n"
+            "%s"
+            "\r\n",
+            entry->content_type_, content_len, entry->etag_, entry->last_modified_, cache_control);
+    }
+
+    // No body is sent for HEAD requests and empty files.
+    if ((MixedCodeConstants::HTTP_METHODS::HEAD == http_request_.http_method_) || (0 == content_len))
+    {
+        cache->Release(entry);
+
+        return gw->SendPredefinedMessage(sd, resp, resp_len);
+    }
+
+    // We don't need original chunk contents.
+    sd->ResetAccumBuffer();
+
+    // Checking if headers fit inside chunk.
+    if (resp_len > (int32_t) sd->get_num_available_network_bytes())
+    {
+        uint32_t err_code = SocketDataChunk::ChangeToBigger(gw, sd, resp_len);
+        if (err_code)
+        {
+            cache->Release(entry);
+            return err_code;
+        }
+    }
+
+    // Response headers are sent from chunk in the same operation as the file.
+    memcpy(sd->get_data_blob_start(), resp, resp_len);
+
+    sd->PrepareForSend(sd->get_data_blob_start(), resp_len);
+
+    return gw->SendStaticFile(sd, entry, first_byte, static_cast<uint32_t>(content_len));
+}
+
+} // namespace network
+} // namespace starcounter
@@ -0,0 +1,692 @@
+#include "static_headers.hpp"
+#include "gateway.hpp"
+#include "handlers.hpp"
+#include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
+#include "http_proto.hpp"
+#include "socket_data.hpp"
+#include "worker_db_interface.hpp"
+#include "worker.hpp"
+
+namespace starcounter {
+namespace network {
+
+// Size of SHA1 certificate thumbprint.
+const int32_t kTlsThumbprintLen = 20;
+
+// ALPN protocols offered when HTTP/2 is enabled, in order of preference.
+const char kTlsAlpnProtocols[] = "\x02h2\x08http/1.1";
+const uint16_t kTlsAlpnProtocolsLen = sizeof(kTlsAlpnProtocols) - 1;
+
+// Fills Schannel application protocols structure and returns its size.
+uint32_t TlsFillAlpnProtocols(uint8_t* buf)
+{
+    SEC_APPLICATION_PROTOCOLS* protocols = (SEC_APPLICATION_PROTOCOLS*) buf;
+    SEC_APPLICATION_PROTOCOL_LIST* list = protocols->ProtocolLists;
+
+    list->ProtoNegoExt = SecApplicationProtocolNegotiationExt_ALPN;
+    list->ProtocolListSize = kTlsAlpnProtocolsLen;
+    memcpy(list->ProtocolList, kTlsAlpnProtocols, kTlsAlpnProtocolsLen);
+
+    protocols->ProtocolListsSize = static_cast<unsigned long>(
+        FIELD_OFFSET(SEC_APPLICATION_PROTOCOL_LIST, ProtocolList) + kTlsAlpnProtocolsLen);
+
+    return static_cast<uint32_t>(FIELD_OFFSET(SEC_APPLICATION_PROTOCOLS, ProtocolLists) + protocols->ProtocolListsSize);
+}
+
+// Converts hexadecimal character to its value (or -1).
+int32_t TlsHexCharValue(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+// Loads port certificate and acquires Schannel credentials for it.
+uint32_t TlsAcquireCredentials(TlsPortInfo* tls_port)
+{
+    // Parsing thumbprint, ignoring separators copied from certificate viewers.
+    BYTE thumbprint[kTlsThumbprintLen];
+    int32_t num_digits = 0;
+
+    for (size_t i = 0; i < tls_port->certificate_thumbprint_.length(); i++)
+    {
+        char c = tls_port->certificate_thumbprint_[i];
+        if ((' ' == c) || (':' == c) || ('\t' == c))
+            continue;
+
+        int32_t v = TlsHexCharValue(c);
+        if ((v < 0) || (num_digits >= kTlsThumbprintLen * 2))
+        {
+            num_digits = -1;
+            break;
+        }
+
+        if (0 == (num_digits % 2))
+            thumbprint[num_digits / 2] = (BYTE) (v << 4);
+        else
+            thumbprint[num_digits / 2] |= (BYTE) v;
+
+        num_digits++;
+    }
+
+    if (num_digits != kTlsThumbprintLen * 2)
+    {
+        g_gateway.LogWriteCritical(L"Gateway XML: TlsPort CertificateThumbprint is not a valid SHA1 thumbprint.");
+        return SCERRBADGATEWAYCONFIG;
+    }
+
+    // Opening local machine certificate store.
+    HCERTSTORE cert_store = CertOpenStore(
+        CERT_STORE_PROV_SYSTEM_A,
+        0,
+        NULL,
+        CERT_SYSTEM_STORE_LOCAL_MACHINE | CERT_STORE_READONLY_FLAG | CERT_STORE_OPEN_EXISTING_FLAG,
+        tls_port->certificate_store_.c_str());
+
+    if (NULL == cert_store)
+    {
+        g_gateway.LogWriteCritical(L"Gateway XML: Can't open TlsPort CertificateStore.");
+        return SCERRBADGATEWAYCONFIG;
+    }
+
+    CRYPT_HASH_BLOB hash_blob;
+    hash_blob.cbData = kTlsThumbprintLen;
+    hash_blob.pbData = thumbprint;
+
+    tls_port->certificate_ = CertFindCertificateInStore(
+        cert_store,
+        X509_ASN_ENCODING | PKCS_7_ASN_ENCODING,
+        0,
+        CERT_FIND_SHA1_HASH,
+        &hash_blob,
+        NULL);
+
+    // NOTE: Found certificate keeps its own reference to the store.
+    CertCloseStore(cert_store, 0);
+
+    if (NULL == tls_port->certificate_)
+    {
+        g_gateway.LogWriteCritical(L"Gateway XML: Can't find TlsPort certificate in CertificateStore.");
+        return SCERRBADGATEWAYCONFIG;
+    }
+
+    SCHANNEL_CRED schannel_cred;
+    memset(&schannel_cred, 0, sizeof(schannel_cred));
+
+    // NOTE: Enabled protocols are left to system defaults.
+    schannel_cred.dwVersion = SCHANNEL_CRED_VERSION;
+    schannel_cred.cCreds = 1;
+    schannel_cred.paCred = &tls_port->certificate_;
+    schannel_cred.dwFlags = SCH_USE_STRONG_CRYPTO;
+
+    // Session cache lifetime is given in milliseconds, zero disables resumption.
+    if (0 == tls_port->session_cache_seconds_)
+        schannel_cred.dwFlags |= SCH_CRED_DISABLE_RECONNECTS;
+    else
+        schannel_cred.dwSessionLifespan = static_cast<DWORD>(tls_port->session_cache_seconds_) * 1000;
+
+    TimeStamp expiry;
+    SECURITY_STATUS status = AcquireCredentialsHandleW(
+        NULL,
+        UNISP_NAME_W,
+        SECPKG_CRED_INBOUND,
+        NULL,
+        &schannel_cred,
+        NULL,
+        NULL,
+        &tls_port->credentials_,
+        &expiry);
+
+    if (SEC_E_OK != status)
+    {
+        std::wstringstream s;
+        s << L"Gateway XML: Can't acquire TLS credentials for port " << tls_port->port_ <<
+            L" (status 0x" << std::hex << (uint32_t) status << L").";
+        g_gateway.LogWriteCritical(s.str().c_str());
+
+        CertFreeCertificateContext(tls_port->certificate_);
+        tls_port->certificate_ = NULL;
+        SecInvalidateHandle(&tls_port->credentials_);
+
+        return SCERRBADGATEWAYCONFIG;
+    }
+
+    return 0;
+}
+
+// Releases port credentials and certificate.
+void TlsReleaseCredentials(TlsPortInfo* tls_port)
+{
+    if (SecIsValidHandle(&tls_port->credentials_))
+    {
+        FreeCredentialsHandle(&tls_port->credentials_);
+        SecInvalidateHandle(&tls_port->credentials_);
+    }
+
+    if (NULL != tls_port->certificate_)
+    {
+        CertFreeCertificateContext(tls_port->certificate_);
+        tls_port->certificate_ = NULL;
+    }
+}
+
+// Beginning of buffered ciphertext.
+uint8_t* TlsContext::GetCiphertext()
+{
+    return recv_sd_->get_data_blob_start();
+}
+
+// Free space left for receiving ciphertext.
+uint32_t TlsContext::GetReceiveSpace()
+{
+    return recv_sd_->get_data_blob_size() - cipher_len_;
+}
+
+// Keeps only given ciphertext, moving it to the beginning of receive buffer.
+void TlsContext::KeepCiphertext(uint8_t* cipher_ptr, uint32_t cipher_len)
+{
+    memmove(recv_sd_->get_data_blob_start(), cipher_ptr, cipher_len);
+    cipher_len_ = cipher_len;
+
+    extra_ptr_ = NULL;
+    extra_len_ = 0;
+}
+
+// Creates TLS context for just accepted socket.
+uint32_t GatewayWorker::TlsCreateContext(SocketDataChunkRef sd, TlsPortInfo* tls_port)
+{
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    GW_ASSERT(NULL == si->tls_context_);
+
+    TlsContext* tls = GwNewConstructor(TlsContext);
+    tls->Init(tls_port);
+
+    si->tls_context_ = tls;
+
+    return 0;
+}
+
+// Releases TLS context and its receive buffer.
+void GatewayWorker::TlsReleaseContext(ScSocketInfoStruct* si)
+{
+    TlsContext* tls = si->tls_context_;
+    if (NULL == tls)
+        return;
+
+    if (tls->get_context_created_flag())
+        DeleteSecurityContext(tls->get_context());
+
+    SocketDataChunk* recv_sd = tls->get_recv_sd();
+    if (NULL != recv_sd)
+        worker_chunks_.ReleaseChunk(recv_sd);
+
+    GwDeleteSingle(tls);
+    si->tls_context_ = NULL;
+}
+
+// Makes sure there is a buffer to receive ciphertext into.
+uint32_t GatewayWorker::TlsPrepareReceive(SocketDataChunkRef sd)
+{
+    TlsContext* tls = sd->get_socket_info()->tls_context_;
+
+    if (NULL == tls->get_recv_sd())
+    {
+        SocketDataChunk* recv_sd = worker_chunks_.ObtainChunkByStoreIndex(TLS_RECEIVE_CHUNK_STORE_INDEX);
+        if (NULL == recv_sd)
+            return SCERRGWMAXCHUNKSNUMBERREACHED;
+
+        tls->set_recv_sd(recv_sd);
+        tls->set_cipher_len(0);
+    }
+
+    // Buffered ciphertext is always a part of one record, so it must fit.
+    if (0 == tls->GetReceiveSpace())
+        return SCERRGWHTTPSPROCESSFAILED;
+
+    return 0;
+}
+
+// Posts delivery of already decrypted data instead of receiving from network.
+uint32_t GatewayWorker::TlsPostPendingData(SocketDataChunkRef sd)
+{
+    TlsContext* tls = sd->get_socket_info()->tls_context_;
+    GW_ASSERT(tls->HasPendingData());
+
+    tls->set_delivery_posted_flag(true);
+
+    sd->set_type_of_network_oper(RECEIVE_SOCKET_OPER);
+    memset(sd->get_ovl(), 0, OVERLAPPED_SIZE);
+
+    if (!PostQueuedCompletionStatus(worker_iocp_, 0, 0, sd->get_ovl()))
+    {
+        tls->set_delivery_posted_flag(false);
+        return SCERRGWFAILEDWSARECV;
+    }
+
+    // NOTE: Setting socket data to null, so other
+    // manipulations on it are not possible.
+    sd = NULL;
+
+    return 0;
+}
+
+// Sends handshake token as is.
+uint32_t GatewayWorker::TlsSendToken(SocketDataChunkRef sd, uint8_t* token, uint32_t token_len)
+{
+    if (token_len > static_cast<uint32_t>(MAX_SOCKET_DATA_SIZE))
+        return SCERRGWHTTPSPROCESSFAILED;
+
+    SocketDataChunk* token_sd = worker_chunks_.ObtainChunk(token_len);
+    if (NULL == token_sd)
+        return SCERRGWMAXCHUNKSNUMBERREACHED;
+
+    token_sd->PlainCopySocketDataInfoHeaders(sd);
+    token_sd->ResetAccumBuffer();
+    token_sd->reset_socket_representer_flag();
+
+    memcpy(token_sd->get_data_blob_start(), token, token_len);
+    token_sd->PrepareForSend(token_sd->get_data_blob_start(), token_len);
+
+    uint32_t err_code = Send(token_sd);
+    if (err_code) {
+        // Releasing the cloned chunk.
+        ReturnSocketDataChunksToPool(token_sd);
+        return err_code;
+    }
+
+    return 0;
+}
+
+// Runs server side handshake on buffered ciphertext.
+uint32_t GatewayWorker::TlsHandshake(SocketDataChunkRef sd)
+{
+    TlsContext* tls = sd->get_socket_info()->tls_context_;
+    TlsPortInfo* tls_port = tls->get_tls_port();
+
+    while (tls->get_cipher_len() > 0)
+    {
+        uint8_t* cipher_ptr = tls->GetCiphertext();
+        uint32_t cipher_len = tls->get_cipher_len();
+
+        SecBuffer in_buffers[3];
+        in_buffers[0].BufferType = SECBUFFER_TOKEN;
+        in_buffers[0].cbBuffer = cipher_len;
+        in_buffers[0].pvBuffer = cipher_ptr;
+        in_buffers[1].BufferType = SECBUFFER_EMPTY;
+        in_buffers[1].cbBuffer = 0;
+        in_buffers[1].pvBuffer = NULL;
+
+        SecBufferDesc in_desc;
+        in_desc.ulVersion = SECBUFFER_VERSION;
+        in_desc.cBuffers = 2;
+        in_desc.pBuffers = in_buffers;
+
+        // Offering HTTP/2 with ALPN, client then starts with HTTP/2 preface.
+        uint8_t alpn_buf[64];
+        if (g_gateway.setting_http2())
+        {
+            in_buffers[2].BufferType = SECBUFFER_APPLICATION_PROTOCOLS;
+            in_buffers[2].cbBuffer = TlsFillAlpnProtocols(alpn_buf);
+            in_buffers[2].pvBuffer = alpn_buf;
+
+            in_desc.cBuffers = 3;
+        }
+
+        SecBuffer out_buffer;
+        out_buffer.BufferType = SECBUFFER_TOKEN;
+        out_buffer.cbBuffer = 0;
+        out_buffer.pvBuffer = NULL;
+
+        SecBufferDesc out_desc;
+        out_desc.ulVersion = SECBUFFER_VERSION;
+        out_desc.cBuffers = 1;
+        out_desc.pBuffers = &out_buffer;
+
+        ULONG context_attrs = 0;
+
+        // NOTE: Resumed sessions and tickets are handled by Schannel itself.
+        SECURITY_STATUS status = AcceptSecurityContext(
+            &tls_port->credentials_,
+            tls->get_context_created_flag() ? tls->get_context() : NULL,
+            &in_desc,
+            kTlsContextRequirements,
+            0,
+            tls->get_context(),
+            &out_desc,
+            &context_attrs,
+            NULL);
+
+        // Waiting for the rest of handshake message.
+        if (SEC_E_INCOMPLETE_MESSAGE == status)
+            return 0;
+
+        if ((SEC_E_OK == status) || (SEC_I_CONTINUE_NEEDED == status))
+            tls->set_context_created_flag();
+
+        // Sending handshake response or alert.
+        if ((out_buffer.cbBuffer > 0) && (NULL != out_buffer.pvBuffer))
+        {
+            uint32_t err_code = TlsSendToken(sd, (uint8_t*) out_buffer.pvBuffer, out_buffer.cbBuffer);
+            FreeContextBuffer(out_buffer.pvBuffer);
+
+            if (err_code)
+                return err_code;
+        }
+
+        if ((SEC_E_OK != status) && (SEC_I_CONTINUE_NEEDED != status))
+        {
+#ifdef GW_WARNINGS_DIAG
+            GW_PRINT_WORKER << "TLS handshake failed on socket index: " << sd->get_socket_info_index() << " with status " << std::hex << (uint32_t) status << std::dec << GW_ENDL;
+#endif
+            return SCERRGWHTTPSPROCESSFAILED;
+        }
+
+        // Keeping ciphertext that belongs to following messages.
+        if (SECBUFFER_EXTRA == in_buffers[1].BufferType)
+            tls->KeepCiphertext(cipher_ptr + cipher_len - in_buffers[1].cbBuffer, in_buffers[1].cbBuffer);
+        else
+            tls->set_cipher_len(0);
+
+        if (SEC_E_OK == status)
+        {
+            status = QueryContextAttributes(tls->get_context(), SECPKG_ATTR_STREAM_SIZES, tls->get_stream_sizes());
+            if (SEC_E_OK != status)
+                return SCERRGWHTTPSPROCESSFAILED;
+
+            // From now on everything sent on this socket is encrypted.
+            tls->set_established_flag();
+
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+// Processes received ciphertext and copies decrypted data into socket data network buffer.
+uint32_t GatewayWorker::TlsFinishReceive(SocketDataChunkRef sd, int32_t num_bytes_received, int32_t* num_plain_bytes)
+{
+    TlsContext* tls = sd->get_socket_info()->tls_context_;
+
+    *num_plain_bytes = 0;
+
+    // Checking if this is a posted delivery of already decrypted data.
+    if (tls->get_delivery_posted_flag())
+    {
+        tls->set_delivery_posted_flag(false);
+    }
+    else
+    {
+        // If we received 0 bytes, the remote side has close the connection.
+        if (0 == num_bytes_received)
+        {
+#ifdef GW_WARNINGS_DIAG
+            GW_PRINT_WORKER << "Zero-bytes receive on socket index: " << sd->get_socket_info_index() << ". Remote side closed the connection." << GW_ENDL;
+#endif
+
+            return SCERRGWSOCKETCLOSEDBYPEER;
+        }
+
+        tls->set_cipher_len(tls->get_cipher_len() + num_bytes_received);
+
+        // Updating connection timestamp also during handshake.
+        sd->UpdateSocketTimeStamp();
+    }
+
+    uint8_t* buf = sd->get_cur_network_buf_ptr();
+    uint32_t buf_len = sd->get_num_available_network_bytes();
+    uint32_t num_delivered = 0;
+
+    // Delivering data left from previously decrypted record.
+    if (tls->HasPendingData())
+    {
+        num_delivered = tls->TakePendingData(buf, buf_len);
+
+        if (tls->HasPendingData())
+        {
+            *num_plain_bytes = num_delivered;
+            return 0;
+        }
+
+        tls->KeepCiphertext(tls->get_extra_ptr(), tls->get_extra_len());
+    }
+
+    // Completing handshake first.
+    if (!tls->get_established_flag())
+    {
+        uint32_t err_code = TlsHandshake(sd);
+        if (err_code)
+            return err_code;
+    }
+
+    // Decrypting whole records in place.
+    while (tls->get_established_flag() && (tls->get_cipher_len() > 0) && (num_delivered < buf_len))
+    {
+        SecBuffer buffers[4];
+        buffers[0].BufferType = SECBUFFER_DATA;
+        buffers[0].cbBuffer = tls->get_cipher_len();
+        buffers[0].pvBuffer = tls->GetCiphertext();
+
+        for (int32_t i = 1; i < 4; i++)
+        {
+            buffers[i].BufferType = SECBUFFER_EMPTY;
+            buffers[i].cbBuffer = 0;
+            buffers[i].pvBuffer = NULL;
+        }
+
+        SecBufferDesc desc;
+        desc.ulVersion = SECBUFFER_VERSION;
+        desc.cBuffers = 4;
+        desc.pBuffers = buffers;
+
+        SECURITY_STATUS status = DecryptMessage(tls->get_context(), &desc, 0, NULL);
+
+        // Waiting for the rest of the record.
+        if (SEC_E_INCOMPLETE_MESSAGE == status)
+            break;
+
+        // Peer has sent close notify.
+        if (SEC_I_CONTEXT_EXPIRED == status)
+            return SCERRGWSOCKETCLOSEDBYPEER;
+
+        // NOTE: Renegotiation is not supported.
+        if (SEC_E_OK != status)
+            return SCERRGWHTTPSPROCESSFAILED;
+
+        uint8_t* plain_ptr = NULL;
+        uint32_t plain_len = 0;
+        uint8_t* extra_ptr = NULL;
+        uint32_t extra_len = 0;
+
+        for (int32_t i = 1; i < 4; i++)
+        {
+            if (SECBUFFER_DATA == buffers[i].BufferType)
+            {
+                plain_ptr = (uint8_t*) buffers[i].pvBuffer;
+                plain_len = buffers[i].cbBuffer;
+            }
+            else if (SECBUFFER_EXTRA == buffers[i].BufferType)
+            {
+                extra_ptr = (uint8_t*) buffers[i].pvBuffer;
+                extra_len = buffers[i].cbBuffer;
+            }
+        }
+
+        // Copying as much as fits into network buffer.
+        uint32_t num_copy_bytes = buf_len - num_delivered;
+        if (num_copy_bytes > plain_len)
+            num_copy_bytes = plain_len;
+
+        memcpy(buf + num_delivered, plain_ptr, num_copy_bytes);
+        num_delivered += num_copy_bytes;
+
+        // Remembering the rest of decrypted record for next receive.
+        if (num_copy_bytes < plain_len)
+        {
+            tls->SetPendingData(plain_ptr + num_copy_bytes, plain_len - num_copy_bytes, extra_ptr, extra_len);
+            break;
+        }
+
+        tls->KeepCiphertext(extra_ptr, extra_len);
+    }
+
+    // Returning receive buffer when nothing is buffered.
+    if ((!tls->HasPendingData()) && (0 == tls->get_cipher_len()))
+    {
+        SocketDataChunk* recv_sd = tls->get_recv_sd();
+        worker_chunks_.ReleaseChunk(recv_sd);
+        tls->set_recv_sd(NULL);
+    }
+
+    *num_plain_bytes = num_delivered;
+
+    return 0;
+}
+
+// Encrypts given data into records at destination.
+// NOTE: Destination may overlap data if records never reach not yet encrypted data.
+uint32_t TlsEncryptRecords(TlsContext* tls, uint8_t* plain_ptr, uint32_t plain_len, uint8_t* dest, uint32_t* num_encrypted_bytes)
+{
+    SecPkgContext_StreamSizes* sizes = tls->get_stream_sizes();
+    uint8_t* out = dest;
+
+    while (plain_len > 0)
+    {
+        uint32_t msg_len = plain_len;
+        if (msg_len > sizes->cbMaximumMessage)
+            msg_len = sizes->cbMaximumMessage;
+
+        memmove(out + sizes->cbHeader, plain_ptr, msg_len);
+
+        SecBuffer buffers[4];
+        buffers[0].BufferType = SECBUFFER_STREAM_HEADER;
+        buffers[0].cbBuffer = sizes->cbHeader;
+        buffers[0].pvBuffer = out;
+        buffers[1].BufferType = SECBUFFER_DATA;
+        buffers[1].cbBuffer = msg_len;
+        buffers[1].pvBuffer = out + sizes->cbHeader;
+        buffers[2].BufferType = SECBUFFER_STREAM_TRAILER;
+        buffers[2].cbBuffer = sizes->cbTrailer;
+        buffers[2].pvBuffer = out + sizes->cbHeader + msg_len;
+        buffers[3].BufferType = SECBUFFER_EMPTY;
+        buffers[3].cbBuffer = 0;
+        buffers[3].pvBuffer = NULL;
+
+        SecBufferDesc desc;
+        desc.ulVersion = SECBUFFER_VERSION;
+        desc.cBuffers = 4;
+        desc.pBuffers = buffers;
+
+        SECURITY_STATUS status = EncryptMessage(tls->get_context(), 0, &desc, 0);
+        if (SEC_E_OK != status)
+            return SCERRGWHTTPSPROCESSFAILED;
+
+        // NOTE: Trailer can be shorter than maximum.
+        out += buffers[0].cbBuffer + buffers[1].cbBuffer + buffers[2].cbBuffer;
+
+        plain_ptr += msg_len;
+        plain_len -= msg_len;
+    }
+
+    *num_encrypted_bytes = static_cast<uint32_t>(out - dest);
+
+    return 0;
+}
+
+// Replaces data prepared for send with TLS records.
+uint32_t GatewayWorker::TlsEncrypt(SocketDataChunkRef sd)
+{
+    TlsContext* tls = sd->get_socket_info()->tls_context_;
+    SecPkgContext_StreamSizes* sizes = tls->get_stream_sizes();
+
+    const uint32_t records_overhead = sizes->cbHeader + sizes->cbTrailer;
+    const uint32_t max_record_len = sizes->cbMaximumMessage + records_overhead;
+    const uint32_t max_plain_per_chunk = (MAX_SOCKET_DATA_SIZE / max_record_len) * sizes->cbMaximumMessage;
+
+    uint8_t* plain_ptr = sd->get_cur_network_buf_ptr();
+    uint32_t plain_len = sd->get_num_available_network_bytes();
+
+    GW_ASSERT(plain_len > 0);
+
+    uint32_t err_code;
+
+    // Sending leading parts that would not fit into one chunk when encrypted.
+    while (plain_len > max_plain_per_chunk)
+    {
+        SocketDataChunk* part_sd = worker_chunks_.ObtainChunk(max_plain_per_chunk);
+        if (NULL == part_sd)
+            return SCERRGWMAXCHUNKSNUMBERREACHED;
+
+        part_sd->PlainCopySocketDataInfoHeaders(sd);
+        part_sd->ResetAccumBuffer();
+        part_sd->reset_socket_representer_flag();
+
+        memcpy(part_sd->get_data_blob_start(), plain_ptr, max_plain_per_chunk);
+        part_sd->PrepareForSend(part_sd->get_data_blob_start(), max_plain_per_chunk);
+
+        // NOTE: Part is encrypted by this send.
+        err_code = Send(part_sd);
+        if (err_code) {
+            // Releasing the cloned chunk.
+            ReturnSocketDataChunksToPool(part_sd);
+            return err_code;
+        }
+
+        plain_ptr += max_plain_per_chunk;
+        plain_len -= max_plain_per_chunk;
+    }
+
+    uint32_t num_records = (plain_len + sizes->cbMaximumMessage - 1) / sizes->cbMaximumMessage;
+    uint32_t max_encrypted_len = plain_len + num_records * records_overhead;
+    uint32_t num_encrypted_bytes = 0;
+
+    // Checking if records fit into current chunk.
+    if (max_encrypted_len > sd->get_data_blob_size())
+    {
+        // Encrypting while copying into bigger chunk.
+        SocketDataChunk* new_sd = worker_chunks_.ObtainChunk(max_encrypted_len);
+        if (NULL == new_sd)
+            return SCERRGWMAXCHUNKSNUMBERREACHED;
+
+        new_sd->PlainCopySocketDataInfoHeaders(sd);
+        new_sd->ResetAccumBuffer();
+
+        err_code = TlsEncryptRecords(tls, plain_ptr, plain_len, new_sd->get_data_blob_start(), &num_encrypted_bytes);
+        if (err_code) {
+            worker_chunks_.ReleaseChunk(new_sd);
+            return err_code;
+        }
+
+        // Releasing chunk.
+        worker_chunks_.ReleaseChunk(sd);
+
+        sd = new_sd;
+    }
+    else
+    {
+        // Moving data to the end of chunk so records are written in front of it.
+        uint8_t* moved_plain_ptr = sd->get_data_blob_start() + sd->get_data_blob_size() - plain_len;
+        memmove(moved_plain_ptr, plain_ptr, plain_len);
+
+        err_code = TlsEncryptRecords(tls, moved_plain_ptr, plain_len, sd->get_data_blob_start(), &num_encrypted_bytes);
+        if (err_code)
+            return err_code;
+    }
+
+    // Prepare buffer to send outside.
+    sd->PrepareForSend(sd->get_data_blob_start(), num_encrypted_bytes);
+
+    return 0;
+}
+
+} // namespace network
+} // namespace starcounter
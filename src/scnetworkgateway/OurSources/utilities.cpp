@@ -158,5 +158,132 @@ uint32_t PrintLastError(bool report_to_log)
     return dw;
 }
 
+// Parses list of existing logical processors like "0,2,4-7".
+bool ParseCpuList(const char* cpu_list, std::vector<int32_t>& cpus)
+{
+    cpus.clear();
+
+    const char* cur = cpu_list;
+    while (*cur)
+    {
+        // Skipping separators.
+        if ((*cur == ',') || (*cur == ' ') || (*cur == '\t') || (*cur == '\r') || (*cur == '\n'))
+        {
+            cur++;
+            continue;
+        }
+
+        if ((*cur < '0') || (*cur > '9'))
+            return false;
+
+        char* end;
+        int32_t first_cpu = strtol(cur, &end, 10);
+        int32_t last_cpu = first_cpu;
+
+        // Checking for a range.
+        if (*end == '-')
+        {
+            cur = end + 1;
+            if ((*cur < '0') || (*cur > '9'))
+                return false;
+
+            last_cpu = strtol(cur, &end, 10);
+            if (last_cpu < first_cpu)
+                return false;
+        }
+
+        // Only processors present in the system are accepted.
+        PROCESSOR_NUMBER proc_number;
+        if (!GetProcessorNumberFromCpuIndex(last_cpu, &proc_number))
+            return false;
+
+        for (int32_t i = first_cpu; i <= last_cpu; i++)
+            cpus.push_back(i);
+
+        cur = end;
+    }
+
+    return cpus.size() > 0;
+}
+
+// Converts logical processor index counted over all processor groups to processor number.
+bool GetProcessorNumberFromCpuIndex(int32_t cpu_index, PROCESSOR_NUMBER* proc_number)
+{
+    if (cpu_index < 0)
+        return false;
+
+    WORD num_groups = GetActiveProcessorGroupCount();
+    for (WORD g = 0; g < num_groups; g++)
+    {
+        int32_t num_group_cpus = static_cast<int32_t>(GetActiveProcessorCount(g));
+        if (cpu_index < num_group_cpus)
+        {
+            proc_number->Group = g;
+            proc_number->Number = static_cast<BYTE>(cpu_index);
+            proc_number->Reserved = 0;
+
+            return true;
+        }
+
+        cpu_index -= num_group_cpus;
+    }
+
+    return false;
+}
+
+// Returns NUMA node of given logical processor or NUMA_NO_PREFERRED_NODE if unknown.
+uint32_t GetCpuNumaNode(int32_t cpu_index)
+{
+    PROCESSOR_NUMBER proc_number;
+    if (!GetProcessorNumberFromCpuIndex(cpu_index, &proc_number))
+        return NUMA_NO_PREFERRED_NODE;
+
+    USHORT node_number;
+    if (!GetNumaProcessorNodeEx(&proc_number, &node_number))
+        return NUMA_NO_PREFERRED_NODE;
+
+    return node_number;
+}
+
+// Restricts thread to given logical processors, all of them should be in one processor group.
+uint32_t PinThreadToCpus(HANDLE thread_handle, const std::vector<int32_t>& cpus)
+{
+    GROUP_AFFINITY group_affinity;
+    memset(&group_affinity, 0, sizeof(group_affinity));
+
+    PROCESSOR_NUMBER ideal_proc_number;
+    memset(&ideal_proc_number, 0, sizeof(ideal_proc_number));
+
+    for (size_t i = 0; i < cpus.size(); i++)
+    {
+        PROCESSOR_NUMBER proc_number;
+        if (!GetProcessorNumberFromCpuIndex(cpus[i], &proc_number))
+            return ERROR_INVALID_PARAMETER;
+
+        if (0 == i)
+        {
+            group_affinity.Group = proc_number.Group;
+            ideal_proc_number = proc_number;
+        }
+        else if (group_affinity.Group != proc_number.Group)
+        {
+            return ERROR_INVALID_PARAMETER;
+        }
+
+        group_affinity.Mask |= (static_cast<KAFFINITY>(1) << proc_number.Number);
+    }
+
+    if (0 == group_affinity.Mask)
+        return ERROR_INVALID_PARAMETER;
+
+    if (!SetThreadGroupAffinity(thread_handle, &group_affinity, NULL))
+        return GetLastError();
+
+    // Scheduler keeps the thread on the first processor when possible.
+    SetThreadIdealProcessorEx(thread_handle, &ideal_proc_number, NULL);
+
+    return 0;
+}
+
 } // namespace network
 } // namespace starcounter
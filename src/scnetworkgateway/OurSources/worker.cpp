@@ -2,6 +2,8 @@
 #include "gateway.hpp"
 #include "handlers.hpp"
 #include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
 #include "http_proto.hpp"
 #include "socket_data.hpp"
 #include "worker_db_interface.hpp"
@@ -10,13 +12,120 @@
 namespace starcounter {
 namespace network {
 
+// Calculates slab sizes from gateway settings.
+void WorkerChunks::Init(uint32_t numa_node)
+{
+    numa_node_ = numa_node;
+
+    for (chunk_store_type i = 0; i < NumGatewayChunkSizes; i++)
+    {
+        chunks_per_slab_[i] = static_cast<int32_t>(g_gateway.setting_chunk_slab_size_bytes() / GatewayChunkSizes[i]);
+        if (chunks_per_slab_[i] < 1)
+            chunks_per_slab_[i] = 1;
+    }
+}
+
+// Allocates a new slab for given store.
+bool WorkerChunks::AllocateSlab(chunk_store_type store_index)
+{
+    ChunkSlab slab;
+
+    // Not allocating more chunks than allowed for this store.
+    slab.num_chunks_ = chunks_per_slab_[store_index];
+    int32_t num_chunks_left = g_gateway.setting_chunk_store_max_chunks(store_index) - num_allocated_chunks_[store_index];
+    if (slab.num_chunks_ > num_chunks_left)
+        slab.num_chunks_ = num_chunks_left;
+
+    slab.size_bytes_ = static_cast<SIZE_T>(slab.num_chunks_) * GatewayChunkSizes[store_index];
+    slab.base_ = NULL;
+
+    // Trying large pages first if enabled.
+    SIZE_T large_page_size = g_gateway.get_large_page_size();
+    if (large_page_size)
+    {
+        SIZE_T large_size_bytes = ((slab.size_bytes_ + large_page_size - 1) / large_page_size) * large_page_size;
+
+        slab.base_ = (uint8_t*) VirtualAllocExNuma(GetCurrentProcess(), NULL, large_size_bytes,
+            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, numa_node_);
+        if (NULL != slab.base_)
+        {
+            // Using the rest of the large page for chunks as well.
+            slab.num_chunks_ = static_cast<int32_t>(large_size_bytes / GatewayChunkSizes[store_index]);
+            if (slab.num_chunks_ > num_chunks_left)
+                slab.num_chunks_ = num_chunks_left;
+
+            slab.size_bytes_ = large_size_bytes;
+        }
+    }
+
+    if (NULL == slab.base_)
+    {
+        slab.base_ = (uint8_t*) VirtualAllocExNuma(GetCurrentProcess(), NULL, slab.size_bytes_,
+            MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, numa_node_);
+        if (NULL == slab.base_)
+            return false;
+    }
+
+    // All chunks are free, lowest addresses are taken first.
+    slab.free_chunks_ = GwNewArray(int32_t, slab.num_chunks_);
+    for (int32_t i = 0; i < slab.num_chunks_; i++)
+        slab.free_chunks_[i] = slab.num_chunks_ - 1 - i;
+
+    slab.num_free_chunks_ = slab.num_chunks_;
+
+    // Inserting slab keeping the order by base address.
+    std::vector<ChunkSlab>& slabs = slabs_[store_index];
+    int32_t slab_index = 0;
+    while ((slab_index < static_cast<int32_t>(slabs.size())) && (slabs[slab_index].base_ < slab.base_))
+        slab_index++;
+
+    slabs.insert(slabs.begin() + slab_index, slab);
+
+    if (slab_index < first_free_slab_[store_index])
+        first_free_slab_[store_index] = slab_index;
+
+    num_allocated_chunks_[store_index] += slab.num_chunks_;
+    num_free_chunks_[store_index] += slab.num_chunks_;
+
+    return true;
+}
+
+// Returns given slab to the operating system.
+void WorkerChunks::FreeSlab(chunk_store_type store_index, int32_t slab_index)
+{
+    std::vector<ChunkSlab>& slabs = slabs_[store_index];
+    ChunkSlab& slab = slabs[slab_index];
+
+    num_allocated_chunks_[store_index] -= slab.num_chunks_;
+    num_free_chunks_[store_index] -= slab.num_free_chunks_;
+
+    VirtualFree(slab.base_, 0, MEM_RELEASE);
+    GwDeleteArray(slab.free_chunks_);
+
+    slabs.erase(slabs.begin() + slab_index);
+
+    if (slab_index < first_free_slab_[store_index])
+        first_free_slab_[store_index]--;
+}
+
 // Mandatory initialization function.
 int32_t GatewayWorker::Init(int32_t new_worker_id)
 {
     worker_id_ = new_worker_id;
 
+    // Worker memory is placed on the node of the processor the worker is pinned to.
+    uint32_t numa_node = g_gateway.GetWorkerNumaNode(worker_id_);
+
+    // Preparing chunk slabs.
+    worker_chunks_.Init(numa_node);
+
     // Allocating data for sockets infos.
-    sockets_infos_ = (ScSocketInfoStruct*) GwNewAligned(sizeof(ScSocketInfoStruct) * g_gateway.setting_max_connections_per_worker());
+    sockets_infos_ = (ScSocketInfoStruct*) VirtualAllocExNuma(GetCurrentProcess(), NULL,
+        sizeof(ScSocketInfoStruct) * g_gateway.setting_max_connections_per_worker(),
+        MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, numa_node);
+
+    if (NULL == sockets_infos_)
+        return SCERROUTOFMEMORY;
 
     // Cleaning all socket infos and setting indexes.
     for (socket_index_type i = g_gateway.setting_max_connections_per_worker() - 1; i >= 0; i--)
@@ -29,6 +138,10 @@ int32_t GatewayWorker::Init(int32_t new_worker_id)
         free_sockets_infos_.PushBack(i);
     }
 
+    // No sockets are bound to databases yet.
+    for (int32_t i = 0; i < MAX_ACTIVE_DATABASES; i++)
+        db_sockets_heads_[i] = INVALID_SOCKET_INDEX;
+
     // Creating IO completion port.
     worker_iocp_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
     GW_ASSERT(worker_iocp_ != NULL);
@@ -42,6 +155,10 @@ int32_t GatewayWorker::Init(int32_t new_worker_id)
     GW_ASSERT(rebalance_accept_sockets_);
     InitializeSListHead(rebalance_accept_sockets_);
 
+    ws_broadcasts_ = (PSLIST_HEADER) GwNewAligned(sizeof(SLIST_HEADER));
+    GW_ASSERT(ws_broadcasts_);
+    InitializeSListHead(ws_broadcasts_);
+
     worker_stats_bytes_received_ = 0;
     worker_stats_bytes_sent_ = 0;
     worker_stats_sent_num_ = 0;
@@ -53,7 +170,22 @@ int32_t GatewayWorker::Init(int32_t new_worker_id)
     // Creating random generator with current time seed.
     rand_gen_ = GwNewConstructor1(random_generator, timeGetTime());
 
-    aggr_timer_ = timeGetTime();
+    // Converting aggregation coalescing delay to performance counter ticks.
+    LARGE_INTEGER perf_freq;
+    QueryPerformanceFrequency(&perf_freq);
+
+    perf_ticks_per_ms_ = perf_freq.QuadPart / 1000;
+    aggr_max_delay_ticks_ = (perf_freq.QuadPart * g_gateway.setting_aggregation_max_delay_us()) / 1000000;
+    aggr_flush_deadline_ticks_ = 0;
+
+    // No requests are traced yet.
+    for (int32_t i = 0; i < MAX_ACTIVE_REQUEST_TRACES; i++)
+        active_traces_[i].in_use_ = false;
+
+    num_completed_traces_ = 0;
+    requests_until_trace_ = g_gateway.setting_trace_sampling_interval();
+
+    num_captured_connections_ = 0;
 
     return 0;
 }
@@ -165,12 +297,192 @@ void GatewayWorker::ReleaseSocketIndex(socket_index_type socket_index)
     GW_ASSERT(!sockets_infos_[socket_index].IsReset());
     //GW_ASSERT(sockets_infos_[socket_index].session_.gw_worker_id_ == worker_id_);
 
+    // Removing socket from its database list.
+    UnlinkSocketFromDb(socket_index);
+
+    // Removing socket from its WebSocket group list.
+    UnlinkSocketFromWsGroup(socket_index);
+
+    // Returning any request body chain segments.
+    ReleaseBufferChain(sockets_infos_ + socket_index);
+
+    // Releasing static file that was being transmitted.
+    if (NULL != sockets_infos_[socket_index].static_file_entry_)
+        static_files_cache_.Release(sockets_infos_[socket_index].static_file_entry_);
+
+    // Releasing TLS connection state.
+    TlsReleaseContext(sockets_infos_ + socket_index);
+
+    // Releasing HTTP/2 connection state with its streams.
+    Http2ReleaseConnection(sockets_infos_ + socket_index);
+
+    // Releasing aggregation v2 handles table.
+    if (NULL != sockets_infos_[socket_index].aggr_v2_connection_)
+        GwDeleteSingle(sockets_infos_[socket_index].aggr_v2_connection_);
+
+    // Dropping unfinished request trace.
+    DropRequestTrace(sockets_infos_ + socket_index);
+
+    // Capturing connection close.
+    if (0 != sockets_infos_[socket_index].capture_connection_id_)
+        CaptureTraffic(sockets_infos_ + socket_index, TRAFFIC_CAPTURE_RECORD_CLOSE, NULL, 0);
+
     sockets_infos_[socket_index].Reset();
 
     // Pushing to free indexes list.
     free_sockets_infos_.PushBack(socket_index);
 }
 
+// Starts traffic capture of accepted connection if capture is enabled.
+void GatewayWorker::StartTrafficCapture(SocketDataChunkRef sd)
+{
+    if (!g_gateway.get_traffic_capture()->IsEnabled())
+        return;
+
+    // Gateway own system traffic is not captured.
+    if (sd->GetPortNumber() == g_gateway.get_setting_internal_system_port())
+        return;
+
+    // Worker id in high bits makes identifiers unique across workers.
+    num_captured_connections_++;
+
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    si->capture_connection_id_ = ((uint64_t) worker_id_ << 56) | num_captured_connections_;
+
+    CaptureTraffic(si, TRAFFIC_CAPTURE_RECORD_OPEN, NULL, 0);
+}
+
+// Starts a trace if current socket request is sampled.
+void GatewayWorker::StartRequestTrace(ScSocketInfoStruct* si)
+{
+    // Checking if tracing is enabled.
+    if (0 == g_gateway.setting_trace_sampling_interval())
+        return;
+
+    // Previous request on this socket was never answered.
+    DropRequestTrace(si);
+
+    requests_until_trace_--;
+    if (requests_until_trace_ > 0)
+        return;
+
+    requests_until_trace_ = g_gateway.setting_trace_sampling_interval();
+
+    // Searching for a free trace slot, request is not traced if all are busy.
+    for (int32_t i = 0; i < MAX_ACTIVE_REQUEST_TRACES; i++)
+    {
+        RequestTrace* trace = active_traces_ + i;
+
+        if (!trace->in_use_)
+        {
+            memset(trace, 0, sizeof(RequestTrace));
+            trace->in_use_ = true;
+            trace->unique_socket_id_ = si->unique_socket_id_;
+            trace->ticks_[TRACE_STAMP_RECEIVE] = GetPerfTicks();
+
+            si->trace_slot_ = static_cast<int8_t>(i);
+
+            return;
+        }
+    }
+}
+
+// Collects codehost trace stamps when response arrives.
+void GatewayWorker::StampRequestTraceResponse(SocketDataChunkRef sd, scheduler_id_type sched_id)
+{
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    if (INVALID_TRACE_SLOT == si->trace_slot_)
+        return;
+
+    RequestTrace* trace = active_traces_ + si->trace_slot_;
+
+    // Only first response of the request is traced.
+    if (0 != trace->ticks_[TRACE_STAMP_RESPONSE])
+        return;
+
+    trace->ticks_[TRACE_STAMP_RESPONSE] = GetPerfTicks();
+    trace->sched_id_ = sched_id;
+
+    // Codehost stamps exist only if request chunk came back.
+    if (sd->get_traced_flag())
+    {
+        trace->ticks_[TRACE_STAMP_SCHEDULER_POP] = sd->GetTraceSchedulerPopTicks();
+        trace->ticks_[TRACE_STAMP_RESPONSE_PUSH] = sd->GetTraceResponsePushTicks();
+    }
+}
+
+// Moves traced request to completed traces after response was sent.
+void GatewayWorker::FinishRequestTrace(ScSocketInfoStruct* si)
+{
+    if (INVALID_TRACE_SLOT == si->trace_slot_)
+        return;
+
+    RequestTrace* trace = active_traces_ + si->trace_slot_;
+
+    // Checking that this send carries the response.
+    if (0 == trace->ticks_[TRACE_STAMP_RESPONSE])
+        return;
+
+    trace->ticks_[TRACE_STAMP_SEND] = GetPerfTicks();
+
+    completed_traces_[num_completed_traces_ % REQUEST_TRACES_RING_SIZE] = *trace;
+    num_completed_traces_++;
+
+    DropRequestTrace(si);
+}
+
+// Prints one Chrome trace complete event if both stamps exist.
+void GatewayWorker::PrintTraceEvent(
+    std::stringstream& str,
+    const char* name,
+    int32_t pid,
+    int32_t tid,
+    uint64_t start_ticks,
+    uint64_t end_ticks,
+    RequestTrace* trace)
+{
+    if ((0 == start_ticks) || (end_ticks < start_ticks))
+        return;
+
+    str << ",{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid
+        << ",\"ts\":" << (start_ticks * 1000 / perf_ticks_per_ms_)
+        << ",\"dur\":" << (static_cast<double>(end_ticks - start_ticks) * 1000.0 / perf_ticks_per_ms_)
+        << ",\"args\":{\"socket\":" << trace->unique_socket_id_ << "}}";
+}
+
+// Prints completed request traces as Chrome trace events.
+void GatewayWorker::PrintRequestTraces(std::stringstream& str)
+{
+    int64_t num_completed_traces = num_completed_traces_;
+    int64_t first_trace = 0;
+    if (num_completed_traces > REQUEST_TRACES_RING_SIZE)
+        first_trace = num_completed_traces - REQUEST_TRACES_RING_SIZE;
+
+    for (int64_t i = first_trace; i < num_completed_traces; i++)
+    {
+        RequestTrace* t = completed_traces_ + (i % REQUEST_TRACES_RING_SIZE);
+
+        // Gateway is process 0, codehosts are numbered by database index.
+        int32_t db_pid = t->db_index_ + 1;
+
+        PrintTraceEvent(str, "gateway receive", 0, worker_id_, t->ticks_[TRACE_STAMP_RECEIVE], t->ticks_[TRACE_STAMP_PUSH], t);
+
+        if ((0 != t->ticks_[TRACE_STAMP_SCHEDULER_POP]) && (0 != t->ticks_[TRACE_STAMP_RESPONSE_PUSH]))
+        {
+            PrintTraceEvent(str, "channel queue", db_pid, t->sched_id_, t->ticks_[TRACE_STAMP_PUSH], t->ticks_[TRACE_STAMP_SCHEDULER_POP], t);
+            PrintTraceEvent(str, "handler", db_pid, t->sched_id_, t->ticks_[TRACE_STAMP_SCHEDULER_POP], t->ticks_[TRACE_STAMP_RESPONSE_PUSH], t);
+            PrintTraceEvent(str, "response queue", 0, worker_id_, t->ticks_[TRACE_STAMP_RESPONSE_PUSH], t->ticks_[TRACE_STAMP_RESPONSE], t);
+        }
+        else
+        {
+            // Response did not come in the request chunk, so codehost time is not split.
+            PrintTraceEvent(str, "codehost", db_pid, t->sched_id_, t->ticks_[TRACE_STAMP_PUSH], t->ticks_[TRACE_STAMP_RESPONSE], t);
+        }
+
+        PrintTraceEvent(str, "gateway send", 0, worker_id_, t->ticks_[TRACE_STAMP_RESPONSE], t->ticks_[TRACE_STAMP_SEND], t);
+    }
+}
+
 // Gets free socket index.
 socket_index_type GatewayWorker::ObtainFreeSocketIndex(
     SOCKET s,
@@ -237,37 +549,28 @@ bool GatewayWorker::ApplySocketInfoToSocketData(
     return false;
 }
 
-// Collects outdated sockets if any.
+// Disconnects all sockets bound to given codehost.
 uint32_t GatewayWorker::DisonnectCodehostSockets(db_index_type db_index)
 {
-	int32_t num_checked = 0;
-	int64_t num_active_sockets = g_gateway.NumberOfActiveSocketsOnAllPortsForWorker(worker_id_);
-
-	for (socket_index_type i = 0; i < g_gateway.setting_max_connections_per_worker(); i++)
+	// Going only through sockets bound to this database.
+	socket_index_type i = db_sockets_heads_[db_index];
+	while (INVALID_SOCKET_INDEX != i)
 	{
 		ScSocketInfoStruct* si = sockets_infos_ + i;
 
+		GW_ASSERT(db_index == si->get_dest_db_index());
+
 		// Checking that socket is alive.
 		if ((!si->IsReset()) && (INVALID_SOCKET != si->get_socket())) {
 
-			// Checking if database is the same.
-			if (db_index == si->get_dest_db_index()) {
+			// Updating unique socket id.
+			GenerateUniqueSocketInfoIds(i);
 
-				// Updating unique socket id.
-				GenerateUniqueSocketInfoIds(i);
-
-				// Disconnecting outdated socket.
-				si->DisconnectSocket();
-			}
-
-			// Increasing number of checked sockets.
-			num_checked++;
+			// Disconnecting outdated socket.
+			si->DisconnectSocket();
 		}
 
-		// Checking if we have checked all active sockets.
-		if (num_checked >= num_active_sockets) {
-			break;
-		}
+		i = si->db_next_socket_index_;
 	}
 
 	// Releasing database index.
@@ -307,7 +610,8 @@ uint32_t GatewayWorker::CollectInactiveSockets()
             // Disconnecting socket.
             switch (si->type_of_network_protocol_)
             {
-                case MixedCodeConstants::NetworkProtocolType::PROTOCOL_HTTP1: {
+                case MixedCodeConstants::NetworkProtocolType::PROTOCOL_HTTP1:
+                case MixedCodeConstants::NetworkProtocolType::PROTOCOL_HTTP2: {
 
                     // Updating unique socket id.
                     GenerateUniqueSocketInfoIds(i);
@@ -368,6 +672,12 @@ uint32_t GatewayWorker::CreateUdpSockets(port_index_type port_index) {
         return PrintLastError();
     }
 
+    // Letting the kernel keep datagram bursts while worker is busy.
+    // NOTE: Ignoring errors on purpose, default buffers still work.
+    int32_t buffer_size = UDP_SOCKET_BUFFER_SIZE;
+    setsockopt(new_socket, SOL_SOCKET, SO_RCVBUF, (char *)&buffer_size, sizeof(buffer_size));
+    setsockopt(new_socket, SOL_SOCKET, SO_SNDBUF, (char *)&buffer_size, sizeof(buffer_size));
+
     // Getting port number.
     ServerPort* sp = g_gateway.get_server_port(port_index);
     uint16_t port = sp->get_port_number();
@@ -433,6 +743,9 @@ uint32_t GatewayWorker::CreateUdpSockets(port_index_type port_index) {
     // This socket data is socket representation.
     new_sd->set_socket_representer_flag();
 
+    // Unique socket id shared by all receives on this socket.
+    random_salt_type unique_socket_id = new_sd->get_unique_socket_id();
+
     // Immediately receiving on this UDP socket.
     err_code = Receive(new_sd);
 
@@ -442,6 +755,32 @@ uint32_t GatewayWorker::CreateUdpSockets(port_index_type port_index) {
         return err_code;
     }
 
+    // Keeping more receives posted, so that datagrams arriving together
+    // complete together and are fetched in one completion port call.
+    // NOTE: Each completed receive is replaced by its clone.
+    for (int32_t i = 1; i < g_gateway.setting_udp_receives_per_socket(); i++) {
+
+        SocketDataChunk* receive_sd = NULL;
+
+        err_code = CreateSocketData(new_socket_index, receive_sd, MAX_UDP_DATAGRAM_SIZE);
+        if (err_code)
+            return err_code;
+
+        receive_sd->SetTypeOfNetworkProtocol(MixedCodeConstants::NetworkProtocolType::PROTOCOL_UDP);
+        receive_sd->set_unique_socket_id(unique_socket_id);
+        receive_sd->set_socket_representer_flag();
+
+        err_code = Receive(receive_sd);
+        if (err_code) {
+
+            // Returning chunks to pool.
+            receive_sd->reset_socket_representer_flag();
+            ReturnSocketDataChunksToPool(receive_sd);
+
+            return err_code;
+        }
+    }
+
     return 0;
 }
 
@@ -450,18 +789,24 @@ uint32_t GatewayWorker::CreateAcceptingSockets(port_index_type port_index)
 {
     GW_ASSERT(0 == worker_id_);
 
-    int32_t how_many_sockets_to_accept = ACCEPT_ROOF_STEP_SIZE;
     ServerPort* sp = g_gateway.get_server_port(port_index);
     GW_ASSERT(NULL != sp);
 
+    // Number of pre-accepted sockets follows the accept rate.
+    int32_t how_many_sockets_to_accept = sp->UpdateAcceptRoof(timeGetTime());
+
     // Checking if this is an aggregation port, then one accepting socket is enough.
     if (sp->get_aggregating_flag())
         how_many_sockets_to_accept = 1;
 
     // Checking if we have not enough accepting sockets.
-    if (sp->get_num_accepting_sockets() >= how_many_sockets_to_accept)
+    int64_t num_accepting_sockets = sp->get_num_accepting_sockets();
+    if (num_accepting_sockets >= how_many_sockets_to_accept)
         return 0;
 
+    // Creating all missing sockets at once.
+    how_many_sockets_to_accept -= static_cast<int32_t>(num_accepting_sockets);
+
     uint32_t err_code;
     int32_t curIntNum = 0;
 
@@ -557,7 +902,7 @@ uint32_t GatewayWorker::CreateAcceptingSockets(port_index_type port_index)
 }
 
 // Running receive on socket data.
-uint32_t GatewayWorker::Receive(SocketDataChunkRef sd)
+uint32_t GatewayWorker::Receive(SocketDataChunkRef sd, bool data_is_ready)
 {
     // Checking correct unique socket.
     if (!sd->CompareUniqueSocketId())
@@ -573,6 +918,15 @@ uint32_t GatewayWorker::Receive(SocketDataChunkRef sd)
     // Checking that not aggregated socket are trying to receive.
     GW_ASSERT_DEBUG(false == sd->GetSocketAggregatedFlag());
 
+    // Receive is posted when socket destination scheduler gets credits back.
+    if ((!data_is_ready) && IsOutOfSchedulerCredits(sd))
+    {
+        paused_receive_sds_.PushBack(sd);
+        sd = NULL;
+
+        return 0;
+    }
+
 #ifdef GW_IOCP_IMMEDIATE_COMPLETION
 // This label is used to avoid recursiveness between Receive and FinishReceive.
 START_RECEIVING_AGAIN:
@@ -583,6 +937,13 @@ START_RECEIVING_AGAIN:
 #endif
 
     uint32_t numBytes, err_code;
+    bool waiting_for_data = false;
+
+    // Request body chain is only kept while accumulating.
+    if (!sd->get_accumulating_flag())
+        ReleaseBufferChain(sd->get_socket_info());
+
+    TlsContext* tls = sd->get_socket_info()->tls_context_;
 
     // Checking if its a UDP socket.
     if (sd->IsUdp()) {
@@ -592,6 +953,33 @@ START_RECEIVING_AGAIN:
 
         err_code = sd->ReceiveUdp(this, &numBytes);
 
+    } else if ((NULL != tls) && tls->HasPendingData()) {
+
+        // Already decrypted data is delivered through completion port.
+        sd->get_socket_info()->SetState(SOCKET_STATE::RECEIVING);
+
+        return TlsPostPendingData(sd);
+
+    } else if ((!data_is_ready) && IsZeroByteReceiveNeeded(sd)) {
+
+        // Idle socket holds only the smallest chunk while waiting for data.
+        err_code = SocketDataChunk::ChangeToSmallest(this, sd);
+        if (err_code)
+            return err_code;
+
+        waiting_for_data = true;
+
+        err_code = sd->ReceiveTcpZeroBytes(this, &numBytes);
+
+    } else if (NULL != tls) {
+
+        // Ciphertext is received into connection TLS buffer.
+        err_code = TlsPrepareReceive(sd);
+        if (err_code)
+            return err_code;
+
+        err_code = sd->ReceiveTls(this, &numBytes);
+
     } else {
 
         err_code = sd->ReceiveTcp(this, &numBytes);
@@ -618,6 +1006,16 @@ START_RECEIVING_AGAIN:
         }
     }
 #ifdef GW_IOCP_IMMEDIATE_COMPLETION
+    else if (waiting_for_data)
+    {
+        // Data is already available, taking a normal chunk for it.
+        err_code = SocketDataChunk::ChangeToBigger(this, sd, GatewayChunkDataSizes[DefaultGatewayChunkSizeType]);
+        if (err_code)
+            return err_code;
+
+        data_is_ready = true;
+        goto START_RECEIVING_AGAIN;
+    }
     else
     {
         // Checking if socket is closed by the other peer.
@@ -650,6 +1048,32 @@ START_RECEIVING_AGAIN:
     return 0;
 }
 
+// Socket became readable after zero-byte receive.
+uint32_t GatewayWorker::FinishZeroByteReceive(SocketDataChunkRef sd)
+{
+#ifdef GW_SOCKET_DIAG
+    GW_PRINT_WORKER << "FinishZeroByteReceive: socket index " << sd->get_socket_info_index() << ":" << sd->GetSocket() << ":" << sd->get_unique_socket_id() << ":" << (uint64_t)sd << GW_ENDL;
+#endif
+
+    // Checking correct unique socket.
+    if (!sd->CompareUniqueSocketId())
+        return SCERRGWOPERATIONONWRONGSOCKET;
+
+    // NOTE: Since we are here means that this socket data represents this socket.
+    GW_ASSERT(true == sd->get_socket_representer_flag());
+
+    // Checking that socket arrived on correct worker.
+    GW_ASSERT(sd->get_bound_worker_id() == worker_id_);
+
+    // Taking a normal chunk only now when data is available.
+    uint32_t err_code = SocketDataChunk::ChangeToBigger(this, sd, GatewayChunkDataSizes[DefaultGatewayChunkSizeType]);
+    if (err_code)
+        return err_code;
+
+    // Receiving the data itself.
+    return Receive(sd, true);
+}
+
 // Socket receive finished.
 __forceinline uint32_t GatewayWorker::FinishReceive(
     SocketDataChunkRef sd,
@@ -674,6 +1098,31 @@ __forceinline uint32_t GatewayWorker::FinishReceive(
     // Setting state.
     sd->get_socket_info()->SetState(SOCKET_STATE::RECEIVED);
 
+    // Decrypting data on TLS sockets.
+    if (NULL != sd->get_socket_info()->tls_context_)
+    {
+        uint32_t err_code = TlsFinishReceive(sd, num_bytes_received, &num_bytes_received);
+        if (err_code)
+            return err_code;
+
+        // Checking if handshake or incomplete record needs more data.
+        if (0 == num_bytes_received)
+        {
+            // Checking if we are called already from Receive to avoid recursiveness.
+            if (!called_from_receive)
+            {
+                return Receive(sd);
+            }
+            else
+            {
+                // Just indicating this way that Receive should be called again.
+                called_from_receive = false;
+
+                return 0;
+            }
+        }
+    }
+
     // If we received 0 bytes, the remote side has close the connection.
     if (0 == num_bytes_received)
     {
@@ -684,11 +1133,15 @@ __forceinline uint32_t GatewayWorker::FinishReceive(
         return SCERRGWSOCKETCLOSEDBYPEER;
     }
 
+    // Capturing received bytes, they are already decrypted on TLS sockets.
+    if (0 != sd->get_socket_info()->capture_connection_id_)
+        CaptureTraffic(sd->get_socket_info(), TRAFFIC_CAPTURE_RECORD_DATA, sd->get_cur_network_buf_ptr(), num_bytes_received);
+
     // Updating connection timestamp.
     sd->UpdateSocketTimeStamp();
 
     // Adding to accumulated bytes.
-    sd->AddAccumulatedBytes(num_bytes_received);
+    sd->AddReceivedBytes(num_bytes_received);
 
     // Incrementing statistics.
     worker_stats_bytes_received_ += num_bytes_received;
@@ -696,6 +1149,21 @@ __forceinline uint32_t GatewayWorker::FinishReceive(
     // Increasing number of receives.
     worker_stats_recv_num_++;
 
+    // Starting request latency measurement unless request is already being received.
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    if (LATENCY_STATE_RECEIVED != si->latency_state_) {
+
+        // NOTE: Only first request on connection measures accept to first byte.
+        if (LATENCY_STATE_ACCEPTED != si->latency_state_)
+            si->latency_state_ = LATENCY_STATE_NONE;
+
+        AdvanceSocketLatencyState(si, si->latency_state_, LATENCY_STATE_RECEIVED);
+
+        // Sampling request for end-to-end tracing (proxied traffic never reaches codehost).
+        if (!sd->HasProxySocket())
+            StartRequestTrace(si);
+    }
+
     // Checking if this is a proxied server socket.
     if (sd->HasProxySocket())
     {
@@ -725,6 +1193,14 @@ __forceinline uint32_t GatewayWorker::FinishReceive(
     // Assigning last received bytes.
     if (sd->get_accumulating_flag())
     {
+        // Checking if current buffer is filled but more data is expected.
+        if (sd->IsNetworkBufferFull() && (sd->GetAccumulatedBytesLeft() > 0))
+        {
+            uint32_t err_code = AppendBufferChainSegment(sd);
+            if (err_code)
+                return err_code;
+        }
+
         // Checking if we have not accumulated everything yet.
         if (!sd->IsNetworkBufferFull())
         {
@@ -746,17 +1222,178 @@ __forceinline uint32_t GatewayWorker::FinishReceive(
             sd->reset_accumulating_flag();
         }
 
-	} else {
-	
-		// Resetting the session based on protocol.
-		sd->ResetSessionBasedOnProtocol(this);
-	}
+	} else {
+	
+		// Resetting the session based on protocol.
+		sd->ResetSessionBasedOnProtocol(this);
+	}
+
+    ProfilerStart(worker_id_, utils::ProfilerEnums::Empty);
+    ProfilerStop(worker_id_, utils::ProfilerEnums::Empty);
+
+    // Running the handler.
+    return RunReceiveHandlers(sd);
+}
+
+// Appends new segment to request body chain and receives into it.
+uint32_t GatewayWorker::AppendBufferChainSegment(SocketDataChunkRef sd)
+{
+    ScSocketInfoStruct* si = sd->get_socket_info();
+
+    uint32_t num_bytes_left = si->accum_data_bytes_left_;
+    GW_ASSERT(num_bytes_left > 0);
+
+    // Segments are limited so that huge chunks are not wasted for chains.
+    if (num_bytes_left > static_cast<uint32_t>(GatewayChunkDataSizes[BUFFER_CHAIN_MAX_SEGMENT_STORE_INDEX]))
+        num_bytes_left = GatewayChunkDataSizes[BUFFER_CHAIN_MAX_SEGMENT_STORE_INDEX];
+
+    SocketDataChunk* segment = worker_chunks_.ObtainChunk(num_bytes_left);
+
+    // Checking if couldn't obtain chunk.
+    if (NULL == segment)
+        return SCERRGWMAXCHUNKSNUMBERREACHED;
+
+    segment->ResetAccumBuffer();
+    segment->set_next_chain_segment(NULL);
+
+    // Linking segment to the end of the chain.
+    if (NULL == si->body_chain_tail_)
+        si->body_chain_head_ = segment;
+    else
+        si->body_chain_tail_->set_next_chain_segment(segment);
+
+    si->body_chain_tail_ = segment;
+
+    // Next receive goes directly into the segment.
+    sd->SetNetworkBuffer(segment->get_data_blob_start(), num_bytes_left);
+
+    return 0;
+}
+
+// Copies given data to the end of socket request body chain.
+uint32_t GatewayWorker::CopyToBufferChain(ScSocketInfoStruct* si, const uint8_t* data, uint32_t data_len)
+{
+    while (data_len > 0)
+    {
+        SocketDataChunk* segment = si->body_chain_tail_;
+
+        // Checking if new segment is needed.
+        if ((NULL == segment) || (segment->get_accumulated_len_bytes() == segment->get_data_blob_size()))
+        {
+            uint32_t segment_len = data_len;
+
+            // Segments are limited so that huge chunks are not wasted for chains.
+            if (segment_len > static_cast<uint32_t>(GatewayChunkDataSizes[BUFFER_CHAIN_MAX_SEGMENT_STORE_INDEX]))
+                segment_len = GatewayChunkDataSizes[BUFFER_CHAIN_MAX_SEGMENT_STORE_INDEX];
+
+            segment = worker_chunks_.ObtainChunk(segment_len);
+
+            // Checking if couldn't obtain chunk.
+            if (NULL == segment)
+                return SCERRGWMAXCHUNKSNUMBERREACHED;
+
+            segment->ResetAccumBuffer();
+            segment->set_next_chain_segment(NULL);
+
+            // Linking segment to the end of the chain.
+            if (NULL == si->body_chain_tail_)
+                si->body_chain_head_ = segment;
+            else
+                si->body_chain_tail_->set_next_chain_segment(segment);
+
+            si->body_chain_tail_ = segment;
+        }
+
+        uint32_t num_copy_bytes = segment->get_data_blob_size() - segment->get_accumulated_len_bytes();
+        if (num_copy_bytes > data_len)
+            num_copy_bytes = data_len;
+
+        memcpy(segment->get_data_blob_start() + segment->get_accumulated_len_bytes(), data, num_copy_bytes);
+        segment->AddAccumulatedBytes(num_copy_bytes);
+        si->body_chain_len_bytes_ += num_copy_bytes;
+
+        data += num_copy_bytes;
+        data_len -= num_copy_bytes;
+    }
+
+    return 0;
+}
+
+// Returns all request body chain segments to chunk stores.
+void GatewayWorker::ReleaseBufferChain(ScSocketInfoStruct* si)
+{
+    ReleaseBufferChainSegments(si->body_chain_head_);
+
+    DetachBufferChain(si);
+}
+
+// Returns given request body chain segments to chunk stores.
+void GatewayWorker::ReleaseBufferChainSegments(SocketDataChunk* segment)
+{
+    while (NULL != segment)
+    {
+        SocketDataChunk* next_segment = segment->get_next_chain_segment();
+        worker_chunks_.ReleaseChunk(segment);
+        segment = next_segment;
+    }
+}
+
+// Takes request body chain from socket without releasing it.
+void GatewayWorker::DetachBufferChain(ScSocketInfoStruct* si)
+{
+    si->body_chain_head_ = NULL;
+    si->body_chain_tail_ = NULL;
+    si->body_chain_len_bytes_ = 0;
+    si->accum_data_bytes_left_ = 0;
+}
+
+// Copies request body chain into socket data itself.
+uint32_t GatewayWorker::FlattenBufferChain(SocketDataChunkRef sd, bool extend_user_data)
+{
+    ScSocketInfoStruct* si = sd->get_socket_info();
+
+    // Checking if there is a fully received chain.
+    if (NULL == sd->GetBodyChainHead())
+        return 0;
+
+    uint32_t chain_len_bytes = si->body_chain_len_bytes_;
+    uint32_t total_len_bytes = sd->get_accumulated_len_bytes() + chain_len_bytes;
+
+    // Checking if data fits in the biggest chunk.
+    if (total_len_bytes > static_cast<uint32_t>(MAX_SOCKET_DATA_SIZE))
+        return SCERRGWMAXDATASIZEREACHED;
+
+    // Checking if we need a bigger chunk.
+    if (sd->get_data_blob_size() < total_len_bytes)
+    {
+        uint32_t err_code = SocketDataChunk::ChangeToBigger(this, sd, total_len_bytes);
+        if (err_code)
+            return err_code;
+    }
+    else
+    {
+        // Pointing network buffer back to the chunk itself.
+        sd->SetNetworkBuffer(sd->get_data_blob_start() + sd->get_accumulated_len_bytes(),
+            sd->get_data_blob_size() - sd->get_accumulated_len_bytes());
+    }
+
+    // Copying all segments one after another.
+    SocketDataChunk* segment = si->body_chain_head_;
+    while (NULL != segment)
+    {
+        memcpy(sd->get_cur_network_buf_ptr(), segment->get_data_blob_start(), segment->get_accumulated_len_bytes());
+        sd->AddAccumulatedBytes(segment->get_accumulated_len_bytes());
+
+        segment = segment->get_next_chain_segment();
+    }
 
-    ProfilerStart(worker_id_, utils::ProfilerEnums::Empty);
-    ProfilerStop(worker_id_, utils::ProfilerEnums::Empty);
+    ReleaseBufferChain(si);
 
-    // Running the handler.
-    return RunReceiveHandlers(sd);
+    // Checking if user data should also include the chain.
+    if (extend_user_data)
+        sd->SetUserData(sd->GetUserData(), sd->get_user_data_length_bytes_icp_chunk() + chain_len_bytes);
+
+    return 0;
 }
 
 // Running send on socket data.
@@ -793,9 +1430,23 @@ uint32_t GatewayWorker::Send(SocketDataChunkRef sd)
         return SendOnAggregationSocket(sd, MixedCodeConstants::AggregationMessageTypes::AGGR_DATA);
     }
 
+    // Checking if response goes to HTTP/2 stream.
+    // NOTE: Frames are sent on the connection socket and counted there.
+    if (sd->IsHttp2Stream())
+        return Http2SendResponse(sd);
+
     // Start sending on socket.
     uint32_t num_sent_bytes, err_code;
 
+    // Encrypting data on established TLS sockets.
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    if ((NULL != si) && (NULL != si->tls_context_) && si->tls_context_->get_established_flag()) {
+
+        err_code = TlsEncrypt(sd);
+        if (err_code)
+            return err_code;
+    }
+
     // Checking if its a UDP socket.
     if (sd->IsUdp()) {
         
@@ -842,6 +1493,82 @@ uint32_t GatewayWorker::Send(SocketDataChunkRef sd)
     return 0;
 }
 
+// Sends prepared response headers followed by part of static file.
+// NOTE: Entry is released by this call or when transmit finishes.
+uint32_t GatewayWorker::SendStaticFile(SocketDataChunkRef sd, StaticFileEntry* entry, uint64_t offset, uint32_t num_bytes)
+{
+#ifdef GW_SOCKET_DIAG
+    GW_PRINT_WORKER << "SendStaticFile: socket index " << sd->get_socket_info_index() << ":" << sd->GetSocket() << ":" << sd->get_unique_socket_id() << ":" << (uint64_t)sd << GW_ENDL;
+#endif
+
+    // Checking that socket data is valid.
+    sd->CheckForValidity();
+
+    // Checking correct unique socket.
+    if (!sd->CompareUniqueSocketId()) {
+        static_files_cache_.Release(entry);
+        return SCERRGWOPERATIONONWRONGSOCKET;
+    }
+
+    // Checking that socket arrived on correct worker.
+    GW_ASSERT(sd->get_bound_worker_id() == worker_id_);
+    GW_ASSERT(sd->GetBoundWorkerId() == worker_id_);
+
+    // Only socket representer receives next request after transmit.
+    GW_ASSERT(sd->get_socket_representer_flag());
+
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    GW_ASSERT(NULL == si->static_file_entry_);
+
+    // Setting state.
+    si->SetState(SOCKET_STATE::SENDING);
+
+    // Keeping file open until transmit is finished.
+    si->static_file_entry_ = entry;
+
+    uint32_t num_head_bytes = sd->get_num_available_network_bytes();
+
+    uint32_t err_code = sd->TransmitFileTcp(this, entry->file_handle_, offset, num_bytes);
+
+    // Checking if operation completed immediately.
+    if (0 != err_code)
+    {
+        int32_t wsa_err_code = WSAGetLastError();
+
+        // Checking if IOCP event was scheduled.
+        if (WSA_IO_PENDING != wsa_err_code)
+        {
+#ifdef GW_WARNINGS_DIAG
+            GW_PRINT_WORKER << "Failed transmit file: socket " << sd->get_socket_info_index() << ":" << sd->GetSocket() << ":" << sd->get_unique_socket_id() << ":" << (uint64_t)sd << ". Disconnecting socket..." << GW_ENDL;
+
+            PrintLastError();
+#endif
+
+            si->static_file_entry_ = NULL;
+            static_files_cache_.Release(entry);
+
+            return SCERRGWFAILEDWSASEND;
+        }
+    }
+#ifdef GW_IOCP_IMMEDIATE_COMPLETION
+    else
+    {
+        g_gateway.num_pending_sends_++;
+
+        // Finish transmit operation.
+        return FinishTransmitFile(sd, num_head_bytes + num_bytes);
+    }
+#endif
+
+    // NOTE: Setting socket data to null, so other
+    // manipulations on it are not possible.
+    sd = NULL;
+
+    g_gateway.num_pending_sends_++;
+
+    return 0;
+}
+
 // Do internal HTTP request.
 uint32_t GatewayWorker::DoInternalHttpRequest(SocketDataChunkRef sd, const char* http_request_data, const int32_t request_data_size) {
 
@@ -935,6 +1662,12 @@ __forceinline uint32_t GatewayWorker::FinishSend(SocketDataChunkRef sd, int32_t
     // Increasing number of sends.
     worker_stats_sent_num_++;
 
+    // Measuring response to send completion.
+    AdvanceSocketLatencyState(sd->get_socket_info(), LATENCY_STATE_RESPONDED, LATENCY_STATE_NONE);
+
+    // Completing sampled request trace.
+    FinishRequestTrace(sd->get_socket_info());
+
 	// Checking if we have streaming response.
 	if (sd->GetStreamingResponseBodyFlag()) {
 
@@ -970,6 +1703,71 @@ __forceinline uint32_t GatewayWorker::FinishSend(SocketDataChunkRef sd, int32_t
     return 0;
 }
 
+// Static file transmit finished.
+uint32_t GatewayWorker::FinishTransmitFile(SocketDataChunkRef sd, int32_t num_bytes_sent)
+{
+#ifdef GW_SOCKET_DIAG
+    GW_PRINT_WORKER << "FinishTransmitFile: socket index " << sd->get_socket_info_index() << ":" << sd->GetSocket() << ":" << sd->get_unique_socket_id() << ":" << (uint64_t)sd << GW_ENDL;
+#endif
+
+    g_gateway.num_pending_sends_--;
+
+    // Checking correct unique socket.
+    if (!sd->CompareUniqueSocketId())
+        return SCERRGWOPERATIONONWRONGSOCKET;
+
+    // Checking that socket data is valid.
+    sd->CheckForValidity();
+
+    // Checking that socket arrived on correct worker.
+    GW_ASSERT(sd->get_bound_worker_id() == worker_id_);
+    GW_ASSERT(sd->GetBoundWorkerId() == worker_id_);
+
+    GW_ASSERT(sd->get_socket_representer_flag());
+
+    ScSocketInfoStruct* si = sd->get_socket_info();
+
+    // File handle is not needed by this socket anymore.
+    if (NULL != si->static_file_entry_) {
+        static_files_cache_.Release(si->static_file_entry_);
+        si->static_file_entry_ = NULL;
+    }
+
+    // Setting state.
+    si->SetState(SOCKET_STATE::SENT);
+
+    // If we sent 0 bytes, the remote side has close the connection.
+    if (0 == num_bytes_sent)
+    {
+#ifdef GW_WARNINGS_DIAG
+        GW_PRINT_WORKER << "Zero-bytes sent on socket index: " << sd->get_socket_info_index() << ". Remote side closed the connection." << GW_ENDL;
+#endif
+
+        return SCERRGWSOCKETCLOSEDBYPEER;
+    }
+
+    // Updating connection timestamp.
+    sd->UpdateSocketTimeStamp();
+
+    // Incrementing statistics.
+    worker_stats_bytes_sent_ += num_bytes_sent;
+
+    // Increasing number of sends.
+    worker_stats_sent_num_++;
+
+    // Resets data buffer offset.
+    sd->SetUserData(sd->get_data_blob_start(), sd->get_accumulated_len_bytes());
+
+    // Resetting buffer information.
+    sd->ResetAccumBuffer();
+
+    // Resetting safe flags.
+    sd->ResetSafeFlags();
+
+    // Performing receive.
+    return Receive(sd);
+}
+
 // Returns given socket data chunk to private chunk pool.
 void GatewayWorker::ReturnSocketDataChunksToPool(SocketDataChunkRef sd)
 {
@@ -977,6 +1775,12 @@ void GatewayWorker::ReturnSocketDataChunksToPool(SocketDataChunkRef sd)
 
     GW_ASSERT(false == sd->get_socket_representer_flag());
 
+    // Releasing shared broadcast frame that was sent from this chunk.
+    if (sd->get_ws_broadcast_buffer_flag()) {
+        ReleaseWsBroadcastBuffer(*(WsBroadcastBuffer**) sd->get_accept_or_params_data());
+        sd->reset_ws_broadcast_buffer_flag();
+    }
+
 #ifdef GW_CHUNKS_DIAG
     GW_PRINT_WORKER << "Returning chunk to pool: socket index " << sd->get_socket_info_index() << ":" << sd->GetSocket() << ":" << sd->get_unique_socket_id() << ":" << (uint64_t)sd << GW_ENDL;
 #endif
@@ -1132,6 +1936,12 @@ void GatewayWorker::DisconnectAndReleaseChunk(SocketDataChunkRef sd)
         if (!sd->CompareUniqueSocketId())
             goto RELEASE_CHUNK_TO_POOL;
 
+        // HTTP/2 streams are reset and released by their connection.
+        if (sd->IsHttp2Stream()) {
+            Http2CancelStream(sd->get_socket_info());
+            goto RELEASE_CHUNK_TO_POOL;
+        }
+
         // Setting unique socket id.
         GenerateUniqueSocketInfoIds(sd->get_socket_info_index());
 
@@ -1420,6 +2230,9 @@ uint32_t GatewayWorker::FinishAccept(SocketDataChunkRef sd)
         // Decreasing number of accepting sockets.
         int64_t cur_num_accept_sockets = ChangeNumAcceptingSockets(port_index, -1);
 
+        // Accounting connection for the accept rate.
+        g_gateway.get_server_port(port_index)->AddAcceptedConnection();
+
         // Creating new set of prepared connections.
         // NOTE: Ignoring error code on purpose.
         CreateAcceptingSockets(port_index);
@@ -1476,6 +2289,23 @@ uint32_t GatewayWorker::FinishAccept(SocketDataChunkRef sd)
     // This socket data is socket representation.
     GW_ASSERT(true == sd->get_socket_representer_flag());
 
+    // Setting up TLS on protected ports.
+    TlsPortInfo* tls_port = g_gateway.FindTlsPort(sd->GetPortNumber());
+    if (NULL != tls_port) {
+
+        err_code = TlsCreateContext(sd, tls_port);
+        if (err_code)
+            return err_code;
+    }
+
+    // Waiting for first byte from accepted connection.
+    ScSocketInfoStruct* si = sd->get_socket_info();
+    si->latency_state_ = LATENCY_STATE_NONE;
+    AdvanceSocketLatencyState(si, LATENCY_STATE_NONE, LATENCY_STATE_ACCEPTED);
+
+    // Capturing accepted connection.
+    StartTrafficCapture(sd);
+
     // Performing receive.
     return Receive(sd);
 }
@@ -1525,6 +2355,47 @@ uint32_t GatewayWorker::ProcessReceiveClones(bool just_delete_clone)
     return err_code;
 }
 
+// Checks if socket destination scheduler is out of credits.
+bool GatewayWorker::IsOutOfSchedulerCredits(SocketDataChunk* sd)
+{
+    db_index_type db_index = sd->GetDestDbIndex();
+    if (INVALID_DB_INDEX == db_index)
+        return false;
+
+    WorkerDbInterface* db = worker_dbs_[db_index];
+    if (NULL == db)
+        return false;
+
+    // Sockets of a database going down are not kept waiting.
+    if (g_gateway.GetDatabase(db_index)->IsDeletionStarted())
+        return false;
+
+    return !db->HasCredits(sd->GetSchedulerId());
+}
+
+// Posts receives on paused sockets whose schedulers got credits back.
+void GatewayWorker::ResumePausedReceives()
+{
+    int32_t num_paused = paused_receive_sds_.get_num_entries();
+
+    for (int32_t i = 0; i < num_paused; i++)
+    {
+        SocketDataChunk* sd = paused_receive_sds_.PopFront();
+
+        // Checking if socket was closed while waiting.
+        if (!sd->CompareUniqueSocketId())
+        {
+            DisconnectAndReleaseChunk(sd);
+            continue;
+        }
+
+        // NOTE: Socket stays paused if there are still no credits.
+        uint32_t err_code = Receive(sd);
+        if (err_code)
+            DisconnectAndReleaseChunk(sd);
+    }
+}
+
 // Processes socket info for aggregation loopback.
 void GatewayWorker::LoopbackForAggregation(SocketDataChunkRef sd)
 {
@@ -1678,7 +2549,9 @@ uint32_t GatewayWorker::WorkerRoutine()
             }
 
             // Checking again if we need to be notified.
+            StartDbPushBatch();
             err_code = ScanChannels(&next_sleep_interval_ms);
+            FinishDbPushBatch();
             GW_ASSERT(0 == err_code);
 
             // If we have some chunks, we need to reset notification.
@@ -1714,6 +2587,9 @@ uint32_t GatewayWorker::WorkerRoutine()
 			g_gateway.SuspendWorker(this);
 		}
 
+        // Pushes and pops of this iteration wake up each scheduler at most once.
+        StartDbPushBatch();
+
         // Checking if operation successfully completed.
         if (TRUE == compl_status)
         {
@@ -1819,6 +2695,13 @@ uint32_t GatewayWorker::WorkerRoutine()
                         break;
                     }
 
+                    // TRANSMIT FILE finished.
+                    case TRANSMIT_FILE_SOCKET_OPER:
+                    {
+                        err_code = FinishTransmitFile(sd, oper_num_bytes);
+                        break;
+                    }
+
                     // RECEIVE finished.
                     case RECEIVE_SOCKET_OPER:
                     {
@@ -1827,6 +2710,13 @@ uint32_t GatewayWorker::WorkerRoutine()
                         break;
                     }
 
+                    // Socket became readable.
+                    case ZERO_BYTE_RECEIVE_SOCKET_OPER:
+                    {
+                        err_code = FinishZeroByteReceive(sd);
+                        break;
+                    }
+
                     // Unknown operation.
                     default:
                     {
@@ -1858,27 +2748,13 @@ uint32_t GatewayWorker::WorkerRoutine()
             GW_ASSERT((STATUS_USER_APC == err_code) || (STATUS_TIMEOUT == err_code));
         }
 
+        // Pushing UDP datagrams received during this iteration.
+        if (!udp_batch_sds_.IsEmpty())
+            PushUdpBatches();
+
         // Setting gateway to wait 1 second for network and other IOCP events.
         next_sleep_interval_ms = 1000;
 
-        // Checking if we have aggregation.
-        if (INVALID_PORT_NUMBER != g_gateway.setting_aggregation_port())
-        {
-            // Setting timeout on GetQueuedCompletionStatusEx.
-            next_sleep_interval_ms = 3;
-
-            // Checking if we have aggregated.
-            if ((timeGetTime() - aggr_timer_) >= 3.0)
-            {
-                // Processing aggregated chunks.
-                // NOTE: Do nothing about error codes.
-                SendAggregatedChunks();
-
-                // Resetting the timer.
-                aggr_timer_ = timeGetTime();
-            }
-        }
-
         // Scanning all channels.
         err_code = ScanChannels(&next_sleep_interval_ms);
         GW_ASSERT(0 == err_code);
@@ -1886,12 +2762,25 @@ uint32_t GatewayWorker::WorkerRoutine()
         // Pushing overflow chunks if any.
         PushOverflowChunks(&next_sleep_interval_ms);
 
+        // Checking if we have aggregated messages to send.
+        if (!aggr_sds_to_send_.IsEmpty())
+        {
+            // Worker is idle if completion port was drained and there is nothing from databases.
+            bool worker_idle = ((TRUE != compl_status) || (num_fetched_ovls < MAX_FETCHED_OVLS)) &&
+                (0 != next_sleep_interval_ms);
+
+            FlushAggregatedChunks(worker_idle, &next_sleep_interval_ms);
+        }
+
         // Creating accepting sockets on all ports and for all databases.
         // NOTE: Ignoring error code on purpose.
         if (0 == worker_id_) {
             CheckAcceptingSocketsOnAllActivePorts();
         }
 
+        // Waking up schedulers before waiting on completion port again.
+        FinishDbPushBatch();
+
 #ifdef WORKER_NO_SLEEP
         next_sleep_interval_ms = 0;
 #endif
@@ -1923,6 +2812,9 @@ uint32_t GatewayWorker::ScanChannels(uint32_t* next_sleep_interval_ms)
 {
     uint32_t err_code;
 
+    // Indicates that paused receives can continue.
+    bool resume_receives = false;
+
     for (int32_t i = 0; i < g_gateway.get_num_dbs_slots(); i++)
     {
         // Scan channels.
@@ -1969,6 +2861,10 @@ uint32_t GatewayWorker::ScanChannels(uint32_t* next_sleep_interval_ms)
 
                     // Releasing all private chunks to shared pool.
                     db->ReturnAllPrivateChunksToSharedPool();
+
+                    // Paused sockets of this database are not waiting for credits anymore.
+                    if (NumPausedReceives() > 0)
+                        resume_receives = true;
                 }
             }
             else
@@ -1977,10 +2873,18 @@ uint32_t GatewayWorker::ScanChannels(uint32_t* next_sleep_interval_ms)
                 err_code = db->ScanChannels(this, next_sleep_interval_ms);
                 if (err_code)
                     return err_code;
+
+                // Checking if schedulers took chunks and gave credits back.
+                if ((NumPausedReceives() > 0) && db->CheckCreditsReturned())
+                    resume_receives = true;
             }
         }
     }
 
+    // Receiving on sockets whose schedulers got credits back.
+    if (resume_receives)
+        ResumePausedReceives();
+
     return 0;
 }
 
@@ -2056,11 +2960,28 @@ uint32_t GatewayWorker::PushSocketDataToDb(
 
         // Checking if there is a non-empty overflow queue, so putting in it.
         if (IsOverflowed()) {
+
             PushToOverflowQueue(sd);
             return 0;
         }
 
-        uint32_t err_code = db->PushSocketDataToDb(this, sd, handler_id, disable_check_for_clone);
+        // NOTE: Socket data is released when pushed.
+        ScSocketInfoStruct* si = sd->get_socket_info();
+
+        MarkRequestTrace(sd, si);
+
+        uint32_t err_code = db->PushSocketDataToDb(this, sd, handler_id, disable_check_for_clone,
+            sd->GetBodyChainHead(), sd->GetBodyChainLength());
+
+        // Measuring receive to push when request reached the codehost.
+        if ((0 == err_code) && (NULL != si)) {
+            AdvanceSocketLatencyState(si, LATENCY_STATE_RECEIVED, LATENCY_STATE_PUSHED);
+            StampRequestTrace(si, TRACE_STAMP_PUSH);
+
+            // Request body chain was copied to IPC chunks.
+            if ((NULL != si->body_chain_head_) && (0 == si->accum_data_bytes_left_))
+                ReleaseBufferChain(si);
+        }
 
         // Checking if any issue occurred.
         if (err_code) {
@@ -2079,9 +3000,109 @@ uint32_t GatewayWorker::PushSocketDataToDb(
     return 0;
 }
 
+// Packs received UDP datagram into the batch of its socket.
+uint32_t GatewayWorker::AddToUdpBatch(SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id)
+{
+    uint32_t err_code;
+
+    uint32_t datagram_len = sd->get_accumulated_len_bytes();
+    uint32_t record_len = MixedCodeConstants::UDP_BATCH_RECORD_HEADER_SIZE + datagram_len;
+    GW_ASSERT(record_len <= static_cast<uint32_t>(UDP_BATCH_MAX_SIZE));
+
+    SocketDataChunk* batch_sd = NULL;
+
+    // Searching for the batch of this socket.
+    for (int32_t i = 0; i < udp_batch_sds_.get_num_entries(); i++)
+    {
+        if ((sd->get_socket_info_index() == udp_batch_sds_[i]->get_socket_info_index()) &&
+            (sd->get_unique_socket_id() == udp_batch_sds_[i]->get_unique_socket_id()) &&
+            (handler_id == udp_batch_sds_[i]->get_handler_id())) {
+
+            batch_sd = udp_batch_sds_[i];
+
+            // Pushing full batch and starting a new one.
+            if (batch_sd->get_accumulated_len_bytes() + record_len > static_cast<uint32_t>(UDP_BATCH_MAX_SIZE)) {
+
+                udp_batch_sds_.RemoveByIndex(i);
+
+                err_code = PushUdpBatch(batch_sd);
+                if (err_code)
+                    return err_code;
+
+                batch_sd = NULL;
+            }
+
+            break;
+        }
+    }
+
+    // Creating new batch for this socket.
+    if (NULL == batch_sd) {
+
+        err_code = CreateSocketData(sd->get_socket_info_index(), batch_sd, UDP_BATCH_MAX_SIZE);
+        if (err_code)
+            return err_code;
+
+        batch_sd->AssignSession(*sd->GetSessionStruct());
+        batch_sd->set_client_ip_info(sd->get_client_ip_info());
+        batch_sd->SetTypeOfNetworkProtocol(MixedCodeConstants::NetworkProtocolType::PROTOCOL_UDP);
+        batch_sd->set_handler_id(handler_id);
+        batch_sd->set_udp_batch_flag();
+
+        udp_batch_sds_.Add(batch_sd);
+    }
+
+    // Appending datagram record.
+    sockaddr_in* addr = (sockaddr_in*) sd->get_accept_or_params_data();
+    uint8_t* record = batch_sd->get_data_blob_start() + batch_sd->get_accumulated_len_bytes();
+
+    *(uint32_t*)(record + MixedCodeConstants::UDP_BATCH_RECORD_OFFSET_IP) = addr->sin_addr.s_addr;
+    *(uint32_t*)(record + MixedCodeConstants::UDP_BATCH_RECORD_OFFSET_PORT) = addr->sin_port;
+    *(uint32_t*)(record + MixedCodeConstants::UDP_BATCH_RECORD_OFFSET_DATA_LEN) = datagram_len;
+    memcpy(record + MixedCodeConstants::UDP_BATCH_RECORD_HEADER_SIZE, sd->get_data_blob_start(), datagram_len);
+
+    batch_sd->AddAccumulatedBytes(record_len);
+
+    // Datagram is copied, receive clone continues on this socket.
+    ReturnSocketDataChunksToPool(sd);
+
+    return 0;
+}
+
+// Pushes packed UDP datagrams to codehost.
+uint32_t GatewayWorker::PushUdpBatch(SocketDataChunkRef batch_sd)
+{
+    batch_sd->SetUserData(batch_sd->get_data_blob_start(), batch_sd->get_accumulated_len_bytes());
+
+    // NOTE: Batch is not a receiving socket data, so no receive clone check.
+    uint32_t err_code = PushSocketDataToDb(batch_sd, batch_sd->get_handler_id(), true);
+
+    // Releasing batch that can't be pushed (e.g. socket was closed).
+    if (err_code)
+        ReturnSocketDataChunksToPool(batch_sd);
+
+    return err_code;
+}
+
+// Pushes all pending UDP batches to codehost.
+void GatewayWorker::PushUdpBatches()
+{
+    for (int32_t i = 0; i < udp_batch_sds_.get_num_entries(); i++)
+    {
+        SocketDataChunk* batch_sd = udp_batch_sds_[i];
+
+        // NOTE: Ignoring error code on purpose, batch is released on failure.
+        PushUdpBatch(batch_sd);
+    }
+
+    udp_batch_sds_.Clear();
+}
+
 // Push given chunk to database queue.
-uint32_t GatewayWorker::PushSocketDataFromOverflowToDb(SocketDataChunkRef sd, BMX_HANDLER_TYPE handler_id, bool* again_for_overflow)
+uint32_t GatewayWorker::PushSocketDataFromOverflowToDb(OverflowChunk* entry, bool* again_for_overflow)
 {
+    SocketDataChunkRef sd = entry->sd_;
+
     // Assuming no tries.
     *again_for_overflow = false;
 
@@ -2104,7 +3125,25 @@ uint32_t GatewayWorker::PushSocketDataFromOverflowToDb(SocketDataChunkRef sd, BM
     // Pushing chunk to that database.
     if (NULL != db) {
 
-        uint32_t err_code = db->PushSocketDataToDb(this, sd, handler_id, true);
+        // NOTE: Socket data is released when pushed.
+        ScSocketInfoStruct* si = sd->get_socket_info();
+
+        MarkRequestTrace(sd, si);
+
+        uint32_t err_code = db->PushSocketDataToDb(this, sd, sd->get_handler_id(), true,
+            entry->body_chain_head_, entry->body_chain_len_bytes_);
+
+        // Measuring receive to push including time spent in overflow queue.
+        if ((0 == err_code) && (NULL != si)) {
+            AdvanceSocketLatencyState(si, LATENCY_STATE_RECEIVED, LATENCY_STATE_PUSHED);
+            StampRequestTrace(si, TRACE_STAMP_PUSH);
+        }
+
+        // Request body chain was copied to IPC chunks.
+        if (0 == err_code) {
+            ReleaseBufferChainSegments(entry->body_chain_head_);
+            entry->body_chain_head_ = NULL;
+        }
 
         // Checking if we need to put the socket back to overflow.
         if (err_code) {
@@ -2128,39 +3167,39 @@ void GatewayWorker::PushOverflowChunks(uint32_t* next_sleep_interval_ms)
 {
     uint32_t err_code;
     bool again_for_overflow;
+    OverflowChunk entry;
 
     // We can't try infinitely.
     int32_t num_tries = 0;
 
     // Looping while we have anything in overflow queue.
-    while (IsOverflowed()) {
+    while (PopFromOverlowQueue(&entry)) {
 
-        SocketDataChunk* sd = PopFromOverlowQueue();
-        
-        GW_ASSERT(sd != NULL);
+        GW_ASSERT(entry.sd_ != NULL);
 
         // Checking that socket data is valid.
-        sd->CheckForValidity();
+        entry.sd_->CheckForValidity();
 
         num_tries++;
 
-        err_code = PushSocketDataFromOverflowToDb(sd, sd->get_handler_id(), &again_for_overflow);
+        err_code = PushSocketDataFromOverflowToDb(&entry, &again_for_overflow);
 
         if (0 == err_code) {
 
             // Checking if sd is again for overflow.
             if (again_for_overflow) {
-                PushToOverflowQueue(sd);
+                PushToOverflowQueue(entry);
             }
 
         } else {
 
+            // Releasing request body chain that moved with the chunk.
+            ReleaseBufferChainSegments(entry.body_chain_head_);
+
             // Disconnecting this socket data.
-            DisconnectAndReleaseChunk(sd);
+            DisconnectAndReleaseChunk(entry.sd_);
         }
 
-        GW_ASSERT(NULL == sd);
-
         // Checking if number of pushes exceeded.
         if (num_tries >= MAX_OVERFLOW_ATTEMPTS)
             break;
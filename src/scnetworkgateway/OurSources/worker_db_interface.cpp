@@ -2,6 +2,8 @@
 #include "gateway.hpp"
 #include "handlers.hpp"
 #include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
 #include "http_proto.hpp"
 #include "socket_data.hpp"
 #include "worker_db_interface.hpp"
@@ -110,7 +112,10 @@ uint32_t WorkerDbInterface::ScanChannels(GatewayWorker *gw, uint32_t* next_sleep
 
                 // A message on channel ch was received. Notify the database
                 // that the out queue in this channel is not full.
-                the_channel.scheduler()->notify(shared_int_.scheduler_work_event(the_channel.get_scheduler_number()));
+                // NOTE: Inside a push batch all pops are acknowledged with one notification.
+                NotifyScheduler(sched_id);
+
+                RemoveInFlightRequest(sched_id);
             }
 
             // Chunk was found.
@@ -171,6 +176,14 @@ uint32_t WorkerDbInterface::ScanChannels(GatewayWorker *gw, uint32_t* next_sleep
 
 READY_SOCKET_DATA:
 
+            // Checking if its a broadcast to many sockets.
+            if (sd->get_ws_broadcast_flag()) {
+
+                // NOTE: Broadcast chunk is always consumed.
+                gw->BroadcastWebSocketGroup(sd);
+                continue;
+            }
+
             // Setting socket info reference.
             sd->set_socket_info_reference(gw);
 
@@ -190,6 +203,12 @@ READY_SOCKET_DATA:
                 GW_ASSERT(sd->GetBoundWorkerId() == worker_id_);
             }
 
+            // Measuring push to response from codehost.
+            gw->AdvanceSocketLatencyState(sd->get_socket_info(), LATENCY_STATE_PUSHED, LATENCY_STATE_RESPONDED);
+
+            // Collecting codehost stamps of sampled request trace.
+            gw->StampRequestTraceResponse(sd, sched_id);
+
             // Initializing socket data that arrived from database.
             sd->PreInitSocketDataFromDb(gw, sched_id);
 
@@ -304,11 +323,14 @@ void WorkerDbInterface::ReturnAllPrivateChunksToSharedPool()
 }
 
 // Push given chunk to database queue.
+// NOTE: Request body chain is copied but not released here.
 uint32_t WorkerDbInterface::PushSocketDataToDb(
     GatewayWorker* gw,
     SocketDataChunkRef sd,
     BMX_HANDLER_TYPE user_handler_id,
-	bool disable_check_for_clone)
+	bool disable_check_for_clone,
+    SocketDataChunk* body_chain_head,
+    uint32_t body_chain_len_bytes)
 {
 #ifdef GW_CHUNKS_DIAG
     GW_PRINT_WORKER_DB << "Pushing chunk: socket index " << sd->get_socket_info_index() << ":" << sd->get_unique_socket_id() << ":" << (uint64_t)sd << GW_ENDL;
@@ -349,7 +371,7 @@ uint32_t WorkerDbInterface::PushSocketDataToDb(
 
     core::chunk_index ipc_first_chunk_index;
     SocketDataChunk* ipc_sd;
-    uint32_t err_code = sd->CopyGatewayChunkToIPCChunks(this, &ipc_sd, &ipc_first_chunk_index);
+    uint32_t err_code = sd->CopyGatewayChunkToIPCChunks(this, body_chain_head, body_chain_len_bytes, &ipc_sd, &ipc_first_chunk_index);
 
     if (0 != err_code) {
 
@@ -383,6 +405,13 @@ uint32_t WorkerDbInterface::PushSocketDataToDb(
         return SCERRCANTPUSHTOCHANNEL;
    }
 
+   // HTTP requests are expected to be responded by the scheduler.
+   if ((!sd->get_gateway_no_ipc_test_flag()) &&
+       ((MixedCodeConstants::NetworkProtocolType::PROTOCOL_HTTP1 == sd->GetTypeOfNetworkProtocol()) ||
+       (MixedCodeConstants::NetworkProtocolType::PROTOCOL_HTTP2 == sd->GetTypeOfNetworkProtocol()))) {
+       AddInFlightRequest(sched_id);
+   }
+
    // Returning gateway chunk to pool.
    gw->ReturnSocketDataChunksToPool(sd);
 
@@ -395,9 +424,17 @@ WorkerDbInterface::WorkerDbInterface(
     const int32_t worker_id)
 {
     channels_ = NULL;
+    pending_notify_schedulers_ = NULL;
+    num_unconsumed_chunks_ = NULL;
+    num_in_flight_requests_ = NULL;
+    credits_exhausted_ = NULL;
+    local_schedulers_ = NULL;
 
     Reset();
 
+    max_scheduler_credits_ = g_gateway.setting_scheduler_credits();
+    least_loaded_scheduling_ = g_gateway.setting_least_loaded_scheduling();
+
     // Setting private/overflow chunk pool capacity.
     private_chunk_pool_.set_capacity(core::chunks_total_number_max);
 
@@ -405,6 +442,7 @@ WorkerDbInterface::WorkerDbInterface(
     worker_id_ = worker_id;
 
     ActiveDatabase* active_db = g_gateway.GetDatabase(db_index_);
+    unique_db_num_ = active_db->get_unique_num();
 
     // Initializing worker shared memory interface.
     shared_int_.init(
@@ -434,6 +472,27 @@ WorkerDbInterface::WorkerDbInterface(
     // Allocating channels.
     num_schedulers_ = static_cast<int32_t> (shared_int_.common_scheduler_interface().number_of_active_schedulers());
     channels_ = GwNewArray(core::channel_number, num_schedulers_);
+    pending_notify_schedulers_ = GwNewArray(bool, num_schedulers_);
+    num_unconsumed_chunks_ = GwNewArray(int32_t, num_schedulers_);
+    num_in_flight_requests_ = GwNewArray(int32_t, num_schedulers_);
+    credits_exhausted_ = GwNewArray(bool, num_schedulers_);
+    local_schedulers_ = GwNewArray(bool, num_schedulers_);
+
+    // Scheduler is local if it is on the same NUMA node or if any of the nodes is unknown.
+    uint32_t worker_numa_node = g_gateway.GetWorkerNumaNode(worker_id_);
+
+    for (int32_t s = 0; s < num_schedulers_; s++)
+    {
+        pending_notify_schedulers_[s] = false;
+        num_unconsumed_chunks_[s] = 0;
+        num_in_flight_requests_[s] = 0;
+        credits_exhausted_[s] = false;
+
+        uint32_t sched_numa_node = g_gateway.GetSchedulerNumaNode(s);
+        local_schedulers_[s] = (NUMA_NO_PREFERRED_NODE == worker_numa_node) ||
+            (NUMA_NO_PREFERRED_NODE == sched_numa_node) ||
+            (worker_numa_node == sched_numa_node);
+    }
 
     // Getting unique client interface for this worker.
     bool shared_int_acquired = shared_int_.acquire_client_number2(worker_id);
@@ -492,6 +551,29 @@ void WorkerDbInterface::PrintInfo(std::stringstream& stats_stream)
             stats_stream << " ";
     }
 
+    stats_stream << "\",";
+
+    stats_stream << "\"SchedulerCredits\":\"";
+    for (int32_t s = 0; s < num_schedulers_; s++)
+    {
+        // NOTE: Credits are not reclaimed here since this runs on statistics thread.
+        stats_stream << (max_scheduler_credits_ - num_unconsumed_chunks_[s] - num_overflow_chunks_);
+        if (s < num_schedulers_ - 1)
+            stats_stream << " ";
+    }
+
+    stats_stream << "\",";
+
+    stats_stream << "\"SchedulerNotifies\":" << num_scheduler_notifies_ << ",";
+
+    stats_stream << "\"InFlightRequests\":\"";
+    for (int32_t s = 0; s < num_schedulers_; s++)
+    {
+        stats_stream << num_in_flight_requests_[s];
+        if (s < num_schedulers_ - 1)
+            stats_stream << " ";
+    }
+
     stats_stream << "\"";
 }
 
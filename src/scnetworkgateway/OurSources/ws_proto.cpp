@@ -2,6 +2,8 @@
 #include "gateway.hpp"
 #include "handlers.hpp"
 #include "ws_proto.hpp"
+#include "tls_proto.hpp"
+#include "http2_proto.hpp"
 #include "http_proto.hpp"
 #include "socket_data.hpp"
 #include "worker_db_interface.hpp"
@@ -763,5 +765,242 @@ uint8_t *WsProto::WritePayload(
     return frame_start;
 }
 
+// Frames broadcast from codehost once and distributes it to all workers.
+uint32_t GatewayWorker::BroadcastWebSocketGroup(SocketDataChunkRef sd)
+{
+    ws_group_id_type group_id = *(ws_group_id_type*) sd->get_accept_or_params_data();
+    uint8_t opcode = *sd->get_ws_proto()->get_opcode_addr();
+
+    uint8_t* payload = sd->GetUserData();
+    uint32_t payload_len = sd->get_user_data_length_bytes();
+
+    WsBroadcastTarget* targets = NULL;
+    int32_t num_targets = 0;
+
+    uint32_t err_code = 0;
+
+    // Broadcast chunk is not needed after frame is copied.
+    sd->reset_ws_broadcast_flag();
+
+    if ((WS_OPCODE_TEXT != opcode) && (WS_OPCODE_BINARY != opcode)) {
+        err_code = SCERRGWWEBSOCKETUNKNOWNOPCODE;
+        goto RELEASE_BROADCAST_CHUNK;
+    }
+
+    // Checking if explicit list of sockets is given.
+    if (MixedCodeConstants::INVALID_WS_CHANNEL_ID == group_id) {
+
+        if (payload_len < sizeof(int32_t)) {
+            err_code = SCERRGWOPERATIONONWRONGSOCKET;
+            goto RELEASE_BROADCAST_CHUNK;
+        }
+
+        num_targets = *(int32_t*) payload;
+
+        uint64_t targets_len = sizeof(int32_t) + static_cast<uint64_t>(num_targets) * WsBroadcastTargetSizeBytes;
+        if ((num_targets <= 0) || (targets_len > payload_len)) {
+            err_code = SCERRGWOPERATIONONWRONGSOCKET;
+            goto RELEASE_BROADCAST_CHUNK;
+        }
+
+        targets = (WsBroadcastTarget*) (payload + sizeof(int32_t));
+        payload += targets_len;
+        payload_len -= static_cast<uint32_t>(targets_len);
+    }
+
+    {
+        // Writing frame header separately since payload may be preceded by targets.
+        uint8_t frame_header[WS_MAX_FRAME_INFO_SIZE];
+        uint32_t frame_header_len = 0;
+        uint8_t* frame_header_start = sd->get_ws_proto()->WritePayload(
+            this, sd, opcode, false, WS_FRAME_SINGLE, payload_len, frame_header + WS_MAX_FRAME_INFO_SIZE, frame_header_len);
+
+        WsBroadcastBuffer* buf = GwNewConstructor(WsBroadcastBuffer);
+        buf->Init(group_id, frame_header_start, frame_header_len, payload, payload_len, targets, num_targets);
+
+        // Releasing broadcast chunk.
+        ReturnSocketDataChunksToPool(sd);
+
+        // Checking which workers have destination sockets.
+        bool worker_has_targets[MAX_WORKER_THREADS];
+        for (int32_t w = 0; w < g_gateway.setting_num_workers(); w++)
+            worker_has_targets[w] = (MixedCodeConstants::INVALID_WS_CHANNEL_ID != group_id);
+
+        for (int32_t i = 0; i < num_targets; i++) {
+            worker_id_type w = buf->get_targets()[i].worker_id_;
+            if ((w >= 0) && (w < g_gateway.setting_num_workers()))
+                worker_has_targets[w] = true;
+        }
+
+        // Passing frame to other workers.
+        for (int32_t w = 0; w < g_gateway.setting_num_workers(); w++) {
+
+            if ((w == worker_id_) || (!worker_has_targets[w]))
+                continue;
+
+            buf->AddRef();
+
+            WsBroadcastTask* task = (WsBroadcastTask*) GwNewAligned(sizeof(WsBroadcastTask));
+            task->Init(buf);
+
+            g_gateway.get_worker(w)->PushWsBroadcastTask(task);
+            g_gateway.SendWsBroadcastAPC(w);
+        }
+
+        // Sending to own sockets.
+        SendWsBroadcast(buf);
+
+        ReleaseWsBroadcastBuffer(buf);
+    }
+
+    return 0;
+
+RELEASE_BROADCAST_CHUNK:
+
+    ReturnSocketDataChunksToPool(sd);
+
+    return err_code;
+}
+
+// Sends broadcasts queued for this worker.
+void GatewayWorker::ProcessWsBroadcasts()
+{
+    PSLIST_ENTRY entry = InterlockedFlushSList(ws_broadcasts_);
+
+    // Restoring the order in which broadcasts were queued.
+    PSLIST_ENTRY ordered = NULL;
+    while (NULL != entry) {
+
+        PSLIST_ENTRY next = entry->Next;
+        entry->Next = ordered;
+        ordered = entry;
+        entry = next;
+    }
+
+    while (NULL != ordered) {
+
+        WsBroadcastTask* task = (WsBroadcastTask*) ordered;
+        ordered = ordered->Next;
+
+        WsBroadcastBuffer* buf = task->get_buffer();
+        GwDeleteAligned(task);
+
+        SendWsBroadcast(buf);
+
+        ReleaseWsBroadcastBuffer(buf);
+    }
+}
+
+// Sends broadcast frame to all its destination sockets on this worker.
+void GatewayWorker::SendWsBroadcast(WsBroadcastBuffer* buf)
+{
+    // Checking if its a group broadcast.
+    if (MixedCodeConstants::INVALID_WS_CHANNEL_ID != buf->get_group_id()) {
+
+        std::unordered_map<ws_group_id_type, socket_index_type>::iterator it = ws_group_heads_.find(buf->get_group_id());
+        if (it == ws_group_heads_.end())
+            return;
+
+        socket_index_type i = it->second;
+        while (INVALID_SOCKET_INDEX != i) {
+
+            socket_index_type next_i = sockets_infos_[i].ws_group_next_socket_index_;
+
+            // NOTE: Errors on separate sockets are not propagated.
+            SendWsBroadcastFrame(buf, i);
+
+            i = next_i;
+        }
+
+        return;
+    }
+
+    WsBroadcastTarget* targets = buf->get_targets();
+
+    for (int32_t i = 0; i < buf->get_num_targets(); i++) {
+
+        if ((worker_id_ != targets[i].worker_id_) ||
+            (targets[i].socket_info_index_ < 0) ||
+            (targets[i].socket_info_index_ >= g_gateway.setting_max_connections_per_worker()) ||
+            (!CompareUniqueSocketId(targets[i].socket_info_index_, targets[i].unique_socket_id_)))
+        {
+            continue;
+        }
+
+        // NOTE: Errors on separate sockets are not propagated.
+        SendWsBroadcastFrame(buf, targets[i].socket_info_index_);
+    }
+}
+
+// Sends broadcast frame to one socket.
+uint32_t GatewayWorker::SendWsBroadcastFrame(WsBroadcastBuffer* buf, socket_index_type socket_index)
+{
+    ScSocketInfoStruct* si = sockets_infos_ + socket_index;
+
+    // Checking that socket is an open WebSocket.
+    if (si->IsReset() ||
+        (MixedCodeConstants::NetworkProtocolType::PROTOCOL_WEBSOCKETS != si->type_of_network_protocol_) ||
+        si->get_ws_close_already_sent_flag())
+    {
+        return SCERRGWOPERATIONONWRONGSOCKET;
+    }
+
+    SocketDataChunk* sd = NULL;
+    uint32_t err_code;
+
+    if (si->get_socket_aggregated_flag()) {
+
+        // Aggregation header is written in front of the frame so it has to be copied.
+        int32_t data_len = AGGR_BLOB_USER_DATA_OFFSET + buf->get_frame_len();
+        if (data_len > MAX_SOCKET_DATA_SIZE)
+            return SCERRGWMAXDATASIZEREACHED;
+
+        err_code = CreateSocketData(socket_index, sd, data_len);
+        if (err_code)
+            return err_code;
+
+        uint8_t* data = sd->get_data_blob_start() + AGGR_BLOB_USER_DATA_OFFSET;
+        memcpy(data, buf->get_frame(), buf->get_frame_len());
+
+        sd->PrepareForSend(data, buf->get_frame_len());
+
+    } else {
+
+        // Smallest chunk is enough since frame is sent from shared buffer.
+        err_code = CreateSocketData(socket_index, sd, 0);
+        if (err_code)
+            return err_code;
+
+        // NOTE: TLS sockets encrypt the frame into own chunks during send.
+        if (NULL == si->tls_context_) {
+
+            buf->AddRef();
+            *(WsBroadcastBuffer**) sd->get_accept_or_params_data() = buf;
+            sd->set_ws_broadcast_buffer_flag();
+        }
+
+        sd->SetNetworkBuffer(buf->get_frame(), buf->get_frame_len());
+    }
+
+    sd->reset_to_database_direction_flag();
+
+    // Sending data.
+    err_code = Send(sd);
+    if (err_code) {
+        DisconnectAndReleaseChunk(sd);
+        return err_code;
+    }
+
+    return 0;
+}
+
+// Releases reference to broadcast buffer, deleting it when not used.
+void GatewayWorker::ReleaseWsBroadcastBuffer(WsBroadcastBuffer* buf)
+{
+    if (buf->Release()) {
+        GwDeleteSingle(buf);
+    }
+}
+
 } // namespace network
 } // namespace starcounter
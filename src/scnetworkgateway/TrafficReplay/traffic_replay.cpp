@@ -0,0 +1,493 @@
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+
+#include "../OurHeaders/traffic_capture.hpp"
+
+namespace starcounter {
+namespace network {
+
+// Replay settings.
+struct ReplaySettings
+{
+    // Capture file to replay.
+    std::string capture_file_;
+
+    // Target host.
+    std::string host_;
+
+    // Target port for all connections, 0 uses recorded ports.
+    uint16_t port_;
+
+    // Time scale, 2 replays twice as fast, 0 replays as fast as possible.
+    double speed_;
+
+    // Seconds to keep receiving responses after the last record.
+    int32_t linger_seconds_;
+
+    ReplaySettings()
+    {
+        host_ = "127.0.0.1";
+        port_ = 0;
+        speed_ = 1;
+        linger_seconds_ = 2;
+    }
+};
+
+// One replayed connection.
+struct ReplayConnection
+{
+    SOCKET sock_;
+
+    // Bytes not yet accepted by the socket.
+    std::string out_;
+    int32_t out_offset_;
+
+    // Set when non-blocking connect has finished.
+    bool connected_;
+
+    // Set when recorded connection was closed, socket is closed once everything is sent.
+    bool close_pending_;
+
+    // Set when socket is closed for any reason.
+    bool closed_;
+
+    ReplayConnection()
+    {
+        sock_ = INVALID_SOCKET;
+        out_offset_ = 0;
+        connected_ = false;
+        close_pending_ = false;
+        closed_ = false;
+    }
+};
+
+// Replay statistics.
+struct ReplayStats
+{
+    int64_t num_records_;
+    int64_t num_connections_;
+    int64_t num_failed_connections_;
+    int64_t num_dropped_data_records_;
+    int64_t bytes_sent_;
+    int64_t bytes_received_;
+
+    // Maximum delay of a record behind its scheduled time.
+    int64_t max_lag_us_;
+
+    ReplayStats()
+    {
+        memset(this, 0, sizeof(ReplayStats));
+    }
+};
+
+// Loaded capture record with its data.
+struct ReplayRecord
+{
+    TrafficCaptureRecord record_;
+
+    // Offset of record data in capture contents.
+    size_t data_offset_;
+};
+
+LARGE_INTEGER g_replay_freq;
+
+int64_t GetReplayTimeUs(const LARGE_INTEGER& start)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    return (now.QuadPart - start.QuadPart) * 1000000 / g_replay_freq.QuadPart;
+}
+
+// Reads capture file, returns false if file is not a valid capture.
+bool LoadCapture(const std::string& capture_file, std::vector<char>* contents, std::vector<ReplayRecord>* records)
+{
+    std::ifstream f(capture_file, std::ios::binary);
+    if (!f)
+    {
+        std::cout << "Can't open capture file " << capture_file << "." << std::endl;
+        return false;
+    }
+
+    contents->assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+
+    if (contents->size() < sizeof(TrafficCaptureFileHeader))
+    {
+        std::cout << "Capture file is too short." << std::endl;
+        return false;
+    }
+
+    TrafficCaptureFileHeader* header = (TrafficCaptureFileHeader*) &contents->front();
+    if ((0 != memcmp(header->magic_, TRAFFIC_CAPTURE_MAGIC, sizeof(header->magic_))) ||
+        (TRAFFIC_CAPTURE_VERSION != header->version_))
+    {
+        std::cout << "Unsupported capture file format." << std::endl;
+        return false;
+    }
+
+    size_t offset = sizeof(TrafficCaptureFileHeader);
+    while (offset + sizeof(TrafficCaptureRecord) <= contents->size())
+    {
+        ReplayRecord r;
+        memcpy(&r.record_, &contents->front() + offset, sizeof(TrafficCaptureRecord));
+        r.data_offset_ = offset + sizeof(TrafficCaptureRecord);
+
+        // Last record can be cut if gateway was stopped while writing.
+        if (r.data_offset_ + r.record_.data_len_ > contents->size())
+            break;
+
+        records->push_back(r);
+        offset = r.data_offset_ + r.record_.data_len_;
+    }
+
+    return true;
+}
+
+// Starts non-blocking connect of a replayed connection.
+bool OpenReplayConnection(ReplayConnection* c, sockaddr_in addr)
+{
+    c->sock_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (INVALID_SOCKET == c->sock_)
+        return false;
+
+    int32_t on_flag = 1;
+    setsockopt(c->sock_, IPPROTO_TCP, TCP_NODELAY, (char*) &on_flag, sizeof(on_flag));
+
+    u_long non_blocking = 1;
+    ioctlsocket(c->sock_, FIONBIO, &non_blocking);
+
+    if (SOCKET_ERROR == connect(c->sock_, (const sockaddr*) &addr, sizeof(addr)))
+    {
+        if (WSAEWOULDBLOCK != WSAGetLastError())
+            return false;
+    }
+
+    return true;
+}
+
+void CloseReplayConnection(ReplayConnection* c)
+{
+    if (INVALID_SOCKET != c->sock_)
+    {
+        closesocket(c->sock_);
+        c->sock_ = INVALID_SOCKET;
+    }
+
+    c->closed_ = true;
+}
+
+// Sends pending bytes and closes connection if its close was replayed.
+void FlushReplayConnection(ReplayConnection* c, ReplayStats* stats)
+{
+    if (c->closed_ || !c->connected_)
+        return;
+
+    while (c->out_offset_ < static_cast<int32_t>(c->out_.size()))
+    {
+        int32_t n = send(c->sock_, c->out_.c_str() + c->out_offset_, static_cast<int32_t>(c->out_.size()) - c->out_offset_, 0);
+
+        if (SOCKET_ERROR == n)
+        {
+            if (WSAEWOULDBLOCK != WSAGetLastError())
+                CloseReplayConnection(c);
+
+            return;
+        }
+
+        c->out_offset_ += n;
+        stats->bytes_sent_ += n;
+    }
+
+    c->out_.clear();
+    c->out_offset_ = 0;
+
+    if (c->close_pending_)
+        CloseReplayConnection(c);
+}
+
+// Polls all open connections for at most given time, receiving and discarding responses.
+void PollReplayConnections(
+    std::unordered_map<uint64_t, ReplayConnection*>& connections,
+    int32_t timeout_ms,
+    ReplayStats* stats)
+{
+    std::vector<WSAPOLLFD> fds;
+    std::vector<ReplayConnection*> polled;
+
+    for (auto it = connections.begin(); it != connections.end(); ++it)
+    {
+        ReplayConnection* c = it->second;
+        if (c->closed_)
+            continue;
+
+        WSAPOLLFD fd;
+        fd.fd = c->sock_;
+        fd.events = POLLRDNORM;
+        fd.revents = 0;
+
+        // Waiting for connect to finish or for space to send pending bytes.
+        if ((!c->connected_) || (c->out_offset_ < static_cast<int32_t>(c->out_.size())))
+            fd.events |= POLLWRNORM;
+
+        fds.push_back(fd);
+        polled.push_back(c);
+    }
+
+    if (fds.empty())
+    {
+        Sleep(timeout_ms);
+        return;
+    }
+
+    if (WSAPoll(&fds.front(), static_cast<ULONG>(fds.size()), timeout_ms) <= 0)
+        return;
+
+    char buf[16 * 1024];
+
+    for (size_t i = 0; i < fds.size(); i++)
+    {
+        ReplayConnection* c = polled[i];
+
+        if ((!c->connected_) && (fds[i].revents & (POLLERR | POLLHUP)))
+        {
+            stats->num_failed_connections_++;
+            CloseReplayConnection(c);
+            continue;
+        }
+
+        if ((!c->connected_) && (fds[i].revents & POLLWRNORM))
+            c->connected_ = true;
+
+        if (fds[i].revents & (POLLRDNORM | POLLHUP))
+        {
+            while (true)
+            {
+                int32_t n = recv(c->sock_, buf, sizeof(buf), 0);
+
+                if (n > 0)
+                {
+                    stats->bytes_received_ += n;
+                    continue;
+                }
+
+                // Gateway closed the connection or receive failed.
+                if ((0 == n) || (WSAEWOULDBLOCK != WSAGetLastError()))
+                    CloseReplayConnection(c);
+
+                break;
+            }
+        }
+
+        FlushReplayConnection(c, stats);
+    }
+}
+
+void PrintReplayUsage()
+{
+    std::cout << "Usage: scgwreplay <capture file> [options]" << std::endl <<
+        "  --host=<address>       Target gateway host (default 127.0.0.1)." << std::endl <<
+        "  --port=<port>          Send all connections to this port (default recorded ports)." << std::endl <<
+        "  --speed=<factor>       Time scale, 2 is twice as fast, 0 is as fast as possible (default 1)." << std::endl <<
+        "  --linger=<seconds>     Time to receive responses after the last record (default 2)." << std::endl;
+}
+
+// Parses command line into settings, returns false on wrong arguments.
+bool ParseReplaySettings(int argc, char* argv[], ReplaySettings* settings)
+{
+    if (argc < 2)
+        return false;
+
+    settings->capture_file_ = argv[1];
+
+    for (int32_t i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (std::string::npos == eq)
+            return false;
+
+        std::string name = arg.substr(0, eq);
+        std::string value = arg.substr(eq + 1);
+
+        if (name == "--host")
+            settings->host_ = value;
+        else if (name == "--port")
+            settings->port_ = static_cast<uint16_t>(atoi(value.c_str()));
+        else if (name == "--speed")
+            settings->speed_ = atof(value.c_str());
+        else if (name == "--linger")
+            settings->linger_seconds_ = atoi(value.c_str());
+        else
+            return false;
+    }
+
+    return (settings->speed_ >= 0) && (settings->linger_seconds_ >= 0);
+}
+
+} // namespace network
+} // namespace starcounter
+
+using namespace starcounter::network;
+
+int main(int argc, char* argv[])
+{
+    ReplaySettings settings;
+
+    if (!ParseReplaySettings(argc, argv, &settings))
+    {
+        PrintReplayUsage();
+        return 1;
+    }
+
+    std::vector<char> contents;
+    std::vector<ReplayRecord> records;
+    if (!LoadCapture(settings.capture_file_, &contents, &records))
+        return 1;
+
+    WSADATA wsa_data;
+    if (0 != WSAStartup(MAKEWORD(2, 2), &wsa_data))
+    {
+        std::cout << "Can't initialize WinSock." << std::endl;
+        return 1;
+    }
+
+    // Resolving target address.
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addr_info = NULL;
+    if ((0 != getaddrinfo(settings.host_.c_str(), NULL, &hints, &addr_info)) || (NULL == addr_info))
+    {
+        std::cout << "Can't resolve host " << settings.host_ << "." << std::endl;
+        return 1;
+    }
+
+    sockaddr_in addr = *(sockaddr_in*) addr_info->ai_addr;
+    freeaddrinfo(addr_info);
+
+    QueryPerformanceFrequency(&g_replay_freq);
+
+    uint64_t recorded_duration_us = records.empty() ? 0 : records.back().record_.time_us_;
+
+    std::cout << "Replaying " << records.size() << " records over " << recorded_duration_us / 1000 << " ms of recorded traffic at speed " <<
+        settings.speed_ << " against " << settings.host_ << ". . ." << std::endl;
+
+    std::unordered_map<uint64_t, ReplayConnection*> connections;
+    ReplayStats stats;
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const TrafficCaptureRecord& r = records[i].record_;
+
+        // Waiting for scheduled time of the record while serving connections.
+        int64_t scheduled_us = 0;
+        if (settings.speed_ > 0)
+            scheduled_us = static_cast<int64_t>(r.time_us_ / settings.speed_);
+
+        while (true)
+        {
+            int64_t now_us = GetReplayTimeUs(start);
+            if (now_us >= scheduled_us)
+            {
+                if (now_us - scheduled_us > stats.max_lag_us_)
+                    stats.max_lag_us_ = now_us - scheduled_us;
+
+                break;
+            }
+
+            int32_t wait_ms = static_cast<int32_t>((scheduled_us - now_us) / 1000);
+            if (wait_ms > 10)
+                wait_ms = 10;
+
+            PollReplayConnections(connections, wait_ms, &stats);
+        }
+
+        stats.num_records_++;
+
+        ReplayConnection* c = NULL;
+        auto it = connections.find(r.connection_id_);
+        if (it != connections.end())
+            c = it->second;
+
+        // Connections accepted before capture started are opened on first data.
+        if ((NULL == c) && (TRAFFIC_CAPTURE_RECORD_CLOSE != r.type_))
+        {
+            c = new ReplayConnection();
+            connections[r.connection_id_] = c;
+            stats.num_connections_++;
+
+            sockaddr_in conn_addr = addr;
+            conn_addr.sin_port = htons((0 != settings.port_) ? settings.port_ : r.port_);
+
+            if (!OpenReplayConnection(c, conn_addr))
+            {
+                stats.num_failed_connections_++;
+                CloseReplayConnection(c);
+            }
+        }
+
+        if (NULL == c)
+            continue;
+
+        switch (r.type_)
+        {
+            case TRAFFIC_CAPTURE_RECORD_DATA:
+            {
+                if (c->closed_)
+                {
+                    stats.num_dropped_data_records_++;
+                    break;
+                }
+
+                c->out_.append(&contents.front() + records[i].data_offset_, r.data_len_);
+                FlushReplayConnection(c, &stats);
+
+                break;
+            }
+
+            case TRAFFIC_CAPTURE_RECORD_CLOSE:
+            {
+                c->close_pending_ = true;
+                FlushReplayConnection(c, &stats);
+
+                break;
+            }
+        }
+    }
+
+    int64_t replay_duration_us = GetReplayTimeUs(start);
+
+    // Letting pending bytes go out and responses come back.
+    int64_t linger_end_us = replay_duration_us + settings.linger_seconds_ * 1000000LL;
+    while (GetReplayTimeUs(start) < linger_end_us)
+        PollReplayConnections(connections, 10, &stats);
+
+    for (auto it = connections.begin(); it != connections.end(); ++it)
+    {
+        CloseReplayConnection(it->second);
+        delete it->second;
+    }
+
+    WSACleanup();
+
+    std::cout << "Records: " << stats.num_records_ << ", connections: " << stats.num_connections_ <<
+        ", failed connections: " << stats.num_failed_connections_ <<
+        ", data records dropped on closed connections: " << stats.num_dropped_data_records_ << std::endl;
+    std::cout << "Sent " << stats.bytes_sent_ << " bytes, received " << stats.bytes_received_ << " bytes." << std::endl;
+    std::cout << "Replay took " << replay_duration_us / 1000 << " ms, maximum lag behind schedule " << stats.max_lag_us_ / 1000 << " ms." << std::endl;
+
+    return (stats.num_failed_connections_ > 0) ? 2 : 0;
+}